@@ -77,7 +77,7 @@ ActiveNode::ActiveNode(const ActiveNodeParams &params, Factory *factory)
                                     m_activeNodeSP,
                                     m_predMutexCond);
     m_periodicVec.push_back(m_activeNodePeriodicCheck);
-    m_factory->registerPeriodicThread(*m_activeNodePeriodicCheck);
+    m_factory->registerPeriodicThread(*m_activeNodePeriodicCheck, true);
     
     /* Get rid of all the previous ProcessSlot objects */
     NameList nl = m_activeNodeSP->getProcessSlotNames();
@@ -110,7 +110,7 @@ ActiveNode::ActiveNode(const ActiveNodeParams &params, Factory *factory)
         processUpdater = 
             new ProcessSlotUpdater(ProcessSlotUpdaterFrequency, processSlotSP);
         m_periodicVec.push_back(processUpdater);
-        m_factory->registerPeriodicThread(*processUpdater);
+        m_factory->registerPeriodicThread(*processUpdater, true);
     }
 }
 
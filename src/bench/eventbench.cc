@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ *
+ * $Id$
+ */
+
+#include "clusterlibinternal.h"
+
+/*
+ * Microbenchmark of the event wrapper memory: several producers wrap
+ * events and put them into one queue, and a single consumer releases
+ * them, as with the repository and event dispatch threads.  The
+ * pooled wrappers are compared with wrappers that use the heap.
+ *
+ * Usage: eventbench [producers] [events per producer]
+ */
+
+using namespace std;
+using namespace clusterlib;
+
+/**
+ * An event wrapper that does not use EventWrapperPool.
+ */
+template<typename E>
+class HeapEventWrapper
+    : public AbstractEventWrapper
+{
+  public:
+    HeapEventWrapper(const E &e)
+        : m_e(e)
+    {
+    }
+    void *getWrapee()
+    {
+        return &m_e;
+    }
+  private:
+    E m_e;
+};
+
+/**
+ * Wraps events and puts them into a queue on its own thread.
+ */
+template <class W>
+class Producer
+{
+  public:
+    Producer(MPSCQueue<GenericEvent> &queue, uint64_t count)
+        : m_queue(queue),
+          m_count(count) {}
+
+    void run(void *param)
+    {
+        for (uint64_t i = 0; i < m_count; ++i) {
+            m_queue.put(GenericEvent(ZKEVENT, new W(i)));
+        }
+    }
+
+  private:
+    MPSCQueue<GenericEvent> &m_queue;
+    uint64_t m_count;
+};
+
+/**
+ * Run one producer per thread against a consumer on this thread.
+ *
+ * @param name the name of the wrapper to print
+ * @param producers the number of producer threads
+ * @param count the events each producer puts
+ */
+template <class W>
+void
+runBenchmark(const string &name, uint64_t producers, uint64_t count)
+{
+    MPSCQueue<GenericEvent> queue;
+    vector<Producer<W> *> producerVec;
+    vector<CXXThread<Producer<W> > *> threadVec;
+
+    int64_t startUsecs = TimerService::getCurrentTimeUsecs();
+    for (uint64_t i = 0; i < producers; ++i) {
+        producerVec.push_back(new Producer<W>(queue, count));
+        threadVec.push_back(new CXXThread<Producer<W> >());
+        threadVec.back()->Create(*producerVec.back(), &Producer<W>::run);
+    }
+
+    vector<GenericEvent> events;
+    uint64_t taken = 0;
+    while (taken < producers * count) {
+        events.clear();
+        queue.takeAllWaitMsecs(
+            -1, events, CLNumericInternal::MAX_EVENT_BATCH_SIZE);
+        taken += events.size();
+    }
+    events.clear();
+    int64_t elapsedUsecs = TimerService::getCurrentTimeUsecs() - startUsecs;
+
+    for (uint64_t i = 0; i < producers; ++i) {
+        threadVec[i]->Join();
+        delete threadVec[i];
+        delete producerVec[i];
+    }
+
+    cout << name << ": " 
+         << producers << " producer(s), "
+         << producers * count << " events in "
+         << elapsedUsecs / 1000 << " msecs ("
+         << (elapsedUsecs > 0 ?
+             (producers * count * 1000000) / elapsedUsecs : 0)
+         << " events/sec)" << endl;
+}
+
+int
+main(int ac, char **av)
+{
+    uint64_t maxProducers = (ac > 1) ? atoll(av[1]) : 4;
+    uint64_t count = (ac > 2) ? atoll(av[2]) : 1000000;
+
+    for (uint64_t producers = 1; producers <= maxProducers; producers *= 2) {
+        runBenchmark<HeapEventWrapper<uint64_t> >(
+            "HeapEventWrapper", producers, count);
+        runBenchmark<EventWrapper<uint64_t> >(
+            "EventWrapper", producers, count);
+    }
+
+    return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ *
+ * $Id$
+ */
+
+#include "clusterlibinternal.h"
+
+/*
+ * Microbenchmark of the notifyable cache: several threads look up
+ * cached notifyables by key, as with getNotifyableWaitMsecs() and
+ * updateCachedObject(), in SafeNotifyableMap and in a single map
+ * behind one lock (how SafeNotifyableMap used to be).
+ *
+ * Usage: notifyablemapbench [threads] [notifyables] [lookups per thread]
+ */
+
+using namespace std;
+using namespace boost;
+using namespace clusterlib;
+
+/**
+ * The notifyables in one map behind one lock.
+ */
+class SingleLockNotifyableMap
+{
+  public:
+    shared_ptr<NotifyableImpl> getNotifyable(const string &notifyableKey)
+    {
+        map<string, shared_ptr<NotifyableImpl> >::const_iterator ntpMapIt =
+            m_ntpMap.find(notifyableKey);
+        if (ntpMapIt == m_ntpMap.end()) {
+            return shared_ptr<NotifyableImpl>();
+        }
+        else {
+            return ntpMapIt->second;
+        }
+    }
+
+    void uniqueInsert(const shared_ptr<NotifyableImpl> &notifyableSP)
+    {
+        m_ntpMap[notifyableSP->getKey()] = notifyableSP;
+    }
+
+    const Mutex &getLock(const string &notifyableKey) const
+    {
+        return m_ntpMapLock;
+    }
+
+  private:
+    map<string, shared_ptr<NotifyableImpl> > m_ntpMap;
+    Mutex m_ntpMapLock;
+};
+
+/**
+ * Looks up random keys on its own thread.
+ */
+template <class M>
+class Reader
+{
+  public:
+    Reader(M &ntpMap, 
+           const vector<string> &keyVec, 
+           uint32_t seed, 
+           int64_t count)
+        : m_ntpMap(ntpMap),
+          m_keyVec(keyVec),
+          m_seed(seed),
+          m_count(count),
+          m_found(0) {}
+
+    void run(void *param)
+    {
+        for (int64_t i = 0; i < m_count; ++i) {
+            const string &key = m_keyVec[rand_r(&m_seed) % m_keyVec.size()];
+            Locker l(&m_ntpMap.getLock(key));
+            if (m_ntpMap.getNotifyable(key) != NULL) {
+                ++m_found;
+            }
+        }
+    }
+
+    int64_t getFound() const { return m_found; }
+
+  private:
+    M &m_ntpMap;
+    const vector<string> &m_keyVec;
+    uint32_t m_seed;
+    int64_t m_count;
+    int64_t m_found;
+};
+
+/**
+ * Run one reader per thread against a map.
+ *
+ * @param name the name of the map to print
+ * @param ntpMap the map with every notifyable of keyVec
+ * @param keyVec the keys to look up
+ * @param threads the number of reader threads
+ * @param count the lookups each reader does
+ * @return false if a lookup missed
+ */
+template <class M>
+bool
+runBenchmark(const string &name,
+             M &ntpMap,
+             const vector<string> &keyVec,
+             int64_t threads,
+             int64_t count)
+{
+    vector<Reader<M> *> readerVec;
+    vector<CXXThread<Reader<M> > *> threadVec;
+
+    int64_t startUsecs = TimerService::getCurrentTimeUsecs();
+    for (int64_t i = 0; i < threads; ++i) {
+        readerVec.push_back(new Reader<M>(ntpMap, keyVec, i + 1, count));
+        threadVec.push_back(new CXXThread<Reader<M> >());
+        threadVec.back()->Create(*readerVec.back(), &Reader<M>::run);
+    }
+    int64_t found = 0;
+    for (int64_t i = 0; i < threads; ++i) {
+        threadVec[i]->Join();
+        found += readerVec[i]->getFound();
+        delete threadVec[i];
+        delete readerVec[i];
+    }
+    int64_t elapsedUsecs = TimerService::getCurrentTimeUsecs() - startUsecs;
+
+    cout << name << ": " << threads << " thread(s), "
+         << threads * count << " lookups in "
+         << elapsedUsecs / 1000 << " msecs ("
+         << (elapsedUsecs > 0 ?
+             (threads * count * 1000000) / elapsedUsecs : 0)
+         << " lookups/sec)" << endl;
+    return (found == threads * count);
+}
+
+int
+main(int ac, char **av)
+{
+    int64_t maxThreads = (ac > 1) ? atoll(av[1]) : 8;
+    int64_t notifyables = (ac > 2) ? atoll(av[2]) : 10000;
+    int64_t count = (ac > 3) ? atoll(av[3]) : 1000000;
+
+    Factory factory("inmemory:notifyablemapbench");
+    shared_ptr<Root> root = factory.createClient()->getRoot();
+
+    SafeNotifyableMap safeNotifyableMap;
+    SingleLockNotifyableMap singleLockNotifyableMap;
+    vector<shared_ptr<Application> > applicationVec;
+    vector<string> keyVec;
+    for (int64_t i = 0; i < notifyables; ++i) {
+        ostringstream oss;
+        oss << "app" << i;
+        applicationVec.push_back(
+            root->getApplication(oss.str(), CREATE_IF_NOT_FOUND));
+        shared_ptr<NotifyableImpl> notifyableSP =
+            dynamic_pointer_cast<NotifyableImpl>(applicationVec.back());
+        safeNotifyableMap.uniqueInsert(notifyableSP);
+        singleLockNotifyableMap.uniqueInsert(notifyableSP);
+        keyVec.push_back(notifyableSP->getKey());
+    }
+
+    bool success = true;
+    for (int64_t threads = 1; threads <= maxThreads; threads *= 2) {
+        success &= runBenchmark("SingleLockNotifyableMap",
+                                singleLockNotifyableMap,
+                                keyVec,
+                                threads,
+                                count);
+        success &= runBenchmark("SafeNotifyableMap",
+                                safeNotifyableMap,
+                                keyVec,
+                                threads,
+                                count);
+    }
+
+    for (int64_t i = 0; i < notifyables; ++i) {
+        safeNotifyableMap.erase(
+            dynamic_pointer_cast<NotifyableImpl>(applicationVec[i]));
+        applicationVec[i]->remove(true);
+    }
+    return success ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ *
+ * $Id$
+ */
+
+#include "clusterlibinternal.h"
+
+/*
+ * Microbenchmark of the queues used for the internal event channels:
+ * several producers put into one queue that a single consumer takes
+ * from, as with the external event, client and timer queues.
+ *
+ * Usage: queuebench [producers] [elements per producer]
+ */
+
+using namespace std;
+using namespace clusterlib;
+
+/**
+ * Puts elements into a queue on its own thread.  Each element holds
+ * the producer index in the upper 32 bits and its sequence number in
+ * the lower 32 bits, so the consumer can check the order.
+ */
+template <class Q>
+class Producer
+{
+  public:
+    Producer(Q &queue, uint64_t index, uint64_t count)
+        : m_queue(queue),
+          m_index(index),
+          m_count(count) {}
+
+    void run(void *param)
+    {
+        for (uint64_t i = 0; i < m_count; ++i) {
+            m_queue.put((m_index << 32) | i);
+        }
+    }
+
+  private:
+    Q &m_queue;
+    uint64_t m_index;
+    uint64_t m_count;
+};
+
+/**
+ * Run one producer per thread against a consumer on this thread.
+ *
+ * @param name the name of the queue to print
+ * @param producers the number of producer threads
+ * @param count the elements each producer puts
+ * @param batchSize the most elements the consumer takes at a time
+ * @return false if elements were lost or out of order
+ */
+template <class Q>
+bool
+runBenchmark(const string &name, 
+             uint64_t producers, 
+             uint64_t count,
+             size_t batchSize)
+{
+    Q queue;
+    vector<Producer<Q> *> producerVec;
+    vector<CXXThread<Producer<Q> > *> threadVec;
+    vector<uint64_t> nextSequence(producers, 0);
+
+    int64_t startUsecs = TimerService::getCurrentTimeUsecs();
+    for (uint64_t i = 0; i < producers; ++i) {
+        producerVec.push_back(new Producer<Q>(queue, i, count));
+        threadVec.push_back(new CXXThread<Producer<Q> >());
+        threadVec.back()->Create(*producerVec.back(), &Producer<Q>::run);
+    }
+
+    bool ordered = true;
+    vector<uint64_t> elements;
+    uint64_t taken = 0;
+    while (taken < producers * count) {
+        elements.clear();
+        if (batchSize == 1) {
+            elements.push_back(queue.take());
+        }
+        else {
+            queue.takeAllWaitMsecs(-1, elements, batchSize);
+        }
+        for (size_t i = 0; i < elements.size(); ++i) {
+            uint64_t index = elements[i] >> 32;
+            if ((index >= producers) ||
+                ((elements[i] & 0xffffffffULL) != nextSequence[index])) {
+                ordered = false;
+            }
+            else {
+                ++nextSequence[index];
+            }
+        }
+        taken += elements.size();
+    }
+    int64_t elapsedUsecs = TimerService::getCurrentTimeUsecs() - startUsecs;
+
+    for (uint64_t i = 0; i < producers; ++i) {
+        threadVec[i]->Join();
+        delete threadVec[i];
+        delete producerVec[i];
+    }
+
+    cout << name << " (batch " << batchSize << "): " 
+         << producers << " producer(s), "
+         << producers * count << " elements in "
+         << elapsedUsecs / 1000 << " msecs ("
+         << (elapsedUsecs > 0 ?
+             (producers * count * 1000000) / elapsedUsecs : 0)
+         << " elements/sec)" << (ordered ? "" : " OUT OF ORDER") << endl;
+    return ordered && queue.empty();
+}
+
+int
+main(int ac, char **av)
+{
+    uint64_t maxProducers = (ac > 1) ? atoll(av[1]) : 4;
+    uint64_t count = (ac > 2) ? atoll(av[2]) : 1000000;
+
+    bool success = true;
+    for (uint64_t producers = 1; producers <= maxProducers; producers *= 2) {
+        for (size_t batchSize = 1; batchSize <= 256; batchSize *= 256) {
+            success &= runBenchmark<BlockingQueue<uint64_t> >(
+                "BlockingQueue", producers, count, batchSize);
+            success &= runBenchmark<MPSCQueue<uint64_t> >(
+                "MPSCQueue", producers, count, batchSize);
+        }
+    }
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ *
+ * $Id$
+ */
+
+#include "clusterlibinternal.h"
+
+/*
+ * Microbenchmark of Timer: scheduling and cancelling many pending
+ * timers (as with many outstanding locks and timer handlers), and
+ * firing timers that are already due.
+ *
+ * Usage: timerbench [timers]
+ */
+
+using namespace std;
+using namespace clusterlib;
+
+/**
+ * Counts the timer events fired.
+ */
+class FireCounter
+    : public EventListener<TimerEvent<int32_t> >
+{
+  public:
+    FireCounter()
+        : m_fired(0) {}
+
+    virtual void eventReceived(const EventSource<TimerEvent<int32_t> > &source,
+                               const TimerEvent<int32_t> &e)
+    {
+        Locker l(&m_mutex);
+        ++m_fired;
+        m_cond.signal();
+    }
+
+    /**
+     * Wait until count events have fired.
+     */
+    void waitForFired(int64_t count)
+    {
+        Locker l(&m_mutex);
+        while (m_fired < count) {
+            m_cond.wait(m_mutex);
+        }
+    }
+
+  private:
+    Mutex m_mutex;
+    Cond m_cond;
+    int64_t m_fired;
+};
+
+/**
+ * Print the rate of an operation.
+ */
+static void
+printRate(const string &name, int64_t count, int64_t elapsedUsecs)
+{
+    cout << name << ": " << count << " in " << elapsedUsecs / 1000
+         << " msecs ("
+         << (elapsedUsecs > 0 ? (count * 1000000) / elapsedUsecs : 0)
+         << "/sec)" << endl;
+}
+
+int
+main(int ac, char **av)
+{
+    int64_t count = (ac > 1) ? atoll(av[1]) : 100000;
+
+    Timer<int32_t> timer;
+    FireCounter counter;
+    timer.addListener(&counter);
+
+    /* Far-future timers with random deadlines, as pending lock timeouts. */
+    vector<TimerId> ids;
+    int64_t nowMsecs = TimerService::getCurrentTimeMsecs();
+    int64_t startUsecs = TimerService::getCurrentTimeUsecs();
+    for (int64_t i = 0; i < count; ++i) {
+        ids.push_back(timer.scheduleAt(nowMsecs + 3600 * 1000 +
+                                       (rand() % (3600 * 1000)),
+                                       static_cast<int32_t>(i)));
+    }
+    printRate("schedule",
+              count,
+              TimerService::getCurrentTimeUsecs() - startUsecs);
+
+    /* Cancel in a different order than the deadlines. */
+    bool success = true;
+    startUsecs = TimerService::getCurrentTimeUsecs();
+    for (int64_t i = 0; i < count; ++i) {
+        success &= timer.cancelAlarm(ids[(i * 7919) % count]);
+    }
+    printRate("cancel",
+              count,
+              TimerService::getCurrentTimeUsecs() - startUsecs);
+
+    /* Timers that are already due fire back to back. */
+    startUsecs = TimerService::getCurrentTimeUsecs();
+    for (int64_t i = 0; i < count; ++i) {
+        timer.scheduleAfter(0, static_cast<int32_t>(i));
+    }
+    counter.waitForFired(count);
+    printRate("schedule and fire",
+              count,
+              TimerService::getCurrentTimeUsecs() - startUsecs);
+
+    timer.removeListener(&counter);
+    return success ? 0 : 1;
+}
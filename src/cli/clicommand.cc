@@ -29,6 +29,7 @@ const string CliCommand::KEY_ARG = "key";
 const string CliCommand::VALUE_ARG = "value";
 const string CliCommand::ZKNODE_ARG = "zknode";
 const string CliCommand::FORCE_ARG = "force";
+const string CliCommand::CACHED_ARG = "cached";
 
 const string CliCommand::UNKNOWN_ARG_HELP_MSG = "Unknown argument";
 
@@ -45,6 +45,9 @@ class CliCommand
     /** Name of the force argument */
     static const std::string FORCE_ARG;
 
+    /** Name of the cached argument */
+    static const std::string CACHED_ARG;
+
     /** 
      * The type of the the arguments (how they will be converted).
      */
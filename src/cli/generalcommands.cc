@@ -193,6 +193,11 @@ GetChildren::GetChildren(Client *client)
            "The notifyable to get the children", 
            NotifyableArg,
            false);
+    addArg(CliCommand::CACHED_ARG,
+           "false", 
+           "True indicates only get the children already in the cache", 
+           BoolArg, 
+           false);
 }
 
 void 
@@ -208,7 +213,9 @@ GetChildren::action()
     }
     
     NotifyableList::const_iterator nlIt;
-    NotifyableList nl = notifyableSP->getMyChildren();
+    NotifyableList nl = notifyableSP->getMyChildren(
+        getArg(CliCommand::CACHED_ARG).getBoolArg() ? 
+        CACHED_ONLY : LOAD_FROM_REPOSITORY);
     CliParams *params = CliParams::getInstance();
     for (nlIt = nl.begin(); nlIt != nl.end(); nlIt++) {
         cout << (*nlIt)->getKey() << endl;
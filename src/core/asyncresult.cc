@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ * 
+ * $Id$
+ */
+
+#include "clusterlibinternal.h"
+
+using namespace std;
+
+namespace clusterlib {
+
+AsyncResultBase::AsyncResultBase(AsyncResultCallback *callback)
+    : mp_callback(callback),
+      m_done(false),
+      mp_rethrowFunction(NULL)
+{
+}
+
+bool
+AsyncResultBase::waitMsecs(int64_t msecTimeout) const
+{
+    TRACE(CL_LOG, "waitMsecs");
+
+    if (msecTimeout < -1) {
+        ostringstream oss;
+        oss << "waitMsecs: Cannot have msecTimeout < -1 (" 
+            << msecTimeout << ")";
+        throw InvalidArgumentsException(oss.str());
+    }
+
+    int64_t maxMsecs = TimerService::getCurrentTimeMsecs() + msecTimeout;
+    Locker l(&m_mutex);
+    while (!m_done) {
+        if (msecTimeout == -1) {
+            m_cond.wait(m_mutex);
+        }
+        else {
+            int64_t remainingMsecs = 
+                maxMsecs - TimerService::getCurrentTimeMsecs();
+            if (remainingMsecs <= 0) {
+                return false;
+            }
+            m_cond.waitMsecs(m_mutex, remainingMsecs);
+        }
+    }
+    return true;
+}
+
+bool
+AsyncResultBase::isDone() const
+{
+    Locker l(&m_mutex);
+    return m_done;
+}
+
+bool
+AsyncResultBase::hasFailed() const
+{
+    Locker l(&m_mutex);
+    return (mp_rethrowFunction != NULL);
+}
+
+string
+AsyncResultBase::getError() const
+{
+    Locker l(&m_mutex);
+    return m_error;
+}
+
+void
+AsyncResultBase::rethrowIfFailed() const
+{
+    waitMsecs(-1);
+
+    RethrowFunction rethrowFunction = NULL;
+    string error;
+    {
+        Locker l(&m_mutex);
+        rethrowFunction = mp_rethrowFunction;
+        error = m_error;
+    }
+    if (rethrowFunction != NULL) {
+        rethrowFunction(error);
+    }
+}
+
+void
+AsyncResultBase::setFailed(RethrowFunction rethrowFunction,
+                           const string &message)
+{
+    TRACE(CL_LOG, "setFailed");
+
+    {
+        Locker l(&m_mutex);
+        mp_rethrowFunction = rethrowFunction;
+        m_error = message;
+    }
+    setDone();
+}
+
+void
+AsyncResultBase::setDone()
+{
+    TRACE(CL_LOG, "setDone");
+
+    {
+        Locker l(&m_mutex);
+        if (m_done) {
+            throw InconsistentInternalStateException(
+                "setDone: Already completed");
+        }
+        m_done = true;
+        m_cond.signal_all();
+    }
+    /*
+     * The operation has completed even if the callback throws, so
+     * the exception must not reach the code that completed it.
+     */
+    if (mp_callback != NULL) {
+        try {
+            mp_callback->asyncCompleted(*this);
+        }
+        catch (std::exception &e) {
+            LOG_ERROR(CL_LOG,
+                      "setDone: Callback threw: %s",
+                      e.what());
+        }
+        catch (...) {
+            LOG_ERROR(CL_LOG, "setDone: Callback threw an unknown exception");
+        }
+    }
+}
+
+}	/* End of 'namespace clusterlib' */
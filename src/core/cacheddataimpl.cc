@@ -88,6 +88,294 @@ CachedDataImpl::CachedDataImpl(NotifyableImpl *pNotifyable)
     m_stat.version = CLNumeric::INITIAL_ZK_VERSION;
 }
 
+int32_t
+CachedDataImpl::publish(bool unconditional)
+{
+    TRACE(CL_LOG, "publish");
+
+    getNotifyable()->throwIfRemoved();
+
+    Locker l(&getCachedDataLock());
+
+    string key;
+    bool chunked = false;
+    string encodedData = encodePublishData(&key, &chunked);
+    return publishEncodedData(key, encodedData, chunked, unconditional);
+}
+
+int32_t
+CachedDataImpl::publishEncodedData(const string &key,
+                                   const string &encodedData,
+                                   bool chunked,
+                                   bool unconditional)
+{
+    TRACE(CL_LOG, "publishEncodedData");
+
+    LOG_DEBUG(CL_LOG,
+              "Tried to publish %s for notifyable %s to %s "
+              "with current version %d, unconditional %d\n",
+              key.c_str(),
+              getNotifyable()->getKey().c_str(), 
+              encodedData.c_str(),
+              getVersion(),
+              unconditional);
+
+    Stat stat;
+    try {
+        if (chunked) {
+            SAFE_CALL_ZK(getOps()->getRepository()->setChunkedNodeData(
+                             key,
+                             encodedData,
+                             ((unconditional == false) ? getVersion(): -1),
+                             &stat),
+                         "Setting of %s failed: %s",
+                         key.c_str(),
+                         false,
+                         true);
+        }
+        else {
+            SAFE_CALL_ZK(getOps()->getRepository()->setNodeData(
+                             key,
+                             encodedData,
+                             ((unconditional == false) ? getVersion(): -1),
+                             &stat),
+                         "Setting of %s failed: %s",
+                         key.c_str(),
+                         false,
+                         true);
+        }
+    } catch (const zk::BadVersionException &e) {
+        throw PublishVersionException(e.what());
+    }
+    
+    /* 
+     * Since we should have the lock, the data should be identical to
+     * the zk data.  When the lock is released, clusterlib events will
+     * try to push this change again.  
+     */
+    setStat(stat);
+    return stat.version;
+}
+
+/**
+ * Publishes cached data.  The data is encoded and written with
+ * setNodeDataAsync() by the caller, and the completion of the write
+ * queues the task on the asynchronous operation workers, which set
+ * the stat.  Data that must be split into chunks is written by the
+ * workers with setChunkedNodeData().
+ */
+class PublishTask
+    : public AsyncTask,
+      public zk::AsyncOperationCallback
+{
+  public:
+    PublishTask(CachedDataImpl *cachedData,
+                const shared_ptr<NotifyableImpl> &notifyableSP,
+                bool unconditional,
+                const shared_ptr<AsyncResult<int32_t> > &resultSP)
+        : mp_cachedData(cachedData),
+          m_notifyableSP(notifyableSP),
+          m_unconditional(unconditional),
+          m_resultSP(resultSP),
+          m_chunked(false),
+          m_split(false),
+          m_completed(false),
+          m_rc(ZOK),
+          m_outstanding(1)
+    {
+        memset(&m_stat, 0, sizeof(m_stat));
+    }
+
+    /**
+     * Encode the data and issue the write.  If this throws, the task
+     * has not been issued.  Otherwise, it may have run and been
+     * deleted by the time this returns.
+     */
+    void issue()
+    {
+        TRACE(CL_LOG, "issue");
+
+        {
+            Locker l(&mp_cachedData->getCachedDataLock());
+
+            m_encodedData = 
+                mp_cachedData->encodePublishData(&m_key, &m_chunked);
+            m_split = m_chunked && 
+                zk::Repository::isChunkedValue(m_encodedData);
+            getOps()->beginAsync();
+            if (!m_split) {
+                __sync_add_and_fetch(&m_outstanding, 1);
+                try {
+                    getOps()->getRepository()->setNodeDataAsync(
+                        m_key,
+                        m_encodedData,
+                        ((m_unconditional == false) ? 
+                         mp_cachedData->getVersion() : -1),
+                        this);
+                }
+                catch (std::exception &e) {
+                    /* 
+                     * A write that could not be sent to the
+                     * repository has already been completed with
+                     * the error.
+                     */
+                    LOG_WARN(CL_LOG,
+                             "issue: Setting of %s failed: %s",
+                             m_key.c_str(),
+                             e.what());
+                    if (!m_completed) {
+                        m_rc = ZSYSTEMERROR;
+                        m_completed = true;
+                        writeDone();
+                    }
+                }
+            }
+        }
+        writeDone();
+    }
+
+    virtual void operationCompleted(const zk::AsyncOperation &operation)
+    {
+        m_rc = operation.getRc();
+        if (m_rc == ZOK) {
+            m_stat = operation.getStat();
+        }
+        m_completed = true;
+        writeDone();
+    }
+
+    virtual void run()
+    {
+        TRACE(CL_LOG, "run");
+
+        int32_t version;
+        if (m_split) {
+            Locker l(&mp_cachedData->getCachedDataLock());
+            version = mp_cachedData->publishEncodedData(
+                m_key, m_encodedData, m_chunked, m_unconditional);
+        }
+        else {
+            if (m_rc != ZOK) {
+                try {
+                    SAFE_CALL_ZK(
+                        zk::ZooKeeperAdapter::throwErrorCode(
+                            string("Unable to set data of node ") + m_key,
+                            m_rc,
+                            (getOps()->getRepository()->getState() ==
+                             zk::Repository::AS_CONNECTED)),
+                        "Setting of %s failed: %s",
+                        m_key.c_str(),
+                        false,
+                        true);
+                } catch (const zk::BadVersionException &e) {
+                    throw PublishVersionException(e.what());
+                }
+            }
+
+            /* Like setChunkedNodeData(), remove the older chunks. */
+            if (m_chunked && (m_stat.numChildren > 0)) {
+                getOps()->getRepository()->removeDataChunks(
+                    m_key, "", m_stat.version);
+            }
+
+            /* 
+             * Writes issued back to back may complete on different
+             * workers, so keep the stat of the latest one.
+             */
+            Locker l(&mp_cachedData->getCachedDataLock());
+            if (mp_cachedData->getVersion() < m_stat.version) {
+                mp_cachedData->setStat(m_stat);
+            }
+            version = m_stat.version;
+        }
+        m_resultSP->setValue(version);
+    }
+
+    virtual AsyncResultBase &getResult() 
+    {
+        return *m_resultSP;
+    }
+
+  private:
+    /**
+     * Used by SAFE_CALL_ZK.
+     */
+    FactoryOps *getOps()
+    {
+        return mp_cachedData->getOps();
+    }
+
+    /**
+     * Count down the completed write (or the end of issue()).  The
+     * last one queues the task on the workers.
+     */
+    void writeDone()
+    {
+        if (__sync_sub_and_fetch(&m_outstanding, 1) == 0) {
+            getOps()->finishAsync(this);
+        }
+    }
+
+  private:
+    /**
+     * The cached data, which lives as long as m_notifyableSP.
+     */
+    CachedDataImpl *mp_cachedData;
+    shared_ptr<NotifyableImpl> m_notifyableSP;
+    bool m_unconditional;
+    shared_ptr<AsyncResult<int32_t> > m_resultSP;
+
+    /**
+     * What encodePublishData() returned.
+     */
+    string m_key;
+    string m_encodedData;
+    bool m_chunked;
+
+    /**
+     * Must the data be split into chunks (written by run())?
+     */
+    bool m_split;
+
+    /**
+     * Has the write completed?
+     */
+    bool m_completed;
+
+    /**
+     * The ZK return code and the stat of the write.
+     */
+    int32_t m_rc;
+    Stat m_stat;
+
+    /**
+     * The write if not completed yet, plus one until issue() is done.
+     */
+    volatile int32_t m_outstanding;
+};
+
+shared_ptr<AsyncResult<int32_t> >
+CachedDataImpl::publishAsync(bool unconditional, 
+                             AsyncResultCallback *callback)
+{
+    TRACE(CL_LOG, "publishAsync");
+
+    getNotifyable()->throwIfRemoved();
+
+    shared_ptr<AsyncResult<int32_t> > resultSP(
+        new AsyncResult<int32_t>(callback));
+    PublishTask *task = 
+        new PublishTask(this, getNotifyable(), unconditional, resultSP);
+    try {
+        task->issue();
+    }
+    catch (...) {
+        delete task;
+        throw;
+    }
+    return resultSP;
+}
+
 shared_ptr<NotifyableImpl>
 CachedDataImpl::getNotifyable()
 {
@@ -32,6 +32,12 @@ class CachedDataImpl
 
     virtual int32_t getVersion();
 
+    virtual int32_t publish(bool unconditional = false);
+
+    virtual boost::shared_ptr<AsyncResult<int32_t> > publishAsync(
+        bool unconditional = false,
+        AsyncResultCallback *callback = NULL);
+
     virtual void getStats(int64_t *czxid = NULL,
                           int64_t *mzxid = NULL,
                           int64_t *ctime = NULL,
@@ -67,6 +73,35 @@ class CachedDataImpl
      */
     virtual void loadDataFromRepository(bool setWatchesOnly) = 0;
 
+    /**
+     * Encode the cached data to publish it.  Called with the cached
+     * data lock held, so it may also update the cached data (i.e. a
+     * history of the published values).
+     *
+     * @param pKey set to the key of the repository node to publish to
+     * @param pChunked set to true if the data is stored with
+     *        setChunkedNodeData(), so it may be larger than a node
+     * @return the encoded data
+     */
+    virtual std::string encodePublishData(std::string *pKey, 
+                                          bool *pChunked) = 0;
+
+    /**
+     * Write encoded data to the repository and set the stat to that
+     * of the write.  Must hold the cached data lock.
+     *
+     * @param key the key of the repository node
+     * @param encodedData the data from encodePublishData()
+     * @param chunked the chunked flag from encodePublishData()
+     * @param unconditional If true, write even if this is not the
+     *        latest version.
+     * @return the published version
+     */
+    int32_t publishEncodedData(const std::string &key,
+                               const std::string &encodedData,
+                               bool chunked,
+                               bool unconditional);
+
     /**
      * Get the lock for cached data.
      */
@@ -95,6 +130,17 @@ class CachedDataImpl
         m_stat = stat;
     }
 
+    /**
+     * Get the data length of the last loaded repository data.  Used
+     * to size the buffer when reading it again.
+     *
+     * @return the data length in bytes
+     */
+    int32_t getDataLength() const
+    {
+        return m_stat.dataLength;
+    }
+
     /**
      * Should the update happen?  Our current version and our new
      * version should indicate whether this is the case.  If the Stat
@@ -26,49 +26,13 @@ CachedKeyValuesImpl::CachedKeyValuesImpl(NotifyableImpl *pNotifyable)
 {
 }
 
-int32_t
-CachedKeyValuesImpl::publish(bool unconditional)
+string
+CachedKeyValuesImpl::encodePublishData(string *pKey, bool *pChunked)
 {
-    TRACE(CL_LOG, "publish");
-
-    getNotifyable()->throwIfRemoved();
-
-    string keyValuesKey = 
-        PropertyListImpl::createKeyValJsonObjectKey(getNotifyable()->getKey());
-
-    Locker l(&getCachedDataLock());
-
-    string encodedJsonObject = JSONCodec::encode(m_keyValues);
-    LOG_DEBUG(CL_LOG,
-              "Tried to publish key values for notifyable %s to %s "
-              "with current version %d, unconditional %d\n",
-              getNotifyable()->getKey().c_str(), 
-              encodedJsonObject.c_str(),
-              getVersion(),
-              unconditional);
-
-    Stat stat;
-    try {
-        SAFE_CALL_ZK(getOps()->getRepository()->setNodeData(
-                         keyValuesKey,
-                         encodedJsonObject,
-                         ((unconditional == false) ? getVersion(): -1),
-                         &stat),
-                     "Setting of %s failed: %s",
-                     keyValuesKey.c_str(),
-                     false,
-                     true);
-    } catch (const zk::BadVersionException &e) {
-        throw PublishVersionException(e.what());
-    }
-    
-    /* 
-     * Since we should have the lock, the data should be identical to
-     * the zk data.  When the lock is released, clusterlib events will
-     * try to push this change again.  
-     */
-    setStat(stat);
-    return stat.version;
+    *pKey = PropertyListImpl::createKeyValJsonObjectKey(
+        getNotifyable()->getKey());
+    *pChunked = true;
+    return JSONCodec::encode(m_keyValues);
 }
 
 void
@@ -84,16 +48,18 @@ CachedKeyValuesImpl::loadDataFromRepository(bool setWatchesOnly)
     Locker l(&getCachedDataLock());
 
     SAFE_CALLBACK_ZK(
-        getOps()->getRepository()->getNodeData(
+        getOps()->getRepository()->getChunkedNodeData(
             keyValuesKey,
             encodedJsonValue,
             getOps()->getZooKeeperEventAdapter(),
             getOps()->getCachedObjectChangeHandlers()->
             getChangeHandler(
                 CachedObjectChangeHandlers::PROPERTYLIST_VALUES_CHANGE),
-            &stat),
-        getOps()->getRepository()->getNodeData(
-            keyValuesKey, encodedJsonValue, NULL, NULL, &stat),
+            &stat,
+            getDataLength()),
+        getOps()->getRepository()->getChunkedNodeData(
+            keyValuesKey, encodedJsonValue, NULL, NULL, &stat,
+            getDataLength()),
         CachedObjectChangeHandlers::PROPERTYLIST_VALUES_CHANGE,
         keyValuesKey,
         "Loading keyValuesKey %s failed: %s",
@@ -26,50 +26,13 @@ CachedProcessInfoImpl::CachedProcessInfoImpl(NotifyableImpl *notifyable)
 {
 }
 
-int32_t
-CachedProcessInfoImpl::publish(bool unconditional)
+string
+CachedProcessInfoImpl::encodePublishData(string *pKey, bool *pChunked)
 {
-    TRACE(CL_LOG, "publish");
-
-    getNotifyable()->throwIfRemoved();
-
-    string processInfoKey = 
-        ProcessSlotImpl::createProcessInfoJsonArrKey(
-            getNotifyable()->getKey());
-
-    Locker l(&getCachedDataLock());
-
-    string encodedJsonObject = JSONCodec::encode(m_portArr);
-    LOG_DEBUG(CL_LOG,
-              "Tried to publish process info for notifyable %s to %s "
-              "with current version %d, unconditional %d\n",
-              getNotifyable()->getKey().c_str(), 
-              encodedJsonObject.c_str(),
-              getVersion(),
-              unconditional);
-
-    Stat stat;
-    try {
-        SAFE_CALL_ZK(getOps()->getRepository()->setNodeData(
-                         processInfoKey,
-                         encodedJsonObject,
-                         ((unconditional == false) ? getVersion(): -1),
-                         &stat),
-                     "Setting of %s failed: %s",
-                     processInfoKey.c_str(),
-                     false,
-                     true);
-    } catch (const zk::BadVersionException &e) {
-        throw PublishVersionException(e.what());
-    }
-    
-    /* 
-     * Since we should have the lock, the data should be identical to
-     * the zk data.  When the lock is released, clusterlib events will
-     * try to push this change again.  
-     */
-    setStat(stat);
-    return stat.version;
+    *pKey = ProcessSlotImpl::createProcessInfoJsonArrKey(
+        getNotifyable()->getKey());
+    *pChunked = false;
+    return JSONCodec::encode(m_portArr);
 }
 
 void
@@ -92,9 +55,11 @@ CachedProcessInfoImpl::loadDataFromRepository(bool setWatchesOnly)
             getOps()->getCachedObjectChangeHandlers()->
             getChangeHandler(
                 CachedObjectChangeHandlers::PROCESSSLOT_PROCESSINFO_CHANGE),
-            &stat),
+            &stat,
+            getDataLength()),
         getOps()->getRepository()->getNodeData(
-            processInfoKey, encodedJsonValue, NULL, NULL, &stat),
+            processInfoKey, encodedJsonValue, NULL, NULL, &stat,
+            getDataLength()),
         CachedObjectChangeHandlers::PROCESSSLOT_PROCESSINFO_CHANGE,
         processInfoKey,
         "Loading processInfoKey %s failed: %s",
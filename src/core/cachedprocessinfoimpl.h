@@ -26,7 +26,7 @@ class CachedProcessInfoImpl
       public virtual CachedProcessInfo
 {
   public:
-    virtual int32_t publish(bool unconditional = false);
+    virtual std::string encodePublishData(std::string *pKey, bool *pChunked);
 
     virtual void loadDataFromRepository(bool setWatchesOnly);
 
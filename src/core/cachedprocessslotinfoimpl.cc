@@ -30,50 +30,13 @@ CachedProcessSlotInfoImpl::CachedProcessSlotInfoImpl(
     m_processSlotInfoArr[CachedProcessSlotInfoImpl::MAX_PROCESSES] = -1;
 }
 
-int32_t
-CachedProcessSlotInfoImpl::publish(bool unconditional)
+string
+CachedProcessSlotInfoImpl::encodePublishData(string *pKey, bool *pChunked)
 {
-    TRACE(CL_LOG, "publish");
-
-    getNotifyable()->throwIfRemoved();
-
-    string processSlotInfoKey = 
-        NodeImpl::createProcessSlotInfoJSONObjectKey(
-            getNotifyable()->getKey());
-
-    Locker l(&getCachedDataLock());
-
-    string encodedJsonObject = JSONCodec::encode(m_processSlotInfoArr);
-    LOG_DEBUG(CL_LOG,
-              "Tried to publish process slot info for notifyable %s to %s "
-              "with current version %d, unconditional %d\n",
-              getNotifyable()->getKey().c_str(), 
-              encodedJsonObject.c_str(),
-              getVersion(),
-              unconditional);
-
-    Stat stat;
-    try {
-        SAFE_CALL_ZK(getOps()->getRepository()->setNodeData(
-                         processSlotInfoKey,
-                         encodedJsonObject,
-                         ((unconditional == false) ? getVersion(): -1),
-                         &stat),
-                     "Setting of %s failed: %s",
-                     processSlotInfoKey.c_str(),
-                     false,
-                     true);
-    } catch (const zk::BadVersionException &e) {
-        throw PublishVersionException(e.what());
-    }
-    
-    /* 
-     * Since we should have the lock, the data should be identical to
-     * the zk data.  When the lock is released, clusterlib events will
-     * try to push this change again.  
-     */
-    setStat(stat);
-    return stat.version;
+    *pKey = NodeImpl::createProcessSlotInfoJSONObjectKey(
+        getNotifyable()->getKey());
+    *pChunked = false;
+    return JSONCodec::encode(m_processSlotInfoArr);
 }
 
 bool
@@ -132,9 +95,11 @@ CachedProcessSlotInfoImpl::loadDataFromRepository(bool setWatchesOnly)
             getOps()->getCachedObjectChangeHandlers()->
             getChangeHandler(
                 CachedObjectChangeHandlers::NODE_PROCESS_SLOT_INFO_CHANGE),
-            &stat),
+            &stat,
+            getDataLength()),
         getOps()->getRepository()->getNodeData(
-            processSlotInfoKey, encodedJsonValue, NULL, NULL, &stat),
+            processSlotInfoKey, encodedJsonValue, NULL, NULL, &stat,
+            getDataLength()),
         CachedObjectChangeHandlers::NODE_PROCESS_SLOT_INFO_CHANGE,
         processSlotInfoKey,
         "Loading processSlotInfoKey %s failed: %s",
@@ -26,7 +26,7 @@ class CachedProcessSlotInfoImpl
       public virtual CachedProcessSlotInfo
 {
   public:
-    virtual int32_t publish(bool unconditional = false);
+    virtual std::string encodePublishData(std::string *pKey, bool *pChunked);
 
     virtual void loadDataFromRepository(bool setWatchesOnly);
 
@@ -84,49 +84,13 @@ CachedShardsImpl::~CachedShardsImpl()
     m_hashRange = NULL;
 }
 
-int32_t
-CachedShardsImpl::publish(bool unconditional)
+string
+CachedShardsImpl::encodePublishData(string *pKey, bool *pChunked)
 {
-    TRACE(CL_LOG, "publish");
-
-    getNotifyable()->throwIfRemoved();
-
-    string shardsKey = DataDistributionImpl::createShardJsonObjectKey(
+    *pKey = DataDistributionImpl::createShardJsonObjectKey(
         getNotifyable()->getKey());
-
-    Locker l(&getCachedDataLock());
-
-    string encodedJsonObject = JSONCodec::encode(marshalShards());
-    LOG_DEBUG(CL_LOG,
-              "Tried to publish shards for notifyable %s to %s "
-              "with current version %d, unconditional %d\n",
-              getNotifyable()->getKey().c_str(), 
-              encodedJsonObject.c_str(),
-              getVersion(),
-              unconditional);
-
-    Stat stat;
-    try {
-        SAFE_CALL_ZK(getOps()->getRepository()->setNodeData(
-                         shardsKey,
-                         encodedJsonObject,
-                         ((unconditional == false) ? getVersion(): -1),
-                         &stat),
-                     "Setting of %s failed: %s",
-                     shardsKey.c_str(),
-                     false,
-                     true);
-    } catch (const zk::BadVersionException &e) {
-        throw PublishVersionException(e.what());
-    }
-    
-    /* 
-     * Since we should have the lock, the data should be identical to
-     * the zk data.  When the lock is released, clusterlib events will
-     * try to push this change again.  
-     */
-    setStat(stat);
-    return stat.version;
+    *pChunked = true;
+    return JSONCodec::encode(marshalShards());
 }
 
 void
@@ -142,16 +106,18 @@ CachedShardsImpl::loadDataFromRepository(bool setWatchesOnly)
     Locker l(&getCachedDataLock());
 
     SAFE_CALLBACK_ZK(
-        getOps()->getRepository()->getNodeData(
+        getOps()->getRepository()->getChunkedNodeData(
             shardsKey,
             encodedJsonValue,
             getOps()->getZooKeeperEventAdapter(),
             getOps()->getCachedObjectChangeHandlers()->
             getChangeHandler(
                 CachedObjectChangeHandlers::SHARDS_CHANGE),
-            &stat),
-        getOps()->getRepository()->getNodeData(
-            shardsKey, encodedJsonValue, NULL, NULL, &stat),
+            &stat,
+            getDataLength()),
+        getOps()->getRepository()->getChunkedNodeData(
+            shardsKey, encodedJsonValue, NULL, NULL, &stat,
+            getDataLength()),
         CachedObjectChangeHandlers::SHARDS_CHANGE,
         shardsKey,
         "Loading shardsKey %s failed: %s",
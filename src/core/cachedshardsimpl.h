@@ -102,7 +102,7 @@ class CachedShardsImpl
       public virtual CachedShards
 {
   public:
-    virtual int32_t publish(bool unconditional = false);
+    virtual std::string encodePublishData(std::string *pKey, bool *pChunked);
 
     virtual void loadDataFromRepository(bool setWatchesOnly);
 
@@ -29,18 +29,12 @@ CachedStateImpl::CachedStateImpl(NotifyableImpl *notifyable,
 {
 }
 
-int32_t
-CachedStateImpl::publish(bool unconditional)
+string
+CachedStateImpl::encodePublishData(string *pKey, bool *pChunked)
 {
-    TRACE(CL_LOG, "publish");
-
-    getNotifyable()->throwIfRemoved();
-
-    string stateKey = 
-        NotifyableImpl::createStateJSONArrayKey(
-            getNotifyable()->getKey(), m_stateType);
-
-    Locker l(&getCachedDataLock());
+    *pKey = NotifyableImpl::createStateJSONArrayKey(
+        getNotifyable()->getKey(), m_stateType);
+    *pChunked = false;
 
     /*
      * Add the time set to each new state and chop down to the max
@@ -55,37 +49,7 @@ CachedStateImpl::publish(bool unconditional)
         m_historyArr.resize(m_maxHistorySize);
     }
 
-    string encodedJsonObject = JSONCodec::encode(m_historyArr);
-    LOG_DEBUG(CL_LOG,
-             "Tried to publish state for notifyable %s to %s "
-             "with current version %d, unconditional %d\n",
-             getNotifyable()->getKey().c_str(), 
-             encodedJsonObject.c_str(),
-             getVersion(),
-             unconditional);
-
-    Stat stat;
-    try {
-        SAFE_CALL_ZK(getOps()->getRepository()->setNodeData(
-                         stateKey,
-                         encodedJsonObject,
-                         ((unconditional == false) ? getVersion(): -1),
-                         &stat),
-                     "Setting of %s failed: %s",
-                     stateKey.c_str(),
-                     false,
-                     true);
-    } catch (const zk::BadVersionException &e) {
-        throw PublishVersionException(e.what());
-    }
-    
-    /* 
-     * Since we should have the lock, the data should be identical to
-     * the zk data.  When the lock is released, clusterlib events will
-     * try to push this change again.  
-     */
-    setStat(stat);
-    return stat.version;
+    return JSONCodec::encode(m_historyArr);
 }
 
 void
@@ -121,9 +85,11 @@ CachedStateImpl::loadDataFromRepository(bool setWatchesOnly)
             encodedJsonValue,
             getOps()->getZooKeeperEventAdapter(),
             handler,
-            &stat),
+            &stat,
+            getDataLength()),
         getOps()->getRepository()->getNodeData(
-            stateKey, encodedJsonValue, NULL, NULL, &stat),
+            stateKey, encodedJsonValue, NULL, NULL, &stat,
+            getDataLength()),
         change,
         stateKey,
         "Loading stateKey %s failed: %s",
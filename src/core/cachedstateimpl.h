@@ -26,7 +26,7 @@ class CachedStateImpl
       public virtual CachedState
 {
   public:
-    virtual int32_t publish(bool unconditional = false);
+    virtual std::string encodePublishData(std::string *pKey, bool *pChunked);
 
     virtual void loadDataFromRepository(bool setWatchesOnly);
 
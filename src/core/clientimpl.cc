@@ -14,6 +14,12 @@
  */
 
 #include "clusterlibinternal.h"
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#else
+#include <fcntl.h>
+#endif
+#include <unistd.h>
 
 using namespace std;
 using namespace boost;
@@ -40,21 +46,90 @@ ClientImpl::getRoot()
     }
 }
 
+ClientImpl::ClientImpl(FactoryOps *fp, int32_t handlerThreads)
+    : mp_f(fp),
+      m_eventFd(-1),
+      m_eventWriteFd(-1),
+      m_eventFdSignaled(0),
+      m_endEventReceived(false),
+      m_jsonRPCRequestCounter(0),
+      m_jsonRPCResponseHandler(NULL),
+      m_jsonRPCMethodHandler(NULL)
+{
+    TRACE(CL_LOG, "ClientImpl");
+
+    if (handlerThreads < 0) {
+        throw InvalidArgumentsException(
+            "ClientImpl: handlerThreads cannot be < 0");
+    }
+
+    /**
+     * Empty out the handlers table.
+     */
+    m_eventHandlers.clear();
+
+    /*
+     * Without handler threads, the application runs the handlers
+     * from its own loop through the event file descriptor.
+     */
+    if (handlerThreads == 0) {
+        createEventFd();
+        return;
+    }
+
+    /*
+     * Create the handler workers if the handlers run in parallel.
+     * They must exist before the event thread starts routing events
+     * to them.
+     */
+    if (handlerThreads > 1) {
+        for (int32_t i = 0; i < handlerThreads; ++i) {
+            m_handlerQueues.push_back(new MPSCQueue<UserEventRequest>());
+            CXXThread<ClientImpl> *threadP = new CXXThread<ClientImpl>();
+            threadP->Create(*this,
+                            &ClientImpl::dispatchHandlerRequests,
+                            reinterpret_cast<void *>(i));
+            m_handlerThreads.push_back(threadP);
+        }
+    }
+
+    /**
+     * Create the thread to dispatch cluster events to specific user
+     * program handlers. The clusterlib cache object affected by the
+     * event already has been updated.
+     */
+    m_eventThread.Create(*this, &ClientImpl::consumeUserEvents);
+}
+
 void
 ClientImpl::sendEvent(UserEventPayload *cepp)
 {
     TRACE(CL_LOG, "sendEvent");
 
     m_queue.put(cepp);
+    signalEventFd();
 }
 
 ClientImpl::~ClientImpl()
 {
     /*
-     * Wait till all events have been handled.
+     * Wait till all events have been handled.  Without an event
+     * thread, the events still queued are handled here.
      */
-    m_predMutexCond.predSignal();
-    m_eventThread.Join();
+    if (m_eventFd == -1) {
+        m_predMutexCond.predSignal();
+        m_eventThread.Join();
+        stopHandlerWorkers();
+    }
+    else {
+        while (dispatchPending(static_cast<int32_t>(
+                   CLNumericInternal::MAX_EVENT_BATCH_SIZE)) > 0) {
+        }
+        if (m_eventWriteFd != m_eventFd) {
+            close(m_eventWriteFd);
+        }
+        close(m_eventFd);
+    }
 
     /*
      * Clean up.
@@ -63,6 +138,7 @@ ClientImpl::~ClientImpl()
     cancelJSONRPCResponseHandler();
     Locker l(getEventHandlersLock());
     m_firstTimeEventHandlers.clear();
+    m_pendingInitialRuns.clear();
     m_eventHandlers.clear();
 }
 
@@ -89,7 +165,7 @@ ClientImpl::consumeUserEvents(void *param)
 {
     TRACE(CL_LOG, "consumeUserEvents");
 
-    UserEventPayload *uepp;
+    vector<UserEventPayload *> ueppVec;
 
     LOG_INFO(CL_LOG,
              "Starting thread with ClientImpl::consumeUserEvents(), "
@@ -97,78 +173,395 @@ ClientImpl::consumeUserEvents(void *param)
              this,
              ProcessThreadService::getTid());
 
-    bool endEventReceived = false;
-    string rootKey = NotifyableKeyManipulator::createRootKey();
-    while (!m_predMutexCond.predWaitMsecs(0) && (endEventReceived != true)) {
-        /*
-         * Run all the handlers that have initialRun true and then
-         * move them into the regular user event multimap.
-         */
-        {
-            Locker l1(getEventHandlersLock());
-            Event userEventMask;
-            vector<UserEventHandler *>::iterator ftEhIt;
-            for (ftEhIt = m_firstTimeEventHandlers.begin();
-                 ftEhIt != m_firstTimeEventHandlers.end();
-                 ++ftEhIt) {
-                userEventMask = (*ftEhIt)->getMask();
-                (*ftEhIt)->handleUserEventDelivery(userEventMask);
-                m_eventHandlers.insert(
-                    pair<const string, UserEventHandler *>
-                    ((*ftEhIt)->getNotifyable()->getKey(), (*ftEhIt)));
-            }
-            m_firstTimeEventHandlers.clear();
-        }
+    while (!m_predMutexCond.predWaitMsecs(0) && (m_endEventReceived != true)) {
+        runFirstTimeHandlers();
 
         LOG_DEBUG(CL_LOG,
                   "consumeUserEvents: Waiting for %" PRId64 " msecs to take "
                   "from the event queue...",
                   eventMsecTimeout);
-	if (!m_queue.takeWaitMsecs(eventMsecTimeout, uepp)) {
+        /* Take every event that is waiting at once. */
+        ueppVec.clear();
+        if (!m_queue.takeAllWaitMsecs(
+                eventMsecTimeout, 
+                ueppVec, 
+                CLNumericInternal::MAX_EVENT_BATCH_SIZE)) {
             continue;
         }
+        handleUserEvents(ueppVec);
+    }
+
+    LOG_INFO(CL_LOG,
+             "Ending thread with ClientImpl::consumeUserEvents(): "
+             "this = %p, thread = %" PRIu32,
+             this,
+             ProcessThreadService::getTid());
+}
+
+int32_t
+ClientImpl::getEventFd()
+{
+    return m_eventFd;
+}
+
+int32_t
+ClientImpl::dispatchPending(int32_t maxEvents)
+{
+    TRACE(CL_LOG, "dispatchPending");
+
+    if (m_eventFd == -1) {
+        throw InvalidMethodException(
+            "dispatchPending: The client has handler threads");
+    }
+    if (maxEvents <= 0) {
+        throw InvalidArgumentsException(
+            "dispatchPending: maxEvents must be > 0");
+    }
+
+    /*
+     * Drain the event file descriptor before clearing the signal and
+     * clear the signal before looking at the queue.  A put that still
+     * sees the signal set has queued its event before the drain
+     * below, and a put after the signal is cleared writes again, so
+     * no event is left pending with the descriptor unreadable.
+     */
+    if (m_eventFdSignaled) {
+        drainEventFd();
+        __sync_bool_compare_and_swap(&m_eventFdSignaled, 1, 0);
+    }
+
+    runFirstTimeHandlers();
+
+    vector<UserEventPayload *> ueppVec;
+    m_queue.drainTo(ueppVec, maxEvents);
+    handleUserEvents(ueppVec);
+
+    /* Whatever is left over is still pending. */
+    if (!m_queue.empty()) {
+        signalEventFd();
+    }
+    return static_cast<int32_t>(ueppVec.size());
+}
+
+void
+ClientImpl::createEventFd()
+{
+    TRACE(CL_LOG, "createEventFd");
+
+#ifdef HAVE_SYS_EVENTFD_H
+    m_eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_eventFd == -1) {
+        ostringstream oss;
+        oss << "createEventFd: eventfd failed with errno=" << errno 
+            << ", strerror=" << strerror(errno);
+        throw SystemFailureException(oss.str());
+    }
+    m_eventWriteFd = m_eventFd;
+#else
+    int pipeFd[2];
+    if (pipe(pipeFd) != 0) {
+        ostringstream oss;
+        oss << "createEventFd: pipe failed with errno=" << errno 
+            << ", strerror=" << strerror(errno);
+        throw SystemFailureException(oss.str());
+    }
+    for (int32_t i = 0; i < 2; ++i) {
+        if ((fcntl(pipeFd[i], F_SETFL, 
+                   fcntl(pipeFd[i], F_GETFL, 0) | O_NONBLOCK) == -1) ||
+            (fcntl(pipeFd[i], F_SETFD, FD_CLOEXEC) == -1)) {
+            ostringstream oss;
+            oss << "createEventFd: fcntl failed with errno=" << errno 
+                << ", strerror=" << strerror(errno);
+            close(pipeFd[0]);
+            close(pipeFd[1]);
+            throw SystemFailureException(oss.str());
+        }
+    }
+    m_eventFd = pipeFd[0];
+    m_eventWriteFd = pipeFd[1];
+#endif
+}
+
+void
+ClientImpl::drainEventFd()
+{
+#ifdef HAVE_SYS_EVENTFD_H
+    eventfd_t value;
+    eventfd_read(m_eventFd, &value);
+#else
+    char buf[64];
+    while (read(m_eventFd, buf, sizeof(buf)) > 0) {
+    }
+#endif
+}
+
+void
+ClientImpl::signalEventFd()
+{
+    if ((m_eventFd != -1) &&
+        __sync_bool_compare_and_swap(&m_eventFdSignaled, 0, 1)) {
+#ifdef HAVE_SYS_EVENTFD_H
+        eventfd_write(m_eventWriteFd, 1);
+#else
+        char byte = 0;
+        ssize_t ret = write(m_eventWriteFd, &byte, 1);
+        (void) ret;
+#endif
+    }
+}
+
+void
+ClientImpl::runFirstTimeHandlers()
+{
+    TRACE(CL_LOG, "runFirstTimeHandlers");
+
+    /*
+     * Run all the handlers that have initialRun true and then
+     * move them into the regular user event multimap.  With
+     * handler workers, the initial run is queued on the worker of
+     * the notifyable ahead of any event it gets afterwards.
+     */
+    Locker l1(getEventHandlersLock());
+    Event userEventMask;
+    vector<UserEventHandler *>::iterator ftEhIt;
+    for (ftEhIt = m_firstTimeEventHandlers.begin();
+         ftEhIt != m_firstTimeEventHandlers.end();
+         ++ftEhIt) {
+        if (m_handlerQueues.empty()) {
+            userEventMask = (*ftEhIt)->getMask() & ~EN_COALESCE;
+            (*ftEhIt)->handleUserEventDelivery(userEventMask);
+        }
+        else {
+            m_pendingInitialRuns.insert(*ftEhIt);
+            m_handlerQueues[getHandlerWorker(
+                (*ftEhIt)->getNotifyable()->getKey())]->put(
+                    UserEventRequest(*ftEhIt));
+        }
+        m_eventHandlers.insert(
+            pair<const string, UserEventHandler *>
+            ((*ftEhIt)->getNotifyable()->getKey(), (*ftEhIt)));
+    }
+    m_firstTimeEventHandlers.clear();
+}
+
+void
+ClientImpl::handleUserEvents(const vector<UserEventPayload *> &ueppVec)
+{
+    TRACE(CL_LOG, "handleUserEvents");
+
+    UserEventPayload *uepp;
+    vector<UserEventPayload *>::const_iterator ueppVecIt;
+    map<string, size_t> lastEventIndexMap;
+    map<string, Event> coalescedEventsMap;
+    string rootKey = NotifyableKeyManipulator::createRootKey();
+
+    /*
+     * Find the last event of each notifyable in the batch and the
+     * events queued for it, for the handlers that merge them.
+     */
+    for (size_t i = 0; i < ueppVec.size(); ++i) {
+        if (ueppVec[i] != NULL) {
+            lastEventIndexMap[ueppVec[i]->getKey()] = i;
+            coalescedEventsMap[ueppVec[i]->getKey()] |= 
+                ueppVec[i]->getEvent();
+        }
+    }
+
+    for (ueppVecIt = ueppVec.begin(); 
+         ueppVecIt != ueppVec.end(); 
+         ++ueppVecIt) {
+        uepp = *ueppVecIt;
 
         /*
          * Exit on NULL user event payload, this is a signal from
          * the Factory to terminate.
          */
-	if (uepp == NULL) {
+        if (uepp == NULL) {
             throw InconsistentInternalStateException(
-                "ConsumeUserEvents: Got a NULL UserEventPayload!");
-	}
+                "handleUserEvents: Got a NULL UserEventPayload!");
+        }
 
-	LOG_DEBUG(CL_LOG,
-                  "ConsumeUserEvents: Received user event %p with "
+        LOG_DEBUG(CL_LOG,
+                  "handleUserEvents: Received user event %p with "
                   "path %s and Event %s",
                   uepp,
                   uepp->getKey().c_str(),
-                  UserEventHandler::getEventsString(uepp->getEvent()).c_str());
+                  UserEventHandler::getEventsString(
+                      uepp->getEvent()).c_str());
 
-        /* Dispatch this event. */
-        dispatchHandlers(uepp->getKey(), uepp->getEvent());
+        /* 
+         * Dispatch this event (nothing is dispatched after the
+         * end event).
+         */
+        if (!m_endEventReceived) {
+            Event coalescedEvents = 0;
+            if (lastEventIndexMap[uepp->getKey()] == 
+                static_cast<size_t>(ueppVecIt - ueppVec.begin())) {
+                coalescedEvents = coalescedEventsMap[uepp->getKey()];
+            }
+            routeHandlers(
+                uepp->getKey(), uepp->getEvent(), coalescedEvents);
+        }
 
         /* Is this is the end event? */
         if ((uepp->getKey().compare(rootKey) == 0) && 
             (uepp->getEvent() == EN_ENDEVENT)) {
-            endEventReceived = true;
+            m_endEventReceived = true;
         }
 
         /* Recycle the payload. */
-	delete uepp;
+        delete uepp;
+    }
+}
+
+void
+ClientImpl::routeHandlers(const string &key, 
+                          Event e, 
+                          Event coalescedEvents)
+{
+    TRACE(CL_LOG, "routeHandlers");
+
+    if (m_handlerQueues.empty()) {
+        dispatchHandlers(key, e, coalescedEvents);
+    }
+    else {
+        m_handlerQueues[getHandlerWorker(key)]->put(
+            UserEventRequest(key, e, coalescedEvents));
     }
+}
+
+size_t
+ClientImpl::getHandlerWorker(const string &key) const
+{
+    /* djb2, cheap and good enough to spread the keys. */
+    uint32_t hash = 5381;
+    for (string::const_iterator it = key.begin(); it != key.end(); ++it) {
+        hash = ((hash << 5) + hash) + static_cast<unsigned char>(*it);
+    }
+    return hash % m_handlerQueues.size();
+}
+
+void
+ClientImpl::dispatchHandlerRequests(void *param)
+{
+    TRACE(CL_LOG, "dispatchHandlerRequests");
 
+    size_t index = reinterpret_cast<size_t>(param);
+    MPSCQueue<UserEventRequest> *queueP = m_handlerQueues[index];
     LOG_INFO(CL_LOG,
-             "Ending thread with ClientImpl::consumeUserEvents(): "
-             "this = %p, thread = %" PRIu32,
+             "Starting thread with ClientImpl::dispatchHandlerRequests(), "
+             "this: %p, worker: %" PRIuPTR ", thread: %" PRId32,
              this,
+             index,
              ProcessThreadService::getTid());
+
+    vector<UserEventRequest> requests;
+    size_t requestIndex = 0;
+    while (true) {
+        if (requestIndex == requests.size()) {
+            requests.clear();
+            requestIndex = 0;
+            queueP->takeAllWaitMsecs(
+                -1, requests, CLNumericInternal::MAX_EVENT_BATCH_SIZE);
+        }
+        const UserEventRequest &request = requests[requestIndex++];
+        if (request.m_end) {
+            break;
+        }
+        if (request.mp_initialRunHandler != NULL) {
+            doInitialRun(request.mp_initialRunHandler);
+        }
+        else {
+            dispatchHandlers(request.m_key, 
+                             request.m_event, 
+                             request.m_coalescedEvents);
+        }
+    }
+
+    LOG_INFO(CL_LOG,
+             "Ending thread with ClientImpl::dispatchHandlerRequests(): "
+             "this: %p, worker: %" PRIuPTR ", thread: %" PRId32,
+             this,
+             index,
+             ProcessThreadService::getTid());
+}
+
+void
+ClientImpl::stopHandlerWorkers()
+{
+    TRACE(CL_LOG, "stopHandlerWorkers");
+
+    vector<MPSCQueue<UserEventRequest> *>::iterator queueIt;
+    for (queueIt = m_handlerQueues.begin();
+         queueIt != m_handlerQueues.end();
+         ++queueIt) {
+        (*queueIt)->put(UserEventRequest());
+    }
+    for (size_t i = 0; i < m_handlerThreads.size(); ++i) {
+        m_handlerThreads[i]->Join();
+        delete m_handlerThreads[i];
+        delete m_handlerQueues[i];
+    }
+    m_handlerThreads.clear();
+    m_handlerQueues.clear();
+}
+
+void
+ClientImpl::doInitialRun(UserEventHandler *uehp)
+{
+    TRACE(CL_LOG, "doInitialRun");
+
+    multimap<UserEventHandler *, int32_t>::iterator runningIt;
+    {
+        Locker l(getEventHandlersLock());
+        multiset<UserEventHandler *>::iterator pendingIt = 
+            m_pendingInitialRuns.find(uehp);
+        if (pendingIt == m_pendingInitialRuns.end()) {
+            /* Cancelled while queued, uehp may be gone. */
+            return;
+        }
+        m_pendingInitialRuns.erase(pendingIt);
+        runningIt = m_runningInitialRuns.insert(
+            make_pair(uehp, ProcessThreadService::getTid()));
+    }
+
+    try {
+        uehp->handleUserEventDelivery(uehp->getMask() & ~EN_COALESCE);
+    }
+    catch (...) {
+        Locker l(getEventHandlersLock());
+        m_runningInitialRuns.erase(runningIt);
+        m_initialRunCond.signal_all();
+        throw;
+    }
+
+    Locker l(getEventHandlersLock());
+    m_runningInitialRuns.erase(runningIt);
+    m_initialRunCond.signal_all();
+}
+
+bool
+ClientImpl::isInitialRunInProgress(UserEventHandler *uehp) const
+{
+    int32_t tid = ProcessThreadService::getTid();
+    pair<multimap<UserEventHandler *, int32_t>::const_iterator,
+         multimap<UserEventHandler *, int32_t>::const_iterator> range =
+        m_runningInitialRuns.equal_range(uehp);
+    for (; range.first != range.second; ++range.first) {
+        if (range.first->second != tid) {
+            return true;
+        }
+    }
+    return false;
 }
 
 /*
  * Call all handlers for the given Notifyable and user Event.
  */
 void
-ClientImpl::dispatchHandlers(const string &key, Event e)
+ClientImpl::dispatchHandlers(const string &key, 
+                             Event e, 
+                             Event coalescedEvents)
 {
     TRACE(CL_LOG, "dispatchHandlers");
 
@@ -178,7 +571,7 @@ ClientImpl::dispatchHandlers(const string &key, Event e)
         return;
     }
 
-    EventHandlersMultimapRange range = m_eventHandlers.equal_range(key);
+    EventHandlersMultimapRange range;
     EventHandlersMultimap copy;
     EventHandlersIterator ehIt;
     UserEventHandler *uehp;
@@ -191,6 +584,7 @@ ClientImpl::dispatchHandlers(const string &key, Event e)
 
     {
         Locker l1(getEventHandlersLock());
+        range = m_eventHandlers.equal_range(key);
 
         /*
          * If there are no handlers registered for this key,
@@ -232,9 +626,16 @@ ClientImpl::dispatchHandlers(const string &key, Event e)
             }
 
             /*
-             * If this handler is not for the given event, then skip it.
+             * If this handler is not for the given event, then skip
+             * it.  Handlers merging their events only run for the
+             * last queued event on the notifyable.
              */
-            if ((uehp->getMask() & e) == 0) {
+            if (uehp->getCoalesce()) {
+                if ((uehp->getMask() & coalescedEvents) == 0) {
+                    continue;
+                }
+            }
+            else if ((uehp->getMask() & e) == 0) {
                 continue;
             }
 
@@ -270,7 +671,18 @@ ClientImpl::dispatchHandlers(const string &key, Event e)
         /*
          * Now call each handler.
          */
-        uehp->handleUserEventDelivery(e);
+        if (uehp->getCoalesce()) {
+            /* One call for each kind of event, lowest bit first. */
+            Event events = uehp->getMask() & coalescedEvents;
+            while (events != 0) {
+                Event event = events & -events;
+                events &= ~event;
+                uehp->handleUserEventDelivery(event);
+            }
+        }
+        else {
+            uehp->handleUserEventDelivery(e);
+        }
     }
 }
 
@@ -289,6 +701,8 @@ ClientImpl::registerHandler(UserEventHandler *uehp)
              uehp->getNotifyable()->getKey().c_str());
 
     Locker l1(getEventHandlersLock());
+
+    getOps()->addSubscription(this, uehp);
     
     /*
      * If the user event handler is to be run immediately put in
@@ -296,6 +710,7 @@ ClientImpl::registerHandler(UserEventHandler *uehp)
      */
     if (uehp->getInitialRun()) {
         m_firstTimeEventHandlers.push_back(uehp);
+        signalEventFd();
     }
     else {
         m_eventHandlers.insert(pair<const string, UserEventHandler *>
@@ -326,12 +741,31 @@ ClientImpl::cancelHandler(UserEventHandler *uehp)
                   uehp);
     if (ftEhIt != m_firstTimeEventHandlers.end()) {
         m_firstTimeEventHandlers.erase(ftEhIt);
+        getOps()->removeSubscription(this, uehp, key);
         return true;
     }
 
+    /*
+     * A handler worker must be done with uehp once this returns:
+     * take a queued initial run out, or wait for the one in
+     * progress (unless it is the caller).
+     */
+    multiset<UserEventHandler *>::iterator pendingIt = 
+        m_pendingInitialRuns.find(uehp);
+    if (pendingIt != m_pendingInitialRuns.end()) {
+        m_pendingInitialRuns.erase(pendingIt);
+    }
+    else {
+        while (isInitialRunInProgress(uehp)) {
+            m_initialRunCond.wait(*getEventHandlersLock());
+        }
+    }
+
+    range = m_eventHandlers.equal_range(key);
     for (ehIt = range.first; ehIt != range.second; ehIt++) {
         if ((*ehIt).second == uehp) {
             m_eventHandlers.erase(ehIt);
+            getOps()->removeSubscription(this, uehp, key);
             return true;
         }
     }
@@ -18,6 +18,73 @@
 
 namespace clusterlib {
 
+/**
+ * Handlers queued for a handler worker of a client.
+ */
+class UserEventRequest
+{
+  public:
+    /**
+     * Constructor for the request that stops a worker.
+     */
+    UserEventRequest()
+        : m_event(EN_NOEVENT),
+          m_coalescedEvents(EN_NOEVENT),
+          mp_initialRunHandler(NULL),
+          m_end(true) {}
+
+    /**
+     * Constructor for the request that dispatches an event.
+     *
+     * @param key the key of the notifyable
+     * @param e the event on this notifyable
+     * @param coalescedEvents see ClientImpl::dispatchHandlers()
+     */
+    UserEventRequest(const std::string &key, Event e, Event coalescedEvents)
+        : m_key(key),
+          m_event(e),
+          m_coalescedEvents(coalescedEvents),
+          mp_initialRunHandler(NULL),
+          m_end(false) {}
+
+    /**
+     * Constructor for the request that does the initial run of a
+     * handler.
+     *
+     * @param initialRunHandler the handler
+     */
+    explicit UserEventRequest(UserEventHandler *initialRunHandler)
+        : m_event(EN_NOEVENT),
+          m_coalescedEvents(EN_NOEVENT),
+          mp_initialRunHandler(initialRunHandler),
+          m_end(false) {}
+
+    /**
+     * The key of the notifyable.
+     */
+    std::string m_key;
+
+    /**
+     * The event on the notifyable.
+     */
+    Event m_event;
+
+    /**
+     * The events handlers merging their events are called with.
+     */
+    Event m_coalescedEvents;
+
+    /**
+     * The handler to do the initial run of, NULL otherwise.
+     */
+    UserEventHandler *mp_initialRunHandler;
+
+    /**
+     * Does this request stop the worker?
+     */
+    bool m_end;
+};
+
 /**
  * Implements class Client.
  */
@@ -50,31 +117,22 @@ class ClientImpl
 
     virtual uint64_t fetchAndIncrRequestCounter();
 
+    virtual int32_t getEventFd();
+
+    virtual int32_t dispatchPending(int32_t maxEvents);
+
     /*
      * Internal functions not used by outside clients
      */
   public:
     /**
      * Constructor used by the factory.
+     *
+     * @param fp the factory delegate
+     * @param handlerThreads the number of threads that run the
+     *        handlers (see Factory::createClient())
      */
-    ClientImpl(FactoryOps *fp)
-        : mp_f(fp),
-          m_jsonRPCRequestCounter(0),
-          m_jsonRPCResponseHandler(NULL),
-          m_jsonRPCMethodHandler(NULL)
-    {
-        /**
-         * Empty out the handlers table.
-         */
-        m_eventHandlers.clear();
-
-        /**
-         * Create the thread to dispatch cluster events to
-         * specific user program handlers. The clusterlib cache
-         * object affected by the event already has been updated.
-         */
-        m_eventThread.Create(*this, &ClientImpl::consumeUserEvents);
-    }
+    ClientImpl(FactoryOps *fp, int32_t handlerThreads = 1);
 
     /**
      * Get the associated factory delegate object.
@@ -113,6 +171,89 @@ class ClientImpl
      */
     void consumeUserEvents(void *param);
 
+    /**
+     * Create the event file descriptor, an eventfd if the platform
+     * has one or else a non-blocking pipe.
+     */
+    void createEventFd();
+
+    /**
+     * Make the event file descriptor unreadable.
+     */
+    void drainEventFd();
+
+    /**
+     * Make the event file descriptor readable, if there is one and
+     * it is not already.
+     */
+    void signalEventFd();
+
+    /**
+     * Do the initial run of the handlers registered with initialRun
+     * set and start sending them events.
+     */
+    void runFirstTimeHandlers();
+
+    /**
+     * Run the handlers of events taken from the queue and delete the
+     * payloads.
+     *
+     * @param ueppVec the payloads, in the order they were queued
+     */
+    void handleUserEvents(const std::vector<UserEventPayload *> &ueppVec);
+
+    /**
+     * Run the handlers of an event now, or hand them to the handler
+     * worker of the notifyable if there are workers.
+     *
+     * @param key the key of the notifyable
+     * @param e the event on this notifyable
+     * @param coalescedEvents see dispatchHandlers()
+     */
+    void routeHandlers(const std::string &key, 
+                       Event e, 
+                       Event coalescedEvents);
+
+    /**
+     * Get the handler worker of a notifyable.  All the handlers
+     * registered on a notifyable run on the same worker.
+     *
+     * @param key the key of the notifyable
+     * @return the index of the worker
+     */
+    size_t getHandlerWorker(const std::string &key) const;
+
+    /**
+     * Run the handlers queued for one handler worker, in order,
+     * until it is stopped.
+     *
+     * @param param the index of the worker
+     */
+    void dispatchHandlerRequests(void *param);
+
+    /**
+     * Stop the handler workers after they run the handlers already
+     * queued, wait for them and delete them.
+     */
+    void stopHandlerWorkers();
+
+    /**
+     * Do an initial run queued for a handler worker, unless
+     * cancelHandler() took it out of m_pendingInitialRuns.
+     *
+     * @param uehp the handler
+     */
+    void doInitialRun(UserEventHandler *uehp);
+
+    /**
+     * Is a handler worker other than this thread doing an initial
+     * run of a handler?  The event handlers lock must be held.
+     *
+     * @param uehp the handler
+     * @return true if the initial run is in progress
+     */
+    bool isInitialRunInProgress(UserEventHandler *uehp) const;
+
     /**
      * Get the event handlers registry lock.
      *
@@ -126,8 +267,14 @@ class ClientImpl
      *
      * @param key the key of the notifyable
      * @param e the event on this notifyable
+     * @param coalescedEvents the events on this notifyable that
+     *        handlers merging their events are called for, one at a
+     *        time, or 0 if a later event on this notifyable is
+     *        already queued
      */
-    void dispatchHandlers(const std::string &key, Event e);
+    void dispatchHandlers(const std::string &key, 
+                          Event e, 
+                          Event coalescedEvents);
 
   private:
     /**
@@ -146,6 +293,40 @@ class ClientImpl
      */
     CXXThread<ClientImpl> m_eventThread;
 
+    /**
+     * The eventfd (or read end of a pipe) that is readable while
+     * events are pending, -1 if the event thread consumes them.
+     */
+    int32_t m_eventFd;
+
+    /**
+     * The descriptor written to make m_eventFd readable (the write
+     * end of the pipe, or m_eventFd itself if it is an eventfd).
+     */
+    int32_t m_eventWriteFd;
+
+    /**
+     * Set while m_eventFd is readable.  Only the put that sets it
+     * writes to m_eventFd.
+     */
+    volatile int32_t m_eventFdSignaled;
+
+    /**
+     * Was the end event handled?
+     */
+    bool m_endEventReceived;
+
+    /**
+     * The queues of the handler workers (empty if the event thread
+     * runs every handler itself).
+     */
+    std::vector<MPSCQueue<UserEventRequest> *> m_handlerQueues;
+
+    /**
+     * The handler workers, one per queue.
+     */
+    std::vector<CXXThread<ClientImpl> *> m_handlerThreads;
+
     /**
      * Map of user event handlers.
      */
@@ -157,7 +338,25 @@ class ClientImpl
     std::vector<UserEventHandler *> m_firstTimeEventHandlers;
 
     /**
-     * Protects both m_eventHandlers and m_firstTimeEventHandlers
+     * Handlers with an initial run queued for a handler worker, once
+     * per queued run.
+     */
+    std::multiset<UserEventHandler *> m_pendingInitialRuns;
+
+    /**
+     * Handlers that a handler worker is doing the initial run of,
+     * with the thread of the worker.
+     */
+    std::multimap<UserEventHandler *, int32_t> m_runningInitialRuns;
+
+    /**
+     * Signaled when a handler worker finishes an initial run.
+     */
+    Cond m_initialRunCond;
+
+    /**
+     * Protects m_eventHandlers, m_firstTimeEventHandlers,
+     * m_pendingInitialRuns and m_runningInitialRuns
      */
     Mutex m_eventHandlersLock;
 
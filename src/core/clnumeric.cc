@@ -102,4 +102,34 @@ const int32_t CLNumericInternal::PROCESSSLOT_COMPONENTS_MIN_COUNT = 8;
 
 const size_t CLNumericInternal::SEQUENCE_NUMBER_SIZE = 10;
 
+const int32_t CLNumericInternal::MAX_ZNODE_DATA_LENGTH = 1024 * 1024;
+const int32_t CLNumericInternal::DEFAULT_READ_BUFFER_SIZE = 4 * 1024;
+const int32_t CLNumericInternal::MAX_RETAINED_READ_BUFFER_SIZE = 64 * 1024;
+
+const size_t CLNumericInternal::MAX_DELETE_BATCH_SIZE = 1000;
+
+const size_t CLNumericInternal::MAX_KNOWN_PATH_COUNT = 4096;
+
+const size_t CLNumericInternal::MAX_WATCH_REARM_BATCH_SIZE = 1000;
+
+const int32_t CLNumericInternal::MAX_DECODED_DATA_LENGTH = 64 * 1024 * 1024;
+
+const int32_t CLNumericInternal::DATA_CHUNK_SIZE = 512 * 1024;
+
+const int32_t CLNumericInternal::MAX_CHUNKED_DATA_ATTEMPTS = 5;
+
+const size_t CLNumericInternal::MAX_POOLED_EVENT_WRAPPERS = 4096;
+
+const size_t CLNumericInternal::EVENT_WRAPPER_BATCH_SIZE = 64;
+
+const size_t CLNumericInternal::MAX_EVENT_BATCH_SIZE = 256;
+
+const int32_t CLNumericInternal::PERIODIC_MAX_FAILURE_BACKOFF = 16;
+
+const int32_t CLNumericInternal::PERIODIC_JITTER_PERCENT = 10;
+
+const int32_t CLNumericInternal::ASYNC_WORKER_THREADS = 16;
+
+const int32_t CLNumericInternal::SAFE_NOTIFYABLE_MAP_SHARDS = 32;
+
 }	/* End of 'namespace clusterlib' */
@@ -59,6 +59,100 @@ class CLNumericInternal
      */
     static const size_t SEQUENCE_NUMBER_SIZE;
 
+    /**
+     * Largest znode data that can be read (ZooKeeper's default
+     * jute.maxbuffer).
+     */
+    static const int32_t MAX_ZNODE_DATA_LENGTH;
+
+    /**
+     * Initial size of the per-thread buffer used to read znode data.
+     */
+    static const int32_t DEFAULT_READ_BUFFER_SIZE;
+
+    /**
+     * A per-thread read buffer that grew beyond this size for a
+     * large read is shrunk back afterwards.
+     */
+    static const int32_t MAX_RETAINED_READ_BUFFER_SIZE;
+
+    /**
+     * Maximum number of znodes removed by a single batch of a
+     * recursive delete.
+     */
+    static const size_t MAX_DELETE_BATCH_SIZE;
+
+    /**
+     * Maximum number of znodes a ZooKeeperAdapter remembers as
+     * existing when creating ancestors.
+     */
+    static const size_t MAX_KNOWN_PATH_COUNT;
+
+    /**
+     * Maximum number of watches a ZooKeeperAdapter sets again at a
+     * time after its session expired.
+     */
+    static const size_t MAX_WATCH_REARM_BATCH_SIZE;
+
+    /**
+     * Largest decompressed znode data that is accepted, to catch a
+     * corrupt length in the header of compressed data.
+     */
+    static const int32_t MAX_DECODED_DATA_LENGTH;
+
+    /**
+     * Values that are still larger than this once encoded are stored
+     * in chunks of this size by Repository::setChunkedNodeData().
+     */
+    static const int32_t DATA_CHUNK_SIZE;
+
+    /**
+     * Number of times a value stored in chunks is read or committed
+     * again when it is replaced concurrently.
+     */
+    static const int32_t MAX_CHUNKED_DATA_ATTEMPTS;
+
+    /**
+     * Number of released event wrappers of each size kept for reuse
+     * in the depot shared by the threads of EventWrapperPool.
+     */
+    static const size_t MAX_POOLED_EVENT_WRAPPERS;
+
+    /**
+     * Number of event wrappers EventWrapperPool moves at a time
+     * between a thread cache and the shared depot.
+     */
+    static const size_t EVENT_WRAPPER_BATCH_SIZE;
+
+    /**
+     * Maximum number of events an event dispatch loop takes from its
+     * queue at a time.
+     */
+    static const size_t MAX_EVENT_BATCH_SIZE;
+
+    /**
+     * Most times its frequency a Periodic waits to run again after
+     * run() threw several times in a row.
+     */
+    static const int32_t PERIODIC_MAX_FAILURE_BACKOFF;
+
+    /**
+     * Most a Periodic is run earlier or later than its frequency, in
+     * percent of the frequency.
+     */
+    static const int32_t PERIODIC_JITTER_PERCENT;
+
+    /**
+     * Number of threads that run the asynchronous operations (i.e.
+     * Root::getApplicationAsync()) of a Factory.
+     */
+    static const int32_t ASYNC_WORKER_THREADS;
+
+    /**
+     * Number of separately locked shards of each SafeNotifyableMap.
+     */
+    static const int32_t SAFE_NOTIFYABLE_MAP_SHARDS;
+
   private:
     /**
      * No constructing.
@@ -113,8 +113,11 @@ const string CLStringInternal::LOCK_DIR = "_lockDir";
 const string CLStringInternal::BARRIER_DIR = "_barrierDir";
 const string CLStringInternal::TRANSACTION_DIR = "_transactionDir";
 const string CLStringInternal::END_EVENT = "_endEvent";
+const string CLStringInternal::REARM_EVENT = "_rearmEvent";
+const string CLStringInternal::INMEMORY_REGISTRY_PREFIX = "inmemory:";
 const string CLStringInternal::PARTIAL_LOCK_NODE = 
 CLString::KEY_SEPARATOR + CLStringInternal::LOCK_DIR + 
     CLString::KEY_SEPARATOR;
+const string CLStringInternal::DATA_CHUNKS_PREFIX = "_dataChunks";
 
 }	/* End of 'namespace clusterlib' */
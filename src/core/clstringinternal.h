@@ -135,12 +135,33 @@ class CLStringInternal {
      */
     const static std::string END_EVENT;
 
+    /**
+     * Special znode path that asks the ZooKeeperAdapter event thread
+     * to set the next batch of lost watches again.
+     * (internal)
+     */
+    const static std::string REARM_EVENT;
+
+    /**
+     * A registry starting with this prefix selects an
+     * InMemoryRepository instead of a ZK ensemble.
+     * (internal)
+     */
+    const static std::string INMEMORY_REGISTRY_PREFIX;
+
     /**
      * Used to detect whether the ZooKeeper node is part of a lock.
      * (internal)
      */
     const static std::string PARTIAL_LOCK_NODE;
 
+    /**
+     * Prefix of the sequence nodes that hold the chunks of a value
+     * too large for one znode.
+     * (internal)
+     */
+    const static std::string DATA_CHUNKS_PREFIX;
+
   private:
     /**
      * No constructing.
@@ -20,18 +20,24 @@
  * The internal full include file for clusterlib.
  */
 
+#include <boost/unordered_map.hpp>
+
 #include "clusterlib.h"
 
 #include "log.h"
 #include "clstringinternal.h"
 #include "clnumericinternal.h"
+#include "futex.h"
+#include "mpscqueue.h"
 #include "intervaltree.h"
 #include "event.h"
 #include "signalmap.h"
 #include "clusterlibrpc.h"
 #include "callbackandcontext.h"
 #include "zkexceptions.h"
+#include "datacodec.h"
 #include "zkadapter.h"
+#include "inmemoryrepository.h"
 
 #include "cacheddataimpl.h"
 #include "cachedkeyvaluesimpl.h"
@@ -50,6 +56,7 @@
 #include "queueimpl.h"
 #include "unknownhashrange.h"
 #include "safenotifyablemap.h"
+#include "notifyablekeytrie.h"
 #include "clientimpl.h"
 #include "registerednotifyable.h"
 #include "registerednotifyableimpl.h"
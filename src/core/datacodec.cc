@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ *
+ * $Id$
+ */
+
+#include "clusterlibinternal.h"
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
+DEFINE_LOGGER(LOG, "zookeeper.datacodec")
+
+using namespace std;
+
+namespace zk {
+
+/**
+ * The bytes every framed value starts with.
+ */
+static const char MAGIC[] = { '\0', 'C', 'L' };
+
+static const size_t MAGIC_LENGTH = sizeof(MAGIC);
+
+/**
+ * The bytes in front of every framed value.
+ */
+static const size_t FORMAT_HEADER_LENGTH = MAGIC_LENGTH + 1;
+
+const size_t DataCodec::HEADER_LENGTH = FORMAT_HEADER_LENGTH + 4;
+
+/**
+ * The bytes every chunk manifest starts with.
+ */
+static const char CHUNK_MANIFEST_MAGIC[] = { '\0', 'C', 'K', '1' };
+
+static const size_t CHUNK_MANIFEST_MAGIC_LENGTH = 
+    sizeof(CHUNK_MANIFEST_MAGIC);
+
+/**
+ * Frame data that starts with NUL so that it is not mistaken for a
+ * header.
+ */
+static void
+encodePlain(const string &value, string &encoded)
+{
+    if (value.empty() || (value[0] != '\0')) {
+        encoded = value;
+        return;
+    }
+    encoded.reserve(FORMAT_HEADER_LENGTH + value.size());
+    encoded.assign(MAGIC, MAGIC_LENGTH);
+    encoded.push_back(static_cast<char>(DataCodec::PLAIN));
+    encoded.append(value);
+}
+
+bool
+DataCodec::canCompress()
+{
+#ifdef HAVE_LIBZ
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool
+DataCodec::encode(const string &value, int32_t threshold, string &encoded)
+{
+    TRACE(LOG, "encode");
+
+    if ((threshold < 0) ||
+        (value.empty()) ||
+        (value.size() < static_cast<size_t>(threshold))) {
+        encodePlain(value, encoded);
+        return false;
+    }
+
+#ifdef HAVE_LIBZ
+    uLongf compressedLength = compressBound(value.size());
+    encoded.resize(HEADER_LENGTH + compressedLength);
+    int32_t rc = compress2(
+        reinterpret_cast<Bytef *>(&encoded[HEADER_LENGTH]),
+        &compressedLength,
+        reinterpret_cast<const Bytef *>(value.data()),
+        value.size(),
+        Z_DEFAULT_COMPRESSION);
+    if ((rc != Z_OK) ||
+        (HEADER_LENGTH + compressedLength >= value.size())) {
+        LOG_DEBUG(LOG,
+                  "encode: Storing %" PRIuPTR " bytes uncompressed "
+                  "(rc %d, compressed %lu)",
+                  value.size(),
+                  rc,
+                  static_cast<unsigned long>(compressedLength));
+        encodePlain(value, encoded);
+        return false;
+    }
+    encoded.resize(HEADER_LENGTH + compressedLength);
+
+    memcpy(&encoded[0], MAGIC, MAGIC_LENGTH);
+    encoded[MAGIC_LENGTH] = static_cast<char>(ZLIB);
+    uint32_t length = static_cast<uint32_t>(value.size());
+    for (size_t i = 0; i < 4; ++i) {
+        encoded[FORMAT_HEADER_LENGTH + i] =
+            static_cast<char>((length >> (8 * (3 - i))) & 0xff);
+    }
+    return true;
+#else
+    encodePlain(value, encoded);
+    return false;
+#endif
+}
+
+bool
+DataCodec::isEncoded(const string &data)
+{
+    return (data.size() >= FORMAT_HEADER_LENGTH) &&
+        (memcmp(data.data(), MAGIC, MAGIC_LENGTH) == 0);
+}
+
+bool
+DataCodec::isCompressed(const string &data)
+{
+    return isEncoded(data) && 
+        (static_cast<unsigned char>(data[MAGIC_LENGTH]) == ZLIB);
+}
+
+bool
+DataCodec::decode(string &data)
+{
+    TRACE(LOG, "decode");
+
+    if (!isEncoded(data)) {
+        return true;
+    }
+
+    if (static_cast<unsigned char>(data[MAGIC_LENGTH]) == PLAIN) {
+        data.erase(0, FORMAT_HEADER_LENGTH);
+        return true;
+    }
+    if (static_cast<unsigned char>(data[MAGIC_LENGTH]) != ZLIB) {
+        LOG_ERROR(LOG,
+                  "decode: Unknown format %d",
+                  static_cast<unsigned char>(data[MAGIC_LENGTH]));
+        return false;
+    }
+    if (data.size() < HEADER_LENGTH) {
+        LOG_ERROR(LOG,
+                  "decode: Truncated header (%" PRIuPTR " bytes)",
+                  data.size());
+        return false;
+    }
+#ifdef HAVE_LIBZ
+    uint32_t length = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        length = (length << 8) |
+            static_cast<unsigned char>(data[FORMAT_HEADER_LENGTH + i]);
+    }
+    if (length > static_cast<uint32_t>(
+            clusterlib::CLNumericInternal::MAX_DECODED_DATA_LENGTH)) {
+        LOG_ERROR(LOG,
+                  "decode: Decompressed length %" PRIu32 " is too large",
+                  length);
+        return false;
+    }
+
+    string decoded(length, '\0');
+    uLongf decodedLength = length;
+    int32_t rc = uncompress(
+        reinterpret_cast<Bytef *>(length > 0 ? &decoded[0] : NULL),
+        &decodedLength,
+        reinterpret_cast<const Bytef *>(data.data() + HEADER_LENGTH),
+        data.size() - HEADER_LENGTH);
+    if ((rc != Z_OK) || (decodedLength != length)) {
+        LOG_ERROR(LOG,
+                  "decode: Failed with rc %d, got %lu of %" PRIu32 " bytes",
+                  rc,
+                  static_cast<unsigned long>(decodedLength),
+                  length);
+        return false;
+    }
+    data.swap(decoded);
+    return true;
+#else
+    LOG_ERROR(LOG, "decode: Built without zlib, cannot decompress");
+    return false;
+#endif
+}
+
+string
+DataCodec::encodeChunkManifest(const string &chunksName,
+                               int32_t chunkCount,
+                               int64_t length)
+{
+    ostringstream oss;
+    oss.write(CHUNK_MANIFEST_MAGIC, CHUNK_MANIFEST_MAGIC_LENGTH);
+    oss << chunksName << " " << chunkCount << " " << length;
+    return oss.str();
+}
+
+bool
+DataCodec::isChunkManifest(const string &data)
+{
+    return (data.size() >= CHUNK_MANIFEST_MAGIC_LENGTH) &&
+        (memcmp(data.data(), 
+                CHUNK_MANIFEST_MAGIC, 
+                CHUNK_MANIFEST_MAGIC_LENGTH) == 0);
+}
+
+bool
+DataCodec::decodeChunkManifest(const string &data,
+                               string &chunksName,
+                               int32_t &chunkCount,
+                               int64_t &length)
+{
+    if ((data.size() <= CHUNK_MANIFEST_MAGIC_LENGTH) ||
+        !isChunkManifest(data)) {
+        return false;
+    }
+
+    istringstream iss(data.substr(CHUNK_MANIFEST_MAGIC_LENGTH));
+    if (!(iss >> chunksName >> chunkCount >> length) ||
+        (chunkCount < 0) ||
+        (length < 0)) {
+        LOG_ERROR(LOG,
+                  "decodeChunkManifest: Invalid manifest (%" PRIuPTR 
+                  " bytes)",
+                  data.size());
+        return false;
+    }
+    return true;
+}
+
+}   /* end of 'namespace zk' */
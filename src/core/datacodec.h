@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ *
+ * $Id$
+ */
+
+#ifndef _CL_DATACODEC_H_
+#define _CL_DATACODEC_H_
+
+namespace zk {
+
+/**
+ * \brief Compresses and decompresses znode data.
+ *
+ * Stored data that starts with NUL is always framed by a header, so
+ * that the header can be told apart from plain data.  JSON never
+ * starts with NUL, so plain data written by older versions is still
+ * read unchanged:
+ *
+ * - 3 bytes of magic: '\\0' 'C' 'L'
+ * - 1 byte format
+ * - for ZLIB, 4 bytes length of the decompressed data (big-endian)
+ *   and the compressed data; for PLAIN, the data itself
+ *
+ * A value split in chunks (see Repository::setChunkedNodeData()) is
+ * encoded as a whole and then split, and the node's data is replaced
+ * by a manifest that starts with '\\0' 'C' 'K' '1' and continues
+ * with the text "<chunks node name> <chunk count> <encoded length>".
+ * The chunks are not compressed again.  setChunkedNodeData() never
+ * stores a value that starts like a manifest unsplit.
+ */
+class DataCodec
+{
+  public:
+    /**
+     * The formats that can follow the magic.
+     */
+    enum Format {
+        /** Data that starts with NUL, stored as is */
+        PLAIN = 0,
+        ZLIB = 1
+    };
+
+    /**
+     * Size of the header in front of compressed data.
+     */
+    static const size_t HEADER_LENGTH;
+
+    /**
+     * Can this build compress data?  Without zlib, data is never
+     * compressed and compressed data cannot be read.
+     */
+    static bool canCompress();
+
+    /**
+     * Compress data if it is at least threshold bytes long and
+     * compression makes it smaller.  Uncompressed data that starts
+     * with NUL is framed as PLAIN.
+     *
+     * @param value the data to store
+     * @param threshold the smallest data to compress; -1 never compresses
+     * @param encoded set to the framed data or a copy of value
+     * @return true if encoded is compressed
+     */
+    static bool encode(const std::string &value,
+                       int32_t threshold,
+                       std::string &encoded);
+
+    /**
+     * Does the data start with a header?
+     *
+     * @param data the data that was read
+     * @return true if framed
+     */
+    static bool isEncoded(const std::string &data);
+
+    /**
+     * Does the data start with the header of compressed data?
+     *
+     * @param data the data that was read
+     * @return true if compressed
+     */
+    static bool isCompressed(const std::string &data);
+
+    /**
+     * Remove the header and decompress data in place if it is
+     * framed.  Other data is left alone.
+     *
+     * @param data the data that was read, replaced by the stored value
+     * @return false if the header is valid but the data is not (then
+     *         data is unchanged)
+     */
+    static bool decode(std::string &data);
+
+    /**
+     * Get the manifest stored in place of a value split in chunks.
+     *
+     * @param chunksName the name of the child node holding the chunks
+     * @param chunkCount the number of chunks
+     * @param length the length of the encoded value
+     * @return the manifest
+     */
+    static std::string encodeChunkManifest(const std::string &chunksName,
+                                           int32_t chunkCount,
+                                           int64_t length);
+
+    /**
+     * Does the data start like the manifest of a value split in
+     * chunks?
+     *
+     * @param data the data that was read or is to be stored
+     * @return true if it starts with the manifest magic
+     */
+    static bool isChunkManifest(const std::string &data);
+
+    /**
+     * Parse the manifest of a value split in chunks.
+     *
+     * @param data the data that was read
+     * @param chunksName set to the name of the child node holding the
+     *        chunks
+     * @param chunkCount set to the number of chunks
+     * @param length set to the length of the encoded value
+     * @return false if data is not a manifest
+     */
+    static bool decodeChunkManifest(const std::string &data,
+                                    std::string &chunksName,
+                                    int32_t &chunkCount,
+                                    int64_t &length);
+
+  private:
+    /**
+     * No constructing.
+     */
+    DataCodec();
+};
+
+}   /* end of 'namespace zk' */
+
+#endif /* _CL_DATACODEC_H_ */
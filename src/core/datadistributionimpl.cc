@@ -38,14 +38,10 @@ DataDistributionImpl::DataDistributionImpl(
     TRACE(CL_LOG, "DataDistributionImpl");
 }
 
-NotifyableList
-DataDistributionImpl::getChildrenNotifyables()
+vector<string>
+DataDistributionImpl::getChildrenRegisteredNames()
 {
-    TRACE(CL_LOG, "getChildrenNotifyables");
-
-    throwIfRemoved();
-    
-    return NotifyableList();
+    return vector<string>();
 }
 
 void
@@ -42,7 +42,7 @@ class DataDistributionImpl
      */
     virtual ~DataDistributionImpl();
 
-    virtual NotifyableList getChildrenNotifyables();
+    virtual std::vector<std::string> getChildrenRegisteredNames();
 
     virtual void initializeCachedRepresentation();
 
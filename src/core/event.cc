@@ -15,8 +15,159 @@
 
 #include "clusterlibinternal.h"
 
+using namespace std;
+
 namespace clusterlib {
 
+/**
+ * Released wrapper memory, by size.
+ */
+typedef map<size_t, vector<void *> > EventWrapperFreeLists;
+
+/**
+ * Released wrapper memory shared by all the threads.  A thread only
+ * goes here to move a batch of blocks in or out of its own cache.
+ */
+static EventWrapperFreeLists eventWrapperDepot;
+
+/**
+ * Protects eventWrapperDepot.
+ */
+static Mutex eventWrapperDepotLock;
+
+/**
+ * Key of the per-thread EventWrapperFreeLists.
+ */
+static pthread_key_t eventWrapperCacheKey;
+
+/**
+ * Makes sure eventWrapperCacheKey is created once.
+ */
+static pthread_once_t eventWrapperCacheKeyOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Move blocks from a thread cache free list to the depot, freeing
+ * the ones that do not fit (must hold eventWrapperDepotLock).
+ *
+ * @param size the size of the blocks
+ * @param freeList the thread cache free list
+ * @param count the number of blocks to move from the back of freeList
+ */
+static void
+moveToEventWrapperDepot(size_t size, vector<void *> &freeList, size_t count)
+{
+    vector<void *> &depotList = eventWrapperDepot[size];
+    for (size_t i = 0; (i < count) && !freeList.empty(); ++i) {
+        if (depotList.size() < CLNumericInternal::MAX_POOLED_EVENT_WRAPPERS) {
+            depotList.push_back(freeList.back());
+        }
+        else {
+            ::operator delete(freeList.back());
+        }
+        freeList.pop_back();
+    }
+}
+
+/**
+ * Give the cache of an exiting thread back to the depot.
+ *
+ * @param cache the EventWrapperFreeLists of the thread
+ */
+static void
+destroyEventWrapperCache(void *cache)
+{
+    EventWrapperFreeLists *freeLists = 
+        reinterpret_cast<EventWrapperFreeLists *>(cache);
+    {
+        Locker l(&eventWrapperDepotLock);
+        EventWrapperFreeLists::iterator freeListIt;
+        for (freeListIt = freeLists->begin(); 
+             freeListIt != freeLists->end(); 
+             ++freeListIt) {
+            moveToEventWrapperDepot(freeListIt->first, 
+                                    freeListIt->second,
+                                    freeListIt->second.size());
+        }
+    }
+    delete freeLists;
+}
+
+static void
+createEventWrapperCacheKey()
+{
+    pthread_key_create(&eventWrapperCacheKey, destroyEventWrapperCache);
+}
+
+/**
+ * Get the wrapper memory cache of this thread.
+ *
+ * @return the cache
+ */
+static EventWrapperFreeLists &
+getEventWrapperCache()
+{
+    pthread_once(&eventWrapperCacheKeyOnce, createEventWrapperCacheKey);
+    EventWrapperFreeLists *freeLists = 
+        reinterpret_cast<EventWrapperFreeLists *>(
+            pthread_getspecific(eventWrapperCacheKey));
+    if (freeLists == NULL) {
+        freeLists = new EventWrapperFreeLists();
+        pthread_setspecific(eventWrapperCacheKey, freeLists);
+    }
+    return *freeLists;
+}
+
+void *
+EventWrapperPool::allocate(size_t size)
+{
+    vector<void *> &freeList = getEventWrapperCache()[size];
+    if (freeList.empty()) {
+        /* Refill the cache with a batch from the depot. */
+        Locker l(&eventWrapperDepotLock);
+        EventWrapperFreeLists::iterator depotListIt = 
+            eventWrapperDepot.find(size);
+        if (depotListIt != eventWrapperDepot.end()) {
+            vector<void *> &depotList = depotListIt->second;
+            size_t count = min(depotList.size(), 
+                               CLNumericInternal::EVENT_WRAPPER_BATCH_SIZE);
+            freeList.insert(freeList.end(), 
+                            depotList.end() - count, 
+                            depotList.end());
+            depotList.resize(depotList.size() - count);
+        }
+    }
+
+    if (!freeList.empty()) {
+        void *p = freeList.back();
+        freeList.pop_back();
+        return p;
+    }
+
+    return ::operator new(size);
+}
+
+void
+EventWrapperPool::deallocate(void *p, size_t size)
+{
+    if (p == NULL) {
+        return;
+    }
+
+    vector<void *> &freeList = getEventWrapperCache()[size];
+    freeList.push_back(p);
+
+    /*
+     * Wrappers are usually released on another thread than the one
+     * that allocated them, so a cache that grew past two batches
+     * hands one back to the depot for the allocating threads.
+     */
+    if (freeList.size() > 2 * CLNumericInternal::EVENT_WRAPPER_BATCH_SIZE) {
+        Locker l(&eventWrapperDepotLock);
+        moveToEventWrapperDepot(
+            size, freeList, CLNumericInternal::EVENT_WRAPPER_BATCH_SIZE);
+    }
+}
+
 bool
 UserEventHandler::waitUntilCondition(uint64_t maxMs, bool interruptible)
 {
@@ -23,6 +23,7 @@
 
 #include "log.h"
 #include "blockingqueue.h"
+#include "mpscqueue.h"
 #include "mutex.h"
 #include "thread.h"
 
@@ -156,12 +157,57 @@ class EventSource
     Mutex m_listenersLock;
 };
 
+/**
+ * \brief Recycles the memory of event wrappers so that an event does
+ * not go through the heap once the process is warmed up.
+ *
+ * Each thread keeps its own free lists and only takes the shared
+ * lock to move CLNumericInternal::EVENT_WRAPPER_BATCH_SIZE blocks at
+ * a time between them and a shared depot.
+ */
+class EventWrapperPool
+{
+  public:
+    /**
+     * \brief Get memory for a wrapper, reusing a released block of
+     * the same size if there is one.
+     *
+     * @param size the size of the wrapper
+     * @return the memory
+     */
+    static void *allocate(size_t size);
+
+    /**
+     * \brief Release the memory of a wrapper.  Up to two batches of
+     * each size are kept by each thread and up to
+     * CLNumericInternal::MAX_POOLED_EVENT_WRAPPERS more in the depot.
+     *
+     * @param p the memory from allocate()
+     * @param size the size passed to allocate()
+     */
+    static void deallocate(void *p, size_t size);
+
+  private:
+    /**
+     * No constructing.
+     */
+    EventWrapperPool();
+};
+
 /**
  * \brief The interface of a generic event wrapper.
+ *
+ * Wrappers are reference counted so that a {@link GenericEvent} can
+ * be copied between listeners and queues without copying the event.
+ * The event is never modified once wrapped.
  */
 class AbstractEventWrapper
 {
   public:
+    /**
+     * \brief Constructor.  The creator holds the only reference.
+     */
+    AbstractEventWrapper() : m_refCount(1) {}
         
     /**
      * \brief Destructor.
@@ -174,9 +220,39 @@ class AbstractEventWrapper
     virtual void *getWrapee() = 0;
 
     /**
-     * \brief Clone functionality for deep copy.
+     * \brief Add a reference.
      */
-    virtual AbstractEventWrapper *clone() const = 0;
+    void acquire()
+    {
+        __sync_add_and_fetch(&m_refCount, 1);
+    }
+
+    /**
+     * \brief Drop a reference and delete the wrapper with the last one.
+     */
+    void release()
+    {
+        if (__sync_sub_and_fetch(&m_refCount, 1) == 0) {
+            delete this;
+        }
+    }
+
+  private:
+    /**
+     * No copying.
+     */
+    AbstractEventWrapper(const AbstractEventWrapper &);
+
+    /**
+     * No assigning.
+     */
+    AbstractEventWrapper &operator=(const AbstractEventWrapper &);
+
+  private:
+    /**
+     * The number of GenericEvent objects sharing this wrapper.
+     */
+    int32_t m_refCount;
 };
 
 /**
@@ -196,8 +272,13 @@ class EventWrapper
     {
         return &m_e;
     }
-    virtual AbstractEventWrapper *clone() const {
-        return new EventWrapper(m_e);
+    static void *operator new(size_t size)
+    {
+        return EventWrapperPool::allocate(size);
+    }
+    static void operator delete(void *p, size_t size)
+    {
+        EventWrapperPool::deallocate(p, size);
     }
   private:
     E m_e;
@@ -219,7 +300,8 @@ class GenericEvent
      * 
      * @param type the type of this event
      * @param eventWrapper the wrapper around event's data 
-     *                     (transfers ownership to this object)
+     *                     (transfers the creator's reference to this 
+     *                     object)
      */
     GenericEvent(int32_t type, AbstractEventWrapper *eventWrapper)
         : m_type(type),
@@ -229,19 +311,33 @@ class GenericEvent
         
     ~GenericEvent()
     {
-        delete mp_eventWrapper;
+        if (mp_eventWrapper != NULL) {
+            mp_eventWrapper->release();
+        }
     }
 
+    /**
+     * \brief Copies share the wrapped event.
+     */
     GenericEvent(const GenericEvent &ge)
+        : m_type(ge.m_type),
+          mp_eventWrapper(ge.mp_eventWrapper)
     {
-        m_type = ge.getType();
-        mp_eventWrapper = ge.mp_eventWrapper->clone();
+        if (mp_eventWrapper != NULL) {
+            mp_eventWrapper->acquire();
+        }
     }
 
     GenericEvent &operator = (const GenericEvent &ge)
     {
-        m_type = ge.getType();
-        mp_eventWrapper = ge.mp_eventWrapper->clone();
+        if (ge.mp_eventWrapper != NULL) {
+            ge.mp_eventWrapper->acquire();
+        }
+        if (mp_eventWrapper != NULL) {
+            mp_eventWrapper->release();
+        }
+        m_type = ge.m_type;
+        mp_eventWrapper = ge.mp_eventWrapper;
         return *this;
     }
 
@@ -286,7 +382,8 @@ class GenericEvent
     int32_t m_type;
 
     /**
-     * The event represented as abstract wrapper.
+     * The event represented as abstract wrapper (shared by the
+     * copies of this event).
      */
     AbstractEventWrapper *mp_eventWrapper;
 };
@@ -383,6 +480,26 @@ class SynchronousEventAdapter
                   ProcessThreadService::getTid());
         return m_queue.takeWaitMsecs(msecTimeout, e);
     }
+
+    /**
+     * \brief Returns the available events from the underlying
+     * queue, possibly blocking, if no data is available.  A burst of
+     * events is handed over at once instead of one per call.
+     * 
+     * @param msecTimeout the amount of msecs to wait until giving up, 
+     *        -1 means wait forever, 0 means return immediately
+     * @param events the vector the events are appended to
+     * @param maxEvents the most events to return
+     * @return true if at least one event was retrieved, false otherwise
+     */
+    bool getNextEvents(int64_t msecTimeout, 
+                       std::vector<E> &events, 
+                       size_t maxEvents)
+    {
+        TRACE(EV_LOG, "getNextEvents");
+
+        return m_queue.takeAllWaitMsecs(msecTimeout, events, maxEvents);
+    }
         
     /**
      * \brief Returns whether there are any events in the queue or not.
@@ -402,9 +519,10 @@ class SynchronousEventAdapter
 
   private:
     /**
-     * The blocking queue of all events received so far.
+     * The queue of all events received so far (only one thread gets
+     * them).
      */
-    BlockingQueue<E> m_queue;
+    MPSCQueue<E> m_queue;
 };
 
 template<typename E>
@@ -583,9 +701,10 @@ class UserEventPayload
 };
 
 /*
- * Typedef for blocking queue of pointers to cluster event payload objects.
+ * Typedef for queue of pointers to cluster event payload objects
+ * (taken by the handler thread of a client only).
  */
-typedef BlockingQueue<UserEventPayload *> UserEventPayloadQueue;
+typedef MPSCQueue<UserEventPayload *> UserEventPayloadQueue;
 
 /***********************************************************************/
 /*                                                                     */
@@ -689,6 +808,15 @@ class TimerEvent
     T m_userData;
 };
 
+/**
+ * Fires timer events on its own thread at their alarm time.
+ *
+ * The pending events are kept in a binary min-heap on the alarm time.
+ * Each heap entry knows its position, and an index by ID finds it, so
+ * both scheduling and cancelling are O(log n).  The thread sleeps
+ * until the earliest alarm (or forever if there is none) and is
+ * woken up when an earlier event is scheduled.
+ */
 template<typename T>
 class Timer
     : public EventSource<TimerEvent<T> >
@@ -709,9 +837,16 @@ class Timer
      */
     virtual ~Timer()
     {
+        m_lock.lock();
         m_terminating = true;
         m_lock.notify();
+        m_lock.unlock();
         m_workerThread.Join();
+
+        typename std::vector<HeapEntry *>::iterator heapIt;
+        for (heapIt = m_heap.begin(); heapIt != m_heap.end(); ++heapIt) {
+            delete *heapIt;
+        }
     }
         
     /**
@@ -742,12 +877,17 @@ class Timer
     TimerId scheduleAt(int64_t absTime, const T &userData)
     {
         m_lock.lock();
-        typename QueueType::iterator pos = 
-            lower_bound(m_queue.begin(), m_queue.end(), absTime);
         TimerId id = m_currentEventID++;
-        TimerEvent<T> event(id, absTime, userData); 
-        m_queue.insert(pos, event);
-        m_lock.notify();
+        HeapEntry *entryP = new HeapEntry(TimerEvent<T>(id, absTime, userData),
+                                          m_heap.size());
+        m_heap.push_back(entryP);
+        m_entries[id] = entryP;
+        siftUp(entryP->m_heapIndex);
+
+        /* Only a new earliest alarm changes how long to sleep. */
+        if (m_heap.front() == entryP) {
+            m_lock.notify();
+        }
         m_lock.unlock();
         return id;
     }
@@ -763,13 +903,14 @@ class Timer
     {
         bool canceled = false;                      
         m_lock.lock();
-        typename QueueType::iterator i;
-        for (i = m_queue.begin(); i != m_queue.end(); ++i) {
-            if (eventID == i->getID()) {
-                m_queue.erase(i);
-                canceled = true;
-                break;
-            }
+        typename std::map<TimerId, HeapEntry *>::iterator entryIt = 
+            m_entries.find(eventID);
+        if (entryIt != m_entries.end()) {
+            HeapEntry *entryP = entryIt->second;
+            m_entries.erase(entryIt);
+            removeAt(entryP->m_heapIndex);
+            delete entryP;
+            canceled = true;
         }
         m_lock.unlock();
         return canceled;
@@ -787,37 +928,34 @@ class Timer
                   ProcessThreadService::getTid());
         
         /** Iterate until terminating */
+        m_lock.lock();
         while (!m_terminating) {
-            m_lock.lock();
             //1 step - wait until there is an event in the queue
-            if (m_queue.empty()) {
-                //wait up to 100ms to get next event
-                m_lock.waitMsecs(100);
+            if (m_heap.empty()) {
+                m_lock.waitMsecs(-1);
+                continue;
             }
-            bool fire = false;
-            if (!m_queue.empty()) {
-                //retrieve the event from the queue and send it
-                TimerEvent<T> event = m_queue.front();      
-                //check whether we can send it right away
-                int64_t timeToWait = 
-                    event.getAlarmTime() - TimerService::getCurrentTimeMsecs();
-                if (timeToWait <= 0) {
-                    m_queue.pop_front();
-                    //we fire only if it's still in the queue and alarm
-                    //time has just elapsed (in case the top event
-                    //is canceled)
-                    fire = true;    
-                } else {
-                    m_lock.waitMsecs(timeToWait);
-                }
-                m_lock.unlock();
-                if (fire) {
-                    fireEventToAllListeners(event);
-                }
-            } else {
-                m_lock.unlock();
+
+            //check whether we can send the first event right away
+            int64_t timeToWait = m_heap.front()->m_event.getAlarmTime() - 
+                TimerService::getCurrentTimeMsecs();
+            if (timeToWait > 0) {
+                //sleep until it is due or an earlier one is scheduled
+                m_lock.waitMsecs(timeToWait);
+                continue;
             }
+
+            //it was not canceled before its alarm time elapsed, fire it
+            HeapEntry *entryP = m_heap.front();
+            m_entries.erase(entryP->m_event.getID());
+            removeAt(0);
+            TimerEvent<T> event = entryP->m_event;
+            delete entryP;
+            m_lock.unlock();
+            fireEventToAllListeners(event);
+            m_lock.lock();
         }
+        m_lock.unlock();
 
         LOG_DEBUG(EV_LOG,
                   "Ending thread with Timer::sendAlarms(): "
@@ -828,10 +966,85 @@ class Timer
         
   private:
     /**
-     * The type of timer events queue.
+     * A pending event and its position in {@link #m_heap}.
+     */
+    struct HeapEntry {
+        HeapEntry(const TimerEvent<T> &event, size_t heapIndex)
+            : m_event(event),
+              m_heapIndex(heapIndex) {}
+        TimerEvent<T> m_event;
+        size_t m_heapIndex;
+    };
+
+    /**
+     * Is the entry at index a due before the one at index b?
      */
-    typedef std::deque<TimerEvent<T> > QueueType;
-        
+    bool isEarlier(size_t a, size_t b) const
+    {
+        return m_heap[a]->m_event.getAlarmTime() < 
+            m_heap[b]->m_event.getAlarmTime();
+    }
+
+    /**
+     * Swap two entries of the heap and update their positions.
+     */
+    void swapEntries(size_t a, size_t b)
+    {
+        std::swap(m_heap[a], m_heap[b]);
+        m_heap[a]->m_heapIndex = a;
+        m_heap[b]->m_heapIndex = b;
+    }
+
+    /**
+     * Move an entry up until its parent is not later.
+     */
+    void siftUp(size_t index)
+    {
+        while ((index > 0) && isEarlier(index, (index - 1) / 2)) {
+            swapEntries(index, (index - 1) / 2);
+            index = (index - 1) / 2;
+        }
+    }
+
+    /**
+     * Move an entry down until no child is earlier.
+     */
+    void siftDown(size_t index)
+    {
+        while (true) {
+            size_t earliest = index;
+            size_t left = 2 * index + 1;
+            size_t right = left + 1;
+            if ((left < m_heap.size()) && isEarlier(left, earliest)) {
+                earliest = left;
+            }
+            if ((right < m_heap.size()) && isEarlier(right, earliest)) {
+                earliest = right;
+            }
+            if (earliest == index) {
+                return;
+            }
+            swapEntries(index, earliest);
+            index = earliest;
+        }
+    }
+
+    /**
+     * Take an entry out of the heap (the caller owns it).
+     */
+    void removeAt(size_t index)
+    {
+        size_t last = m_heap.size() - 1;
+        if (index != last) {
+            swapEntries(index, last);
+        }
+        m_heap.pop_back();
+        if (index < m_heap.size()) {
+            siftDown(index);
+            siftUp(index);
+        }
+    }
+
     /**
      * The current event ID, auto-incremented each time a new event 
      * is created.
@@ -839,12 +1052,17 @@ class Timer
     TimerId m_currentEventID;
         
     /**
-     * The queue of timer events sorted by {@link TimerEvent#alarmTime}.
+     * The pending events, a min-heap on {@link TimerEvent#alarmTime}.
+     */
+    std::vector<HeapEntry *> m_heap;
+
+    /**
+     * The pending events by ID.
      */
-    QueueType m_queue;
+    std::map<TimerId, HeapEntry *> m_entries;
         
     /**
-     * The lock used to guard {@link #m_queue}.
+     * The lock used to guard {@link #m_heap} and {@link #m_entries}.
      */
     Lock m_lock;
         
@@ -935,7 +1153,7 @@ class TimerEventPayload
  */
 typedef TimerEvent<TimerEventPayload *>		ClusterlibTimerEvent;
 typedef Timer<TimerEventPayload *>		ClusterlibTimerEventSource;
-typedef BlockingQueue<TimerEventPayload *>	TimerEventQueue;
+typedef MPSCQueue<TimerEventPayload *>		TimerEventQueue;
 
 }   /* end of 'namespace clusterlib' */
 
@@ -20,12 +20,20 @@ using namespace boost;
 
 namespace clusterlib {
 
-Factory::Factory(const string &registry, int64_t msecConnectTimeout)
+Factory::Factory(const string &registry, 
+                 int64_t msecConnectTimeout,
+                 int32_t repositorySessions,
+                 int32_t eventDispatchThreads,
+                 int32_t periodicThreads)
     : m_ops(NULL)
 {
     TRACE(CL_LOG, "Factory");
 
-    m_ops = new FactoryOps(registry, msecConnectTimeout);
+    m_ops = new FactoryOps(registry, 
+                           msecConnectTimeout, 
+                           repositorySessions,
+                           eventDispatchThreads,
+                           periodicThreads);
 }
 
 Factory::~Factory()
@@ -36,11 +44,11 @@ Factory::~Factory()
 }
 
 Client *
-Factory::createClient()
+Factory::createClient(int32_t handlerThreads)
 {
     TRACE(CL_LOG, "createClient");
 
-    return getOps()->createClient();
+    return getOps()->createClient(handlerThreads);
 }
 
 bool
@@ -74,9 +82,9 @@ Factory::isConnected()
 }
 
 void
-Factory::registerPeriodicThread(Periodic &periodic)
+Factory::registerPeriodicThread(Periodic &periodic, bool mayBlock)
 {
-    getOps()->registerPeriodicThread(periodic);
+    getOps()->registerPeriodicThread(periodic, mayBlock);
 }
 
 bool
@@ -101,7 +109,31 @@ Factory::registerHashRange(const HashRange &hashRange)
     getOps()->registerHashRange(hashRange);
 }
 
-zk::ZooKeeperAdapter *
+RepositoryStats
+Factory::getRepositoryStats()
+{
+    TRACE(CL_LOG, "getRepositoryStats");
+
+    return getOps()->getRepositoryStats();
+}
+
+void
+Factory::resetRepositoryStats()
+{
+    TRACE(CL_LOG, "resetRepositoryStats");
+
+    getOps()->resetRepositoryStats();
+}
+
+void
+Factory::setDataCompressionThreshold(int32_t threshold)
+{
+    TRACE(CL_LOG, "setDataCompressionThreshold");
+
+    getOps()->setDataCompressionThreshold(threshold);
+}
+
+zk::Repository *
 Factory::getRepository()
 {
     TRACE(CL_LOG, "getRepository");
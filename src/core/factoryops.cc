@@ -21,14 +21,27 @@ using namespace json;
 
 namespace clusterlib {
 
-FactoryOps::FactoryOps(const string &registry, int64_t msecConnectTimeout)
+FactoryOps::FactoryOps(const string &registry, 
+                       int64_t msecConnectTimeout,
+                       int32_t repositorySessions,
+                       int32_t eventDispatchThreads,
+                       int32_t periodicThreads)
     : m_syncEventId(0),
       m_syncEventIdCompleted(0),
       m_endEventDispatched(false),
       m_config(registry, msecConnectTimeout, true), 
-      m_zk(m_config, NULL, false),
+      m_zkSP(createRepository(m_config, false)),
+      m_repositoryPoolIndex(0),
       m_timerEventAdapter(m_timerEventSrc),
-      m_zkEventAdapter(m_zk),
+      m_zkEventAdapter(*m_zkSP, this),
+      m_eventDispatchStopped(false),
+      m_periodicSharedThreads(periodicThreads),
+      m_periodicBlockingCount(0),
+      m_periodicSeed(static_cast<uint32_t>(
+                         TimerService::getCurrentTimeUsecs())),
+      m_periodicShutdown(false),
+      m_asyncShutdown(false),
+      m_asyncPending(0),
       m_shutdown(false),
       m_connected(false),
       m_cachedObjectChangeHandlers(this),
@@ -36,12 +49,42 @@ FactoryOps::FactoryOps(const string &registry, int64_t msecConnectTimeout)
 {
     TRACE(CL_LOG, "FactoryOps");
 
+    if (periodicThreads < 1) {
+        throw InvalidArgumentsException(
+            "FactoryOps: periodicThreads must be at least 1");
+    }
+
     /*
      * Link up the event sources.
      */
     m_timerEventAdapter.addListener(&m_externalEventAdapter);
     m_zkEventAdapter.addListener(&m_externalEventAdapter);
 
+    /*
+     * Create the event dispatch workers.  The repository event thread
+     * hands the ZK events straight to them, so they must exist before
+     * the repository connects.  Even with one worker, the repository
+     * event thread must not dispatch the events itself, since
+     * updating the cache waits on the repository.
+     */
+    if (eventDispatchThreads < 1) {
+        eventDispatchThreads = 1;
+    }
+    for (int32_t i = 0; i < eventDispatchThreads; ++i) {
+        m_eventDispatchQueues.push_back(
+            new MPSCQueue<ExternalEventRequest>());
+    }
+    for (int32_t i = 0; i < eventDispatchThreads; ++i) {
+        CXXThread<FactoryOps> *threadP = new CXXThread<FactoryOps>();
+        threadP->Create(*this,
+                        &FactoryOps::dispatchWorkerEvents,
+                        reinterpret_cast<void *>(i));
+        m_eventDispatchThreads.push_back(threadP);
+    }
+    LOG_INFO(CL_LOG, 
+             "FactoryOps: Using %" PRIuPTR " event dispatch worker(s)",
+             m_eventDispatchThreads.size());
+
     /*
      * Create the clusterlib event dispatch thread (processes only
      * events that are visible to clusterlib clients)
@@ -60,7 +103,7 @@ FactoryOps::FactoryOps(const string &registry, int64_t msecConnectTimeout)
      * second to allow zookeeper_init() to complete and return.
      */
     try {
-        m_zk.reconnect();
+        m_zkSP->reconnect();
         LOG_INFO(CL_LOG, 
                  "Waiting for connect event from ZooKeeper up to %" PRId64 
                  " msecs from %s, thread: %" PRId32,
@@ -82,13 +125,38 @@ FactoryOps::FactoryOps(const string &registry, int64_t msecConnectTimeout)
                  static_cast<int>(m_connected));
     } 
     catch (zk::ZooKeeperException &e) {
-        m_zk.disconnect();
+        m_zkSP->disconnect();
         LOG_FATAL(CL_LOG, 
                   "Failed to connect to Zookeeper (%s)",
                   m_config.getHosts().c_str());
         throw RepositoryInternalsFailureException(e.what());
     }
 
+    /*
+     * Open the additional sessions of the pool.  They have no
+     * listeners and connect in the background.  If one cannot be
+     * opened, the ones already opened are closed.
+     */
+    try {
+        for (int32_t i = 1; i < repositorySessions; ++i) {
+            m_repositoryPool.push_back(
+                createRepository(m_config, true));
+        }
+    }
+    catch (...) {
+        vector<zk::Repository *>::iterator repositoryPoolIt;
+        for (repositoryPoolIt = m_repositoryPool.begin();
+             repositoryPoolIt != m_repositoryPool.end();
+             ++repositoryPoolIt) {
+            delete *repositoryPoolIt;
+        }
+        m_repositoryPool.clear();
+        throw;
+    }
+    LOG_INFO(CL_LOG, 
+             "FactoryOps: Using %" PRIuPTR " repository session(s)",
+             m_repositoryPool.size() + 1);
+
     /*
      * Register the HashRange objects.
      */
@@ -208,6 +276,11 @@ FactoryOps::unregisterAllHashRanges()
 void
 FactoryOps::cleanCachedNotifyableMaps()
 {
+    {
+        Locker l(&m_cachedNotifyableTrie.getLock());
+        m_cachedNotifyableTrie.clear();
+    }
+
     Locker l(&m_cachedNotifyableMapLock);
 
     map<string, SafeNotifyableMap *>::iterator cachedNotifyableMapIt;
@@ -222,6 +295,12 @@ FactoryOps::~FactoryOps()
 {
     TRACE(CL_LOG, "~FactoryOps");
 
+    /*
+     * Finish the asynchronous operations already issued while the
+     * repository is still usable.
+     */
+    stopAsyncWorkers();
+
     /*
      * Zookeeper will not deliver any more events after the end event
      * is propagated to the cache and then to the clients.  All event
@@ -229,7 +308,7 @@ FactoryOps::~FactoryOps()
      * this cascades through the the event handler threads, they
      * deliver and then exit.
      */
-    m_zk.injectEndEvent();
+    m_zkSP->injectEndEvent();
 
     /*
      * Allow our threads to shut down.
@@ -247,13 +326,22 @@ FactoryOps::~FactoryOps()
     cleanCachedNotifyableMaps();
 
     try {
-        m_zk.disconnect(true);
+        m_zkSP->disconnect(true);
     } catch (zk::ZooKeeperException &e) {
         LOG_WARN(CL_LOG,
                  "Got exception during disconnect: %s",
                  e.what());
     }
 
+    /* The pooled sessions disconnect when deleted. */
+    vector<zk::Repository *>::iterator repositoryPoolIt;
+    for (repositoryPoolIt = m_repositoryPool.begin();
+         repositoryPoolIt != m_repositoryPool.end();
+         ++repositoryPoolIt) {
+        delete *repositoryPoolIt;
+    }
+    m_repositoryPool.clear();
+
     /* Clean up any contexts that are being waited on. */
     m_handlerAndContextManager.deleteAllCallbackAndContext();
 
@@ -262,10 +350,28 @@ FactoryOps::~FactoryOps()
      * or else events may be propagated to missing listeners through
      * fireEvent().
      */
-    m_zk.removeListener(&m_zkEventAdapter);
+    m_zkSP->removeListener(&m_zkEventAdapter);
     m_timerEventSrc.removeListener(&m_timerEventAdapter);
     m_timerEventAdapter.removeListener(&m_externalEventAdapter);
     m_zkEventAdapter.removeListener(&m_externalEventAdapter);
+
+    m_zkSP.reset();
+}
+
+zk::Repository *
+FactoryOps::createRepository(const zk::ZooKeeperConfig &config,
+                             bool establishConnection)
+{
+    TRACE(CL_LOG, "createRepository");
+
+    string treeName;
+    int64_t latencyUsecs = 0;
+    if (zk::InMemoryRepository::parseRegistry(
+            config.getHosts(), &treeName, &latencyUsecs)) {
+        return new zk::InMemoryRepository(
+            treeName, latencyUsecs, establishConnection);
+    }
+    return new zk::ZooKeeperAdapter(config, NULL, establishConnection);
 }
 
 void
@@ -275,10 +381,26 @@ FactoryOps::waitForThreads()
 
     m_timerHandlerThread.Join();
     m_externalEventThread.Join();
+
+    /* The workers were stopped by the external event thread. */
+    vector<CXXThread<FactoryOps> *>::iterator threadIt;
+    for (threadIt = m_eventDispatchThreads.begin();
+         threadIt != m_eventDispatchThreads.end();
+         ++threadIt) {
+        delete *threadIt;
+    }
+    m_eventDispatchThreads.clear();
+    vector<MPSCQueue<ExternalEventRequest> *>::iterator queueIt;
+    for (queueIt = m_eventDispatchQueues.begin();
+         queueIt != m_eventDispatchQueues.end();
+         ++queueIt) {
+        delete *queueIt;
+    }
+    m_eventDispatchQueues.clear();
 }
 
 Client *
-FactoryOps::createClient()
+FactoryOps::createClient(int32_t handlerThreads)
 {
     TRACE(CL_LOG, "createClient");
 
@@ -293,7 +415,7 @@ FactoryOps::createClient()
     /*
      * Create the new client and add it to the registry.
      */
-    ClientImpl *cp = new ClientImpl(this);
+    ClientImpl *cp = new ClientImpl(this, handlerThreads);
     addClient(cp);
     return cp;
 }
@@ -391,7 +513,7 @@ FactoryOps::synchronize()
     LOG_DEBUG(CL_LOG, 
               "synchronize: Starting sync with event id (%" PRId64 ")", 
               syncEventId);
-    SAFE_CALL_ZK(m_zk.sync(
+    SAFE_CALL_ZK(m_zkSP->sync(
                      key, 
                      &m_zkEventAdapter, 
                      callbackAndContext),
@@ -412,10 +534,75 @@ FactoryOps::synchronize()
               syncEventId);
 }
 
-zk::ZooKeeperAdapter *
+zk::Repository *
 FactoryOps::getRepository()
 {
-    return &m_zk;
+    return m_zkSP.get();
+}
+
+zk::Repository *
+FactoryOps::getPooledRepository()
+{
+    if (m_repositoryPool.empty()) {
+        return m_zkSP.get();
+    }
+
+    Locker l(getRepositoryPoolLock());
+    m_repositoryPoolIndex = 
+        (m_repositoryPoolIndex + 1) % (m_repositoryPool.size() + 1);
+    if (m_repositoryPoolIndex == 0) {
+        return m_zkSP.get();
+    }
+    return m_repositoryPool.at(m_repositoryPoolIndex - 1);
+}
+
+RepositoryStats
+FactoryOps::getRepositoryStats()
+{
+    TRACE(CL_LOG, "getRepositoryStats");
+
+    RepositoryStats stats;
+    m_zkSP->getStats(stats);
+    vector<zk::Repository *>::const_iterator it;
+    for (it = m_repositoryPool.begin(); it != m_repositoryPool.end(); ++it) {
+        RepositoryStats sessionStats;
+        (*it)->getStats(sessionStats);
+        stats.add(sessionStats);
+    }
+    return stats;
+}
+
+void
+FactoryOps::resetRepositoryStats()
+{
+    TRACE(CL_LOG, "resetRepositoryStats");
+
+    m_zkSP->resetStats();
+    vector<zk::Repository *>::const_iterator it;
+    for (it = m_repositoryPool.begin(); it != m_repositoryPool.end(); ++it) {
+        (*it)->resetStats();
+    }
+}
+
+void
+FactoryOps::setDataCompressionThreshold(int32_t threshold)
+{
+    TRACE(CL_LOG, "setDataCompressionThreshold");
+
+    LOG_INFO(CL_LOG,
+             "setDataCompressionThreshold: Compressing node data of at "
+             "least %" PRId32 " bytes",
+             threshold);
+    if ((threshold >= 0) && !zk::DataCodec::canCompress()) {
+        LOG_WARN(CL_LOG,
+                 "setDataCompressionThreshold: Built without zlib, node "
+                 "data will not be compressed");
+    }
+    m_zkSP->setCompressionThreshold(threshold);
+    vector<zk::Repository *>::const_iterator it;
+    for (it = m_repositoryPool.begin(); it != m_repositoryPool.end(); ++it) {
+        (*it)->setCompressionThreshold(threshold);
+    }
 }
 
 /**********************************************************************/
@@ -450,11 +637,83 @@ FactoryOps::removeClient(ClientImpl *clp)
     }
     else {
         m_clients.erase(clIt);
+        removeAllSubscriptions(clp);
         delete clp;
         return true;
     }
 }
 
+void
+FactoryOps::addSubscription(ClientImpl *clp, UserEventHandler *uehp)
+{
+    TRACE(CL_LOG, "addSubscription");
+
+    Locker l(&m_subscriptionsLock);
+    m_subscriptions.insert(
+        make_pair(uehp->getNotifyable()->getKey(), make_pair(clp, uehp)));
+}
+
+void
+FactoryOps::removeSubscription(ClientImpl *clp, 
+                               UserEventHandler *uehp,
+                               const string &key)
+{
+    TRACE(CL_LOG, "removeSubscription");
+
+    Locker l(&m_subscriptionsLock);
+    multimap<string, pair<ClientImpl *, UserEventHandler *> >::iterator 
+        subscriptionIt;
+    for (subscriptionIt = m_subscriptions.lower_bound(key);
+         subscriptionIt != m_subscriptions.upper_bound(key);
+         ++subscriptionIt) {
+        if ((subscriptionIt->second.first == clp) &&
+            (subscriptionIt->second.second == uehp)) {
+            m_subscriptions.erase(subscriptionIt);
+            return;
+        }
+    }
+}
+
+void
+FactoryOps::getSubscribedClients(const string &key, 
+                                 Event e, 
+                                 ClientImplList &clients)
+{
+    TRACE(CL_LOG, "getSubscribedClients");
+
+    Locker l(&m_subscriptionsLock);
+    multimap<string, pair<ClientImpl *, UserEventHandler *> >::iterator 
+        subscriptionIt;
+    for (subscriptionIt = m_subscriptions.lower_bound(key);
+         subscriptionIt != m_subscriptions.upper_bound(key);
+         ++subscriptionIt) {
+        if (((subscriptionIt->second.second->getMask() & e) != 0) &&
+            (find(clients.begin(), 
+                  clients.end(), 
+                  subscriptionIt->second.first) == clients.end())) {
+            clients.push_back(subscriptionIt->second.first);
+        }
+    }
+}
+
+void
+FactoryOps::removeAllSubscriptions(ClientImpl *clp)
+{
+    TRACE(CL_LOG, "removeAllSubscriptions");
+
+    Locker l(&m_subscriptionsLock);
+    multimap<string, pair<ClientImpl *, UserEventHandler *> >::iterator 
+        subscriptionIt = m_subscriptions.begin();
+    while (subscriptionIt != m_subscriptions.end()) {
+        if (subscriptionIt->second.first == clp) {
+            m_subscriptions.erase(subscriptionIt++);
+        }
+        else {
+            ++subscriptionIt;
+        }
+    }
+}
+
 RegisteredNotifyable *
 FactoryOps::getRegisteredNotifyable(const string &registeredName, 
                                     bool throwIfNotFound)
@@ -513,36 +772,125 @@ FactoryOps::runPeriodic(void *param)
              ProcessThreadService::getTid());
     
     m_periodicMapLock.acquire();
-        
-    Periodic *periodic = reinterpret_cast<Periodic *>(param);
-    map<Periodic *, CXXThread<FactoryOps> *>::const_iterator periodicMapIt
-        = m_periodicMap.find(periodic);
-    if (periodicMapIt == m_periodicMap.end()) {
-        throw InconsistentInternalStateException(
-            "runPeriodic: Couldn't find thread");
-    }
-    PredMutexCond &predMutexCondRef = 
-        periodicMapIt->second->getPredMutexCond();
+    while (!m_periodicShutdown) {
+        /* 
+         * Retire if a Periodic that may block was canceled.  The
+         * next registration (or the shutdown) joins this worker.
+         */
+        if (m_periodicThreads.size() > getPeriodicWorkerTarget()) {
+            CXXThread<FactoryOps> *threadP = 
+                reinterpret_cast<CXXThread<FactoryOps> *>(param);
+            m_periodicThreads.erase(find(m_periodicThreads.begin(),
+                                         m_periodicThreads.end(),
+                                         threadP));
+            m_periodicRetiredThreads.push_back(threadP);
+            break;
+        }
+        if (m_periodicSchedule.empty()) {
+            m_periodicCond.wait(m_periodicMapLock);
+            continue;
+        }
 
-    m_periodicMapLock.release();
-    
-    try {
-        do {
-            LOG_DEBUG(CL_LOG, 
-                      "runPeriodic: thread: %" PRId32 " doing run() "
-                      "after waiting %" PRId64,
-                      ProcessThreadService::getTid(),
-                      periodic->getMsecsFrequency());
+        int64_t nowMsecs = TimerService::getCurrentTimeMsecs();
+        set<pair<int64_t, Periodic *> >::iterator periodicScheduleIt = 
+            m_periodicSchedule.begin();
+        if (periodicScheduleIt->first > nowMsecs) {
+            m_periodicCond.waitMsecs(m_periodicMapLock, 
+                                     periodicScheduleIt->first - nowMsecs);
+            continue;
+        }
+
+        int64_t lateMsecs = nowMsecs - periodicScheduleIt->first;
+        Periodic *periodic = periodicScheduleIt->second;
+        m_periodicSchedule.erase(periodicScheduleIt);
+        map<Periodic *, PeriodicRegistration *>::const_iterator 
+            periodicMapIt = m_periodicMap.find(periodic);
+        if (periodicMapIt == m_periodicMap.end()) {
+            m_periodicMapLock.release();
+            throw InconsistentInternalStateException(
+                "runPeriodic: Couldn't find registration");
+        }
+        PeriodicRegistration *registrationP = periodicMapIt->second;
+        registrationP->m_nextRunMsecs = -1;
+        registrationP->m_running = true;
+        registrationP->m_runningTid = ProcessThreadService::getTid();
+        m_periodicMapLock.release();
+
+        int64_t frequencyMsecs = periodic->getMsecsFrequency();
+        if (lateMsecs > frequencyMsecs) {
+            LOG_WARN(CL_LOG,
+                     "runPeriodic: Periodic %p started %" PRId64 
+                     " msecs late (frequency %" PRId64 " msecs), all "
+                     "workers were busy",
+                     periodic,
+                     lateMsecs,
+                     frequencyMsecs);
+        }
+
+        LOG_DEBUG(CL_LOG, 
+                  "runPeriodic: thread: %" PRId32 " doing run() of %p",
+                  ProcessThreadService::getTid(),
+                  periodic);
+        bool failed = false;
+        try {
             periodic->run();
-        } while (predMutexCondRef.predWaitMsecs(periodic->getMsecsFrequency()) 
-                 == false);
-    }
-    catch (Exception e) {
-        LOG_ERROR(CL_LOG, 
-                  "runPeriodic failed with Exception %s", 
-                  e.what());
-        throw e;
+        }
+        catch (Exception &e) {
+            LOG_ERROR(CL_LOG, 
+                      "runPeriodic: run() of %p failed with Exception %s, "
+                      "running it again later", 
+                      periodic,
+                      e.what());
+            failed = true;
+        }
+        catch (std::exception &stde) {
+            LOG_ERROR(CL_LOG, 
+                      "runPeriodic: run() of %p failed with std::exception "
+                      "%s, running it again later", 
+                      periodic,
+                      stde.what());
+            failed = true;
+        }
+        catch (...) {
+            LOG_ERROR(CL_LOG, 
+                      "runPeriodic: run() of %p failed with an unknown "
+                      "exception, running it again later", 
+                      periodic);
+            failed = true;
+        }
+
+        int64_t endMsecs = TimerService::getCurrentTimeMsecs();
+        if (endMsecs - nowMsecs > frequencyMsecs) {
+            LOG_WARN(CL_LOG,
+                     "runPeriodic: run() of %p took %" PRId64 " msecs, "
+                     "longer than its frequency (%" PRId64 " msecs)",
+                     periodic,
+                     endMsecs - nowMsecs,
+                     frequencyMsecs);
+        }
+
+        m_periodicMapLock.acquire();
+        registrationP->m_running = false;
+        registrationP->m_runningTid = -1;
+        if (registrationP->m_canceledByRun) {
+            m_periodicMap.erase(periodic);
+            delete registrationP;
+        }
+        else if (registrationP->m_canceled) {
+            m_periodicCond.signal_all();
+        }
+        else {
+            /* A failed run() is tried again later, backing off. */
+            registrationP->m_failures = 
+                failed ? (registrationP->m_failures + 1) : 0;
+            registrationP->m_nextRunMsecs = 
+                getNextPeriodicRunMsecs(frequencyMsecs,
+                                        registrationP->m_failures);
+            m_periodicSchedule.insert(
+                make_pair(registrationP->m_nextRunMsecs, periodic));
+        }
     }
+    m_periodicMapLock.release();
 
     LOG_INFO(CL_LOG,
              "Ending thread with FactoryOps::runPeriodic(): "
@@ -551,14 +899,67 @@ FactoryOps::runPeriodic(void *param)
              ProcessThreadService::getTid());
 }
 
+size_t
+FactoryOps::getPeriodicWorkerTarget() const
+{
+    return static_cast<size_t>(m_periodicSharedThreads + 
+                               m_periodicBlockingCount);
+}
+
+void
+FactoryOps::adjustPeriodicWorkers()
+{
+    TRACE(CL_LOG, "adjustPeriodicWorkers");
+
+    /* A retired worker only has to return once it is in the list. */
+    vector<CXXThread<FactoryOps> *>::iterator retiredIt;
+    for (retiredIt = m_periodicRetiredThreads.begin();
+         retiredIt != m_periodicRetiredThreads.end();
+         ++retiredIt) {
+        (*retiredIt)->Join();
+        delete *retiredIt;
+    }
+    m_periodicRetiredThreads.clear();
+
+    while (!m_periodicShutdown && 
+           (m_periodicThreads.size() < getPeriodicWorkerTarget())) {
+        CXXThread<FactoryOps> *threadP = new CXXThread<FactoryOps>();
+        m_periodicThreads.push_back(threadP);
+        threadP->Create(*this, &FactoryOps::runPeriodic, threadP);
+    }
+}
+
+int64_t
+FactoryOps::getNextPeriodicRunMsecs(int64_t frequencyMsecs, 
+                                    int32_t failures)
+{
+    int64_t waitMsecs = frequencyMsecs;
+    for (int32_t i = 0; 
+         (i < failures) && 
+             (waitMsecs < frequencyMsecs * 
+              CLNumericInternal::PERIODIC_MAX_FAILURE_BACKOFF);
+         ++i) {
+        waitMsecs *= 2;
+    }
+    int64_t jitterMsecs = 
+        (waitMsecs * CLNumericInternal::PERIODIC_JITTER_PERCENT) / 100;
+    int64_t nextRunMsecs = 
+        TimerService::getCurrentTimeMsecs() + waitMsecs;
+    if (jitterMsecs > 0) {
+        nextRunMsecs += 
+            (rand_r(&m_periodicSeed) % (2 * jitterMsecs + 1)) - jitterMsecs;
+    }
+    return nextRunMsecs;
+}
+
 void
-FactoryOps::registerPeriodicThread(Periodic &periodic)
+FactoryOps::registerPeriodicThread(Periodic &periodic, bool mayBlock)
 {
     TRACE(CL_LOG, "registerPeriodicThread");
 
     Locker l(&m_periodicMapLock);
 
-    map<Periodic *, CXXThread<FactoryOps> *>::const_iterator periodicMapIt =
+    map<Periodic *, PeriodicRegistration *>::const_iterator periodicMapIt =
         m_periodicMap.find(&periodic);
     if (periodicMapIt != m_periodicMap.end()) {
         throw InvalidArgumentsException(
@@ -566,9 +967,19 @@ FactoryOps::registerPeriodicThread(Periodic &periodic)
             "already registered");
     }
 
-    m_periodicMap[&periodic] = new CXXThread<FactoryOps>(); 
-    m_periodicMap[&periodic]->Create(
-        *this, &FactoryOps::runPeriodic, &periodic);
+    /* The first run() is right away. */
+    PeriodicRegistration *registrationP = 
+        new PeriodicRegistration(&periodic, mayBlock);
+    registrationP->m_nextRunMsecs = TimerService::getCurrentTimeMsecs();
+    m_periodicMap[&periodic] = registrationP;
+    m_periodicSchedule.insert(
+        make_pair(registrationP->m_nextRunMsecs, &periodic));
+    if (mayBlock) {
+        ++m_periodicBlockingCount;
+    }
+
+    adjustPeriodicWorkers();
+    m_periodicCond.signal();
 }
 
 bool
@@ -576,28 +987,46 @@ FactoryOps::cancelPeriodicThread(Periodic &periodic)
 {
     TRACE(CL_LOG, "cancelPeriodicThread");
     
-    map<Periodic *, CXXThread<FactoryOps> *>::iterator periodicMapIt;
-
-    {
-        Locker l(&m_periodicMapLock);
+    Locker l(&m_periodicMapLock);
 
-        periodicMapIt = m_periodicMap.find(&periodic);
+    map<Periodic *, PeriodicRegistration *>::iterator periodicMapIt =
+        m_periodicMap.find(&periodic);
+    if ((periodicMapIt == m_periodicMap.end()) ||
+        (periodicMapIt->second->m_canceled)) {
+        return false;
     }
 
-    if (periodicMapIt == m_periodicMap.end()) {
-        return false;
+    PeriodicRegistration *registrationP = periodicMapIt->second;
+    registrationP->m_canceled = true;
+    if (registrationP->m_nextRunMsecs != -1) {
+        m_periodicSchedule.erase(
+            make_pair(registrationP->m_nextRunMsecs, &periodic));
     }
 
-    periodicMapIt->second->getPredMutexCond().predSignal();
-    periodicMapIt->second->Join();
+    /* The worker added for it retires once it is idle. */
+    if (registrationP->m_mayBlock) {
+        --m_periodicBlockingCount;
+        m_periodicCond.signal_all();
+    }
 
-    {
-        Locker l(&m_periodicMapLock);
+    /*
+     * A run() cannot wait for itself to finish.  Its worker drops the
+     * registration when it returns.
+     */
+    if (registrationP->m_running && 
+        (registrationP->m_runningTid == ProcessThreadService::getTid())) {
+        registrationP->m_canceledByRun = true;
+        return true;
+    }
 
-        delete periodicMapIt->second;
-        m_periodicMap.erase(periodicMapIt);
+    /* Once this returns, the caller may delete the Periodic. */
+    while (registrationP->m_running) {
+        m_periodicCond.wait(m_periodicMapLock);
     }
 
+    m_periodicMap.erase(&periodic);
+    delete registrationP;
+
     return true;
 }
 
@@ -615,6 +1044,9 @@ FactoryOps::discardAllClients()
 	delete *clIt;
     }
     m_clients.clear();
+
+    Locker l2(&m_subscriptionsLock);
+    m_subscriptions.clear();
 }
 
 void
@@ -622,20 +1054,225 @@ FactoryOps::discardAllPeriodicThreads()
 {
     TRACE(CL_LOG, "discardAllPeriodicThreads");
 
-    map<Periodic *, CXXThread<FactoryOps> *>::iterator periodicMapIt;
+    /* The workers finish the run() they are doing. */
     m_periodicMapLock.acquire();
-    while (!m_periodicMap.empty()) {
-        periodicMapIt = m_periodicMap.begin();
-        m_periodicMapLock.release();
-        
-        periodicMapIt->second->getPredMutexCond().predSignal();
-        periodicMapIt->second->Join();
+    m_periodicShutdown = true;
+    m_periodicCond.signal_all();
+    vector<CXXThread<FactoryOps> *> periodicThreads(m_periodicThreads);
+    periodicThreads.insert(periodicThreads.end(),
+                           m_periodicRetiredThreads.begin(),
+                           m_periodicRetiredThreads.end());
+    m_periodicThreads.clear();
+    m_periodicRetiredThreads.clear();
+    m_periodicMapLock.release();
 
-        m_periodicMapLock.acquire();
+    /* No worker retires once the workers are stopping. */
+    vector<CXXThread<FactoryOps> *>::iterator periodicThreadsIt;
+    for (periodicThreadsIt = periodicThreads.begin();
+         periodicThreadsIt != periodicThreads.end();
+         ++periodicThreadsIt) {
+        (*periodicThreadsIt)->Join();
+        delete *periodicThreadsIt;
+    }
+
+    Locker l(&m_periodicMapLock);
+
+    map<Periodic *, PeriodicRegistration *>::iterator periodicMapIt;
+    for (periodicMapIt = m_periodicMap.begin();
+         periodicMapIt != m_periodicMap.end();
+         ++periodicMapIt) {
         delete periodicMapIt->second;
-        m_periodicMap.erase(periodicMapIt);
     }
-    m_periodicMapLock.release();
+    m_periodicMap.clear();
+    m_periodicSchedule.clear();
+}
+
+/**
+ * Rethrow an exception an asynchronous operation failed with.
+ */
+template <class E>
+static void
+rethrowAsyncException(const string &message)
+{
+    throw E(message);
+}
+
+void
+FactoryOps::runAsync(AsyncTask *task)
+{
+    TRACE(CL_LOG, "runAsync");
+
+    Locker l(&m_asyncThreadsLock);
+
+    if (m_asyncShutdown) {
+        delete task;
+        throw InvalidMethodException(
+            "runAsync: The factory is shutting down");
+    }
+    startAsyncWorkers();
+    m_asyncTasks.put(task);
+}
+
+void
+FactoryOps::beginAsync()
+{
+    TRACE(CL_LOG, "beginAsync");
+
+    Locker l(&m_asyncThreadsLock);
+
+    if (m_asyncShutdown) {
+        throw InvalidMethodException(
+            "beginAsync: The factory is shutting down");
+    }
+    ++m_asyncPending;
+}
+
+void
+FactoryOps::finishAsync(AsyncTask *task)
+{
+    TRACE(CL_LOG, "finishAsync");
+
+    Locker l(&m_asyncThreadsLock);
+
+    /* 
+     * Even when shutting down, since stopAsyncWorkers() waits for
+     * the pending operations before stopping the workers.
+     */
+    startAsyncWorkers();
+    m_asyncTasks.put(task);
+    --m_asyncPending;
+    if (m_asyncPending == 0) {
+        m_asyncPendingCond.signal_all();
+    }
+}
+
+void
+FactoryOps::startAsyncWorkers()
+{
+    if (!m_asyncThreads.empty()) {
+        return;
+    }
+    for (int32_t i = 0; i < CLNumericInternal::ASYNC_WORKER_THREADS; ++i) {
+        CXXThread<FactoryOps> *threadP = new CXXThread<FactoryOps>();
+        threadP->Create(*this, &FactoryOps::runAsyncTasks);
+        m_asyncThreads.push_back(threadP);
+    }
+}
+
+void
+FactoryOps::runAsyncTasks(void *param)
+{
+    TRACE(CL_LOG, "runAsyncTasks");
+
+    LOG_INFO(CL_LOG,
+             "Starting thread with FactoryOps::runAsyncTasks(), "
+             "this: %p, thread: %" PRId32,
+             this,
+             ProcessThreadService::getTid());
+
+    AsyncTask *task;
+    while ((task = m_asyncTasks.take()) != NULL) {
+        /* 
+         * Keep the type of the exception, so that the caller can
+         * catch it as if it had called the operation itself.
+         */
+        try {
+            task->run();
+        } 
+        catch (AlreadyConnectedException &e) {
+            task->getResult().setFailed(
+                &rethrowAsyncException<AlreadyConnectedException>, 
+                e.what());
+        }
+        catch (InconsistentInternalStateException &e) {
+            task->getResult().setFailed(
+                &rethrowAsyncException<InconsistentInternalStateException>, 
+                e.what());
+        }
+        catch (InvalidArgumentsException &e) {
+            task->getResult().setFailed(
+                &rethrowAsyncException<InvalidArgumentsException>, 
+                e.what());
+        }
+        catch (InvalidMethodException &e) {
+            task->getResult().setFailed(
+                &rethrowAsyncException<InvalidMethodException>, 
+                e.what());
+        }
+        catch (PublishVersionException &e) {
+            task->getResult().setFailed(
+                &rethrowAsyncException<PublishVersionException>, 
+                e.what());
+        }
+        catch (ObjectRemovedException &e) {
+            task->getResult().setFailed(
+                &rethrowAsyncException<ObjectRemovedException>, 
+                e.what());
+        }
+        catch (RepositoryConnectionFailureException &e) {
+            task->getResult().setFailed(
+                &rethrowAsyncException<RepositoryConnectionFailureException>,
+                e.what());
+        }
+        catch (RepositoryInternalsFailureException &e) {
+            task->getResult().setFailed(
+                &rethrowAsyncException<RepositoryInternalsFailureException>,
+                e.what());
+        }
+        catch (SystemFailureException &e) {
+            task->getResult().setFailed(
+                &rethrowAsyncException<SystemFailureException>, 
+                e.what());
+        }
+        catch (RepositoryDataMissingException &e) {
+            task->getResult().setFailed(
+                &rethrowAsyncException<RepositoryDataMissingException>, 
+                e.what());
+        }
+        catch (std::exception &e) {
+            task->getResult().setFailed(
+                &rethrowAsyncException<Exception>, e.what());
+        }
+        delete task;
+    }
+
+    LOG_INFO(CL_LOG,
+             "Ending thread with FactoryOps::runAsyncTasks(): "
+             "this: %p, thread: %" PRId32,
+             this,
+             ProcessThreadService::getTid());
+}
+
+void
+FactoryOps::stopAsyncWorkers()
+{
+    TRACE(CL_LOG, "stopAsyncWorkers");
+
+    {
+        Locker l(&m_asyncThreadsLock);
+        m_asyncShutdown = true;
+        while (m_asyncPending > 0) {
+            m_asyncPendingCond.wait(m_asyncThreadsLock);
+        }
+    }
+
+    /* 
+     * No more threads are added once m_asyncShutdown is set and no
+     * operation is pending.
+     */
+    vector<CXXThread<FactoryOps> *>::iterator asyncThreadsIt;
+    for (asyncThreadsIt = m_asyncThreads.begin();
+         asyncThreadsIt != m_asyncThreads.end();
+         ++asyncThreadsIt) {
+        m_asyncTasks.put(NULL);
+    }
+    for (asyncThreadsIt = m_asyncThreads.begin();
+         asyncThreadsIt != m_asyncThreads.end();
+         ++asyncThreadsIt) {
+        (*asyncThreadsIt)->Join();
+        delete *asyncThreadsIt;
+    }
+    m_asyncThreads.clear();
 }
 
 FactoryOps *
@@ -660,6 +1297,8 @@ FactoryOps::dispatchExternalEvents(void *param)
              ProcessThreadService::getTid());
 
     try {
+        vector<GenericEvent> events;
+        size_t eventIndex = 0;
         while (m_shutdown == false) { 
             LOG_DEBUG(CL_LOG,
                       "[%d]: Asking for next event",
@@ -667,11 +1306,16 @@ FactoryOps::dispatchExternalEvents(void *param)
             eventSeqId++;
 
             /*
-             * Get the next event and send it off to the
-             * correct handler.
+             * Get the next event and send it off to the correct
+             * handler.  Events are taken from the queue in bursts.
              */
-            GenericEvent ge;
-            m_externalEventAdapter.getNextEvent(ge);
+            if (eventIndex == events.size()) {
+                events.clear();
+                eventIndex = 0;
+                m_externalEventAdapter.getNextEvents(
+                    -1, events, CLNumericInternal::MAX_EVENT_BATCH_SIZE);
+            }
+            GenericEvent ge = events[eventIndex++];
 
             LOG_DEBUG(CL_LOG,
                       "[%" PRIu32 ", %p] dispatchExternalEvents() received "
@@ -720,7 +1364,7 @@ FactoryOps::dispatchExternalEvents(void *param)
                             dispatchSessionEvent(zp);
                         } 
                         else {
-                            dispatchZKEvent(zp);
+                            routeZKEvent(ge);
                         }
                     }
                     break;
@@ -734,21 +1378,25 @@ FactoryOps::dispatchExternalEvents(void *param)
         }
 
         /*
-         * After the event loop, we inform all
-         * registered clients that there will
+         * After the event loop (and the events still queued on the
+         * workers), we inform all registered clients that there will
          * be no more events coming.
          */
+        stopEventDispatchWorkers();
         dispatchEndEvent();
 
     } catch (zk::ZooKeeperException &zke) {
         LOG_ERROR(CL_LOG, "ZooKeeperException: %s", zke.what());
+        stopEventDispatchWorkers();
         dispatchEndEvent();
         throw RepositoryInternalsFailureException(zke.what());
     } catch (Exception &e) {
+        stopEventDispatchWorkers();
         dispatchEndEvent();
         throw Exception(e.what());
     } catch (std::exception &stde) {
         LOG_ERROR(CL_LOG, "Unknown exception: %s", stde.what());
+        stopEventDispatchWorkers();
         dispatchEndEvent();
         throw Exception(stde.what());
     }
@@ -760,6 +1408,190 @@ FactoryOps::dispatchExternalEvents(void *param)
              ProcessThreadService::getTid());
 }
 
+void
+ZooKeeperEventRouter::eventReceived(
+    const EventSource<zk::ZKWatcherEvent> &source, 
+    const zk::ZKWatcherEvent &e)
+{
+    TRACE(CL_LOG, "eventReceived");
+
+    GenericEvent ge(ZKEVENT, new EventWrapper<zk::ZKWatcherEvent>(e));
+    if ((e.getType() == ZOO_SESSION_EVENT) &&
+        (e.getPath().compare(CLStringInternal::SYNC) != 0)) {
+        fireEventToAllListeners(ge);
+    }
+    else {
+        mp_ops->routeZKEvent(ge);
+    }
+}
+
+void
+FactoryOps::routeZKEvent(const GenericEvent &ge)
+{
+    TRACE(CL_LOG, "routeZKEvent");
+
+    zk::ZKWatcherEvent *zp = (zk::ZKWatcherEvent *) ge.getEvent();
+
+    Locker l(&m_eventDispatchLock);
+    if (m_eventDispatchStopped) {
+        LOG_DEBUG(CL_LOG,
+                  "routeZKEvent: Dropping the event on %s, the workers "
+                  "are stopped",
+                  zp->getPath().c_str());
+        return;
+    }
+
+    /*
+     * A sync event must be seen by the client after every event
+     * queued before it, so every worker has to reach it first.
+     */
+    if (zp->getPath().compare(CLStringInternal::SYNC) == 0) {
+        boost::shared_ptr<ExternalEventBarrier> barrierSP(
+            new ExternalEventBarrier(m_eventDispatchQueues.size()));
+        vector<MPSCQueue<ExternalEventRequest> *>::iterator queueIt;
+        for (queueIt = m_eventDispatchQueues.begin();
+             queueIt != m_eventDispatchQueues.end();
+             ++queueIt) {
+            (*queueIt)->put(ExternalEventRequest(ge, barrierSP));
+        }
+        return;
+    }
+
+    m_eventDispatchQueues[getEventDispatchWorker(zp->getPath())]->put(
+        ExternalEventRequest(ge));
+}
+
+size_t
+FactoryOps::getEventDispatchWorker(const string &path)
+{
+    TRACE(CL_LOG, "getEventDispatchWorker");
+
+    /*
+     * Lock nodes live under the notifyable they lock and the other
+     * paths are at most one level below their notifyable.  Paths that
+     * are not part of a notifyable keep to themselves.
+     */
+    string key;
+    size_t lockDirIndex = path.find(CLStringInternal::PARTIAL_LOCK_NODE);
+    if (lockDirIndex != string::npos) {
+        key = path.substr(0, lockDirIndex);
+    }
+    else {
+        try {
+            key = getNotifyableKeyFromKey(path);
+        } 
+        catch (InconsistentInternalStateException &e) {
+            LOG_WARN(CL_LOG,
+                     "getEventDispatchWorker: Using path %s as the key (%s)",
+                     path.c_str(),
+                     e.what());
+        }
+        if (key.empty()) {
+            key = path;
+        }
+    }
+
+    /* djb2, cheap and good enough to spread the keys. */
+    uint32_t hash = 5381;
+    for (string::const_iterator it = key.begin(); it != key.end(); ++it) {
+        hash = ((hash << 5) + hash) + static_cast<unsigned char>(*it);
+    }
+    return hash % m_eventDispatchQueues.size();
+}
+
+void
+FactoryOps::dispatchWorkerEvents(void *param)
+{
+    TRACE(CL_LOG, "dispatchWorkerEvents");
+
+    size_t index = reinterpret_cast<size_t>(param);
+    MPSCQueue<ExternalEventRequest> *queueP = 
+        m_eventDispatchQueues[index];
+    LOG_INFO(CL_LOG,
+             "Starting thread with FactoryOps::dispatchWorkerEvents(), "
+             "this: %p, worker: %" PRIuPTR ", thread: %" PRId32,
+             this,
+             index,
+             ProcessThreadService::getTid());
+
+    vector<ExternalEventRequest> requests;
+    size_t requestIndex = 0;
+    while (true) {
+        if (requestIndex == requests.size()) {
+            requests.clear();
+            requestIndex = 0;
+            queueP->takeAllWaitMsecs(
+                -1, requests, CLNumericInternal::MAX_EVENT_BATCH_SIZE);
+        }
+        const ExternalEventRequest &request = requests[requestIndex++];
+        if (request.m_end) {
+            break;
+        }
+        if ((request.m_barrierSP != NULL) && 
+            (!request.m_barrierSP->arrive())) {
+            continue;
+        }
+
+        /*
+         * Nothing else takes from this queue, so a failed event must
+         * not stop the worker.  The notifyable is reloaded on its
+         * next event.
+         */
+        zk::ZKWatcherEvent *zp = 
+            (zk::ZKWatcherEvent *) request.m_event.getEvent();
+        try {
+            dispatchZKEvent(zp);
+        } catch (std::exception &stde) {
+            LOG_ERROR(CL_LOG, 
+                      "dispatchWorkerEvents: Worker %" PRIuPTR " failed "
+                      "to dispatch the event on %s: %s",
+                      index,
+                      zp->getPath().c_str(),
+                      stde.what());
+        } catch (...) {
+            LOG_ERROR(CL_LOG, 
+                      "dispatchWorkerEvents: Worker %" PRIuPTR " failed "
+                      "to dispatch the event on %s: unknown exception",
+                      index,
+                      zp->getPath().c_str());
+        }
+    }
+
+    LOG_INFO(CL_LOG,
+             "Ending thread with FactoryOps::dispatchWorkerEvents(): "
+             "this: %p, worker: %" PRIuPTR ", thread: %" PRId32,
+             this,
+             index,
+             ProcessThreadService::getTid());
+}
+
+void
+FactoryOps::stopEventDispatchWorkers()
+{
+    TRACE(CL_LOG, "stopEventDispatchWorkers");
+
+    /* No event is queued after the requests that stop the workers. */
+    {
+        Locker l(&m_eventDispatchLock);
+        if (m_eventDispatchStopped) {
+            return;
+        }
+        m_eventDispatchStopped = true;
+        vector<MPSCQueue<ExternalEventRequest> *>::iterator queueIt;
+        for (queueIt = m_eventDispatchQueues.begin();
+             queueIt != m_eventDispatchQueues.end();
+             ++queueIt) {
+            (*queueIt)->put(ExternalEventRequest());
+        }
+    }
+    vector<CXXThread<FactoryOps> *>::iterator threadIt;
+    for (threadIt = m_eventDispatchThreads.begin();
+         threadIt != m_eventDispatchThreads.end();
+         ++threadIt) {
+        (*threadIt)->Join();
+    }
+}
+
 void
 FactoryOps::dispatchTimerEvent(ClusterlibTimerEvent *tep)
 {
@@ -829,15 +1661,17 @@ FactoryOps::dispatchZKEvent(zk::ZKWatcherEvent *zp)
     }
 
     /*
-     * Now dispatch the event to all registered clients in
-     * case they have a registered handler for the event on
-     * the affected clusterlib repository object.
+     * Now dispatch the event to the registered clients that have a
+     * handler for the event on the affected clusterlib repository
+     * object.
      */
     {
         Locker l(getClientsLock());
 
-        for (clIt = m_clients.begin();
-             clIt != m_clients.end(); 
+        ClientImplList clients;
+        getSubscribedClients(uep->getKey(), uep->getEvent(), clients);
+        for (clIt = clients.begin();
+             clIt != clients.end(); 
              clIt++) {
             uepp = new UserEventPayload(*uep);
             LOG_DEBUG(CL_LOG, 
@@ -891,11 +1725,14 @@ FactoryOps::dispatchSessionEvent(zk::ZKWatcherEvent *zep)
     }
     else if (zep->getState() == ZOO_EXPIRED_SESSION_STATE) {
         /*
-         * We give up on SESSION_EXPIRED.
+         * We give up on SESSION_EXPIRED.  The ephemeral nodes of the
+         * old session (i.e. the distributed locks and the ready
+         * nodes) are gone, so the locks this process thinks it holds
+         * may already be held by others.  Keeping on with a new
+         * session would break mutual exclusion.
          */
-#ifdef	VERY_VERY_VERBOSE
-        LOG_WARN(CL_LOG, "Giving up.");
-#endif
+        LOG_WARN(CL_LOG, 
+                 "dispatchSessionEvent: Session expired, giving up");
         m_shutdown = true;
         m_connected = false;
     }
@@ -1095,7 +1932,7 @@ FactoryOps::getNotifyableWaitMsecs(
 
     /* Try to find the notifyable in its proper map cache. */
     {
-        Locker l(&safeNotifyableMap->getLock());
+        Locker l(&safeNotifyableMap->getLock(notifyableKey));
 
         *pNotifyableSP = safeNotifyableMap->getNotifyable(notifyableKey);
     }
@@ -1104,43 +1941,13 @@ FactoryOps::getNotifyableWaitMsecs(
         return true;
     }
 
-    /*
-     * Need to lock the parent if it is being LOAD_FROM_REPOSITORY or
-     * CREATE_IF_NOT_FOUND.  However, if the minimum lock is already
-     * held, there is no need to do this.
-     */
     bool hasMinimumLock = false;
-    if (parentSP != NULL) {
-        DistributedLockType distributedLockType = DIST_LOCK_SHARED;
-        if (accessType == CREATE_IF_NOT_FOUND) {
-            distributedLockType = DIST_LOCK_EXCL;
-        }
-        DistributedLockType ownerDistributedLockType = DIST_LOCK_INIT;
-        hasMinimumLock = parentSP->hasLock(CLString::CHILD_LOCK, 
-                                           &ownerDistributedLockType);
-        if (hasMinimumLock) {
-            if ((distributedLockType == DIST_LOCK_EXCL) &&
-                (ownerDistributedLockType != DIST_LOCK_EXCL)) {
-                ostringstream oss;
-                oss << "getNotifyableWaitMsecs: Notiyable to be retrieved "
-                    << "with Notiyable key=" << notifyableKey << " has parent="
-                    << parentSP->getKey() << " that is already locked with "
-                    << distributedLockTypeToString(ownerDistributedLockType)
-                    << " but needs "
-                    << distributedLockTypeToString(distributedLockType);
-                throw InvalidMethodException(oss.str());
-            }
-        }
-        else {
-            hasMinimumLock = getOps()->getDistributedLocks()->acquireWaitMsecs(
-                msecTimeout,
-                dynamic_pointer_cast<Notifyable>(parentSP),
-                CLString::CHILD_LOCK,
-                distributedLockType);
-            if (false == hasMinimumLock) {
-                return false;
-            }
-        }
+    if (!lockParentWaitMsecs(parentSP, 
+                             accessType, 
+                             notifyableKey, 
+                             msecTimeout, 
+                             &hasMinimumLock)) {
+        return false;
     }
     
     *pNotifyableSP = registeredNotifyable->loadNotifyableFromRepository(
@@ -1158,12 +1965,7 @@ FactoryOps::getNotifyableWaitMsecs(
     }
 
     if (*pNotifyableSP != NULL) {
-        (*pNotifyableSP)->setSafeNotifyableMap(*safeNotifyableMap);
-
-        Locker l(&safeNotifyableMap->getLock());
-
-        safeNotifyableMap->uniqueInsert(*pNotifyableSP);
-        (*pNotifyableSP)->initialize();
+        cacheLoadedNotifyable(safeNotifyableMap, pNotifyableSP);
     }
     
     if ((true == hasMinimumLock) && (NULL != parentSP)) {
@@ -1192,6 +1994,81 @@ FactoryOps::getNotifyable(
     return notifyableSP;
 }
 
+bool
+FactoryOps::lockParentWaitMsecs(const shared_ptr<NotifyableImpl> &parentSP,
+                                AccessType accessType,
+                                const string &notifyableKey,
+                                int64_t msecTimeout,
+                                bool *pHasMinimumLock)
+{
+    TRACE(CL_LOG, "lockParentWaitMsecs");
+
+    /*
+     * Need to lock the parent if it is being LOAD_FROM_REPOSITORY or
+     * CREATE_IF_NOT_FOUND.  However, if the minimum lock is already
+     * held, there is no need to do this.
+     */
+    *pHasMinimumLock = false;
+    if (parentSP != NULL) {
+        DistributedLockType distributedLockType = DIST_LOCK_SHARED;
+        if (accessType == CREATE_IF_NOT_FOUND) {
+            distributedLockType = DIST_LOCK_EXCL;
+        }
+        DistributedLockType ownerDistributedLockType = DIST_LOCK_INIT;
+        *pHasMinimumLock = parentSP->hasLock(CLString::CHILD_LOCK, 
+                                             &ownerDistributedLockType);
+        if (*pHasMinimumLock) {
+            if ((distributedLockType == DIST_LOCK_EXCL) &&
+                (ownerDistributedLockType != DIST_LOCK_EXCL)) {
+                ostringstream oss;
+                oss << "lockParentWaitMsecs: Notiyable to be retrieved "
+                    << "with Notiyable key=" << notifyableKey << " has parent="
+                    << parentSP->getKey() << " that is already locked with "
+                    << distributedLockTypeToString(ownerDistributedLockType)
+                    << " but needs "
+                    << distributedLockTypeToString(distributedLockType);
+                throw InvalidMethodException(oss.str());
+            }
+        }
+        else {
+            *pHasMinimumLock = 
+                getOps()->getDistributedLocks()->acquireWaitMsecs(
+                    msecTimeout,
+                    dynamic_pointer_cast<Notifyable>(parentSP),
+                    CLString::CHILD_LOCK,
+                    distributedLockType);
+            if (false == *pHasMinimumLock) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void
+FactoryOps::cacheLoadedNotifyable(SafeNotifyableMap *safeNotifyableMap,
+                                  shared_ptr<NotifyableImpl> *pNotifyableSP)
+{
+    TRACE(CL_LOG, "cacheLoadedNotifyable");
+
+    (*pNotifyableSP)->setSafeNotifyableMap(*safeNotifyableMap);
+
+    Locker l(&safeNotifyableMap->getLock((*pNotifyableSP)->getKey()));
+
+    shared_ptr<NotifyableImpl> cachedNotifyableSP = 
+        safeNotifyableMap->getNotifyable((*pNotifyableSP)->getKey());
+    if (cachedNotifyableSP != NULL) {
+        *pNotifyableSP = cachedNotifyableSP;
+        return;
+    }
+    safeNotifyableMap->uniqueInsert(*pNotifyableSP);
+    (*pNotifyableSP)->initialize();
+
+    Locker l2(&m_cachedNotifyableTrie.getLock());
+    m_cachedNotifyableTrie.insert(*pNotifyableSP);
+}
+
 bool
 FactoryOps::isValidKey(const vector<string> &registeredNameVec,
                        const string &key)
@@ -1412,7 +2289,8 @@ FactoryOps::removeCachedNotifyable(
 {
     TRACE(CL_LOG, "removeCachedNotifyable");
     
-    Locker l(&notifyableSP->getSafeNotifyableMap()->getLock());
+    Locker l(&notifyableSP->getSafeNotifyableMap()->getLock(
+                 notifyableSP->getKey()));
     {
         LOG_DEBUG(CL_LOG, 
                   "removeCachedNotifyable: state changing to REMOVED "
@@ -1430,6 +2308,27 @@ FactoryOps::removeCachedNotifyable(
     }
 
     notifyableSP->getSafeNotifyableMap()->erase(notifyableSP);
+
+    Locker l2(&m_cachedNotifyableTrie.getLock());
+    m_cachedNotifyableTrie.erase(notifyableSP->getKey());
+}
+
+NotifyableList
+FactoryOps::getCachedChildren(const string &key)
+{
+    TRACE(CL_LOG, "getCachedChildren");
+
+    Locker l(&m_cachedNotifyableTrie.getLock());
+    return m_cachedNotifyableTrie.getChildren(key);
+}
+
+NotifyableList
+FactoryOps::getCachedNotifyablesFromKeyPrefix(const string &keyPrefix)
+{
+    TRACE(CL_LOG, "getCachedNotifyablesFromKeyPrefix");
+
+    Locker l(&m_cachedNotifyableTrie.getLock());
+    return m_cachedNotifyableTrie.getFromKeyPrefix(keyPrefix);
 }
 
 const Mutex &
@@ -1467,6 +2366,13 @@ FactoryOps::getEndEventLock() const
     return m_endEventLock; 
 }
 
+const Mutex &
+FactoryOps::getRepositoryPoolLock() const 
+{
+    TRACE(CL_LOG, "getRepositoryPoolLock");
+    return m_repositoryPoolLock; 
+}
+
 NameList
 FactoryOps::getChildrenNames(
     const string &notifyableKey,
@@ -1476,13 +2382,13 @@ FactoryOps::getChildrenNames(
 
     NameList nameList;
     SAFE_CALLBACK_ZK(
-        m_zk.getNodeChildren(
+        m_zkSP->getNodeChildren(
             notifyableKey,
             nameList,
             &m_zkEventAdapter,
             getCachedObjectChangeHandlers()->
             getChangeHandler(change)),
-        m_zk.getNodeChildren(notifyableKey, nameList),
+        m_zkSP->getNodeChildren(notifyableKey, nameList),
         change,
         notifyableKey,
         "Reading the value of %s failed: %s",
@@ -1518,22 +2424,101 @@ FactoryOps::getNotifyableListWaitMsecs(
     shared_ptr<NotifyableImpl> notifyableSP;
     NameList::const_iterator nameListIt;
     bool completed = false;
+    if ((accessType != LOAD_FROM_REPOSITORY) || (nameList.size() < 2)) {
+        for (nameListIt = nameList.begin(); 
+             nameListIt != nameList.end(); 
+             ++nameListIt) {
+            completed = getNotifyableWaitMsecs(parentSP, 
+                                               registeredNotifyableName, 
+                                               *nameListIt, 
+                                               accessType, 
+                                               msecTimeout, 
+                                               &notifyableSP);
+            if ((completed == true) && (notifyableSP != NULL)) {
+                pNotifyableList->push_back(
+                    dynamic_pointer_cast<Notifyable>(notifyableSP));
+            }
+        }
+
+        return completed;
+    }
+
+    /*
+     * Load all the notifyables that are not cached together, so that
+     * their repository requests overlap and the parent is locked
+     * once.
+     */
+    RegisteredNotifyable *registeredNotifyable = 
+        getRegisteredNotifyable(registeredNotifyableName, true);
+    SafeNotifyableMap *safeNotifyableMap = 
+        registeredNotifyable->getSafeNotifyableMap();
+    vector<shared_ptr<NotifyableImpl> > notifyableVec;
+    vector<string> loadNameVec;
+    vector<string> loadKeyVec;
+    vector<size_t> loadIndexVec;
     for (nameListIt = nameList.begin(); 
          nameListIt != nameList.end(); 
          ++nameListIt) {
-        completed = getNotifyableWaitMsecs(parentSP, 
-                                           registeredNotifyableName, 
-                                           *nameListIt, 
-                                           accessType, 
-                                           msecTimeout, 
-                                           &notifyableSP);
-        if ((completed == true) && (notifyableSP != NULL)) {
+        if (!registeredNotifyable->isValidName(*nameListIt)) {
+            ostringstream oss;
+            oss << "getNotifyableListWaitMsecs: Name (" << *nameListIt
+                << ") is invalid for type " << registeredNotifyableName;
+            throw InvalidArgumentsException(oss.str());
+        }
+        string notifyableKey = registeredNotifyable->generateKey(
+            ((parentSP == NULL) ? "" : parentSP->getKey()),
+            *nameListIt);
+        {
+            Locker l(&safeNotifyableMap->getLock(notifyableKey));
+
+            notifyableVec.push_back(
+                safeNotifyableMap->getNotifyable(notifyableKey));
+        }
+        if (notifyableVec.back() == NULL) {
+            loadNameVec.push_back(*nameListIt);
+            loadKeyVec.push_back(notifyableKey);
+            loadIndexVec.push_back(notifyableVec.size() - 1);
+        }
+    }
+
+    if (!loadNameVec.empty()) {
+        bool hasMinimumLock = false;
+        if (!lockParentWaitMsecs(parentSP, 
+                                 accessType, 
+                                 loadKeyVec.front(), 
+                                 msecTimeout, 
+                                 &hasMinimumLock)) {
+            return false;
+        }
+
+        vector<shared_ptr<NotifyableImpl> > loadedVec = 
+            registeredNotifyable->loadNotifyablesFromRepository(
+                loadNameVec, loadKeyVec, parentSP);
+        for (size_t i = 0; i < loadedVec.size(); ++i) {
+            if (loadedVec[i] != NULL) {
+                cacheLoadedNotifyable(safeNotifyableMap, &loadedVec[i]);
+                notifyableVec[loadIndexVec[i]] = loadedVec[i];
+            }
+        }
+
+        if ((true == hasMinimumLock) && (NULL != parentSP)) {
+            getOps()->getDistributedLocks()->release(
+                parentSP,
+                CLString::CHILD_LOCK);
+        }
+    }
+
+    vector<shared_ptr<NotifyableImpl> >::const_iterator notifyableVecIt;
+    for (notifyableVecIt = notifyableVec.begin();
+         notifyableVecIt != notifyableVec.end();
+         ++notifyableVecIt) {
+        if (*notifyableVecIt != NULL) {
             pNotifyableList->push_back(
-                dynamic_pointer_cast<Notifyable>(notifyableSP));
+                dynamic_pointer_cast<Notifyable>(*notifyableVecIt));
         }
     }
 
-    return completed;
+    return true;
 }
 
 NotifyableList 
@@ -1741,7 +2726,7 @@ FactoryOps::establishNotifyableStateChange(NotifyableImpl *ntp)
     }
 
     SAFE_CALLBACK_ZK(
-        m_zk.getNodeData(
+        m_zkSP->getNodeData(
             ntp->getKey(),
             ready,
             &m_zkEventAdapter,
@@ -53,7 +53,12 @@
 }
 
 /**
- * Macro for safely setting up callbacks for zookeeper.
+ * Macro for safely setting up callbacks for zookeeper.  The handler
+ * callback is claimed under the handler lock, but the lock is not
+ * held across the repository call, so loads of other keys (or on
+ * other event dispatch workers) are not serialized behind it.  The
+ * claim is given back if _action1 throws.
+ *
  * @param _action1 the action that occurs if the handler callback == 0
  * @param _action2 the action that occurs if the handler callback > 0
  * @param _changeHandler the CachedObjectChange (i.e. NODES_CHANGE)
@@ -68,13 +73,27 @@
                          _warning, \
                          _once) \
 { \
-    Locker __l1(getOps()->getCachedObjectChangeHandlers()->getLock()); \
-    bool __ready = getOps()->getCachedObjectChangeHandlers()-> \
-        isHandlerCallbackReady(_changeHandler, _key); \
+    CachedObjectChangeHandlers *__handlers = \
+        getOps()->getCachedObjectChangeHandlers(); \
+    bool __ready = true; \
+    { \
+        Locker __l1(__handlers->getLock()); \
+        __ready = __handlers->isHandlerCallbackReady(_changeHandler, _key); \
+        if (__ready == false) { \
+            __handlers->setHandlerCallbackReady(_changeHandler, _key); \
+        } \
+    } \
     if (__ready == false) { \
-        SAFE_CALL_ZK(_action1, _message, _node, _warning, _once); \
-        getOps()->getCachedObjectChangeHandlers()-> \
-            setHandlerCallbackReady(_changeHandler, _key); \
+        try { \
+            SAFE_CALL_ZK(_action1, _message, _node, _warning, _once); \
+        } catch (...) { \
+            Locker __l2(__handlers->getLock()); \
+            if (__handlers->isHandlerCallbackReady(_changeHandler, _key)) { \
+                __handlers->unsetHandlerCallbackReady(_changeHandler, \
+                                                      _key); \
+            } \
+            throw; \
+        } \
     } \
     else { \
         SAFE_CALL_ZK(_action2, _message, _node, _warning, _once); \
@@ -91,6 +110,203 @@ typedef EventListenerAdapter<ClusterlibTimerEvent, TIMEREVENT>
 typedef EventListenerAdapter<zk::ZKWatcherEvent, ZKEVENT>
     ZooKeeperEventAdapter;
 
+/**
+ * Listener of the ZK events of a FactoryOps.  The watch and sync
+ * events go straight from the repository event thread to the event
+ * dispatch workers.  Only the session events (i.e. the end event)
+ * go through the external event thread, since they change the state
+ * of the FactoryOps.
+ */
+class ZooKeeperEventRouter
+    : public ZooKeeperEventAdapter
+{
+  public:
+    /**
+     * Constructor.
+     *
+     * @param eventSource the repository to listen to
+     * @param factoryOps the FactoryOps that dispatches the events
+     */
+    ZooKeeperEventRouter(EventSource<zk::ZKWatcherEvent> &eventSource,
+                         FactoryOps *factoryOps)
+        : ZooKeeperEventAdapter(eventSource),
+          mp_ops(factoryOps) {}
+
+    virtual void eventReceived(
+        const EventSource<zk::ZKWatcherEvent> &source, 
+        const zk::ZKWatcherEvent &e);
+
+  private:
+    /**
+     * The FactoryOps that dispatches the events.
+     */
+    FactoryOps *mp_ops;
+};
+
+/**
+ * Counts down the event dispatch workers that have reached a sync
+ * event.  The last one dispatches it, after every event queued
+ * before it on any worker.
+ */
+class ExternalEventBarrier
+{
+  public:
+    /**
+     * Constructor.
+     *
+     * @param count the number of workers that must arrive
+     */
+    explicit ExternalEventBarrier(int32_t count)
+        : m_remaining(count) {}
+
+    /**
+     * A worker reached the barrier.
+     *
+     * @return true if it was the last one
+     */
+    bool arrive()
+    {
+        return (__sync_sub_and_fetch(&m_remaining, 1) == 0);
+    }
+
+  private:
+    /**
+     * The workers that have not arrived yet.
+     */
+    int32_t m_remaining;
+};
+
+/**
+ * A ZK event queued for an event dispatch worker.
+ */
+class ExternalEventRequest
+{
+  public:
+    /**
+     * Constructor for the request that stops a worker.
+     */
+    ExternalEventRequest()
+        : m_end(true) {}
+
+    /**
+     * Constructor.
+     *
+     * @param event the ZKEVENT to dispatch (shared, not copied)
+     * @param barrierSP if set, only the last worker to reach it
+     *        dispatches the event
+     */
+    ExternalEventRequest(
+        const GenericEvent &event,
+        const boost::shared_ptr<ExternalEventBarrier> &barrierSP = 
+        boost::shared_ptr<ExternalEventBarrier>())
+        : m_event(event),
+          m_barrierSP(barrierSP),
+          m_end(false) {}
+
+    /**
+     * The event to dispatch.
+     */
+    GenericEvent m_event;
+
+    /**
+     * The barrier of a sync event, NULL otherwise.
+     */
+    boost::shared_ptr<ExternalEventBarrier> m_barrierSP;
+
+    /**
+     * Does this request stop the worker?
+     */
+    bool m_end;
+};
+
+/**
+ * The schedule of a Periodic registered with a FactoryOps.
+ */
+class PeriodicRegistration
+{
+  public:
+    /**
+     * Constructor.
+     *
+     * @param periodic the registered Periodic
+     */
+    PeriodicRegistration(Periodic *periodic, bool mayBlock)
+        : mp_periodic(periodic),
+          m_mayBlock(mayBlock),
+          m_failures(0),
+          m_nextRunMsecs(-1),
+          m_running(false),
+          m_runningTid(-1),
+          m_canceled(false),
+          m_canceledByRun(false) {}
+
+    /**
+     * The registered Periodic.
+     */
+    Periodic *mp_periodic;
+
+    /**
+     * May run() block?  Then the pool has one more worker while it
+     * is registered.
+     */
+    bool m_mayBlock;
+
+    /**
+     * The number of run() calls in a row that threw.
+     */
+    int32_t m_failures;
+
+    /**
+     * When run() is due next (msecs since the epoch), -1 if it is
+     * not in the schedule.
+     */
+    int64_t m_nextRunMsecs;
+
+    /**
+     * Is a worker doing run() now?
+     */
+    bool m_running;
+
+    /**
+     * The thread of the worker doing run(), -1 if not running.
+     */
+    int32_t m_runningTid;
+
+    /**
+     * Is it being canceled?
+     */
+    bool m_canceled;
+
+    /**
+     * Was it canceled from its own run()?  Then the worker drops the
+     * registration once run() returns, since nobody waits for it.
+     */
+    bool m_canceledByRun;
+};
+
+/**
+ * An operation run by the asynchronous operation workers (see
+ * FactoryOps::runAsync()).
+ */
+class AsyncTask
+{
+  public:
+    /**
+     * Virtual destructor.
+     */
+    virtual ~AsyncTask() {}
+
+    /**
+     * Run the operation and complete its result with the value.
+     */
+    virtual void run() = 0;
+
+    /**
+     * Get the result, completed by the worker if run() throws.
+     */
+    virtual AsyncResultBase &getResult() = 0;
+};
+
 /**
  * This class does all the actual work of the Factory
  */
@@ -104,8 +320,18 @@ class FactoryOps
      *        server:port (i.e. localhost:2221,localhost2:2222).
      * @param msecConnectTimeout the amount of milliseconds to wait for a 
      *        connection to the specified registry
+     * @param repositorySessions the number of sessions to the registry
+     * @param eventDispatchThreads the number of threads that update
+     *        the cache and notify the clients (1 dispatches every
+     *        event in order)
+     * @param periodicThreads the number of threads shared by the
+     *        Periodic objects that do not block (at least 1)
      */
-    FactoryOps(const std::string &registry, int64_t msecConnectTimeout);
+    FactoryOps(const std::string &registry, 
+               int64_t msecConnectTimeout,
+               int32_t repositorySessions = 1,
+               int32_t eventDispatchThreads = 1,
+               int32_t periodicThreads = 4);
 
     /**
      * Destructory
@@ -116,9 +342,11 @@ class FactoryOps
      * Create a cluster client object.  This object is a gateway to
      * the clusterlib objects and a context for user-level events.
      *
+     * @param handlerThreads the number of threads that run the
+     *        handlers of the client (see Factory::createClient())
      * @return a Client pointer
      */
-    Client *createClient();
+    Client *createClient(int32_t handlerThreads = 1);
 
     /**
      * Create a client for handling JSON-RPC responses.
@@ -171,9 +399,40 @@ class FactoryOps
      * For use by unit tests only: get the zkadapter so that the test can
      * synthesize ZK events and examine the results.
      * 
-     * @return Pointer to ZooKeeperAdapter
+     * @return Pointer to the repository
      */
-    zk::ZooKeeperAdapter *getRepository();
+    zk::Repository *getRepository();
+
+    /**
+     * Get the next session of the repository pool (round-robin,
+     * including the session from getRepository()).  Only use it for
+     * operations that neither set watches, create ephemeral nodes,
+     * nor rely on ordering with operations of other sessions.
+     * 
+     * @return Pointer to the repository
+     */
+    zk::Repository *getPooledRepository();
+
+    /**
+     * Get the operation counters of all the repository sessions.
+     * 
+     * @return the sum of the counters of every session
+     */
+    RepositoryStats getRepositoryStats();
+
+    /**
+     * Set the operation counters of all the repository sessions back
+     * to 0.
+     */
+    void resetRepositoryStats();
+
+    /**
+     * Set the compression threshold of all the repository sessions.
+     *
+     * @param threshold the smallest node data to compress in bytes;
+     *        -1 turns compression off
+     */
+    void setDataCompressionThreshold(int32_t threshold);
 
     /**
      * Register a notifyable for use in clusterlib.  A notifyable may
@@ -251,6 +510,28 @@ class FactoryOps
     void addClient(ClientImpl *clp);
     bool removeClient(ClientImpl *clp);
 
+    /**
+     * Record that a client has a handler for a Notifyable, so that
+     * events on the Notifyable are sent to that client.
+     *
+     * @param clp the client
+     * @param uehp the handler (its Notifyable and mask are looked up
+     *        on each event)
+     */
+    void addSubscription(ClientImpl *clp, UserEventHandler *uehp);
+
+    /**
+     * Forget a handler recorded by addSubscription().
+     *
+     * @param clp the client
+     * @param uehp the handler
+     * @param key the key of the Notifyable the handler was registered 
+     *        for
+     */
+    void removeSubscription(ClientImpl *clp, 
+                            UserEventHandler *uehp,
+                            const std::string &key);
+
     /**
      * Register a timer handler.
      * 
@@ -464,6 +745,25 @@ class FactoryOps
         const std::string &key, 
         AccessType accessType);
 
+    /**
+     * Get the cached children of a notifyable without going to the
+     * repository.
+     *
+     * @param key the key of the parent notifyable
+     * @return the cached children
+     */
+    NotifyableList getCachedChildren(const std::string &key);
+
+    /**
+     * Get the cached notifyables with keys that start with a prefix
+     * without going to the repository.
+     *
+     * @param keyPrefix the prefix of the keys
+     * @return the cached notifyables, each before the ones under it
+     */
+    NotifyableList getCachedNotifyablesFromKeyPrefix(
+        const std::string &keyPrefix);
+
     /**
      * Get the notifyable represented by these components.
      *
@@ -506,6 +806,7 @@ class FactoryOps
     const Mutex &getSyncEventLock() const;
     const Cond &getSyncEventCond() const;
     const Mutex &getEndEventLock() const;
+    const Mutex &getRepositoryPoolLock() const;
 
     /**
      * Increment the sync event id completed
@@ -655,18 +956,51 @@ class FactoryOps
      */
     HashRange &getHashRange(const std::string &name);
 
+    /**
+     * Run an operation on the asynchronous operation workers.  The
+     * workers are started with the first operation.
+     *
+     * @param task the operation (deleted once it has run)
+     * @throw InvalidMethodException if the factory is shutting down
+     */
+    void runAsync(AsyncTask *task);
+
+    /**
+     * Reserve the asynchronous operation workers for an operation
+     * that first waits on repository completions and then is queued
+     * with finishAsync().  The workers are not stopped while it is
+     * outstanding.
+     *
+     * @throw InvalidMethodException if the factory is shutting down
+     */
+    void beginAsync();
+
+    /**
+     * Queue an operation reserved with beginAsync() on the
+     * asynchronous operation workers.  Safe to call from a
+     * repository completion, since it does not wait on the
+     * repository.
+     *
+     * @param task the operation (deleted once it has run)
+     */
+    void finishAsync(AsyncTask *task);
+
     /**
      * Register a new Periodic object.  This Periodic object will be
      * run at regular intervals according to its set frequency.
      *
      * @param periodic The periodic object to start running at regular
      *        intervals.
+     * @param mayBlock true if run() may block (i.e. on a distributed
+     *        lock), then the pool gets one more worker while it is
+     *        registered
      */
-    void registerPeriodicThread(Periodic &periodic);
+    void registerPeriodicThread(Periodic &periodic, bool mayBlock = false);
 
     /**
      * Unregister a Periodic object. This will cause it to stop
-     * running.
+     * running.  Waits for a run() in progress to finish, unless
+     * called from that run().
      * 
      * @param periodic The Periodic object to stop.
      * @return True if found and stopped, false otherwise.
@@ -674,6 +1008,53 @@ class FactoryOps
     bool cancelPeriodicThread(Periodic &periodic);
 
   private:
+    friend class ZooKeeperEventRouter;
+
+    /**
+     * Create the repository for a registry.  Registries starting
+     * with CLStringInternal::INMEMORY_REGISTRY_PREFIX get an
+     * InMemoryRepository, all others a ZooKeeperAdapter.
+     *
+     * @param config the configuration with the registry
+     * @param establishConnection whether to connect right away
+     * @return the allocated repository
+     */
+    static zk::Repository *createRepository(
+        const zk::ZooKeeperConfig &config,
+        bool establishConnection);
+
+    /**
+     * Lock the parent of a notifyable as needed to load it (shared)
+     * or create it (exclusive), unless the calling thread already
+     * holds the lock.
+     *
+     * @param parentSP the parent (NULL if no parent)
+     * @param accessType the access the notifyable is loaded with
+     * @param notifyableKey the key of the notifyable (for errors)
+     * @param msecTimeout -1 for wait forever, 0 for return immediately,
+     *        otherwise the number of milliseconds to wait for the lock
+     * @param pHasMinimumLock set to true if the lock is held and must
+     *        be released after loading
+     * @return false if the lock was not acquired within msecTimeout
+     */
+    bool lockParentWaitMsecs(const boost::shared_ptr<NotifyableImpl> &parentSP,
+                             AccessType accessType,
+                             const std::string &notifyableKey,
+                             int64_t msecTimeout,
+                             bool *pHasMinimumLock);
+
+    /**
+     * Add a notifyable that was just loaded from the repository to
+     * the cache and initialize it.  If another thread cached the
+     * same notifyable first, that one is used instead.
+     *
+     * @param safeNotifyableMap the map of this type of notifyable
+     * @param pNotifyableSP the loaded notifyable, set to the cached one
+     */
+    void cacheLoadedNotifyable(
+        SafeNotifyableMap *safeNotifyableMap,
+        boost::shared_ptr<NotifyableImpl> *pNotifyableSP);
+
     /**
      * Unregister all registered notifyables.
      */
@@ -690,22 +1071,83 @@ class FactoryOps
     void discardAllClients();
 
     /**
-     * Clean up all Periodic threads.
+     * Get the clients that have a handler for an event on a
+     * Notifyable.  The clients lock must be held.
+     *
+     * @param key the key of the Notifyable
+     * @param e the event
+     * @param clients set to the clients, each once
+     */
+    void getSubscribedClients(const std::string &key, 
+                              Event e, 
+                              ClientImplList &clients);
+
+    /**
+     * Forget every handler of a client.
+     *
+     * @param clp the client
+     */
+    void removeAllSubscriptions(ClientImpl *clp);
+
+    /**
+     * Cancel all Periodic objects and stop the workers.
      */
     void discardAllPeriodicThreads();
 
+    /**
+     * Stop the asynchronous operation workers after they run the
+     * operations already queued or waiting on repository completions
+     * and wait for them.
+     */
+    void stopAsyncWorkers();
+
     /**
      * Required to support SAFE_CALL_ZK macro for various classes
      */
     FactoryOps *getOps();
 
     /**
-     * Dispatch all events. Reads from the
-     * event sources and sends events to
-     * the registered client for each event.
+     * Dispatch the timer and session events.  The other ZK events go
+     * from the repository event thread straight to the event dispatch
+     * workers (see ZooKeeperEventRouter), one handoff from the
+     * repository event thread to the thread that updates the cache.
      */
     void dispatchExternalEvents(void *param);
 
+    /**
+     * Hand a ZK event to the worker of its notifyable.  A sync event
+     * goes to every worker and is dispatched once they all reach it.
+     * Called on the repository event thread, so it must not block.
+     * Once the workers are stopped, the event is dropped.
+     *
+     * @param ge the ZKEVENT
+     */
+    void routeZKEvent(const GenericEvent &ge);
+
+    /**
+     * Get the worker that dispatches the events of a path.  All the
+     * paths of a notifyable (including its locks) map to the same
+     * worker.
+     *
+     * @param path the path of the event
+     * @return the index of the worker
+     */
+    size_t getEventDispatchWorker(const std::string &path);
+
+    /**
+     * Dispatch the ZK events routed to one worker, in order, until it
+     * is stopped.
+     *
+     * @param param the index of the worker
+     */
+    void dispatchWorkerEvents(void *param);
+
+    /**
+     * Stop the event dispatch workers after they dispatch the events
+     * already queued and wait for them.
+     */
+    void stopEventDispatchWorkers();
+
     /**
      * This method consumes timer events. It runs in a separate
      * thread.
@@ -713,12 +1155,61 @@ class FactoryOps
     void consumeTimerEvents(void *param);
 
     /**
-     * This method is is run by the threads for each registered
-     * Periodic object.  It will run as frequently as the Periodic
-     * object dictacts.
+     * This method is run by each of the Periodic workers.  It does
+     * run() of the registered Periodic objects when they are due,
+     * until the workers are stopped or the pool has more workers
+     * than it needs.
+     *
+     * @param param the CXXThread of the worker
      */
     void runPeriodic(void *param);
 
+    /**
+     * Get the number of Periodic workers the pool needs now: the
+     * shared ones plus one per registered Periodic that may block.
+     * m_periodicMapLock must be held.
+     *
+     * @return the number of workers
+     */
+    size_t getPeriodicWorkerTarget() const;
+
+    /**
+     * Start Periodic workers until the pool has as many as it needs
+     * and wait for the ones that retired.  m_periodicMapLock must be
+     * held.
+     */
+    void adjustPeriodicWorkers();
+
+    /**
+     * This method is run by each of the asynchronous operation
+     * workers.  It runs the queued operations until it takes a NULL
+     * one.
+     */
+    void runAsyncTasks(void *param);
+
+    /**
+     * Start the asynchronous operation workers if they are not
+     * running yet.  Must hold m_asyncThreadsLock.
+     */
+    void startAsyncWorkers();
+
+    /**
+     * Get the time a Periodic is due next after a run().  The
+     * frequency is spread by up to
+     * CLNumericInternal::PERIODIC_JITTER_PERCENT either way so that
+     * Periodic objects registered together do not keep running at
+     * the same time.  m_periodicMapLock must be held.
+     *
+     * @param frequencyMsecs the frequency of the Periodic
+     * @param failures the number of run() calls in a row that threw,
+     *        the wait doubles with each of them up to
+     *        CLNumericInternal::PERIODIC_MAX_FAILURE_BACKOFF times
+     *        the frequency
+     * @return the time in msecs since the epoch
+     */
+    int64_t getNextPeriodicRunMsecs(int64_t frequencyMsecs, 
+                                    int32_t failures = 0);
+
   private:
     /*
      * The registry of attached clients (and servers).
@@ -726,6 +1217,18 @@ class FactoryOps
     ClientImplList m_clients;
     Mutex m_clLock;
 
+    /**
+     * The handlers of the clients, by Notifyable key.  A ZK event is
+     * only sent to the clients that have a handler for it.
+     */
+    std::multimap<std::string, std::pair<ClientImpl *, UserEventHandler *> >
+        m_subscriptions;
+
+    /**
+     * Protects m_subscriptions.  May be taken with m_clLock held.
+     */
+    Mutex m_subscriptionsLock;
+
     /**
      * The cache of all clusterlib Notifyable objects
      */
@@ -736,6 +1239,13 @@ class FactoryOps
      */
     Mutex m_cachedNotifyableMapLock;
 
+    /**
+     * Every cached notifyable by the components of its key.  Filled
+     * in after the notifyable is initialized and emptied when it is
+     * removed from the cache.
+     */
+    NotifyableKeyTrie m_cachedNotifyableTrie;
+
     /**
      * All the registered notifyables
      */
@@ -794,10 +1304,26 @@ class FactoryOps
     zk::ZooKeeperConfig m_config;
 
     /**
-     * The ZooKeeper adapter object being used.  Needs to be mutable
-     * so that lock operations can be denoted as 'const'.
+     * The repository being used, either a ZooKeeperAdapter or an
+     * InMemoryRepository depending on the registry.
      */
-    zk::ZooKeeperAdapter m_zk;
+    boost::scoped_ptr<zk::Repository> m_zkSP;
+
+    /**
+     * Additional sessions for getPooledRepository().  The primary
+     * session (m_zkSP) is not in this list.
+     */
+    std::vector<zk::Repository *> m_repositoryPool;
+
+    /**
+     * The index of the last session returned by getPooledRepository().
+     */
+    size_t m_repositoryPoolIndex;
+
+    /**
+     * Makes m_repositoryPoolIndex thread-safe.
+     */
+    Mutex m_repositoryPoolLock;
 
     /**
      * The timer event source.
@@ -822,7 +1348,7 @@ class FactoryOps
     /**
      * The Zookeeper source adapter.
      */
-    ZooKeeperEventAdapter m_zkEventAdapter;
+    ZooKeeperEventRouter m_zkEventAdapter;
 
     /**
      * Synchronous event adapter for m_externalEventThread.
@@ -836,16 +1362,113 @@ class FactoryOps
     CXXThread<FactoryOps> m_externalEventThread;
 
     /**
-     * Threads that will be running any user-defined Periodic
-     * functions and the PredMutexCond that will coordinate them.
+     * The queues of the event dispatch workers (at least one).
+     */
+    std::vector<MPSCQueue<ExternalEventRequest> *> m_eventDispatchQueues;
+
+    /**
+     * Protects m_eventDispatchStopped and the puts into
+     * m_eventDispatchQueues.
+     */
+    Mutex m_eventDispatchLock;
+
+    /**
+     * Were the event dispatch workers stopped?  Then the ZK events
+     * are dropped.
+     */
+    bool m_eventDispatchStopped;
+
+    /**
+     * The event dispatch workers, one per queue.
+     */
+    std::vector<CXXThread<FactoryOps> *> m_eventDispatchThreads;
+
+    /**
+     * The registered Periodic objects.
+     */
+    std::map<Periodic *, PeriodicRegistration *> m_periodicMap;
+
+    /**
+     * The Periodic objects that are not running, ordered by when
+     * they are due next.
+     */
+    std::set<std::pair<int64_t, Periodic *> > m_periodicSchedule;
+
+    /**
+     * The workers that run the Periodic objects when they are due.
+     * Started with the first registration.
+     */
+    std::vector<CXXThread<FactoryOps> *> m_periodicThreads;
+
+    /**
+     * The workers that retired and have yet to be joined.
      */
-    std::map<Periodic *, CXXThread<FactoryOps> *> m_periodicMap;
+    std::vector<CXXThread<FactoryOps> *> m_periodicRetiredThreads;
 
     /**
-     * Protects m_periodicMap.
+     * The number of workers shared by the Periodic objects that do
+     * not block.
+     */
+    int32_t m_periodicSharedThreads;
+
+    /**
+     * The number of registered Periodic objects that may block.
+     */
+    int32_t m_periodicBlockingCount;
+
+    /**
+     * Protects m_periodicMap, m_periodicSchedule, m_periodicThreads,
+     * m_periodicRetiredThreads, m_periodicBlockingCount,
+     * m_periodicSeed and m_periodicShutdown.
      */
     Mutex m_periodicMapLock;
 
+    /**
+     * Signaled when a Periodic is scheduled, a run() ends or the
+     * workers are stopped.
+     */
+    Cond m_periodicCond;
+
+    /**
+     * The seed of the jitter added to the Periodic schedule.
+     */
+    uint32_t m_periodicSeed;
+
+    /**
+     * Are the Periodic workers stopping?
+     */
+    bool m_periodicShutdown;
+
+    /**
+     * The operations queued by runAsync().
+     */
+    BlockingQueue<AsyncTask *> m_asyncTasks;
+
+    /**
+     * The workers that run the operations queued by runAsync().
+     */
+    std::vector<CXXThread<FactoryOps> *> m_asyncThreads;
+
+    /**
+     * Protects m_asyncThreads, m_asyncShutdown and m_asyncPending.
+     */
+    Mutex m_asyncThreadsLock;
+
+    /**
+     * Are the asynchronous operation workers stopping?
+     */
+    bool m_asyncShutdown;
+
+    /**
+     * Number of operations between beginAsync() and finishAsync().
+     */
+    int32_t m_asyncPending;
+
+    /**
+     * Signaled when m_asyncPending drops to 0.
+     */
+    Cond m_asyncPendingCond;
+
     /**
      * Is the event loop terminating?
      */
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ * 
+ * $Id$
+ */
+
+#include "clusterlibinternal.h"
+#ifdef HAVE_LINUX_FUTEX_H
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+using namespace std;
+
+namespace clusterlib {
+
+#ifdef HAVE_LINUX_FUTEX_H
+
+void
+Futex::wait(volatile int32_t *word, int32_t expected, int64_t usecTimeout)
+{
+    struct timespec timeout;
+    struct timespec *timeoutP = NULL;
+    if (usecTimeout >= 0) {
+        timeout.tv_sec = usecTimeout / 1000000LL;
+        timeout.tv_nsec = (usecTimeout % 1000000LL) * 1000;
+        timeoutP = &timeout;
+    }
+
+    /* EAGAIN, EINTR and ETIMEDOUT all leave it to the caller. */
+    syscall(SYS_futex, 
+            const_cast<int32_t *>(word), 
+            FUTEX_WAIT_PRIVATE, 
+            expected, 
+            timeoutP, 
+            NULL, 
+            0);
+}
+
+void
+Futex::wakeOne(volatile int32_t *word)
+{
+    syscall(SYS_futex, 
+            const_cast<int32_t *>(word), 
+            FUTEX_WAKE_PRIVATE, 
+            1, 
+            NULL, 
+            NULL, 
+            0);
+}
+
+#else
+
+/**
+ * Number of condition variables the words are spread over.
+ */
+static const size_t futexBucketCount = 64;
+
+/**
+ * The threads waiting on the words that map to it.
+ */
+struct FutexBucket
+{
+    Mutex m_mutex;
+    Cond m_cond;
+};
+
+static FutexBucket futexBuckets[futexBucketCount];
+
+/**
+ * Get the bucket of a word.
+ *
+ * @param word the word
+ * @return the bucket
+ */
+static FutexBucket &
+getFutexBucket(volatile int32_t *word)
+{
+    return futexBuckets[(reinterpret_cast<uintptr_t>(word) / 
+                         sizeof(int32_t)) % futexBucketCount];
+}
+
+void
+Futex::wait(volatile int32_t *word, int32_t expected, int64_t usecTimeout)
+{
+    /*
+     * The word is checked under the bucket lock, which wakeOne()
+     * takes after the word changes, so the wake up cannot be missed.
+     */
+    FutexBucket &bucket = getFutexBucket(word);
+    Locker l(&bucket.m_mutex);
+    if (*word != expected) {
+        return;
+    }
+    bucket.m_cond.waitUsecs(bucket.m_mutex, usecTimeout);
+}
+
+void
+Futex::wakeOne(volatile int32_t *word)
+{
+    /* Other words may share the bucket, so wake every waiter. */
+    FutexBucket &bucket = getFutexBucket(word);
+    Locker l(&bucket.m_mutex);
+    bucket.m_cond.signal_all();
+}
+
+#endif
+
+}	/* End of 'namespace clusterlib' */
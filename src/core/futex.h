@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ * 
+ * $Id$
+ */
+
+#ifndef _CL_FUTEX_H_
+#define _CL_FUTEX_H_
+
+namespace clusterlib {
+
+/**
+ * Waits on and wakes up threads through a 32-bit word.  Uses the
+ * Linux futex system call if available (HAVE_LINUX_FUTEX_H) and
+ * otherwise condition variables picked by the address of the word
+ * (i.e. on Darwin).  Only useful to code that keeps its own state in
+ * the word (i.e. MPSCQueue).
+ */
+class Futex
+{
+  public:
+    /**
+     * Wait until woken up if the word still holds the expected value.
+     * May return early (i.e. on a signal), so the caller must check
+     * its state again.
+     *
+     * @param word the word to wait on
+     * @param expected the value the word must hold to go to sleep
+     * @param usecTimeout the amount of usecs to wait until giving up, 
+     *        -1 means wait forever
+     */
+    static void wait(volatile int32_t *word, 
+                     int32_t expected, 
+                     int64_t usecTimeout);
+
+    /**
+     * Wake up one thread waiting on the word.  The caller must
+     * change the word before, so that a thread about to wait does
+     * not go to sleep.
+     *
+     * @param word the word to wake up on
+     */
+    static void wakeOne(volatile int32_t *word);
+
+  private:
+    /**
+     * No constructing.
+     */
+    Futex();
+};
+
+}	/* End of 'namespace clusterlib' */
+
+#endif	/* !_CL_FUTEX_H_ */
@@ -156,38 +156,14 @@ GroupImpl::getDataDistribution(const string &name,
     return dataDistributionSP;
 }
 
-NotifyableList
-GroupImpl::getChildrenNotifyables()
+vector<string>
+GroupImpl::getChildrenRegisteredNames()
 {
-    TRACE(CL_LOG, "getChildrenNotifyables");
-    
-    throwIfRemoved();
-    
-    /*
-     * Add the notifyables from this object and then the subclass
-     * specific objects.
-     */
-    NotifyableList tmpList, finalList;
-    tmpList = getOps()->getNotifyableList(
-        shared_from_this(),
-        CLString::REGISTERED_NODE_NAME,
-        getNodeNames(),
-        LOAD_FROM_REPOSITORY);
-    finalList.insert(finalList.end(), tmpList.begin(), tmpList.end());
-    tmpList = getOps()->getNotifyableList(
-        shared_from_this(),
-        CLString::REGISTERED_GROUP_NAME,
-        getGroupNames(),
-        LOAD_FROM_REPOSITORY);
-    finalList.insert(finalList.end(), tmpList.begin(), tmpList.end());
-    tmpList = getOps()->getNotifyableList(
-        shared_from_this(),
-        CLString::REGISTERED_DATADISTRIBUTION_NAME,
-        getDataDistributionNames(),
-        LOAD_FROM_REPOSITORY);
-    finalList.insert(finalList.end(), tmpList.begin(), tmpList.end());
-
-    return finalList;
+    vector<string> registeredNameVec;
+    registeredNameVec.push_back(CLString::REGISTERED_NODE_NAME);
+    registeredNameVec.push_back(CLString::REGISTERED_GROUP_NAME);
+    registeredNameVec.push_back(CLString::REGISTERED_DATADISTRIBUTION_NAME);
+    return registeredNameVec;
 }
 
 void
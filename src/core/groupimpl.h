@@ -80,7 +80,7 @@ class GroupImpl
      */
     virtual ~GroupImpl() {};
 
-    virtual NotifyableList getChildrenNotifyables();
+    virtual std::vector<std::string> getChildrenRegisteredNames();
 
     virtual void initializeCachedRepresentation();
 
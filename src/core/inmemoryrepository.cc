@@ -0,0 +1,1674 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ *
+ * $Id$
+ */
+
+#include "clusterlibinternal.h"
+
+DEFINE_LOGGER(LOG, "zookeeper.inmemory")
+
+using namespace std;
+using namespace boost;
+
+namespace zk {
+
+/**
+ * Sleeps for the given amount of usecs.
+ */
+static void
+sleepUsecs(int64_t usecs)
+{
+    struct timespec ts;
+    ts.tv_sec = usecs / 1000000;
+    ts.tv_nsec = (usecs % 1000000) * 1000;
+    while ((nanosleep(&ts, &ts) == -1) && (errno == EINTR)) {
+    }
+}
+
+/**
+ * Get the parent of a node.
+ */
+static string
+getParentPath(const string &path)
+{
+    string::size_type pos = path.rfind('/');
+    return (pos == 0) ? string("/") : path.substr(0, pos);
+}
+
+/**
+ * Get the absolute path of a child.
+ */
+static string
+getChildPath(const string &path, const string &childName)
+{
+    return (path == "/") ? (path + childName) : (path + "/" + childName);
+}
+
+/**
+ * \brief A node of an InMemoryTree.
+ */
+class InMemoryNode
+{
+  public:
+    InMemoryNode()
+    {
+        memset(&m_stat, 0, sizeof(m_stat));
+    }
+
+    /**
+     * The data of the node.
+     */
+    string m_data;
+
+    /**
+     * The node statistics.
+     */
+    Stat m_stat;
+
+    /**
+     * The names of the children, sorted.
+     */
+    set<string> m_childSet;
+};
+
+/**
+ * \brief The nodes and watches shared by the InMemoryRepository
+ * objects of the same name.
+ *
+ * All the methods are atomic.  Watches are fired after a change has
+ * been fully applied by queueing the events in the sessions that set
+ * them.
+ */
+class InMemoryTree
+{
+  public:
+    /**
+     * Get the tree of the given name, creating it if no
+     * InMemoryRepository is using it.
+     *
+     * @param name the name of the tree
+     * @return the tree
+     */
+    static shared_ptr<InMemoryTree> getTree(const string &name);
+
+    /**
+     * \brief Constructor.  The tree only has the root node.
+     */
+    InMemoryTree();
+
+    /**
+     * Opens a new session.
+     *
+     * @return the session id
+     */
+    int64_t openSession();
+
+    /**
+     * Closes a session, deleting its ephemeral nodes and dropping its
+     * watches.
+     *
+     * @param session the repository of the session
+     * @param sessionId the session id
+     */
+    void closeSession(InMemoryRepository *session, int64_t sessionId);
+
+    /**
+     * Checks whether a node exists.  The watch is set either way.
+     */
+    int32_t exists(InMemoryRepository *session,
+                   const string &path,
+                   Stat *stat,
+                   clusterlib::CallbackAndContext *watch);
+
+    /**
+     * Gets the sorted absolute paths of the children of a node and
+     * optionally its stat.  The watch is only set if the node exists.
+     */
+    int32_t getChildren(InMemoryRepository *session,
+                        const string &path,
+                        vector<string> *children,
+                        Stat *stat,
+                        clusterlib::CallbackAndContext *watch);
+
+    /**
+     * Gets the data of a node.  The watch is only set if the node
+     * exists.
+     */
+    int32_t getData(InMemoryRepository *session,
+                    const string &path,
+                    string *data,
+                    Stat *stat,
+                    clusterlib::CallbackAndContext *watch);
+
+    /**
+     * Creates a node.
+     */
+    int32_t create(int64_t sessionId,
+                   const string &path,
+                   const string &value,
+                   int32_t flags,
+                   string *createdPath);
+
+    /**
+     * Deletes a node without children.
+     */
+    int32_t remove(const string &path, int32_t version);
+
+    /**
+     * Deletes a node and all its descendants.
+     *
+     * @param path the root of the subtree
+     * @param pCount set to the number of deleted nodes
+     */
+    int32_t removeTree(const string &path, size_t *pCount);
+
+    /**
+     * Sets the data of a node.
+     */
+    int32_t setData(const string &path,
+                    const string &value,
+                    int32_t version,
+                    Stat *stat);
+
+    /**
+     * Executes operations atomically.
+     */
+    int32_t multi(int64_t sessionId,
+                  const vector<MultiOperation> &operations,
+                  vector<int32_t> *pResults);
+
+  private:
+    /**
+     * A watch: the session that set it and its context.
+     */
+    typedef multimap<string,
+                     pair<InMemoryRepository *,
+                          clusterlib::CallbackAndContext *> > WatchMap;
+
+    /**
+     * The state of a node prior to a change: whether it existed and
+     * its contents.
+     */
+    typedef map<string, pair<bool, InMemoryNode> > UndoMap;
+
+    /**
+     * A change that fires watches: the event type and the path.
+     */
+    typedef vector<pair<int32_t, string> > TriggerVector;
+
+    /**
+     * Get the lock that makes this object thread-safe.
+     */
+    const clusterlib::Mutex &getLock() const
+    {
+        return m_lock;
+    }
+
+    /**
+     * Saves the state of a node before it is changed by a multi.
+     */
+    void saveUndo(UndoMap *pUndo, const string &path);
+
+    /**
+     * Restores the nodes saved by saveUndo().
+     */
+    void applyUndo(const UndoMap &undo);
+
+    int32_t doCreate(int64_t sessionId,
+                     const string &path,
+                     const string &value,
+                     int32_t flags,
+                     string *createdPath,
+                     TriggerVector *pTriggers,
+                     UndoMap *pUndo);
+
+    int32_t doRemove(const string &path,
+                     int32_t version,
+                     TriggerVector *pTriggers,
+                     UndoMap *pUndo);
+
+    int32_t doSetData(const string &path,
+                      const string &value,
+                      int32_t version,
+                      Stat *stat,
+                      TriggerVector *pTriggers,
+                      UndoMap *pUndo);
+
+    int32_t doMulti(int64_t sessionId,
+                    const vector<MultiOperation> &operations,
+                    vector<int32_t> *pResults,
+                    TriggerVector *pTriggers);
+
+    /**
+     * Adds a watch or releases it if it is not to be set.
+     */
+    void addWatch(WatchMap *pWatchMap,
+                  InMemoryRepository *session,
+                  const string &path,
+                  clusterlib::CallbackAndContext *watch,
+                  bool setWatch);
+
+    /**
+     * Fires and removes all the watches of a path.
+     */
+    void fireWatches(WatchMap *pWatchMap, const string &path, int32_t type);
+
+    /**
+     * Fires the watches of all the changes.
+     */
+    void fireTriggers(const TriggerVector &triggers);
+
+  private:
+    /**
+     * All the nodes by path.
+     */
+    map<string, InMemoryNode> m_nodeMap;
+
+    /**
+     * Watches set by exists() and getData().
+     */
+    WatchMap m_dataWatchMap;
+
+    /**
+     * Watches set by getChildren().
+     */
+    WatchMap m_childWatchMap;
+
+    /**
+     * Last transaction id.
+     */
+    int64_t m_zxid;
+
+    /**
+     * Last session id.
+     */
+    int64_t m_sessionId;
+
+    /**
+     * Makes this object thread-safe.
+     */
+    clusterlib::Mutex m_lock;
+
+    /**
+     * The trees in use by name.
+     */
+    static map<string, weak_ptr<InMemoryTree> > s_treeMap;
+
+    /**
+     * Makes {@link #s_treeMap} thread-safe.
+     */
+    static clusterlib::Mutex s_treeMapLock;
+};
+
+map<string, weak_ptr<InMemoryTree> > InMemoryTree::s_treeMap;
+clusterlib::Mutex InMemoryTree::s_treeMapLock;
+
+shared_ptr<InMemoryTree>
+InMemoryTree::getTree(const string &name)
+{
+    TRACE(LOG, "getTree");
+
+    clusterlib::Locker l(s_treeMapLock);
+    shared_ptr<InMemoryTree> treeSP = s_treeMap[name].lock();
+    if (treeSP.get() == NULL) {
+        treeSP.reset(new InMemoryTree());
+        s_treeMap[name] = treeSP;
+    }
+    return treeSP;
+}
+
+InMemoryTree::InMemoryTree()
+    : m_zxid(0),
+      m_sessionId(0)
+{
+    m_nodeMap["/"] = InMemoryNode();
+}
+
+int64_t
+InMemoryTree::openSession()
+{
+    clusterlib::Locker l(getLock());
+    return ++m_sessionId;
+}
+
+void
+InMemoryTree::closeSession(InMemoryRepository *session, int64_t sessionId)
+{
+    TRACE(LOG, "closeSession");
+
+    clusterlib::Locker l(getLock());
+
+    /* Ephemeral nodes cannot have children, so any order works. */
+    vector<string> ephemeralVec;
+    map<string, InMemoryNode>::const_iterator nodeMapIt;
+    for (nodeMapIt = m_nodeMap.begin();
+         nodeMapIt != m_nodeMap.end();
+         ++nodeMapIt) {
+        if (nodeMapIt->second.m_stat.ephemeralOwner == sessionId) {
+            ephemeralVec.push_back(nodeMapIt->first);
+        }
+    }
+    TriggerVector triggers;
+    for (size_t i = 0; i < ephemeralVec.size(); ++i) {
+        doRemove(ephemeralVec[i], -1, &triggers, NULL);
+    }
+
+    /* Drop the watches of the session before firing the others. */
+    WatchMap *watchMapArr[] = { &m_dataWatchMap, &m_childWatchMap };
+    for (size_t i = 0; i < 2; ++i) {
+        WatchMap::iterator watchMapIt = watchMapArr[i]->begin();
+        while (watchMapIt != watchMapArr[i]->end()) {
+            if (watchMapIt->second.first == session) {
+                session->releaseWatch(watchMapIt->second.second);
+                watchMapArr[i]->erase(watchMapIt++);
+            }
+            else {
+                ++watchMapIt;
+            }
+        }
+    }
+    fireTriggers(triggers);
+}
+
+int32_t
+InMemoryTree::exists(InMemoryRepository *session,
+                     const string &path,
+                     Stat *stat,
+                     clusterlib::CallbackAndContext *watch)
+{
+    clusterlib::Locker l(getLock());
+
+    addWatch(&m_dataWatchMap, session, path, watch, true);
+    map<string, InMemoryNode>::const_iterator nodeMapIt =
+        m_nodeMap.find(path);
+    if (nodeMapIt == m_nodeMap.end()) {
+        return ZNONODE;
+    }
+    if (stat != NULL) {
+        *stat = nodeMapIt->second.m_stat;
+    }
+    return ZOK;
+}
+
+int32_t
+InMemoryTree::getChildren(InMemoryRepository *session,
+                          const string &path,
+                          vector<string> *children,
+                          Stat *stat,
+                          clusterlib::CallbackAndContext *watch)
+{
+    clusterlib::Locker l(getLock());
+
+    map<string, InMemoryNode>::const_iterator nodeMapIt =
+        m_nodeMap.find(path);
+    addWatch(&m_childWatchMap,
+             session,
+             path,
+             watch,
+             nodeMapIt != m_nodeMap.end());
+    if (nodeMapIt == m_nodeMap.end()) {
+        return ZNONODE;
+    }
+    children->clear();
+    children->reserve(nodeMapIt->second.m_childSet.size());
+    set<string>::const_iterator childSetIt;
+    for (childSetIt = nodeMapIt->second.m_childSet.begin();
+         childSetIt != nodeMapIt->second.m_childSet.end();
+         ++childSetIt) {
+        children->push_back(getChildPath(path, *childSetIt));
+    }
+    if (stat != NULL) {
+        *stat = nodeMapIt->second.m_stat;
+    }
+    return ZOK;
+}
+
+int32_t
+InMemoryTree::getData(InMemoryRepository *session,
+                      const string &path,
+                      string *data,
+                      Stat *stat,
+                      clusterlib::CallbackAndContext *watch)
+{
+    clusterlib::Locker l(getLock());
+
+    map<string, InMemoryNode>::const_iterator nodeMapIt =
+        m_nodeMap.find(path);
+    addWatch(&m_dataWatchMap,
+             session,
+             path,
+             watch,
+             nodeMapIt != m_nodeMap.end());
+    if (nodeMapIt == m_nodeMap.end()) {
+        return ZNONODE;
+    }
+    *data = nodeMapIt->second.m_data;
+    if (stat != NULL) {
+        *stat = nodeMapIt->second.m_stat;
+    }
+    return ZOK;
+}
+
+int32_t
+InMemoryTree::create(int64_t sessionId,
+                     const string &path,
+                     const string &value,
+                     int32_t flags,
+                     string *createdPath)
+{
+    clusterlib::Locker l(getLock());
+
+    TriggerVector triggers;
+    int32_t rc = doCreate(
+        sessionId, path, value, flags, createdPath, &triggers, NULL);
+    fireTriggers(triggers);
+    return rc;
+}
+
+int32_t
+InMemoryTree::remove(const string &path, int32_t version)
+{
+    clusterlib::Locker l(getLock());
+
+    TriggerVector triggers;
+    int32_t rc = doRemove(path, version, &triggers, NULL);
+    fireTriggers(triggers);
+    return rc;
+}
+
+int32_t
+InMemoryTree::removeTree(const string &path, size_t *pCount)
+{
+    TRACE(LOG, "removeTree");
+
+    clusterlib::Locker l(getLock());
+
+    if (m_nodeMap.find(path) == m_nodeMap.end()) {
+        return ZNONODE;
+    }
+
+    /*
+     * Collect the subtree breadth first and delete it in reverse
+     * order.
+     */
+    vector<string> treeVec;
+    treeVec.push_back(path);
+    for (size_t i = 0; i < treeVec.size(); ++i) {
+        const set<string> &childSet = m_nodeMap[treeVec[i]].m_childSet;
+        set<string>::const_iterator childSetIt;
+        for (childSetIt = childSet.begin();
+             childSetIt != childSet.end();
+             ++childSetIt) {
+            treeVec.push_back(getChildPath(treeVec[i], *childSetIt));
+        }
+    }
+    vector<MultiOperation> operationVec;
+    vector<string>::const_reverse_iterator treeVecIt;
+    for (treeVecIt = treeVec.rbegin();
+         treeVecIt != treeVec.rend();
+         ++treeVecIt) {
+        operationVec.push_back(MultiOperation::deleteNode(*treeVecIt));
+    }
+
+    TriggerVector triggers;
+    int32_t rc = doMulti(0, operationVec, NULL, &triggers);
+    fireTriggers(triggers);
+    *pCount = treeVec.size();
+    return rc;
+}
+
+int32_t
+InMemoryTree::setData(const string &path,
+                      const string &value,
+                      int32_t version,
+                      Stat *stat)
+{
+    clusterlib::Locker l(getLock());
+
+    TriggerVector triggers;
+    int32_t rc = doSetData(path, value, version, stat, &triggers, NULL);
+    fireTriggers(triggers);
+    return rc;
+}
+
+int32_t
+InMemoryTree::multi(int64_t sessionId,
+                    const vector<MultiOperation> &operations,
+                    vector<int32_t> *pResults)
+{
+    clusterlib::Locker l(getLock());
+
+    TriggerVector triggers;
+    int32_t rc = doMulti(sessionId, operations, pResults, &triggers);
+    fireTriggers(triggers);
+    return rc;
+}
+
+void
+InMemoryTree::saveUndo(UndoMap *pUndo, const string &path)
+{
+    if ((pUndo == NULL) || (pUndo->find(path) != pUndo->end())) {
+        return;
+    }
+    map<string, InMemoryNode>::const_iterator nodeMapIt =
+        m_nodeMap.find(path);
+    if (nodeMapIt == m_nodeMap.end()) {
+        (*pUndo)[path] = make_pair(false, InMemoryNode());
+    }
+    else {
+        (*pUndo)[path] = make_pair(true, nodeMapIt->second);
+    }
+}
+
+void
+InMemoryTree::applyUndo(const UndoMap &undo)
+{
+    UndoMap::const_iterator undoIt;
+    for (undoIt = undo.begin(); undoIt != undo.end(); ++undoIt) {
+        if (undoIt->second.first) {
+            m_nodeMap[undoIt->first] = undoIt->second.second;
+        }
+        else {
+            m_nodeMap.erase(undoIt->first);
+        }
+    }
+}
+
+int32_t
+InMemoryTree::doCreate(int64_t sessionId,
+                       const string &path,
+                       const string &value,
+                       int32_t flags,
+                       string *createdPath,
+                       TriggerVector *pTriggers,
+                       UndoMap *pUndo)
+{
+    if (path == "/") {
+        return ZNODEEXISTS;
+    }
+    string parentPath = getParentPath(path);
+    map<string, InMemoryNode>::iterator parentIt = m_nodeMap.find(parentPath);
+    if (parentIt == m_nodeMap.end()) {
+        return ZNONODE;
+    }
+    if (parentIt->second.m_stat.ephemeralOwner != 0) {
+        return ZNOCHILDRENFOREPHEMERALS;
+    }
+
+    string actualPath = path;
+    if (flags & ZOO_SEQUENCE) {
+        char sequence[16];
+        snprintf(sequence,
+                 sizeof(sequence),
+                 "%010d",
+                 parentIt->second.m_stat.cversion);
+        actualPath.append(sequence);
+    }
+    if (m_nodeMap.find(actualPath) != m_nodeMap.end()) {
+        return ZNODEEXISTS;
+    }
+
+    saveUndo(pUndo, parentPath);
+    saveUndo(pUndo, actualPath);
+
+    int64_t msecs = clusterlib::TimerService::getCurrentTimeMsecs();
+    InMemoryNode &node = m_nodeMap[actualPath];
+    node.m_data = value;
+    node.m_stat.czxid = ++m_zxid;
+    node.m_stat.mzxid = m_zxid;
+    node.m_stat.pzxid = m_zxid;
+    node.m_stat.ctime = msecs;
+    node.m_stat.mtime = msecs;
+    node.m_stat.ephemeralOwner = (flags & ZOO_EPHEMERAL) ? sessionId : 0;
+    node.m_stat.dataLength = value.length();
+
+    /* The reference may have been invalidated by the insertion. */
+    InMemoryNode &parent = m_nodeMap[parentPath];
+    parent.m_childSet.insert(actualPath.substr(actualPath.rfind('/') + 1));
+    parent.m_stat.cversion++;
+    parent.m_stat.numChildren = parent.m_childSet.size();
+    parent.m_stat.pzxid = m_zxid;
+
+    if (createdPath != NULL) {
+        *createdPath = actualPath;
+    }
+    pTriggers->push_back(make_pair(ZOO_CREATED_EVENT, actualPath));
+    return ZOK;
+}
+
+int32_t
+InMemoryTree::doRemove(const string &path,
+                       int32_t version,
+                       TriggerVector *pTriggers,
+                       UndoMap *pUndo)
+{
+    if (path == "/") {
+        return ZBADARGUMENTS;
+    }
+    map<string, InMemoryNode>::iterator nodeMapIt = m_nodeMap.find(path);
+    if (nodeMapIt == m_nodeMap.end()) {
+        return ZNONODE;
+    }
+    if ((version != -1) && (version != nodeMapIt->second.m_stat.version)) {
+        return ZBADVERSION;
+    }
+    if (!nodeMapIt->second.m_childSet.empty()) {
+        return ZNOTEMPTY;
+    }
+
+    string parentPath = getParentPath(path);
+    saveUndo(pUndo, parentPath);
+    saveUndo(pUndo, path);
+
+    m_nodeMap.erase(nodeMapIt);
+    InMemoryNode &parent = m_nodeMap[parentPath];
+    parent.m_childSet.erase(path.substr(path.rfind('/') + 1));
+    parent.m_stat.cversion++;
+    parent.m_stat.numChildren = parent.m_childSet.size();
+    parent.m_stat.pzxid = ++m_zxid;
+
+    pTriggers->push_back(make_pair(ZOO_DELETED_EVENT, path));
+    return ZOK;
+}
+
+int32_t
+InMemoryTree::doSetData(const string &path,
+                        const string &value,
+                        int32_t version,
+                        Stat *stat,
+                        TriggerVector *pTriggers,
+                        UndoMap *pUndo)
+{
+    map<string, InMemoryNode>::iterator nodeMapIt = m_nodeMap.find(path);
+    if (nodeMapIt == m_nodeMap.end()) {
+        return ZNONODE;
+    }
+    if ((version != -1) && (version != nodeMapIt->second.m_stat.version)) {
+        return ZBADVERSION;
+    }
+
+    saveUndo(pUndo, path);
+
+    InMemoryNode &node = nodeMapIt->second;
+    node.m_data = value;
+    node.m_stat.version++;
+    node.m_stat.mzxid = ++m_zxid;
+    node.m_stat.mtime = clusterlib::TimerService::getCurrentTimeMsecs();
+    node.m_stat.dataLength = value.length();
+    if (stat != NULL) {
+        *stat = node.m_stat;
+    }
+
+    pTriggers->push_back(make_pair(ZOO_CHANGED_EVENT, path));
+    return ZOK;
+}
+
+int32_t
+InMemoryTree::doMulti(int64_t sessionId,
+                      const vector<MultiOperation> &operations,
+                      vector<int32_t> *pResults,
+                      TriggerVector *pTriggers)
+{
+    UndoMap undo;
+    TriggerVector triggers;
+    int32_t rc = ZOK;
+    size_t i = 0;
+    for (; (i < operations.size()) && (rc == ZOK); ++i) {
+        const MultiOperation &operation = operations[i];
+        switch (operation.getType()) {
+            case MultiOperation::CREATE_NODE:
+                rc = doCreate(sessionId,
+                              operation.getPath(),
+                              operation.getValue(),
+                              operation.getFlags(),
+                              NULL,
+                              &triggers,
+                              &undo);
+                break;
+            case MultiOperation::DELETE_NODE:
+                rc = doRemove(operation.getPath(),
+                              operation.getVersion(),
+                              &triggers,
+                              &undo);
+                break;
+            case MultiOperation::SET_NODE_DATA:
+                rc = doSetData(operation.getPath(),
+                               operation.getValue(),
+                               operation.getVersion(),
+                               NULL,
+                               &triggers,
+                               &undo);
+                break;
+            case MultiOperation::CHECK_VERSION:
+                {
+                    map<string, InMemoryNode>::const_iterator nodeMapIt =
+                        m_nodeMap.find(operation.getPath());
+                    if (nodeMapIt == m_nodeMap.end()) {
+                        rc = ZNONODE;
+                    }
+                    else if ((operation.getVersion() != -1) &&
+                             (operation.getVersion() !=
+                              nodeMapIt->second.m_stat.version)) {
+                        rc = ZBADVERSION;
+                    }
+                }
+                break;
+            default:
+                rc = ZBADARGUMENTS;
+        }
+        if (pResults != NULL) {
+            pResults->push_back(rc);
+        }
+    }
+
+    if (rc != ZOK) {
+        /* Like ZK, the operations that were not run are inconsistent. */
+        applyUndo(undo);
+        if (pResults != NULL) {
+            for (; i < operations.size(); ++i) {
+                pResults->push_back(ZRUNTIMEINCONSISTENCY);
+            }
+        }
+        return rc;
+    }
+
+    pTriggers->insert(pTriggers->end(), triggers.begin(), triggers.end());
+    return ZOK;
+}
+
+void
+InMemoryTree::addWatch(WatchMap *pWatchMap,
+                       InMemoryRepository *session,
+                       const string &path,
+                       clusterlib::CallbackAndContext *watch,
+                       bool setWatch)
+{
+    if (watch == NULL) {
+        return;
+    }
+    if (setWatch) {
+        pWatchMap->insert(make_pair(path, make_pair(session, watch)));
+    }
+    else {
+        session->releaseWatch(watch);
+    }
+}
+
+void
+InMemoryTree::fireWatches(WatchMap *pWatchMap,
+                          const string &path,
+                          int32_t type)
+{
+    pair<WatchMap::iterator, WatchMap::iterator> range =
+        pWatchMap->equal_range(path);
+    for (WatchMap::iterator watchMapIt = range.first;
+         watchMapIt != range.second;
+         ++watchMapIt) {
+        watchMapIt->second.first->enqueueEvent(
+            ZKWatcherEvent(type,
+                           ZOO_CONNECTED_STATE,
+                           path,
+                           watchMapIt->second.second));
+    }
+    pWatchMap->erase(range.first, range.second);
+}
+
+void
+InMemoryTree::fireTriggers(const TriggerVector &triggers)
+{
+    TriggerVector::const_iterator triggersIt;
+    for (triggersIt = triggers.begin();
+         triggersIt != triggers.end();
+         ++triggersIt) {
+        const string &path = triggersIt->second;
+        fireWatches(&m_dataWatchMap, path, triggersIt->first);
+        if (triggersIt->first == ZOO_DELETED_EVENT) {
+            fireWatches(&m_childWatchMap, path, ZOO_DELETED_EVENT);
+        }
+        if (triggersIt->first != ZOO_CHANGED_EVENT) {
+            fireWatches(&m_childWatchMap,
+                        getParentPath(path),
+                        ZOO_CHILD_EVENT);
+        }
+    }
+}
+
+bool
+InMemoryRepository::parseRegistry(const string &registry,
+                                  string *pTreeName,
+                                  int64_t *pLatencyUsecs)
+{
+    TRACE(LOG, "parseRegistry");
+
+    const string &prefix =
+        clusterlib::CLStringInternal::INMEMORY_REGISTRY_PREFIX;
+    if (registry.compare(0, prefix.length(), prefix) != 0) {
+        return false;
+    }
+
+    string treeName = registry.substr(prefix.length());
+    int64_t latencyUsecs = 0;
+    string::size_type pos = treeName.find(':');
+    if (pos != string::npos) {
+        char *ptr = NULL;
+        latencyUsecs = strtoll(treeName.c_str() + pos + 1, &ptr, 10);
+        if ((ptr == NULL) || (*ptr != '\0') || (latencyUsecs < 0)) {
+            throw InvalidArgumentsException(
+                string("Invalid latency in registry ") + registry);
+        }
+        treeName.erase(pos);
+    }
+
+    if (pTreeName != NULL) {
+        *pTreeName = treeName;
+    }
+    if (pLatencyUsecs != NULL) {
+        *pLatencyUsecs = latencyUsecs;
+    }
+    return true;
+}
+
+InMemoryRepository::InMemoryRepository(const string &treeName,
+                                       int64_t latencyUsecs,
+                                       bool establishConnection)
+    : m_treeSP(InMemoryTree::getTree(treeName)),
+      m_latencyUsecs(latencyUsecs),
+      m_sessionId(0),
+      m_state(AS_DISCONNECTED),
+      m_eventDispatchAllowed(true)
+{
+    TRACE(LOG, "InMemoryRepository");
+
+    m_requestThread.Create(*this, &InMemoryRepository::processRequests);
+
+    if (establishConnection) {
+        reconnect();
+    }
+}
+
+InMemoryRepository::~InMemoryRepository()
+{
+    TRACE(LOG, "~InMemoryRepository");
+
+    disconnect(true);
+
+    /*
+     * The end event may have been injected already, in which case
+     * this one is never processed.
+     */
+    injectEndEvent();
+    m_requestThread.Join();
+
+    getListenerAndContextManager()->deleteAllCallbackAndContext();
+}
+
+void
+InMemoryRepository::reconnect()
+{
+    TRACE(LOG, "reconnect");
+
+    clusterlib::Locker l(getStateLock());
+    if (m_sessionId != 0) {
+        m_treeSP->closeSession(this, m_sessionId);
+    }
+    m_sessionId = m_treeSP->openSession();
+    m_state = AS_CONNECTED;
+    enqueueEvent(ZKWatcherEvent(ZOO_SESSION_EVENT, ZOO_CONNECTED_STATE, ""));
+
+    LOG_INFO(LOG,
+             "reconnect: Opened session %" PRId64 " with %" PRId64
+             " usecs latency",
+             m_sessionId,
+             m_latencyUsecs);
+}
+
+void
+InMemoryRepository::disconnect(bool final)
+{
+    TRACE(LOG, "disconnect");
+
+    clusterlib::Locker l(getStateLock());
+    if (m_sessionId != 0) {
+        m_treeSP->closeSession(this, m_sessionId);
+        m_sessionId = 0;
+        if (final) {
+            m_state = AS_NORECONNECT;
+            injectEndEvent();
+        }
+        else {
+            m_state = AS_DISCONNECTED;
+        }
+    }
+}
+
+void
+InMemoryRepository::stopEventDispatch()
+{
+    m_eventDispatchAllowed = false;
+}
+
+bool
+InMemoryRepository::sync(const string &path,
+                         ZKEventListener *listener,
+                         void *context)
+{
+    TRACE(LOG, "sync");
+
+    validatePath(path);
+    RepositoryOperationTimer timer(getStatsRecorder(),
+                                   clusterlib::RepositoryStats::SYNC);
+    verifyConnection();
+    waitLatency();
+    timer.setRc(ZOK);
+
+    /*
+     * The sync event is queued behind the pending operations and the
+     * events of all the changes made so far.
+     */
+    m_requests.put(InMemoryRequest(
+                       ZKWatcherEvent(
+                           ZOO_SESSION_EVENT,
+                           ZOO_CONNECTED_STATE,
+                           clusterlib::CLStringInternal::SYNC,
+                           getListenerAndContextManager()->
+                           createCallbackAndContext(listener, context))));
+    return true;
+}
+
+bool
+InMemoryRepository::createNode(const string &path,
+                               const string &value,
+                               int32_t flags,
+                               bool createAncestors)
+{
+    TRACE(LOG, "createNode");
+
+    string createdPath;
+    return createNode(path, value, flags, createAncestors, createdPath);
+}
+
+bool
+InMemoryRepository::createNode(const string &path,
+                               const string &value,
+                               int32_t flags,
+                               bool createAncestors,
+                               string &createdPath)
+{
+    TRACE(LOG, "createNode (internal)");
+
+    validatePath(path);
+    RepositoryOperationTimer timer(getStatsRecorder(),
+                                   clusterlib::RepositoryStats::CREATE);
+    int64_t sessionId = verifyConnection();
+    waitLatency();
+    string data = encodeData(value);
+    int32_t rc = m_treeSP->create(sessionId, path, data, flags, &createdPath);
+    if ((rc == ZNONODE) && createAncestors) {
+        for (string::size_type pos = path.find('/', 1);
+             pos != string::npos;
+             pos = path.find('/', pos + 1)) {
+            createNode(path.substr(0, pos), "", 0, false);
+        }
+        waitLatency();
+        rc = m_treeSP->create(sessionId, path, data, flags, &createdPath);
+    }
+    timer.setRc(rc);
+    if (rc == ZOK) {
+        getStatsRecorder().recordBytesWritten(data.length());
+        return true;
+    }
+    else if (rc == ZNODEEXISTS) {
+        LOG_WARN(LOG,
+                 "createNode: Error %d for %s",
+                 rc,
+                 path.c_str());
+        return false;
+    }
+
+    LOG_ERROR(LOG,
+              "createNode: Error %d for %s",
+              rc,
+              path.c_str());
+    ZooKeeperAdapter::throwErrorCode(string("Unable to create node ") + path,
+                                     rc,
+                                     getState() == AS_CONNECTED);
+    return false;
+}
+
+int64_t
+InMemoryRepository::createSequence(const string &path,
+                                   const string &value,
+                                   int32_t flags,
+                                   bool createAncestors,
+                                   string &createdPath)
+{
+    TRACE(LOG, "createSequence");
+
+    if (!createNode(path,
+                    value,
+                    flags | ZOO_SEQUENCE,
+                    createAncestors,
+                    createdPath)) {
+        return -1;
+    }
+    return strtoll(createdPath.c_str() + path.length(), NULL, 10);
+}
+
+bool
+InMemoryRepository::deleteNode(const string &path,
+                               bool recursive,
+                               int32_t version,
+                               DeleteProgressCallback *progress)
+{
+    TRACE(LOG, "deleteNode");
+
+    validatePath(path);
+    RepositoryOperationTimer timer(getStatsRecorder(),
+                                   clusterlib::RepositoryStats::DELETE);
+    verifyConnection();
+    waitLatency();
+    int32_t rc = m_treeSP->remove(path, version);
+    if ((rc == ZNOTEMPTY) && recursive) {
+        size_t count = 0;
+        rc = m_treeSP->removeTree(path, &count);
+        if ((rc == ZOK) && (progress != NULL)) {
+            progress->nodesDeleted(path, count, count);
+        }
+    }
+    timer.setRc(rc);
+    if (rc == ZOK) {
+        return true;
+    }
+    else if (rc == ZNONODE) {
+        LOG_WARN(LOG,
+                 "deleteNode: Error %d for %s",
+                 rc,
+                 path.c_str());
+        return false;
+    }
+
+    LOG_ERROR(LOG,
+              "deleteNode: Error %d for %s",
+              rc,
+              path.c_str());
+    ZooKeeperAdapter::throwErrorCode(string("Unable to delete node ") + path,
+                                     rc,
+                                     getState() == AS_CONNECTED);
+    return false;
+}
+
+bool
+InMemoryRepository::nodeExists(const string &path,
+                               ZKEventListener *listener,
+                               void *context,
+                               Stat *stat)
+{
+    TRACE(LOG, "nodeExists");
+
+    validatePath(path);
+    RepositoryOperationTimer timer(getStatsRecorder(),
+                                   clusterlib::RepositoryStats::EXISTS);
+    verifyConnection();
+    waitLatency();
+
+    struct Stat tmpStat;
+    if (stat == NULL) {
+        stat = &tmpStat;
+    }
+    memset(stat, 0, sizeof(Stat));
+
+    int32_t rc = m_treeSP->exists(
+        this, path, stat, createWatch(listener, context));
+    timer.setRc(rc);
+    if ((listener != NULL) && ((rc == ZOK) || (rc == ZNONODE))) {
+        getStatsRecorder().recordWatch();
+    }
+    return (rc == ZOK);
+}
+
+bool
+InMemoryRepository::getNodeChildren(const string &path,
+                                    vector<string> &children,
+                                    ZKEventListener *listener,
+                                    void *context)
+{
+    TRACE(LOG, "getNodeChildren");
+
+    validatePath(path);
+    RepositoryOperationTimer timer(getStatsRecorder(),
+                                   clusterlib::RepositoryStats::GET_CHILDREN);
+    verifyConnection();
+    waitLatency();
+
+    children.clear();
+    int32_t rc = m_treeSP->getChildren(
+        this, path, &children, NULL, createWatch(listener, context));
+    timer.setRc(rc);
+    if ((listener != NULL) && (rc == ZOK)) {
+        getStatsRecorder().recordWatch();
+    }
+    return (rc == ZOK);
+}
+
+bool
+InMemoryRepository::getNodeData(const string &path,
+                                string &data,
+                                ZKEventListener *listener,
+                                void *context,
+                                Stat *stat,
+                                int32_t dataLengthHint)
+{
+    TRACE(LOG, "getNodeData");
+
+    validatePath(path);
+    RepositoryOperationTimer timer(getStatsRecorder(),
+                                   clusterlib::RepositoryStats::GET_DATA);
+    verifyConnection();
+    waitLatency();
+
+    if (stat != NULL) {
+        memset(stat, 0, sizeof(Stat));
+    }
+    int32_t rc = m_treeSP->getData(
+        this, path, &data, stat, createWatch(listener, context));
+    timer.setRc(rc);
+    if (rc == ZOK) {
+        getStatsRecorder().recordBytesRead(data.size());
+        if (listener != NULL) {
+            getStatsRecorder().recordWatch();
+        }
+        if (!decodeData(path, data)) {
+            data.clear();
+            ZooKeeperAdapter::throwErrorCode(
+                string("Unable to decode data of node ") + path,
+                ZMARSHALLINGERROR,
+                getState() == AS_CONNECTED);
+        }
+    }
+    return (rc == ZOK);
+}
+
+void
+InMemoryRepository::setNodeData(const string &path,
+                                const string &value,
+                                int32_t version,
+                                Stat *stat)
+{
+    TRACE(LOG, "setNodeData");
+
+    validatePath(path);
+    RepositoryOperationTimer timer(getStatsRecorder(),
+                                   clusterlib::RepositoryStats::SET_DATA);
+    verifyConnection();
+    waitLatency();
+
+    string data = encodeData(value);
+    int32_t rc = m_treeSP->setData(path, data, version, stat);
+    timer.setRc(rc);
+    if (rc == ZOK) {
+        getStatsRecorder().recordBytesWritten(data.length());
+    }
+    else {
+        LOG_ERROR(LOG,
+                  "setNodeData: Error %d for %s",
+                  rc,
+                  path.c_str());
+        ZooKeeperAdapter::throwErrorCode("setNodeData: Failed",
+                                         rc,
+                                         getState() == AS_CONNECTED);
+    }
+}
+
+AsyncOperationSP
+InMemoryRepository::nodeExistsAsync(const string &path,
+                                    ZKEventListener *listener,
+                                    void *context,
+                                    AsyncOperationCallback *callback)
+{
+    TRACE(LOG, "nodeExistsAsync");
+
+    InMemoryRequest request(
+        AsyncOperationSP(
+            new AsyncOperation(AsyncOperation::NODE_EXISTS, path, callback)),
+        0);
+    return queueOperation(request, listener, context);
+}
+
+AsyncOperationSP
+InMemoryRepository::getNodeChildrenAsync(const string &path,
+                                         ZKEventListener *listener,
+                                         void *context,
+                                         AsyncOperationCallback *callback)
+{
+    TRACE(LOG, "getNodeChildrenAsync");
+
+    InMemoryRequest request(
+        AsyncOperationSP(
+            new AsyncOperation(
+                AsyncOperation::GET_NODE_CHILDREN, path, callback)),
+        0);
+    return queueOperation(request, listener, context);
+}
+
+AsyncOperationSP
+InMemoryRepository::getNodeDataAsync(const string &path,
+                                     ZKEventListener *listener,
+                                     void *context,
+                                     AsyncOperationCallback *callback)
+{
+    TRACE(LOG, "getNodeDataAsync");
+
+    InMemoryRequest request(
+        AsyncOperationSP(
+            new AsyncOperation(
+                AsyncOperation::GET_NODE_DATA, path, callback)),
+        0);
+    return queueOperation(request, listener, context);
+}
+
+AsyncOperationSP
+InMemoryRepository::createNodeAsync(const string &path,
+                                    const string &value,
+                                    int32_t flags,
+                                    AsyncOperationCallback *callback)
+{
+    TRACE(LOG, "createNodeAsync");
+
+    InMemoryRequest request(
+        AsyncOperationSP(
+            new AsyncOperation(AsyncOperation::CREATE_NODE, path, callback)),
+        0);
+    request.m_value = encodeData(value, flags);
+    request.m_flags = getZKFlags(flags);
+    return queueOperation(request, NULL, NULL);
+}
+
+AsyncOperationSP
+InMemoryRepository::setNodeDataAsync(const string &path,
+                                     const string &value,
+                                     int32_t version,
+                                     AsyncOperationCallback *callback)
+{
+    TRACE(LOG, "setNodeDataAsync");
+
+    InMemoryRequest request(
+        AsyncOperationSP(
+            new AsyncOperation(
+                AsyncOperation::SET_NODE_DATA, path, callback)),
+        0);
+    request.m_value = encodeData(value);
+    request.m_version = version;
+    return queueOperation(request, NULL, NULL);
+}
+
+AsyncOperationSP
+InMemoryRepository::deleteNodeAsync(const string &path,
+                                    int32_t version,
+                                    AsyncOperationCallback *callback)
+{
+    TRACE(LOG, "deleteNodeAsync");
+
+    InMemoryRequest request(
+        AsyncOperationSP(
+            new AsyncOperation(AsyncOperation::DELETE_NODE, path, callback)),
+        0);
+    request.m_version = version;
+    return queueOperation(request, NULL, NULL);
+}
+
+bool
+InMemoryRepository::multi(const vector<MultiOperation> &operations,
+                          vector<int32_t> *pResults)
+{
+    TRACE(LOG, "multi");
+
+    if (pResults != NULL) {
+        pResults->clear();
+    }
+    if (operations.empty()) {
+        return true;
+    }
+    vector<MultiOperation>::const_iterator operationsIt;
+    for (operationsIt = operations.begin();
+         operationsIt != operations.end();
+         ++operationsIt) {
+        validatePath(operationsIt->getPath());
+    }
+    vector<MultiOperation> storedOperations;
+    storedOperations.reserve(operations.size());
+    for (operationsIt = operations.begin();
+         operationsIt != operations.end();
+         ++operationsIt) {
+        if (operationsIt->getType() == MultiOperation::CREATE_NODE) {
+            storedOperations.push_back(
+                MultiOperation::createNode(
+                    operationsIt->getPath(),
+                    encodeData(operationsIt->getValue(),
+                               operationsIt->getFlags()),
+                    getZKFlags(operationsIt->getFlags())));
+        }
+        else if (operationsIt->getType() == MultiOperation::SET_NODE_DATA) {
+            storedOperations.push_back(
+                MultiOperation::setNodeData(
+                    operationsIt->getPath(),
+                    encodeData(operationsIt->getValue(),
+                               operationsIt->getFlags()),
+                    operationsIt->getVersion()));
+        }
+        else {
+            storedOperations.push_back(*operationsIt);
+        }
+    }
+    RepositoryOperationTimer timer(getStatsRecorder(),
+                                   clusterlib::RepositoryStats::MULTI);
+    int64_t sessionId = verifyConnection();
+    waitLatency();
+
+    int32_t rc = m_treeSP->multi(sessionId, storedOperations, pResults);
+    timer.setRc(rc);
+    if (rc == ZOK) {
+        for (operationsIt = storedOperations.begin();
+             operationsIt != storedOperations.end();
+             ++operationsIt) {
+            getStatsRecorder().recordBytesWritten(
+                operationsIt->getValue().length());
+        }
+        return true;
+    }
+    else if ((rc == ZNODEEXISTS) ||
+             (rc == ZNONODE) ||
+             (rc == ZNOTEMPTY) ||
+             (rc == ZBADVERSION)) {
+        LOG_WARN(LOG,
+                 "multi: Aborted with error %d for %" PRIuPTR
+                 " operations starting with %s",
+                 rc,
+                 operations.size(),
+                 operations.front().getPath().c_str());
+        return false;
+    }
+
+    LOG_ERROR(LOG,
+              "multi: Error %d for %" PRIuPTR
+              " operations starting with %s",
+              rc,
+              operations.size(),
+              operations.front().getPath().c_str());
+    ZooKeeperAdapter::throwErrorCode(
+        string("Unable to execute transaction starting with ") +
+        operations.front().getPath(),
+        rc,
+        getState() == AS_CONNECTED);
+    return false;
+}
+
+Repository::AdapterState
+InMemoryRepository::getState() const
+{
+    clusterlib::Locker l(getStateLock());
+    return m_state;
+}
+
+void
+InMemoryRepository::injectEndEvent()
+{
+    m_requests.put(InMemoryRequest(
+                       ZKWatcherEvent(
+                           ZOO_SESSION_EVENT,
+                           ZOO_EXPIRED_SESSION_STATE,
+                           clusterlib::CLStringInternal::END_EVENT,
+                           NULL)));
+}
+
+int64_t
+InMemoryRepository::verifyConnection()
+{
+    clusterlib::Locker l(getStateLock());
+    if (m_state != AS_CONNECTED) {
+        throw Exception(
+            "Disconnected from the in-memory repository. "
+            "Please use reconnect() before attempting to use it");
+    }
+    return m_sessionId;
+}
+
+void
+InMemoryRepository::waitLatency()
+{
+    if (m_latencyUsecs > 0) {
+        sleepUsecs(m_latencyUsecs);
+    }
+}
+
+clusterlib::CallbackAndContext *
+InMemoryRepository::createWatch(ZKEventListener *listener, void *context)
+{
+    if (listener == NULL) {
+        return NULL;
+    }
+    return getListenerAndContextManager()->createCallbackAndContext(
+        listener, context);
+}
+
+void
+InMemoryRepository::releaseWatch(clusterlib::CallbackAndContext *watch)
+{
+    if (watch != NULL) {
+        getListenerAndContextManager()->deleteCallbackAndContext(watch);
+    }
+}
+
+AsyncOperationSP
+InMemoryRepository::queueOperation(InMemoryRequest &request,
+                                   ZKEventListener *listener,
+                                   void *context)
+{
+    TRACE(LOG, "queueOperation");
+
+    AsyncOperationSP &operationSP = request.m_operationSP;
+    validatePath(operationSP->getPath());
+    verifyConnection();
+
+    operationSP->mp_callbackAndContext = createWatch(listener, context);
+    operationSP->mp_statsRecorder = &getStatsRecorder();
+    request.m_dueUsecs =
+        clusterlib::TimerService::getCurrentTimeUsecs() + m_latencyUsecs;
+    m_requests.put(request);
+    return operationSP;
+}
+
+void
+InMemoryRepository::executeOperation(const InMemoryRequest &request)
+{
+    TRACE(LOG, "executeOperation");
+
+    const AsyncOperationSP &operationSP = request.m_operationSP;
+    clusterlib::CallbackAndContext *watch =
+        operationSP->mp_callbackAndContext;
+    operationSP->mp_callbackAndContext = NULL;
+
+    int64_t sessionId = 0;
+    {
+        clusterlib::Locker l(getStateLock());
+        sessionId = m_sessionId;
+    }
+    if (sessionId == 0) {
+        releaseWatch(watch);
+        recordAsync(*operationSP, ZCONNECTIONLOSS, false);
+        operationSP->complete(ZCONNECTIONLOSS);
+        return;
+    }
+
+    const string &path = operationSP->getPath();
+    int32_t rc = ZOK;
+    switch (operationSP->getType()) {
+        case AsyncOperation::NODE_EXISTS:
+            rc = m_treeSP->exists(this, path, &operationSP->m_stat, watch);
+            break;
+        case AsyncOperation::GET_NODE_CHILDREN:
+            rc = m_treeSP->getChildren(this,
+                                       path,
+                                       &operationSP->m_children,
+                                       &operationSP->m_stat,
+                                       watch);
+            break;
+        case AsyncOperation::GET_NODE_DATA:
+            rc = m_treeSP->getData(this,
+                                   path,
+                                   &operationSP->m_data,
+                                   &operationSP->m_stat,
+                                   watch);
+            break;
+        case AsyncOperation::CREATE_NODE:
+            rc = m_treeSP->create(sessionId,
+                                  path,
+                                  request.m_value,
+                                  request.m_flags,
+                                  &operationSP->m_data);
+            break;
+        case AsyncOperation::SET_NODE_DATA:
+            rc = m_treeSP->setData(path,
+                                   request.m_value,
+                                   request.m_version,
+                                   &operationSP->m_stat);
+            break;
+        case AsyncOperation::DELETE_NODE:
+            rc = m_treeSP->remove(path, request.m_version);
+            break;
+        default:
+            releaseWatch(watch);
+            watch = NULL;
+            rc = ZBADARGUMENTS;
+    }
+    if ((rc == ZOK) &&
+        ((operationSP->getType() == AsyncOperation::CREATE_NODE) ||
+         (operationSP->getType() == AsyncOperation::SET_NODE_DATA))) {
+        getStatsRecorder().recordBytesWritten(request.m_value.length());
+    }
+    recordAsync(*operationSP,
+                rc,
+                (watch != NULL) &&
+                ((rc == ZOK) ||
+                 ((rc == ZNONODE) &&
+                  (operationSP->getType() == AsyncOperation::NODE_EXISTS))));
+    if ((rc == ZOK) &&
+        (operationSP->getType() == AsyncOperation::GET_NODE_DATA)) {
+        operationSP->m_decodePending = true;
+    }
+    operationSP->complete(rc);
+}
+
+void
+InMemoryRepository::enqueueEvent(const ZKWatcherEvent &event)
+{
+    if (!m_eventDispatchAllowed) {
+        releaseWatch(
+            reinterpret_cast<clusterlib::CallbackAndContext *>(
+                event.getContext()));
+        return;
+    }
+    m_requests.put(InMemoryRequest(event));
+}
+
+void
+InMemoryRepository::deliverEvent(const ZKWatcherEvent &event)
+{
+    TRACE(LOG, "deliverEvent");
+
+    /*
+     * Same as ZooKeeperAdapter: a context is a CallbackAndContext
+     * with the listener of the watch, otherwise the event goes to all
+     * listeners.
+     */
+    ZKEventListener *listener = NULL;
+    void *userContext = NULL;
+    clusterlib::CallbackAndContext *callbackAndContext =
+        reinterpret_cast<clusterlib::CallbackAndContext *>(
+            event.getContext());
+    if (callbackAndContext != NULL) {
+        listener =
+            reinterpret_cast<ZKEventListener *>(callbackAndContext->callback);
+        userContext = callbackAndContext->context;
+    }
+
+    try {
+        ZKWatcherEvent sentEvent(event.getType(),
+                                 event.getState(),
+                                 event.getPath(),
+                                 userContext);
+        if (listener != NULL) {
+            fireEvent(listener, sentEvent);
+        }
+        else {
+            fireEventToAllListeners(sentEvent);
+        }
+    }
+    catch (std::exception &e) {
+        LOG_ERROR(LOG,
+                  "Unable to process event (type: %s, state: %s, "
+                  "path: %s), because of exception: %s",
+                  ZooKeeperAdapter::getEventString(event.getType()).c_str(),
+                  ZooKeeperAdapter::getStateString(event.getState()).c_str(),
+                  event.getPath().c_str(),
+                  e.what());
+    }
+
+    releaseWatch(callbackAndContext);
+}
+
+void
+InMemoryRepository::processRequests(void *param)
+{
+    TRACE(LOG, "processRequests");
+
+    LOG_INFO(LOG,
+             "Starting thread with InMemoryRepository::processRequests(), "
+             "this: %p, thread: %" PRIu32,
+             this,
+             clusterlib::ProcessThreadService::getTid());
+
+    while (1) {
+        InMemoryRequest request = m_requests.take();
+        if (request.m_operationSP.get() != NULL) {
+            int64_t usecs = request.m_dueUsecs -
+                clusterlib::TimerService::getCurrentTimeUsecs();
+            if (usecs > 0) {
+                sleepUsecs(usecs);
+            }
+            executeOperation(request);
+        }
+        else {
+            deliverEvent(request.m_event);
+            if (isEndEvent(request.m_event)) {
+                break;
+            }
+        }
+    }
+
+    LOG_INFO(LOG,
+             "Ending thread with InMemoryRepository::processRequests(): "
+             "this: %p, thread: %" PRIu32,
+             this,
+             clusterlib::ProcessThreadService::getTid());
+}
+
+bool
+InMemoryRepository::isEndEvent(const ZKWatcherEvent &event) const
+{
+    return ((event.getType() == ZOO_SESSION_EVENT) &&
+            (event.getState() == ZOO_EXPIRED_SESSION_STATE) &&
+            (event.getPath() == clusterlib::CLStringInternal::END_EVENT) &&
+            (event.getContext() == NULL));
+}
+
+}   /* end of 'namespace zk' */
@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ *
+ * $Id$
+ */
+
+#ifndef _CL_INMEMORYREPOSITORY_H_
+#define _CL_INMEMORYREPOSITORY_H_
+
+namespace zk {
+
+class InMemoryTree;
+
+/**
+ * \brief A queued asynchronous operation or event of an
+ * InMemoryRepository.
+ */
+class InMemoryRequest
+{
+  public:
+    /**
+     * \brief Constructor for an event.
+     *
+     * @param event the event to deliver
+     */
+    explicit InMemoryRequest(const ZKWatcherEvent &event = ZKWatcherEvent())
+        : m_event(event),
+          m_flags(0),
+          m_version(-1),
+          m_dueUsecs(0) {}
+
+    /**
+     * \brief Constructor for an operation.
+     *
+     * @param operationSP the operation to execute
+     * @param dueUsecs when to execute it (usecs since the epoch)
+     */
+    InMemoryRequest(const AsyncOperationSP &operationSP, int64_t dueUsecs)
+        : m_operationSP(operationSP),
+          m_flags(0),
+          m_version(-1),
+          m_dueUsecs(dueUsecs) {}
+
+    /**
+     * The operation to execute; NULL if this is an event.
+     */
+    AsyncOperationSP m_operationSP;
+
+    /**
+     * The event to deliver if this is not an operation.
+     */
+    ZKWatcherEvent m_event;
+
+    /**
+     * The value for CREATE_NODE and SET_NODE_DATA.
+     */
+    std::string m_value;
+
+    /**
+     * The flags for CREATE_NODE.
+     */
+    int32_t m_flags;
+
+    /**
+     * The expected version for SET_NODE_DATA and DELETE_NODE.
+     */
+    int32_t m_version;
+
+    /**
+     * When the operation is executed (usecs since the epoch).
+     */
+    int64_t m_dueUsecs;
+};
+
+/**
+ * \brief A Repository that keeps the nodes in the memory of this
+ * process instead of a ZK ensemble.
+ *
+ * All the repositories created with the same tree name share the
+ * same nodes, so several Factory objects in one process see each
+ * other's changes, locks and queues.  Each repository is a separate
+ * session with its own ephemeral nodes and watches.  Every operation
+ * is delayed by a fixed latency to model the round trip to the
+ * server.  Asynchronous operations and events are handled in order
+ * by one thread per repository, so pipelined operations overlap
+ * their latency like they would with ZK.
+ */
+class InMemoryRepository
+    : public Repository
+{
+  public:
+    /**
+     * Parses a registry of the form
+     * "inmemory:[<tree name>][:<latency in usecs>]".
+     *
+     * @param registry the registry passed to the Factory
+     * @param pTreeName if not NULL, set to the tree name
+     * @param pLatencyUsecs if not NULL, set to the latency
+     * @return true if the registry names an in-memory tree
+     */
+    static bool parseRegistry(const std::string &registry,
+                              std::string *pTreeName = NULL,
+                              int64_t *pLatencyUsecs = NULL);
+
+    /**
+     * \brief Constructor.
+     *
+     * @param treeName the name of the tree to share with other
+     *        repositories
+     * @param latencyUsecs how long each operation takes
+     * @param establishConnection whether to open the session now
+     */
+    InMemoryRepository(const std::string &treeName,
+                       int64_t latencyUsecs,
+                       bool establishConnection = false);
+
+    /**
+     * \brief Destructor.
+     */
+    virtual ~InMemoryRepository();
+
+    virtual void reconnect();
+
+    virtual void disconnect(bool final = false);
+
+    virtual void stopEventDispatch();
+
+    virtual bool sync(const std::string &path,
+                      ZKEventListener *listener,
+                      void *context);
+
+    virtual bool createNode(const std::string &path,
+                            const std::string &value = "",
+                            int flags = 0,
+                            bool createAncestors = true);
+
+    virtual int64_t createSequence(const std::string &path,
+                                   const std::string &value,
+                                   int flags,
+                                   bool createAncestors,
+                                   std::string &createdPath);
+
+    virtual bool deleteNode(const std::string &path,
+                            bool recursive = false,
+                            int version = -1,
+                            DeleteProgressCallback *progress = NULL);
+
+    virtual bool nodeExists(const std::string &path,
+                            ZKEventListener *listener = NULL,
+                            void *context = NULL,
+                            Stat *stat = NULL);
+
+    virtual bool getNodeChildren(const std::string &path,
+                                 std::vector<std::string> &children,
+                                 ZKEventListener *listener = NULL,
+                                 void *context = NULL);
+
+    virtual bool getNodeData(const std::string &path,
+                             std::string &data,
+                             ZKEventListener *listener = NULL,
+                             void *context = NULL,
+                             Stat *stat = NULL,
+                             int32_t dataLengthHint = -1);
+
+    virtual void setNodeData(const std::string &path,
+                             const std::string &value,
+                             int version = -1,
+                             Stat *stat = NULL);
+
+    virtual AsyncOperationSP nodeExistsAsync(
+        const std::string &path,
+        ZKEventListener *listener = NULL,
+        void *context = NULL,
+        AsyncOperationCallback *callback = NULL);
+
+    virtual AsyncOperationSP getNodeChildrenAsync(
+        const std::string &path,
+        ZKEventListener *listener = NULL,
+        void *context = NULL,
+        AsyncOperationCallback *callback = NULL);
+
+    virtual AsyncOperationSP getNodeDataAsync(
+        const std::string &path,
+        ZKEventListener *listener = NULL,
+        void *context = NULL,
+        AsyncOperationCallback *callback = NULL);
+
+    virtual AsyncOperationSP createNodeAsync(
+        const std::string &path,
+        const std::string &value = "",
+        int flags = 0,
+        AsyncOperationCallback *callback = NULL);
+
+    virtual AsyncOperationSP setNodeDataAsync(
+        const std::string &path,
+        const std::string &value,
+        int version = -1,
+        AsyncOperationCallback *callback = NULL);
+
+    virtual AsyncOperationSP deleteNodeAsync(
+        const std::string &path,
+        int version = -1,
+        AsyncOperationCallback *callback = NULL);
+
+    virtual bool multi(const std::vector<MultiOperation> &operations,
+                       std::vector<int32_t> *pResults = NULL);
+
+    virtual AdapterState getState() const;
+
+    virtual void injectEndEvent();
+
+    /**
+     * Get the latency of each operation.
+     */
+    int64_t getLatencyUsecs() const { return m_latencyUsecs; }
+
+  private:
+    /**
+     * InMemoryTree delivers the watch events of this session.
+     */
+    friend class InMemoryTree;
+
+    /**
+     * Creates a node, like ZooKeeperAdapter's internal createNode().
+     */
+    bool createNode(const std::string &path,
+                    const std::string &value,
+                    int flags,
+                    bool createAncestors,
+                    std::string &createdPath);
+
+    /**
+     * Throws if the session is not open.
+     *
+     * @return the current session id
+     */
+    int64_t verifyConnection();
+
+    /**
+     * Sleeps for the latency of one operation.
+     */
+    void waitLatency();
+
+    /**
+     * Creates the CallbackAndContext of a watch.
+     *
+     * @param listener the listener of the watch; if NULL no watch is set
+     * @param context the user context passed back with the event
+     * @return the allocated CallbackAndContext or NULL if no listener
+     */
+    clusterlib::CallbackAndContext *createWatch(ZKEventListener *listener,
+                                                void *context);
+
+    /**
+     * Releases the CallbackAndContext of a watch that was not set.
+     *
+     * @param watch the watch to release, may be NULL
+     */
+    void releaseWatch(clusterlib::CallbackAndContext *watch);
+
+    /**
+     * Queues an asynchronous operation for the request thread.
+     *
+     * @param request the request with all the arguments
+     * @param listener the listener of the watch; if NULL no watch is set
+     * @param context the user context passed back with the event
+     * @return the pending operation
+     */
+    AsyncOperationSP queueOperation(InMemoryRequest &request,
+                                    ZKEventListener *listener,
+                                    void *context);
+
+    /**
+     * Executes a queued asynchronous operation against the tree and
+     * completes it.
+     *
+     * @param request the request to execute
+     */
+    void executeOperation(const InMemoryRequest &request);
+
+    /**
+     * Queues an event for the request thread, unless event dispatch
+     * was stopped.  Called with the tree lock held.
+     *
+     * @param event the event to deliver
+     */
+    void enqueueEvent(const ZKWatcherEvent &event);
+
+    /**
+     * Hands an event to the listeners, logging any exception.
+     *
+     * @param event the event to deliver
+     */
+    void deliverEvent(const ZKWatcherEvent &event);
+
+    /**
+     * Executes operations and delivers events in order until the end
+     * event.
+     */
+    void processRequests(void *param);
+
+    /**
+     * Is this an end event?
+     *
+     * @param event the event to check
+     * @return true if this is an end event
+     */
+    bool isEndEvent(const ZKWatcherEvent &event) const;
+
+    /**
+     * Gets the lock that protects {@link #m_state} and {@link
+     * #m_sessionId}.
+     */
+    const clusterlib::Mutex &getStateLock() const
+    {
+        return m_stateLock;
+    }
+
+    /**
+     * Get the callback and context manager.
+     */
+    clusterlib::CallbackAndContextManager *getListenerAndContextManager()
+    {
+        return &m_listenerAndContextManager;
+    }
+
+  private:
+    /**
+     * The nodes shared with the other repositories of the same name.
+     */
+    boost::shared_ptr<InMemoryTree> m_treeSP;
+
+    /**
+     * How long each operation takes.
+     */
+    const int64_t m_latencyUsecs;
+
+    /**
+     * The current session; 0 if not connected.
+     */
+    int64_t m_sessionId;
+
+    /**
+     * The state of this repository.
+     */
+    AdapterState m_state;
+
+    /**
+     * Is event dispatch allowed? (default == true)
+     */
+    volatile bool m_eventDispatchAllowed;
+
+    /**
+     * Protects {@link #m_state} and {@link #m_sessionId}.
+     */
+    clusterlib::Mutex m_stateLock;
+
+    /**
+     * Queued asynchronous operations and events, in order.
+     */
+    clusterlib::BlockingQueue<InMemoryRequest> m_requests;
+
+    /**
+     * The thread that handles {@link #m_requests}.
+     */
+    clusterlib::CXXThread<InMemoryRepository> m_requestThread;
+
+    /**
+     * Manages the CallbackAndContexts of the watches.
+     */
+    clusterlib::CallbackAndContextManager m_listenerAndContextManager;
+};
+
+}   /* end of 'namespace zk' */
+
+#endif /* _CL_INMEMORYREPOSITORY_H_ */
@@ -0,0 +1,440 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ *
+ * $Id$
+ */
+
+#ifndef _CL_MPSCQUEUE_H_
+#define _CL_MPSCQUEUE_H_
+
+namespace clusterlib  {
+
+/**
+ * \brief An unbounded queue of elements of type E that any number of
+ * threads may put into and only one thread at a time may take from.
+ *
+ * It has the same interface as {@link BlockingQueue} and can stand
+ * in for it on channels with a single consumer.  Elements go into a
+ * lock-free ring of fixed capacity, so put() only costs a
+ * compare-and-swap, and the consumer only makes a system call
+ * (futex) when it has to sleep or a sleeping consumer has to be woken
+ * up.  If the ring is full, elements go to an overflow list behind a
+ * mutex until the consumer has drained it, so put() never blocks and
+ * the elements of each producer are taken in order.
+ *
+ * E must be default constructible and assignable.
+ */
+template <class E>
+class MPSCQueue
+{
+    public:
+        /**
+         * \brief Constructor.
+         *
+         * @param capacity the number of elements the ring holds
+         *        (rounded up to a power of 2)
+         */
+        explicit MPSCQueue(size_t capacity = 1024);
+
+        /**
+         * \brief Adds the specified element to this queue.  Never
+         * blocks.
+         *
+         * @param element the element to be added
+         */
+        void put(E element);
+
+        /**
+         * \brief Retrieves and removes the head of this queue,
+         * waiting forever if no elements are present in this
+         * queue.  Only one thread may take at a time.
+         *
+         * @return Element from the queue
+         */
+        E take();
+
+        /**
+         * \brief Retrieves and removes the head of this queue,
+         * waiting if no elements are present in this queue.  Only one
+         * thread may take at a time.
+         *
+         * @param msecTimeout the amount of msecs to wait until giving up,
+         *        -1 means wait forever, 0 means return immediately
+         * @param element the element filled in if returned true
+         * @return true if an element was retrieved, false otherwise
+         */
+        bool takeWaitMsecs(int64_t msecTimeout, E &element);
+
+        /**
+         * \brief Retrieves and removes the elements at the head of
+         * this queue, waiting if no elements are present in this
+         * queue.  Only one thread may take at a time.
+         *
+         * @param msecTimeout the amount of msecs to wait until giving up,
+         *        -1 means wait forever, 0 means return immediately
+         * @param elements the vector the elements are appended to
+         * @param maxElements the most elements to take
+         * @return true if at least one element was retrieved, false
+         *         otherwise
+         */
+        bool takeAllWaitMsecs(int64_t msecTimeout,
+                              std::vector<E> &elements,
+                              size_t maxElements);
+
+        /**
+         * \brief Retrieves and removes the elements at the head of
+         * this queue without waiting.  Only one thread may take at a
+         * time.
+         *
+         * @param elements the vector the elements are appended to
+         * @param maxElements the most elements to take
+         * @return the number of elements retrieved
+         */
+        size_t drainTo(std::vector<E> &elements, size_t maxElements);
+
+        /**
+         * Returns the current size of this queue (approximate while
+         * elements are being added).
+         *
+         * @return the number of elements in this queue
+         */
+        int32_t size() const;
+
+        /**
+         * \brief Returns whether this queue is empty or not.
+         *
+         * @return true if this queue has no elements; false otherwise
+         */
+        bool empty() const;
+
+        /**
+         * \brief Erases the queue.  Only the thread that takes may
+         * call this.
+         */
+        void erase();
+
+    private:
+        /**
+         * Add an element to the ring.
+         *
+         * @param element the element to be added
+         * @return false if the ring is full
+         */
+        bool tryPutRing(const E &element);
+
+        /**
+         * Take the head of the ring, or of the overflow list once
+         * the ring is empty.
+         *
+         * @param element the element filled in if returned true
+         * @return true if an element was retrieved, false otherwise
+         */
+        bool tryTake(E &element);
+
+        /**
+         * Wake up the consumer if it is waiting.
+         */
+        void wakeConsumer();
+
+        /**
+         * No copy construction allowed.
+         */
+        MPSCQueue(const MPSCQueue &);
+
+        /**
+         * No assignment allowed.
+         */
+        MPSCQueue &operator=(const MPSCQueue &);
+
+    private:
+        /**
+         * Number of times the consumer looks for an element before it
+         * goes to sleep.
+         */
+        static const int32_t SPIN_COUNT = 100;
+
+        /**
+         * A slot of the ring.  The sequence tells whether the slot
+         * can be written for the position (sequence == position) or
+         * read (sequence == position + 1).
+         */
+        struct Cell {
+            Cell() : m_sequence(0) {}
+            volatile size_t m_sequence;
+            E m_element;
+        };
+
+        /**
+         * The ring.
+         */
+        std::vector<Cell> m_cells;
+
+        /**
+         * The size of the ring - 1.
+         */
+        size_t m_mask;
+
+        /**
+         * The position the next put() claims.
+         */
+        volatile size_t m_enqueuePos;
+
+        /**
+         * The position the consumer takes next.
+         */
+        volatile size_t m_dequeuePos;
+
+        /**
+         * Elements put while the ring was full, in order.
+         */
+        std::deque<E> m_overflow;
+
+        /**
+         * Protects m_overflow and m_overflowing.
+         */
+        Mutex m_overflowMutex;
+
+        /**
+         * Set while m_overflow has elements, so that producers keep
+         * appending to it instead of the ring.
+         */
+        volatile int32_t m_overflowing;
+
+        /**
+         * The futex word the consumer sleeps on.  Producers bump it
+         * before waking the consumer up.
+         */
+        volatile int32_t m_wakeups;
+
+        /**
+         * Set while the consumer may be sleeping.  The first producer
+         * to clear it wakes the consumer up.
+         */
+        volatile int32_t m_consumerWaiting;
+};
+
+template<class E>
+MPSCQueue<E>::MPSCQueue(size_t capacity)
+    : m_mask(0),
+      m_enqueuePos(0),
+      m_dequeuePos(0),
+      m_overflowing(0),
+      m_wakeups(0),
+      m_consumerWaiting(0)
+{
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    m_cells.resize(size);
+    for (size_t i = 0; i < size; ++i) {
+        m_cells[i].m_sequence = i;
+    }
+    m_mask = size - 1;
+}
+
+template<class E>
+int32_t MPSCQueue<E>::size() const
+{
+    int32_t size = static_cast<int32_t>(m_enqueuePos - m_dequeuePos);
+    Locker l(&m_overflowMutex);
+    return size + static_cast<int32_t>(m_overflow.size());
+}
+
+template<class E>
+bool MPSCQueue<E>::empty() const
+{
+    return (size() == 0);
+}
+
+template<class E>
+void MPSCQueue<E>::put(E element)
+{
+    if (m_overflowing || !tryPutRing(element)) {
+        Locker l(&m_overflowMutex);
+        m_overflow.push_back(element);
+        m_overflowing = 1;
+    }
+    wakeConsumer();
+}
+
+template<class E>
+E MPSCQueue<E>::take()
+{
+    E element;
+    takeWaitMsecs(-1, element);
+    return element;
+}
+
+template<class E>
+bool MPSCQueue<E>::takeWaitMsecs(int64_t msecTimeout, E &element)
+{
+    if (msecTimeout < -1) {
+        std::stringstream ss;
+        ss << "takeWaitMsecs: Cannot have msecTimeout < -1 ("
+           << msecTimeout << ")";
+        throw InvalidArgumentsException(ss.str());
+    }
+
+    int64_t maxUsecs = 0;
+    if (msecTimeout != -1) {
+        maxUsecs = TimerService::getCurrentTimeUsecs() + (msecTimeout * 1000);
+    }
+
+    while (true) {
+        /* Producers are often about to publish, so look a few times. */
+        for (int32_t i = 0; i < SPIN_COUNT; ++i) {
+            if (tryTake(element)) {
+                return true;
+            }
+        }
+
+        /*
+         * Announce the wait before checking one last time, so that a
+         * producer either sees m_consumerWaiting or its element is
+         * seen here.
+         */
+        int32_t wakeups = m_wakeups;
+        m_consumerWaiting = 1;
+        __sync_synchronize();
+        if (tryTake(element)) {
+            m_consumerWaiting = 0;
+            return true;
+        }
+
+        int64_t usecTimeout = -1;
+        if (msecTimeout != -1) {
+            usecTimeout = std::max(
+                maxUsecs - TimerService::getCurrentTimeUsecs(),
+                static_cast<int64_t>(0));
+            if (usecTimeout == 0) {
+                m_consumerWaiting = 0;
+                return false;
+            }
+        }
+        Futex::wait(&m_wakeups, wakeups, usecTimeout);
+        m_consumerWaiting = 0;
+    }
+}
+
+template<class E>
+bool MPSCQueue<E>::takeAllWaitMsecs(int64_t msecTimeout,
+                                    std::vector<E> &elements,
+                                    size_t maxElements)
+{
+    E element;
+    if (!takeWaitMsecs(msecTimeout, element)) {
+        return false;
+    }
+    elements.push_back(element);
+    if (maxElements > 1) {
+        drainTo(elements, maxElements - 1);
+    }
+    return true;
+}
+
+template<class E>
+size_t MPSCQueue<E>::drainTo(std::vector<E> &elements, size_t maxElements)
+{
+    size_t count = 0;
+    E element;
+    while ((count < maxElements) && tryTake(element)) {
+        elements.push_back(element);
+        ++count;
+    }
+    return count;
+}
+
+template<class E>
+void MPSCQueue<E>::erase()
+{
+    E element;
+    while (tryTake(element)) {
+    }
+}
+
+template<class E>
+bool MPSCQueue<E>::tryPutRing(const E &element)
+{
+    size_t pos = m_enqueuePos;
+    while (true) {
+        Cell &cell = m_cells[pos & m_mask];
+        size_t sequence = cell.m_sequence;
+        if (sequence == pos) {
+            if (__sync_bool_compare_and_swap(&m_enqueuePos, pos, pos + 1)) {
+                cell.m_element = element;
+                __sync_synchronize();
+                cell.m_sequence = pos + 1;
+                return true;
+            }
+            pos = m_enqueuePos;
+        }
+        else if (static_cast<ssize_t>(sequence - pos) < 0) {
+            /* The consumer has not freed this slot yet. */
+            return false;
+        }
+        else {
+            pos = m_enqueuePos;
+        }
+    }
+}
+
+template<class E>
+bool MPSCQueue<E>::tryTake(E &element)
+{
+    size_t pos = m_dequeuePos;
+    Cell &cell = m_cells[pos & m_mask];
+    if (cell.m_sequence == pos + 1) {
+        __sync_synchronize();
+        element = cell.m_element;
+        cell.m_element = E();
+        __sync_synchronize();
+        cell.m_sequence = pos + m_mask + 1;
+        m_dequeuePos = pos + 1;
+        return true;
+    }
+
+    /*
+     * Only take from the overflow list once every claimed slot has
+     * been taken, since a producer may have filled the ring before
+     * overflowing.
+     */
+    if (!m_overflowing || (m_enqueuePos != pos)) {
+        return false;
+    }
+    Locker l(&m_overflowMutex);
+    if (m_overflow.empty()) {
+        m_overflowing = 0;
+        return false;
+    }
+    element = m_overflow.front();
+    m_overflow.pop_front();
+    if (m_overflow.empty()) {
+        m_overflowing = 0;
+    }
+    return true;
+}
+
+template<class E>
+void MPSCQueue<E>::wakeConsumer()
+{
+    __sync_synchronize();
+    if (m_consumerWaiting && 
+        __sync_bool_compare_and_swap(&m_consumerWaiting, 1, 0)) {
+        __sync_add_and_fetch(&m_wakeups, 1);
+        Futex::wakeOne(&m_wakeups);
+    }
+}
+
+}	/* End of 'namespace clusterlib' */
+
+#endif  /* _CL_MPSCQUEUE_H_ */
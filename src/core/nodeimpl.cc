@@ -124,18 +124,12 @@ NodeImpl::~NodeImpl()
 {
 }
 
-NotifyableList
-NodeImpl::getChildrenNotifyables()
+vector<string>
+NodeImpl::getChildrenRegisteredNames()
 {
-    TRACE(CL_LOG, "getChildrenNotifyables");
-    
-    throwIfRemoved();
-    
-    return getOps()->getNotifyableList(
-        shared_from_this(),
-        CLString::REGISTERED_PROCESSSLOT_NAME,
-        getProcessSlotNames(),
-        LOAD_FROM_REPOSITORY);
+    vector<string> registeredNameVec;
+    registeredNameVec.push_back(CLString::REGISTERED_PROCESSSLOT_NAME);
+    return registeredNameVec;
 }
 
 void
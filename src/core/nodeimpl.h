@@ -59,7 +59,7 @@ class NodeImpl
      */
     virtual ~NodeImpl();
 
-    virtual NotifyableList getChildrenNotifyables();
+    virtual std::vector<std::string> getChildrenRegisteredNames();
 
     virtual void initializeCachedRepresentation();
 
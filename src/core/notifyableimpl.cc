@@ -162,33 +162,382 @@ NotifyableImpl::getMyParent() const
     return dynamic_pointer_cast<Notifyable>(mp_parent);
 }
 
+/**
+ * Get the key under which the children of a registered type are
+ * named and the change that a watch on it reports.
+ */
+static void
+getChildrenKeyAndChange(const string &notifyableKey,
+                        const string &registeredName,
+                        string *pChildrenKey,
+                        CachedObjectChangeHandlers::CachedObjectChange *pChange)
+{
+    if (registeredName == CLString::REGISTERED_PROPERTYLIST_NAME) {
+        *pChildrenKey = 
+            NotifyableKeyManipulator::createPropertyListChildrenKey(
+                notifyableKey);
+        *pChange = CachedObjectChangeHandlers::PROPERTYLISTS_CHANGE;
+    }
+    else if (registeredName == CLString::REGISTERED_QUEUE_NAME) {
+        *pChildrenKey = 
+            NotifyableKeyManipulator::createQueueChildrenKey(notifyableKey);
+        *pChange = CachedObjectChangeHandlers::QUEUES_CHANGE;
+    }
+    else if (registeredName == CLString::REGISTERED_APPLICATION_NAME) {
+        *pChildrenKey = 
+            NotifyableKeyManipulator::createApplicationChildrenKey(
+                notifyableKey);
+        *pChange = CachedObjectChangeHandlers::APPLICATIONS_CHANGE;
+    }
+    else if (registeredName == CLString::REGISTERED_GROUP_NAME) {
+        *pChildrenKey = 
+            NotifyableKeyManipulator::createGroupChildrenKey(notifyableKey);
+        *pChange = CachedObjectChangeHandlers::GROUPS_CHANGE;
+    }
+    else if (registeredName == CLString::REGISTERED_DATADISTRIBUTION_NAME) {
+        *pChildrenKey = 
+            NotifyableKeyManipulator::createDataDistributionChildrenKey(
+                notifyableKey);
+        *pChange = CachedObjectChangeHandlers::DATADISTRIBUTIONS_CHANGE;
+    }
+    else if (registeredName == CLString::REGISTERED_NODE_NAME) {
+        *pChildrenKey = 
+            NotifyableKeyManipulator::createNodeChildrenKey(notifyableKey);
+        *pChange = CachedObjectChangeHandlers::NODES_CHANGE;
+    }
+    else if (registeredName == CLString::REGISTERED_PROCESSSLOT_NAME) {
+        *pChildrenKey = 
+            NotifyableKeyManipulator::createProcessSlotChildrenKey(
+                notifyableKey);
+        *pChange = CachedObjectChangeHandlers::PROCESSSLOTS_CHANGE;
+    }
+    else {
+        throw InconsistentInternalStateException(
+            "getChildrenKeyAndChange: No children of type " + 
+            registeredName);
+    }
+}
+
+/**
+ * Gets the children of a Notifyable.  The names of the children of
+ * every type are listed with pipelined getNodeChildrenAsync() calls.
+ * The completion of the last listing queues the task on the
+ * asynchronous operation workers, which load the children.
+ */
+class GetMyChildrenTask
+    : public AsyncTask,
+      public zk::AsyncOperationCallback
+{
+  public:
+    GetMyChildrenTask(
+        const shared_ptr<NotifyableImpl> &notifyableSP,
+        const shared_ptr<AsyncResult<NotifyableList> > &resultSP)
+        : m_notifyableSP(notifyableSP),
+          m_resultSP(resultSP),
+          m_outstanding(1)
+    {
+        vector<string> registeredNameVec = 
+            m_notifyableSP->getAllChildrenRegisteredNames();
+        m_listingVec.resize(registeredNameVec.size());
+        for (size_t i = 0; i < registeredNameVec.size(); ++i) {
+            m_listingVec[i].m_registeredName = registeredNameVec[i];
+            getChildrenKeyAndChange(m_notifyableSP->getKey(),
+                                    registeredNameVec[i],
+                                    &m_listingVec[i].m_childrenKey,
+                                    &m_listingVec[i].m_change);
+        }
+    }
+
+    /**
+     * Issue the listings.  The task may have run and been deleted
+     * by the time this returns.
+     */
+    void issue()
+    {
+        TRACE(CL_LOG, "issue");
+
+        /*
+         * Claim the watches like SAFE_CALLBACK_ZK does.  The claims
+         * of the listings that fail are given back in run().
+         */
+        CachedObjectChangeHandlers *changeHandlers = 
+            getOps()->getCachedObjectChangeHandlers();
+        vector<Listing>::iterator listingVecIt;
+        for (listingVecIt = m_listingVec.begin(); 
+             listingVecIt != m_listingVec.end(); 
+             ++listingVecIt) {
+            {
+                Locker l(changeHandlers->getLock());
+                if (!changeHandlers->isHandlerCallbackReady(
+                        listingVecIt->m_change, 
+                        listingVecIt->m_childrenKey)) {
+                    changeHandlers->setHandlerCallbackReady(
+                        listingVecIt->m_change, 
+                        listingVecIt->m_childrenKey);
+                    listingVecIt->m_watch = true;
+                }
+            }
+
+            __sync_add_and_fetch(&m_outstanding, 1);
+            try {
+                if (listingVecIt->m_watch) {
+                    getOps()->getRepository()->getNodeChildrenAsync(
+                        listingVecIt->m_childrenKey,
+                        getOps()->getZooKeeperEventAdapter(),
+                        changeHandlers->getChangeHandler(
+                            listingVecIt->m_change),
+                        this);
+                }
+                else {
+                    getOps()->getRepository()->getNodeChildrenAsync(
+                        listingVecIt->m_childrenKey, NULL, NULL, this);
+                }
+            }
+            catch (std::exception &e) {
+                /* 
+                 * A listing that could not be sent to the repository
+                 * has already been completed with the error.
+                 */
+                LOG_WARN(CL_LOG,
+                         "issue: Listing %s failed: %s",
+                         listingVecIt->m_childrenKey.c_str(),
+                         e.what());
+                if (!listingVecIt->m_completed) {
+                    listingVecIt->m_rc = ZSYSTEMERROR;
+                    listingVecIt->m_completed = true;
+                    listingDone();
+                }
+            }
+        }
+        listingDone();
+    }
+
+    virtual void operationCompleted(const zk::AsyncOperation &operation)
+    {
+        vector<Listing>::iterator listingVecIt;
+        for (listingVecIt = m_listingVec.begin(); 
+             listingVecIt != m_listingVec.end(); 
+             ++listingVecIt) {
+            if (listingVecIt->m_childrenKey == operation.getPath()) {
+                listingVecIt->m_rc = operation.getRc();
+                if (listingVecIt->m_rc == ZOK) {
+                    listingVecIt->m_nameList = operation.getChildren();
+                }
+                listingVecIt->m_completed = true;
+                listingDone();
+                return;
+            }
+        }
+    }
+
+    virtual void run()
+    {
+        TRACE(CL_LOG, "run");
+
+        CachedObjectChangeHandlers *changeHandlers = 
+            getOps()->getCachedObjectChangeHandlers();
+        NotifyableList tmpList, finalList;
+        vector<Listing>::iterator listingVecIt;
+        for (listingVecIt = m_listingVec.begin(); 
+             listingVecIt != m_listingVec.end(); 
+             ++listingVecIt) {
+            /* ZK only sets the watch when the listing succeeds. */
+            if ((listingVecIt->m_rc != ZOK) && listingVecIt->m_watch) {
+                Locker l(changeHandlers->getLock());
+                if (changeHandlers->isHandlerCallbackReady(
+                        listingVecIt->m_change, 
+                        listingVecIt->m_childrenKey)) {
+                    changeHandlers->unsetHandlerCallbackReady(
+                        listingVecIt->m_change, 
+                        listingVecIt->m_childrenKey);
+                }
+            }
+            if ((listingVecIt->m_rc != ZOK) && 
+                (listingVecIt->m_rc != ZNONODE)) {
+                SAFE_CALL_ZK(
+                    zk::ZooKeeperAdapter::throwErrorCode(
+                        string("Unable to get children of node ") + 
+                        listingVecIt->m_childrenKey,
+                        listingVecIt->m_rc,
+                        (getOps()->getRepository()->getState() == 
+                         zk::Repository::AS_CONNECTED)),
+                    "Reading the value of %s failed: %s",
+                    listingVecIt->m_childrenKey.c_str(),
+                    true,
+                    true);
+            }
+
+            /* Remove the key prefix */
+            NameList::iterator nameListIt;
+            for (nameListIt = listingVecIt->m_nameList.begin();
+                 nameListIt != listingVecIt->m_nameList.end();
+                 ++nameListIt) {
+                *nameListIt = nameListIt->substr(
+                    listingVecIt->m_childrenKey.length() + 
+                    CLString::KEY_SEPARATOR.length());
+            }
+
+            tmpList = getOps()->getNotifyableList(
+                m_notifyableSP,
+                listingVecIt->m_registeredName,
+                listingVecIt->m_nameList,
+                LOAD_FROM_REPOSITORY);
+            finalList.insert(finalList.end(), tmpList.begin(), tmpList.end());
+        }
+
+        m_resultSP->setValue(finalList);
+    }
+
+    virtual AsyncResultBase &getResult() 
+    {
+        return *m_resultSP;
+    }
+
+  private:
+    /**
+     * Used by SAFE_CALL_ZK.
+     */
+    FactoryOps *getOps()
+    {
+        return m_notifyableSP->getOps();
+    }
+
+    /**
+     * Count down a completed listing (or the end of issue()).  The
+     * last one queues the task on the workers.
+     */
+    void listingDone()
+    {
+        if (__sync_sub_and_fetch(&m_outstanding, 1) == 0) {
+            getOps()->finishAsync(this);
+        }
+    }
+
+  private:
+    /**
+     * The listing of the children of one type.
+     */
+    struct Listing
+    {
+        Listing()
+            : m_change(CachedObjectChangeHandlers::NOTIFYABLE_REMOVED_CHANGE),
+              m_watch(false),
+              m_completed(false),
+              m_rc(ZOK) {}
+
+        /**
+         * The registered name of the children.
+         */
+        string m_registeredName;
+
+        /**
+         * The key under which the children are named.
+         */
+        string m_childrenKey;
+
+        /**
+         * The change a watch on m_childrenKey reports.
+         */
+        CachedObjectChangeHandlers::CachedObjectChange m_change;
+
+        /**
+         * Was the watch claimed by this listing?
+         */
+        bool m_watch;
+
+        /**
+         * Has the listing completed?
+         */
+        bool m_completed;
+
+        /**
+         * The ZK return code of the listing.
+         */
+        int32_t m_rc;
+
+        /**
+         * The keys of the children.
+         */
+        NameList m_nameList;
+    };
+
+    shared_ptr<NotifyableImpl> m_notifyableSP;
+    shared_ptr<AsyncResult<NotifyableList> > m_resultSP;
+    vector<Listing> m_listingVec;
+
+    /**
+     * The listings not completed yet, plus one until issue() is done.
+     */
+    volatile int32_t m_outstanding;
+};
+
+shared_ptr<AsyncResult<NotifyableList> >
+NotifyableImpl::getMyChildrenAsync(AsyncResultCallback *callback)
+{
+    TRACE(CL_LOG, "getMyChildrenAsync");
+
+    throwIfRemoved();
+
+    shared_ptr<AsyncResult<NotifyableList> > resultSP(
+        new AsyncResult<NotifyableList>(callback));
+    GetMyChildrenTask *task = 
+        new GetMyChildrenTask(shared_from_this(), resultSP);
+    try {
+        getOps()->beginAsync();
+    }
+    catch (...) {
+        delete task;
+        throw;
+    }
+    task->issue();
+    return resultSP;
+}
+
+vector<string>
+NotifyableImpl::getAllChildrenRegisteredNames()
+{
+    vector<string> registeredNameVec;
+    registeredNameVec.push_back(CLString::REGISTERED_PROPERTYLIST_NAME);
+    registeredNameVec.push_back(CLString::REGISTERED_QUEUE_NAME);
+    vector<string> childrenRegisteredNameVec = getChildrenRegisteredNames();
+    registeredNameVec.insert(registeredNameVec.end(), 
+                             childrenRegisteredNameVec.begin(),
+                             childrenRegisteredNameVec.end());
+    return registeredNameVec;
+}
+
 NotifyableList
-NotifyableImpl::getMyChildren()
+NotifyableImpl::getMyChildren(AccessType accessType)
 {
     TRACE(CL_LOG, "getMyChildren");
 
     throwIfRemoved();
+
+    if (accessType == CACHED_ONLY) {
+        return getOps()->getCachedChildren(getKey());
+    }
     
     /*
      * Add the notifyables from this object and then the subclass
      * specific objects.
      */
     NotifyableList tmpList, finalList;
-    tmpList = getOps()->getNotifyableList(
-        shared_from_this(),
-        CLString::REGISTERED_PROPERTYLIST_NAME,
-        getPropertyListNames(),
-        LOAD_FROM_REPOSITORY);
-    finalList.insert(finalList.end(), tmpList.begin(), tmpList.end());
-    tmpList = getOps()->getNotifyableList(
-        shared_from_this(),
-        CLString::REGISTERED_QUEUE_NAME,
-        getQueueNames(),
-        LOAD_FROM_REPOSITORY);
-    finalList.insert(finalList.end(), tmpList.begin(), tmpList.end());
-    
-    tmpList = getChildrenNotifyables();
-    finalList.insert(finalList.end(), tmpList.begin(), tmpList.end());
+    vector<string> registeredNameVec = getAllChildrenRegisteredNames();
+    vector<string>::const_iterator registeredNameVecIt;
+    for (registeredNameVecIt = registeredNameVec.begin();
+         registeredNameVecIt != registeredNameVec.end();
+         ++registeredNameVecIt) {
+        string childrenKey;
+        CachedObjectChangeHandlers::CachedObjectChange change;
+        getChildrenKeyAndChange(
+            getKey(), *registeredNameVecIt, &childrenKey, &change);
+        tmpList = getOps()->getNotifyableList(
+            shared_from_this(),
+            *registeredNameVecIt,
+            getOps()->getChildrenNames(childrenKey, change),
+            LOAD_FROM_REPOSITORY);
+        finalList.insert(finalList.end(), tmpList.begin(), tmpList.end());
+    }
 
     return finalList;
 }
@@ -318,6 +667,14 @@ NotifyableImpl::getNotifyableFromKey(const string &key)
     return notifyableSP;
 }
 
+NotifyableList
+NotifyableImpl::getCachedNotifyablesFromKeyPrefix(const string &keyPrefix)
+{
+    TRACE(CL_LOG, "getCachedNotifyablesFromKeyPrefix");
+
+    return getOps()->getCachedNotifyablesFromKeyPrefix(keyPrefix);
+}
+
 Notifyable::State
 NotifyableImpl::getState() const
 {
@@ -80,7 +80,11 @@ class NotifyableImpl
 
     virtual boost::shared_ptr<Notifyable> getMyParent() const;
     
-    virtual NotifyableList getMyChildren();
+    virtual NotifyableList getMyChildren(
+        AccessType accessType = LOAD_FROM_REPOSITORY);
+
+    virtual boost::shared_ptr<AsyncResult<NotifyableList> > 
+    getMyChildrenAsync(AsyncResultCallback *callback = NULL);
 
     virtual bool getMyApplicationWaitMsecs(
         int64_t msecTimeout,
@@ -102,6 +106,9 @@ class NotifyableImpl
     virtual boost::shared_ptr<Notifyable> getNotifyableFromKey(
         const std::string &key);
 
+    virtual NotifyableList getCachedNotifyablesFromKeyPrefix(
+        const std::string &keyPrefix);
+
     virtual Notifyable::State getState() const;
     
     virtual NameList getPropertyListNames();
@@ -191,15 +198,25 @@ class NotifyableImpl
     virtual ~NotifyableImpl() {}
 
     /**
-     * Get the children notifyables specific to this subclassed
-     * NotifyableImpl.  The children of NotifyableImpl (i.e. Queue and
-     * PropertyList) are not included here.  This is a snapshot and
-     * could change.
+     * Get the registered names of the types of children specific to
+     * this subclassed NotifyableImpl (i.e.
+     * CLString::REGISTERED_NODE_NAME).  The children of
+     * NotifyableImpl (i.e. Queue and PropertyList) are not included
+     * here.
+     *
+     * @return The registered names in the order the children are
+     *         listed by getMyChildren()
+     */
+    virtual std::vector<std::string> getChildrenRegisteredNames() = 0;
+
+    /**
+     * Get the registered names of the types of all the children of
+     * this NotifyableImpl, the NotifyableImpl ones first.
      *
-     * @return A list of Notifyable * that are children specific to 
-     *         this Notifyable
+     * @return The registered names in the order the children are
+     *         listed by getMyChildren()
      */
-    virtual NotifyableList getChildrenNotifyables() = 0;
+    std::vector<std::string> getAllChildrenRegisteredNames();
 
     /**
      * Calls the local initializeCachedRepresentation() and also
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ *
+ * $Id$
+ */
+
+#include "clusterlibinternal.h"
+#include "notifyablekeytrie.h"
+
+using namespace std;
+using namespace boost;
+
+namespace clusterlib {
+
+NotifyableKeyTrie::Node::~Node()
+{
+    map<string, Node *>::iterator childrenIt;
+    for (childrenIt = m_children.begin();
+         childrenIt != m_children.end();
+         ++childrenIt) {
+        delete childrenIt->second;
+    }
+}
+
+NotifyableKeyTrie::NotifyableKeyTrie()
+    : m_root(NULL, "")
+{
+}
+
+void
+NotifyableKeyTrie::insert(const shared_ptr<NotifyableImpl> &notifyableSP)
+{
+    TRACE(CL_LOG, "insert");
+
+    vector<string> components;
+    split(components, notifyableSP->getKey(),
+          is_any_of(CLString::KEY_SEPARATOR));
+
+    Node *node = &m_root;
+    vector<string>::const_iterator componentsIt;
+    for (componentsIt = components.begin();
+         componentsIt != components.end();
+         ++componentsIt) {
+        map<string, Node *>::iterator childrenIt =
+            node->m_children.find(*componentsIt);
+        if (childrenIt == node->m_children.end()) {
+            childrenIt = node->m_children.insert(
+                make_pair(*componentsIt, new Node(node, *componentsIt))).first;
+        }
+        node = childrenIt->second;
+    }
+    node->m_notifyableSP = notifyableSP;
+}
+
+bool
+NotifyableKeyTrie::erase(const string &notifyableKey)
+{
+    TRACE(CL_LOG, "erase");
+
+    vector<string> components;
+    split(components, notifyableKey, is_any_of(CLString::KEY_SEPARATOR));
+    Node *node = const_cast<Node *>(findNode(components, components.size()));
+    if ((node == NULL) || (node->m_notifyableSP == NULL)) {
+        return false;
+    }
+    node->m_notifyableSP.reset();
+
+    /* Prune the nodes that no longer lead to a notifyable. */
+    while ((node != &m_root) &&
+           (node->m_notifyableSP == NULL) &&
+           node->m_children.empty()) {
+        Node *parent = node->mp_parent;
+        parent->m_children.erase(node->m_component);
+        delete node;
+        node = parent;
+    }
+    return true;
+}
+
+NotifyableList
+NotifyableKeyTrie::getChildren(const string &notifyableKey) const
+{
+    TRACE(CL_LOG, "getChildren");
+
+    NotifyableList notifyableList;
+    vector<string> components;
+    split(components, notifyableKey, is_any_of(CLString::KEY_SEPARATOR));
+    const Node *node = findNode(components, components.size());
+    if (node == NULL) {
+        return notifyableList;
+    }
+
+    /*
+     * The children are under their type (i.e. key/_groups/name), so
+     * they are two components down.
+     */
+    map<string, Node *>::const_iterator typeIt;
+    map<string, Node *>::const_iterator childIt;
+    for (typeIt = node->m_children.begin();
+         typeIt != node->m_children.end();
+         ++typeIt) {
+        for (childIt = typeIt->second->m_children.begin();
+             childIt != typeIt->second->m_children.end();
+             ++childIt) {
+            if (childIt->second->m_notifyableSP != NULL) {
+                notifyableList.push_back(childIt->second->m_notifyableSP);
+            }
+        }
+    }
+    return notifyableList;
+}
+
+NotifyableList
+NotifyableKeyTrie::getFromKeyPrefix(const string &keyPrefix) const
+{
+    TRACE(CL_LOG, "getFromKeyPrefix");
+
+    NotifyableList notifyableList;
+    vector<string> components;
+    split(components, keyPrefix, is_any_of(CLString::KEY_SEPARATOR));
+
+    /* The last component may only be the start of a component. */
+    const Node *node = findNode(components, components.size() - 1);
+    if (node == NULL) {
+        return notifyableList;
+    }
+    const string &partial = components.back();
+    map<string, Node *>::const_iterator childrenIt;
+    for (childrenIt = node->m_children.lower_bound(partial);
+         (childrenIt != node->m_children.end()) &&
+             (childrenIt->first.compare(0, partial.size(), partial) == 0);
+         ++childrenIt) {
+        appendSubtree(childrenIt->second, notifyableList);
+    }
+    return notifyableList;
+}
+
+void
+NotifyableKeyTrie::clear()
+{
+    TRACE(CL_LOG, "clear");
+
+    map<string, Node *>::iterator childrenIt;
+    for (childrenIt = m_root.m_children.begin();
+         childrenIt != m_root.m_children.end();
+         ++childrenIt) {
+        delete childrenIt->second;
+    }
+    m_root.m_children.clear();
+    m_root.m_notifyableSP.reset();
+}
+
+const Mutex &
+NotifyableKeyTrie::getLock() const
+{
+    return m_rootLock;
+}
+
+NotifyableKeyTrie::~NotifyableKeyTrie()
+{
+}
+
+const NotifyableKeyTrie::Node *
+NotifyableKeyTrie::findNode(const vector<string> &components,
+                            size_t elements) const
+{
+    const Node *node = &m_root;
+    for (size_t i = 0; i < elements; ++i) {
+        map<string, Node *>::const_iterator childrenIt =
+            node->m_children.find(components[i]);
+        if (childrenIt == node->m_children.end()) {
+            return NULL;
+        }
+        node = childrenIt->second;
+    }
+    return node;
+}
+
+void
+NotifyableKeyTrie::appendSubtree(const Node *node,
+                                 NotifyableList &notifyableList)
+{
+    if (node->m_notifyableSP != NULL) {
+        notifyableList.push_back(node->m_notifyableSP);
+    }
+    map<string, Node *>::const_iterator childrenIt;
+    for (childrenIt = node->m_children.begin();
+         childrenIt != node->m_children.end();
+         ++childrenIt) {
+        appendSubtree(childrenIt->second, notifyableList);
+    }
+}
+
+}	/* End of 'namespace clusterlib' */
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ *
+ * $Id$
+ */
+
+#ifndef	_CL_NOTIFYABLEKEYTRIE_H_
+#define	_CL_NOTIFYABLEKEYTRIE_H_
+
+namespace clusterlib {
+
+/**
+ * Index of the cached notifyables of every type by the components of
+ * their keys, so that the cached notifyables under a key or with a
+ * key prefix are found without going to the repository, in time
+ * proportional to the length of the key and the number of results.
+ */
+class NotifyableKeyTrie
+{
+  public:
+    /**
+     * Constructor.
+     */
+    NotifyableKeyTrie();
+
+    /**
+     * Index the notifyable by its key (thread-safe if holding the
+     * mutex).
+     *
+     * @param notifyableSP Pointer to the notifyable to insert
+     */
+    void insert(const boost::shared_ptr<NotifyableImpl> &notifyableSP);
+
+    /**
+     * Remove the notifyable from the index (thread-safe if holding
+     * the mutex).
+     *
+     * @param notifyableKey the key of the notifyable
+     * @return true if the notifyable was indexed, false otherwise
+     */
+    bool erase(const std::string &notifyableKey);
+
+    /**
+     * Get the indexed notifyables that are children of a notifyable
+     * (thread-safe if holding the mutex).
+     *
+     * @param notifyableKey the key of the parent notifyable
+     * @return the children
+     */
+    NotifyableList getChildren(const std::string &notifyableKey) const;
+
+    /**
+     * Get the indexed notifyables with keys that start with a prefix
+     * (thread-safe if holding the mutex).  A notifyable key followed
+     * by the key separator gets all the notifyables under it.
+     *
+     * @param keyPrefix the prefix of the keys
+     * @return the notifyables, each before the ones under it
+     */
+    NotifyableList getFromKeyPrefix(const std::string &keyPrefix) const;
+
+    /**
+     * Remove every notifyable from the index (thread-safe if holding
+     * the mutex).
+     */
+    void clear();
+
+    /**
+     * Get the lock that protects this object.
+     *
+     * @return a reference to the mutex
+     */
+    const Mutex &getLock() const;
+
+    /**
+     * Destructor.
+     */
+    ~NotifyableKeyTrie();
+
+  private:
+    /**
+     * No copy constructor.
+     */
+    NotifyableKeyTrie(const NotifyableKeyTrie &other);
+
+    /**
+     * No assignment.
+     */
+    NotifyableKeyTrie & operator=(const NotifyableKeyTrie &other);
+
+    /**
+     * A key component.
+     */
+    struct Node
+    {
+        Node(Node *parent, const std::string &component)
+            : mp_parent(parent),
+              m_component(component) {}
+
+        ~Node();
+
+        /**
+         * The node of the previous key component, NULL for the root.
+         */
+        Node *mp_parent;
+
+        /**
+         * The key component.
+         */
+        std::string m_component;
+
+        /**
+         * The notifyable with the key up to this component, if any.
+         */
+        boost::shared_ptr<NotifyableImpl> m_notifyableSP;
+
+        /**
+         * The nodes of the next key components.
+         */
+        std::map<std::string, Node *> m_children;
+    };
+
+    /**
+     * Find the node of a key.
+     *
+     * @param components the components of the key
+     * @param elements the number of components to look up
+     * @return the node or NULL if no indexed key goes through it
+     */
+    const Node *findNode(const std::vector<std::string> &components,
+                         size_t elements) const;
+
+    /**
+     * Append the notifyables of a node and all the nodes under it,
+     * each before the ones under it.
+     *
+     * @param node the node to start from
+     * @param notifyableList the list to append to
+     */
+    static void appendSubtree(const Node *node,
+                              NotifyableList &notifyableList);
+
+  private:
+    /**
+     * The node before the first key component.
+     */
+    Node m_root;
+
+    /**
+     * Lock that protects m_root.
+     */
+    Mutex m_rootLock;
+};
+
+}	/* End of 'namespace clusterlib' */
+
+#endif	/* !_CL_NOTIFYABLEKEYTRIE_H_ */
@@ -200,14 +200,10 @@ ProcessSlotImpl::stopLocal(pid_t pid, int32_t signal)
     }
 }
 
-NotifyableList
-ProcessSlotImpl::getChildrenNotifyables()
+vector<string>
+ProcessSlotImpl::getChildrenRegisteredNames()
 {
-    TRACE(CL_LOG, "getChildrenNotifyables");
-
-    throwIfRemoved();
-    
-    return NotifyableList();
+    return vector<string>();
 }
  
 void
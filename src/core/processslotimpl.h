@@ -90,7 +90,7 @@ class ProcessSlotImpl
      */
     virtual ~ProcessSlotImpl();
 
-    virtual NotifyableList getChildrenNotifyables();
+    virtual std::vector<std::string> getChildrenRegisteredNames();
 
     virtual void initializeCachedRepresentation();
 
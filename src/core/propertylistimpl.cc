@@ -48,14 +48,10 @@ PropertyListImpl::PropertyListImpl(FactoryOps *fp,
 {
 }
 
-NotifyableList
-PropertyListImpl::getChildrenNotifyables()
+vector<string>
+PropertyListImpl::getChildrenRegisteredNames()
 {
-    TRACE(CL_LOG, "getChildrenNotifyables");
-
-    throwIfRemoved();
-    
-    return NotifyableList();
+    return vector<string>();
 }
 
 void 
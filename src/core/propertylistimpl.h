@@ -46,7 +46,7 @@ class PropertyListImpl
                      const std::string &name,
                      const boost::shared_ptr<NotifyableImpl> &parent);
 
-    virtual NotifyableList getChildrenNotifyables();
+    virtual std::vector<std::string> getChildrenRegisteredNames();
     
     virtual void initializeCachedRepresentation();
 
@@ -29,7 +29,8 @@ QueueImpl::QueueImpl(FactoryOps *fp,
                      const string &name,
                      const shared_ptr<NotifyableImpl> &parent)
     : NotifyableImpl(fp, key, name, parent), 
-      m_queueParentKey(NotifyableKeyManipulator::createQueueParentKey(key))
+      m_queueParentKey(NotifyableKeyManipulator::createQueueParentKey(key)),
+      m_pooledPutPending(0)
 {
     TRACE(CL_LOG, "QueueImpl");
 }
@@ -44,7 +45,17 @@ QueueImpl::put(const string &element)
 
     int64_t myBid = -1;
     string createdPath;
-    SAFE_CALL_ZK((myBid = getOps()->getRepository()->createSequence(
+    /*
+     * Adding an element does not depend on the watches of this
+     * process, so any pooled session can be used.  The reads of this
+     * process then sync the primary session (see
+     * getReadRepository()).
+     */
+    zk::Repository *repository = getOps()->getPooledRepository();
+    if (repository != getOps()->getRepository()) {
+        __sync_lock_test_and_set(&m_pooledPutPending, 1);
+    }
+    SAFE_CALL_ZK((myBid = repository->createSequence(
                       queuePrefix,
                       element,
                       0, 
@@ -216,7 +227,8 @@ QueueImpl::front(string &element)
 
     NameList childList;
     bool found = false;
-    SAFE_CALL_ZK(getOps()->getRepository()->getNodeChildren(
+    zk::Repository *repository = getReadRepository();
+    SAFE_CALL_ZK(repository->getNodeChildren(
                      getQueueParentKey(),
                      childList),
                  "Getting children for node %s failed: %s",
@@ -224,7 +236,7 @@ QueueImpl::front(string &element)
                  false,
                  true);
     if (childList.size() > 0) {
-        SAFE_CALL_ZK((found = getOps()->getRepository()->getNodeData(
+        SAFE_CALL_ZK((found = repository->getNodeData(
                           childList.front(),
                           element)),
                      "Getting the front %s failed: %s",
@@ -244,7 +256,7 @@ QueueImpl::size()
     TRACE(CL_LOG, "size");
     
     NameList childList;
-    SAFE_CALL_ZK(getOps()->getRepository()->getNodeChildren(
+    SAFE_CALL_ZK(getReadRepository()->getNodeChildren(
                      getQueueParentKey(),
                      childList),
                  "Getting children for node %s failed: %s",
@@ -340,7 +352,8 @@ QueueImpl::getAllElements()
     map<int64_t, string> idElementMap;
     map<int64_t, string>::iterator idElementMapIt;
     NameList childList;
-    SAFE_CALL_ZK(getOps()->getRepository()->getNodeChildren(
+    zk::Repository *repository = getReadRepository();
+    SAFE_CALL_ZK(repository->getNodeChildren(
                      getQueueParentKey(),
                      childList),
                  "Getting children for node %s failed: %s",
@@ -358,7 +371,7 @@ QueueImpl::getAllElements()
                                                 NULL,
                                                 &sequenceNumber);
 
-        SAFE_CALL_ZK((found = getOps()->getRepository()->getNodeData(
+        SAFE_CALL_ZK((found = repository->getNodeData(
                           *childListIt,
                           element)),
                      "Getting the element %s failed: %s",
@@ -380,14 +393,10 @@ QueueImpl::getAllElements()
     return idElementMap;
 }
 
-NotifyableList
-QueueImpl::getChildrenNotifyables()
+vector<string>
+QueueImpl::getChildrenRegisteredNames()
 {
-    TRACE(CL_LOG, "getChildrenNotifyables");
-
-    throwIfRemoved();
-    
-    return NotifyableList();
+    return vector<string>();
 }
 
 void
@@ -428,4 +437,25 @@ QueueImpl::establishQueueWatch()
         true);
 }
 
+zk::Repository *
+QueueImpl::getReadRepository()
+{
+    TRACE(CL_LOG, "getReadRepository");
+
+    /*
+     * ZK only orders the operations of one session, so the primary
+     * session may not have seen an element put() added on another one
+     * yet.
+     */
+    zk::Repository *repository = getOps()->getRepository();
+    if (__sync_lock_test_and_set(&m_pooledPutPending, 0) != 0) {
+        SAFE_CALL_ZK(repository->sync(getQueueParentKey(), NULL, NULL),
+                     "Syncing %s failed: %s",
+                     getQueueParentKey().c_str(),
+                     false,
+                     true);
+    }
+    return repository;
+}
+
 }       /* End of 'namespace clusterlib' */
@@ -59,7 +59,7 @@ class QueueImpl
      */
     virtual ~QueueImpl();
 
-    virtual NotifyableList getChildrenNotifyables();
+    virtual std::vector<std::string> getChildrenRegisteredNames();
 
     virtual void initializeCachedRepresentation();
 
@@ -81,10 +81,26 @@ class QueueImpl
      */
     const std::string &getQueueParentKey() { return m_queueParentKey; }
 
+    /**
+     * Get the session to read the elements from: the primary one,
+     * which also takes the elements.  If put() added an element on
+     * another session, the primary session is synced first so the
+     * read sees it.
+     *
+     * @return the primary repository session
+     */
+    zk::Repository *getReadRepository();
+
     /**
      * Key for the queue parent
      */
     std::string m_queueParentKey;
+
+    /**
+     * 1 if put() added an element on a session other than the
+     * primary one since the last read, 0 otherwise.
+     */
+    int32_t m_pooledPutPending;
 };
 
 }	/* End of 'namespace clusterlib' */
@@ -64,6 +64,24 @@ class RegisteredNotifyable
         const std::string &notifyableKey,
         const boost::shared_ptr<NotifyableImpl> &parentSP) = 0;
 
+    /**
+     * Same as loadNotifyableFromRepository() for several notifyables
+     * with the same parent, with the repository requests of all of
+     * them overlapped.
+     *
+     * @param notifyableNameVec the names of the notifyables to load
+     * @param notifyableKeyVec the keys of the notifyables to load (same
+     *        order as notifyableNameVec)
+     * @param parentSP the parent of the new notifyables
+     * @return pointers to the new notifyables (same order as
+     *         notifyableNameVec), NULL for the ones that couldn't be found
+     */
+    virtual std::vector<boost::shared_ptr<NotifyableImpl> >
+    loadNotifyablesFromRepository(
+        const std::vector<std::string> &notifyableNameVec,
+        const std::vector<std::string> &notifyableKeyVec,
+        const boost::shared_ptr<NotifyableImpl> &parentSP) = 0;
+
     /**
      * Creates the necessary zknodes in the repository.  This is part
      * of creating notifyable object.
@@ -46,40 +46,148 @@ RegisteredNotifyableImpl::loadNotifyableFromRepository(
 {
     TRACE(CL_LOG, "loadNotifyableFromRepository");
 
-    vector<string> zknodeVec = 
-        generateRepositoryList(notifyableName, notifyableKey);
-    /* Add some zknodes that are part of every notifyable */
-    zknodeVec.push_back(
-        NotifyableImpl::createStateJSONArrayKey(
-           notifyableKey, CachedStateImpl::CURRENT_STATE));
-    zknodeVec.push_back(
-        NotifyableImpl::createStateJSONArrayKey(
-           notifyableKey, CachedStateImpl::DESIRED_STATE));
+    return loadNotifyablesFromRepository(
+        vector<string>(1, notifyableName),
+        vector<string>(1, notifyableKey),
+        parent).front();
+}
 
-    bool exists = false;
-    vector<string>::const_iterator zknodeVecIt;
-    for (zknodeVecIt = zknodeVec.begin(); 
-         zknodeVecIt != zknodeVec.end();
-         ++zknodeVecIt) {
-        SAFE_CALLBACK_ZK(
-            (exists = getOps()->getRepository()->nodeExists(
-                *zknodeVecIt,
-                getOps()->getZooKeeperEventAdapter(),
-                getOps()->getCachedObjectChangeHandlers()->
-                getChangeHandler(
-                    CachedObjectChangeHandlers::NOTIFYABLE_REMOVED_CHANGE))),
-            (exists = getOps()->getRepository()->nodeExists(*zknodeVecIt)),
-            CachedObjectChangeHandlers::NOTIFYABLE_REMOVED_CHANGE,
-            *zknodeVecIt,
-            "Checking existence and establishing watch on value %s failed: %s",
-            zknodeVecIt->c_str(),
-            false,
-            true);
-        if (!exists) {
-            return shared_ptr<NotifyableImpl>();
+vector<shared_ptr<NotifyableImpl> >
+RegisteredNotifyableImpl::loadNotifyablesFromRepository(
+    const vector<string> &notifyableNameVec,
+    const vector<string> &notifyableKeyVec,
+    const shared_ptr<NotifyableImpl> &parent)
+{
+    TRACE(CL_LOG, "loadNotifyablesFromRepository");
+
+    vector<vector<string> > zknodeVecVec;
+    for (size_t i = 0; i < notifyableNameVec.size(); ++i) {
+        zknodeVecVec.push_back(
+            generateRepositoryList(notifyableNameVec[i], 
+                                   notifyableKeyVec[i]));
+        /* Add some zknodes that are part of every notifyable */
+        zknodeVecVec.back().push_back(
+            NotifyableImpl::createStateJSONArrayKey(
+                notifyableKeyVec[i], CachedStateImpl::CURRENT_STATE));
+        zknodeVecVec.back().push_back(
+            NotifyableImpl::createStateJSONArrayKey(
+                notifyableKeyVec[i], CachedStateImpl::DESIRED_STATE));
+    }
+
+    vector<bool> existsVec(notifyableNameVec.size(), false);
+    SAFE_CALL_ZK(repositoryObjectsExist(zknodeVecVec, &existsVec),
+                 "Checking existence and establishing watches on %s "
+                 "failed: %s",
+                 notifyableKeyVec.front().c_str(),
+                 false,
+                 true);
+
+    vector<shared_ptr<NotifyableImpl> > notifyableVec;
+    for (size_t i = 0; i < notifyableNameVec.size(); ++i) {
+        if (existsVec[i]) {
+            notifyableVec.push_back(createNotifyable(notifyableNameVec[i], 
+                                                     notifyableKeyVec[i], 
+                                                     parent, 
+                                                     *getOps()));
+        }
+        else {
+            notifyableVec.push_back(shared_ptr<NotifyableImpl>());
         }
     }
-    return createNotifyable(notifyableName, notifyableKey, parent, *getOps());
+    return notifyableVec;
+}
+
+void
+RegisteredNotifyableImpl::repositoryObjectsExist(
+    const vector<vector<string> > &zknodeVecVec,
+    vector<bool> *pExistsVec)
+{
+    TRACE(CL_LOG, "repositoryObjectsExist");
+
+    CachedObjectChangeHandlers *changeHandlers = 
+        getOps()->getCachedObjectChangeHandlers();
+
+    /*
+     * Claim the watches that are not outstanding while holding the
+     * handler lock, but do not hold it while waiting on the
+     * repository.  The claims of the watches that could not be
+     * established are given back.
+     */
+    vector<string> zknodeVec;
+    vector<size_t> ownerVec;
+    vector<bool> watchVec;
+    {
+        Locker l(changeHandlers->getLock());
+        for (size_t i = 0; i < zknodeVecVec.size(); ++i) {
+            vector<string>::const_iterator zknodeVecIt;
+            for (zknodeVecIt = zknodeVecVec[i].begin(); 
+                 zknodeVecIt != zknodeVecVec[i].end();
+                 ++zknodeVecIt) {
+                bool ready = changeHandlers->isHandlerCallbackReady(
+                    CachedObjectChangeHandlers::NOTIFYABLE_REMOVED_CHANGE,
+                    *zknodeVecIt);
+                if (ready == false) {
+                    changeHandlers->setHandlerCallbackReady(
+                        CachedObjectChangeHandlers::NOTIFYABLE_REMOVED_CHANGE,
+                        *zknodeVecIt);
+                }
+                zknodeVec.push_back(*zknodeVecIt);
+                ownerVec.push_back(i);
+                watchVec.push_back(!ready);
+            }
+        }
+    }
+
+    /* Issue every existence check before waiting on any of them. */
+    vector<zk::AsyncOperationSP> operationVec;
+    vector<bool> establishedVec(zknodeVec.size(), false);
+    vector<bool> existsVec(zknodeVecVec.size(), true);
+    try {
+        for (size_t i = 0; i < zknodeVec.size(); ++i) {
+            if (watchVec[i]) {
+                operationVec.push_back(
+                    getOps()->getRepository()->nodeExistsAsync(
+                        zknodeVec[i],
+                        getOps()->getZooKeeperEventAdapter(),
+                        changeHandlers->getChangeHandler(
+                            CachedObjectChangeHandlers::
+                            NOTIFYABLE_REMOVED_CHANGE)));
+            }
+            else {
+                operationVec.push_back(
+                    getOps()->getRepository()->nodeExistsAsync(
+                        zknodeVec[i]));
+            }
+        }
+        for (size_t i = 0; i < operationVec.size(); ++i) {
+            int32_t rc = getOps()->getRepository()->waitAsync(
+                operationVec[i], ZNONODE);
+            establishedVec[i] = true;
+            if (rc == ZNONODE) {
+                existsVec[ownerVec[i]] = false;
+            }
+        }
+        pExistsVec->swap(existsVec);
+    }
+    catch (zk::ZooKeeperException &) {
+        /* A watch is set by any issued check that completed. */
+        for (size_t i = 0; i < operationVec.size(); ++i) {
+            if (watchVec[i] && !establishedVec[i]) {
+                operationVec[i]->waitUsecs(-1);
+                establishedVec[i] = ((operationVec[i]->getRc() == ZOK) ||
+                                     (operationVec[i]->getRc() == ZNONODE));
+            }
+        }
+        Locker l(changeHandlers->getLock());
+        for (size_t i = 0; i < zknodeVec.size(); ++i) {
+            if (watchVec[i] && !establishedVec[i]) {
+                changeHandlers->unsetHandlerCallbackReady(
+                    CachedObjectChangeHandlers::NOTIFYABLE_REMOVED_CHANGE,
+                    zknodeVec[i]);
+            }
+        }
+        throw;
+    }
 }
 
 void
@@ -98,7 +206,33 @@ RegisteredNotifyableImpl::createRepositoryObjects(const string &notifyableName,
         NotifyableImpl::createStateJSONArrayKey(
            notifyableKey, CachedStateImpl::DESIRED_STATE));
 
+    /*
+     * Try to create all the zknodes in a single transaction.  The
+     * notifyable key comes first so its children can be created in
+     * the same transaction.
+     */
+    vector<zk::MultiOperation> operationVec;
     vector<string>::const_iterator zknodeVecIt;
+    for (zknodeVecIt = zknodeVec.begin(); 
+         zknodeVecIt != zknodeVec.end();
+         ++zknodeVecIt) {
+        operationVec.push_back(zk::MultiOperation::createNode(*zknodeVecIt));
+    }
+    bool created = false;
+    SAFE_CALL_ZK((created = getOps()->getRepository()->multi(operationVec)),
+                 "Could not create keys for %s in one transaction: %s",
+                 notifyableKey.c_str(),
+                 true,
+                 true);
+    if (created) {
+        return;
+    }
+
+    /*
+     * Some of the zknodes already exist (i.e. a partially created
+     * notifyable) or ancestors are missing, so fall back to creating
+     * them one at a time.
+     */
     for (zknodeVecIt = zknodeVec.begin(); 
          zknodeVecIt != zknodeVec.end();
          ++zknodeVecIt) {
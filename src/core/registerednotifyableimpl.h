@@ -36,6 +36,12 @@ class RegisteredNotifyableImpl
         const std::string &notifyableKey,
         const boost::shared_ptr<NotifyableImpl> &parentSP);
 
+    virtual std::vector<boost::shared_ptr<NotifyableImpl> >
+    loadNotifyablesFromRepository(
+        const std::vector<std::string> &notifyableNameVec,
+        const std::vector<std::string> &notifyableKeyVec,
+        const boost::shared_ptr<NotifyableImpl> &parentSP);
+
     virtual void createRepositoryObjects(const std::string &notifyableName,
                                          const std::string &notifyableKey);
 
@@ -114,6 +120,19 @@ class RegisteredNotifyableImpl
     FactoryOps *getOps() { return mp_f; }
 
   private:
+    /**
+     * Check the existence of all the zknodes of several notifyables
+     * and establish the NOTIFYABLE_REMOVED_CHANGE watches on them.
+     * The checks are issued together so their round trips overlap.
+     *
+     * @param zknodeVecVec the zknodes to check for each notifyable
+     * @param pExistsVec returns, for each notifyable, true if all its
+     *        zknodes exist
+     */
+    void repositoryObjectsExist(
+        const std::vector<std::vector<std::string> > &zknodeVecVec,
+        std::vector<bool> *pExistsVec);
+
     /**
      * Get the read-write lock that makes this object thread-safe.
      *
@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ *
+ * $Id$
+ */
+
+#include "clusterlibinternal.h"
+
+using namespace std;
+
+namespace clusterlib {
+
+string
+RepositoryStats::getOperationName(Operation operation)
+{
+    switch (operation) {
+        case GET_DATA: return "getData";
+        case GET_CHILDREN: return "getChildren";
+        case EXISTS: return "exists";
+        case CREATE: return "create";
+        case SET_DATA: return "setData";
+        case DELETE: return "delete";
+        case SYNC: return "sync";
+        case MULTI: return "multi";
+        default:
+            ostringstream oss;
+            oss << "unknown(" << operation << ")";
+            return oss.str();
+    }
+}
+
+int64_t
+RepositoryStats::getLatencyBucketMaxUsecs(int32_t bucket)
+{
+    if ((bucket < 0) || (bucket >= LATENCY_BUCKET_COUNT)) {
+        ostringstream oss;
+        oss << "getLatencyBucketMaxUsecs: Invalid bucket " << bucket;
+        throw InvalidArgumentsException(oss.str());
+    }
+    if (bucket == LATENCY_BUCKET_COUNT - 1) {
+        return -1;
+    }
+    return (1LL << bucket) - 1;
+}
+
+int32_t
+RepositoryStats::getLatencyBucket(int64_t usecs)
+{
+    if (usecs <= 0) {
+        return 0;
+    }
+
+    /* The number of significant bits of usecs */
+    int32_t bucket = 64 - __builtin_clzll(static_cast<uint64_t>(usecs));
+    if (bucket >= LATENCY_BUCKET_COUNT) {
+        return LATENCY_BUCKET_COUNT - 1;
+    }
+    return bucket;
+}
+
+RepositoryStats::RepositoryStats()
+    : m_retryCount(0),
+      m_bytesRead(0),
+      m_bytesDecoded(0),
+      m_decodeErrorCount(0),
+      m_bytesWritten(0),
+      m_watchCount(0)
+{
+    memset(m_count, 0, sizeof(m_count));
+    memset(m_errorCount, 0, sizeof(m_errorCount));
+    memset(m_totalUsecs, 0, sizeof(m_totalUsecs));
+    memset(m_maxUsecs, 0, sizeof(m_maxUsecs));
+    memset(m_latencyBucketCount, 0, sizeof(m_latencyBucketCount));
+}
+
+int64_t
+RepositoryStats::getCount(Operation operation) const
+{
+    checkOperation(operation);
+    return m_count[operation];
+}
+
+int64_t
+RepositoryStats::getErrorCount(Operation operation) const
+{
+    checkOperation(operation);
+    return m_errorCount[operation];
+}
+
+int64_t
+RepositoryStats::getTotalUsecs(Operation operation) const
+{
+    checkOperation(operation);
+    return m_totalUsecs[operation];
+}
+
+int64_t
+RepositoryStats::getMaxUsecs(Operation operation) const
+{
+    checkOperation(operation);
+    return m_maxUsecs[operation];
+}
+
+int64_t
+RepositoryStats::getLatencyBucketCount(Operation operation,
+                                       int32_t bucket) const
+{
+    checkOperation(operation);
+    if ((bucket < 0) || (bucket >= LATENCY_BUCKET_COUNT)) {
+        ostringstream oss;
+        oss << "getLatencyBucketCount: Invalid bucket " << bucket;
+        throw InvalidArgumentsException(oss.str());
+    }
+    return m_latencyBucketCount[operation][bucket];
+}
+
+int64_t
+RepositoryStats::getPercentileUsecs(Operation operation,
+                                    double percentile) const
+{
+    checkOperation(operation);
+    if ((percentile < 0.0) || (percentile > 100.0)) {
+        ostringstream oss;
+        oss << "getPercentileUsecs: Invalid percentile " << percentile;
+        throw InvalidArgumentsException(oss.str());
+    }
+
+    int64_t count = 0;
+    for (int32_t i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+        count += m_latencyBucketCount[operation][i];
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    int64_t rank = static_cast<int64_t>(count * percentile / 100.0);
+    if (rank < 1) {
+        rank = 1;
+    }
+    int64_t seen = 0;
+    for (int32_t i = 0; i < LATENCY_BUCKET_COUNT - 1; ++i) {
+        seen += m_latencyBucketCount[operation][i];
+        if (seen >= rank) {
+            return min(getLatencyBucketMaxUsecs(i), m_maxUsecs[operation]);
+        }
+    }
+    return m_maxUsecs[operation];
+}
+
+void
+RepositoryStats::add(const RepositoryStats &other)
+{
+    for (int32_t i = 0; i < OPERATION_COUNT; ++i) {
+        m_count[i] += other.m_count[i];
+        m_errorCount[i] += other.m_errorCount[i];
+        m_totalUsecs[i] += other.m_totalUsecs[i];
+        m_maxUsecs[i] = max(m_maxUsecs[i], other.m_maxUsecs[i]);
+        for (int32_t j = 0; j < LATENCY_BUCKET_COUNT; ++j) {
+            m_latencyBucketCount[i][j] += other.m_latencyBucketCount[i][j];
+        }
+    }
+    m_retryCount += other.m_retryCount;
+    m_bytesRead += other.m_bytesRead;
+    m_bytesDecoded += other.m_bytesDecoded;
+    m_decodeErrorCount += other.m_decodeErrorCount;
+    m_bytesWritten += other.m_bytesWritten;
+    m_watchCount += other.m_watchCount;
+}
+
+string
+RepositoryStats::toString() const
+{
+    ostringstream oss;
+    for (int32_t i = 0; i < OPERATION_COUNT; ++i) {
+        if (m_count[i] == 0) {
+            continue;
+        }
+        Operation operation = static_cast<Operation>(i);
+        oss << getOperationName(operation)
+            << ": count=" << m_count[i]
+            << " errors=" << m_errorCount[i]
+            << " avg=" << (m_totalUsecs[i] / m_count[i]) << "us"
+            << " p50=" << getPercentileUsecs(operation, 50.0) << "us"
+            << " p99=" << getPercentileUsecs(operation, 99.0) << "us"
+            << " max=" << m_maxUsecs[i] << "us\n";
+    }
+    oss << "retries=" << m_retryCount
+        << " bytesRead=" << m_bytesRead
+        << " bytesDecoded=" << m_bytesDecoded
+        << " decodeErrors=" << m_decodeErrorCount
+        << " bytesWritten=" << m_bytesWritten
+        << " watches=" << m_watchCount;
+    return oss.str();
+}
+
+void
+RepositoryStats::checkOperation(Operation operation)
+{
+    if ((operation < 0) || (operation >= OPERATION_COUNT)) {
+        ostringstream oss;
+        oss << "checkOperation: Invalid operation " << operation;
+        throw InvalidArgumentsException(oss.str());
+    }
+}
+
+}	/* End of 'namespace clusterlib' */
+
+namespace zk {
+
+/**
+ * Atomically read a counter that other threads may be updating.
+ */
+static inline int64_t
+loadCounter(const int64_t &counter)
+{
+    return __sync_fetch_and_add(const_cast<int64_t *>(&counter), 0);
+}
+
+void
+RepositoryStatsRecorder::recordOperation(
+    clusterlib::RepositoryStats::Operation operation,
+    int64_t usecs,
+    int32_t rc)
+{
+    if (usecs < 0) {
+        usecs = 0;
+    }
+    __sync_add_and_fetch(&m_stats.m_count[operation], 1);
+    if ((rc != ZOK) && (rc > ZAPIERROR)) {
+        __sync_add_and_fetch(&m_stats.m_errorCount[operation], 1);
+    }
+    __sync_add_and_fetch(&m_stats.m_totalUsecs[operation], usecs);
+    __sync_add_and_fetch(
+        &m_stats.m_latencyBucketCount[operation][
+            clusterlib::RepositoryStats::getLatencyBucket(usecs)],
+        1);
+
+    int64_t maxUsecs = m_stats.m_maxUsecs[operation];
+    while (usecs > maxUsecs) {
+        int64_t oldMaxUsecs = __sync_val_compare_and_swap(
+            &m_stats.m_maxUsecs[operation], maxUsecs, usecs);
+        if (oldMaxUsecs == maxUsecs) {
+            break;
+        }
+        maxUsecs = oldMaxUsecs;
+    }
+}
+
+void
+RepositoryStatsRecorder::getStats(clusterlib::RepositoryStats &stats) const
+{
+    for (int32_t i = 0; i < clusterlib::RepositoryStats::OPERATION_COUNT;
+         ++i) {
+        stats.m_count[i] = loadCounter(m_stats.m_count[i]);
+        stats.m_errorCount[i] = loadCounter(m_stats.m_errorCount[i]);
+        stats.m_totalUsecs[i] = loadCounter(m_stats.m_totalUsecs[i]);
+        stats.m_maxUsecs[i] = loadCounter(m_stats.m_maxUsecs[i]);
+        for (int32_t j = 0;
+             j < clusterlib::RepositoryStats::LATENCY_BUCKET_COUNT;
+             ++j) {
+            stats.m_latencyBucketCount[i][j] =
+                loadCounter(m_stats.m_latencyBucketCount[i][j]);
+        }
+    }
+    stats.m_retryCount = loadCounter(m_stats.m_retryCount);
+    stats.m_bytesRead = loadCounter(m_stats.m_bytesRead);
+    stats.m_bytesDecoded = loadCounter(m_stats.m_bytesDecoded);
+    stats.m_decodeErrorCount = loadCounter(m_stats.m_decodeErrorCount);
+    stats.m_bytesWritten = loadCounter(m_stats.m_bytesWritten);
+    stats.m_watchCount = loadCounter(m_stats.m_watchCount);
+}
+
+void
+RepositoryStatsRecorder::reset()
+{
+    for (int32_t i = 0; i < clusterlib::RepositoryStats::OPERATION_COUNT;
+         ++i) {
+        __sync_lock_test_and_set(&m_stats.m_count[i], 0);
+        __sync_lock_test_and_set(&m_stats.m_errorCount[i], 0);
+        __sync_lock_test_and_set(&m_stats.m_totalUsecs[i], 0);
+        __sync_lock_test_and_set(&m_stats.m_maxUsecs[i], 0);
+        for (int32_t j = 0;
+             j < clusterlib::RepositoryStats::LATENCY_BUCKET_COUNT;
+             ++j) {
+            __sync_lock_test_and_set(
+                &m_stats.m_latencyBucketCount[i][j], 0);
+        }
+    }
+    __sync_lock_test_and_set(&m_stats.m_retryCount, 0);
+    __sync_lock_test_and_set(&m_stats.m_bytesRead, 0);
+    __sync_lock_test_and_set(&m_stats.m_bytesDecoded, 0);
+    __sync_lock_test_and_set(&m_stats.m_decodeErrorCount, 0);
+    __sync_lock_test_and_set(&m_stats.m_bytesWritten, 0);
+    __sync_lock_test_and_set(&m_stats.m_watchCount, 0);
+}
+
+}   /* end of 'namespace zk' */
@@ -63,18 +63,64 @@ RootImpl::getApplication(const string &name,
     return applicationSP;
 }
 
-NotifyableList
-RootImpl::getChildrenNotifyables()
+/**
+ * Gets an Application on an asynchronous operation worker.
+ */
+class GetApplicationTask
+    : public AsyncTask
 {
-    TRACE(CL_LOG, "getChildrenNotifyables");
-    
-    throwIfRemoved();
-    
-    return getOps()->getNotifyableList(
-        shared_from_this(),
-        CLString::REGISTERED_APPLICATION_NAME,
-        getApplicationNames(),
-        LOAD_FROM_REPOSITORY);
+  public:
+    GetApplicationTask(
+        const shared_ptr<Root> &rootSP,
+        const string &name,
+        AccessType accessType,
+        const shared_ptr<AsyncResult<shared_ptr<Application> > > &resultSP)
+        : m_rootSP(rootSP),
+          m_name(name),
+          m_accessType(accessType),
+          m_resultSP(resultSP) {}
+
+    virtual void run()
+    {
+        m_resultSP->setValue(m_rootSP->getApplication(m_name, m_accessType));
+    }
+
+    virtual AsyncResultBase &getResult() 
+    {
+        return *m_resultSP;
+    }
+
+  private:
+    shared_ptr<Root> m_rootSP;
+    string m_name;
+    AccessType m_accessType;
+    shared_ptr<AsyncResult<shared_ptr<Application> > > m_resultSP;
+};
+
+shared_ptr<AsyncResult<shared_ptr<Application> > >
+RootImpl::getApplicationAsync(const string &name,
+                              AccessType accessType,
+                              AsyncResultCallback *callback)
+{
+    TRACE(CL_LOG, "getApplicationAsync");
+
+    shared_ptr<AsyncResult<shared_ptr<Application> > > resultSP(
+        new AsyncResult<shared_ptr<Application> >(callback));
+    getOps()->runAsync(
+        new GetApplicationTask(
+            dynamic_pointer_cast<Root>(shared_from_this()),
+            name, 
+            accessType, 
+            resultSP));
+    return resultSP;
+}
+
+vector<string>
+RootImpl::getChildrenRegisteredNames()
+{
+    vector<string> registeredNameVec;
+    registeredNameVec.push_back(CLString::REGISTERED_APPLICATION_NAME);
+    return registeredNameVec;
 }
 
 void
@@ -38,6 +38,11 @@ class RootImpl
         const std::string &name,
         AccessType accessType);
 
+    virtual boost::shared_ptr<AsyncResult<boost::shared_ptr<Application> > >
+    getApplicationAsync(const std::string &name,
+                        AccessType accessType,
+                        AsyncResultCallback *callback = NULL);
+
     virtual boost::shared_ptr<Notifyable> getMyParent() const
     {
         throw InvalidMethodException("RootImpl does not have a parent");
@@ -88,7 +93,7 @@ class RootImpl
 
     virtual ~RootImpl() {};
 
-    virtual NotifyableList getChildrenNotifyables();
+    virtual std::vector<std::string> getChildrenRegisteredNames();
 
     virtual void initializeCachedRepresentation();
 
@@ -20,16 +20,25 @@ using namespace std;
 using namespace boost;
 
 namespace clusterlib {
+
+SafeNotifyableMap::SafeNotifyableMap()
+{
+    for (int32_t i = 0; i < CLNumericInternal::SAFE_NOTIFYABLE_MAP_SHARDS; 
+         ++i) {
+        m_shards.push_back(new Shard());
+    }
+}
     
 shared_ptr<NotifyableImpl>
 SafeNotifyableMap::getNotifyable(const string &notifyableKey)
 {
-    map<string, shared_ptr<NotifyableImpl> >::const_iterator ntpMapIt = 
-        m_ntpMap.find(notifyableKey);
+    Shard &shard = getShard(notifyableKey);
+    unordered_map<string, shared_ptr<NotifyableImpl> >::const_iterator 
+        ntpMapIt = shard.m_ntpMap.find(notifyableKey);
     LOG_DEBUG(CL_LOG,
               "getNotifyable: Looking for key=%s",
               notifyableKey.c_str());
-    if (ntpMapIt == m_ntpMap.end()) {
+    if (ntpMapIt == shard.m_ntpMap.end()) {
         return shared_ptr<NotifyableImpl>();
     }
     else {
@@ -40,18 +49,15 @@ SafeNotifyableMap::getNotifyable(const string &notifyableKey)
 void
 SafeNotifyableMap::uniqueInsert(const shared_ptr<NotifyableImpl> &notifyableSP)
 {
-    map<string, shared_ptr<NotifyableImpl> >::const_iterator ntpMapIt = 
-        m_ntpMap.find(notifyableSP->getKey());
-    if (ntpMapIt != m_ntpMap.end()) {
+    Shard &shard = getShard(notifyableSP->getKey());
+    if (!shard.m_ntpMap.insert(
+            make_pair(notifyableSP->getKey(), notifyableSP)).second) {
         ostringstream oss;
         oss << "uniqueInsert: Cache entry already exists for key=" 
             << notifyableSP->getKey();
         throw InconsistentInternalStateException(oss.str());
     }
     else {
-        m_ntpMap.insert(make_pair<string, shared_ptr<NotifyableImpl> >(
-                            notifyableSP->getKey(), 
-                            notifyableSP));
         LOG_DEBUG(CL_LOG,
                   "uniqueInsert: Adding name=%s, key=%s",
                   notifyableSP->getName().c_str(),
@@ -62,27 +68,32 @@ SafeNotifyableMap::uniqueInsert(const shared_ptr<NotifyableImpl> &notifyableSP)
 void
 SafeNotifyableMap::erase(const shared_ptr<NotifyableImpl> &notifyableSP)
 {
-    map<string, shared_ptr<NotifyableImpl> >::iterator ntpMapIt = 
-        m_ntpMap.find(notifyableSP->getKey());
-    if (ntpMapIt == m_ntpMap.end()) {
+    Shard &shard = getShard(notifyableSP->getKey());
+    if (shard.m_ntpMap.erase(notifyableSP->getKey()) == 0) {
         ostringstream oss;
-        oss << "uniqueInsert: Cache entry for key=" 
+        oss << "erase: Cache entry for key=" 
             << notifyableSP->getKey() << " doesn't exist!";
         throw InconsistentInternalStateException(oss.str());
     }
-    else {
-        m_ntpMap.erase(ntpMapIt);
-    }
 }
 
 const Mutex &
-SafeNotifyableMap::getLock() const
+SafeNotifyableMap::getLock(const string &notifyableKey) const
 {
-    return m_ntpMapLock;
+    return getShard(notifyableKey).m_ntpMapLock;
+}
+
+SafeNotifyableMap::Shard &
+SafeNotifyableMap::getShard(const string &notifyableKey) const
+{
+    return *m_shards[hash<string>()(notifyableKey) % m_shards.size()];
 }
 
 SafeNotifyableMap::~SafeNotifyableMap()
 {
+    for (size_t i = 0; i < m_shards.size(); ++i) {
+        delete m_shards[i];
+    }
 }
 
 }	/* End of 'namespace clusterlib' */
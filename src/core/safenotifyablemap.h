@@ -18,19 +18,27 @@
 
 namespace clusterlib {
 
- /**
-  * Special caching structure for clusterlib notifyables.
-  */
+/**
+ * Special caching structure for clusterlib notifyables.
+ *
+ * It is consulted on every lookup of a notifyable and on every
+ * update of the cached objects, so the notifyables are spread over
+ * SAFE_NOTIFYABLE_MAP_SHARDS hash tables by the hash of their keys,
+ * each with its own lock.  Threads that look up different keys
+ * rarely wait on each other and a lookup costs a hash of the key
+ * instead of O(log n) string compares.
+ */
 class SafeNotifyableMap
 {
   public:
     /**
      * Constructor.
      */
-    SafeNotifyableMap() {};
+    SafeNotifyableMap();
 
     /**
-     * Try to find the notifyable (thread-safe if holding the mutex).
+     * Try to find the notifyable (thread-safe if holding the mutex
+     * of notifyableKey).
      *
      * @param notifyableKey the key of the notifyable
      * @return a pointer to the notifyable or NULL if not found
@@ -40,9 +48,10 @@ class SafeNotifyableMap
     
     /**
      * Insert the notifyable into the map if it is unique (thread-safe
-     * if holding the mutex).  The map key is the notifyable's key.
-     * At this point, the memory of the notifyable is owned by
-     * SafeNotifyableMap and will be removed during destruction.
+     * if holding the mutex of the notifyable's key).  The map key is
+     * the notifyable's key.  At this point, the memory of the
+     * notifyable is owned by SafeNotifyableMap and will be removed
+     * during destruction.
      *
      * @param notifyableSP Pointer to the notifyable to insert
      */
@@ -50,16 +59,19 @@ class SafeNotifyableMap
 
     /**
      * Remove the notifyable from the map (thread-safe if holding the
-     * mutex).
+     * mutex of the notifyable's key).
      */
     void erase(const boost::shared_ptr<NotifyableImpl> &notifyableSP);
 
     /**
-     * Get the lock that protects this object.
+     * Get the lock that protects the notifyable with this key.  It
+     * also protects other notifyables whose keys hash to the same
+     * shard.
      *
+     * @param notifyableKey the key of the notifyable
      * @return a reference to the mutex
      */
-    const Mutex &getLock() const;
+    const Mutex &getLock(const std::string &notifyableKey) const;
 
     /**
      * Destructor.  Frees all memory for every NotifyableImpl * in the map.
@@ -77,17 +89,37 @@ class SafeNotifyableMap
      */
     SafeNotifyableMap & operator=(const SafeNotifyableMap &other);
 
-  private:
-    /** 
-     * The map containing the pointers to the allocated Notifyable
-     * objects.
+    /**
+     * The notifyables whose keys hash to the same shard.
      */
-    std::map<std::string, boost::shared_ptr<NotifyableImpl> > m_ntpMap;
-    
+    struct Shard
+    {
+        /** 
+         * The map containing the pointers to the allocated Notifyable
+         * objects.
+         */
+        boost::unordered_map<std::string, 
+                             boost::shared_ptr<NotifyableImpl> > m_ntpMap;
+
+        /**
+         * Lock that protects m_ntpMap.
+         */
+        Mutex m_ntpMapLock;
+    };
+
     /**
-     * Lock that protects m_ntpMap.
+     * Get the shard of a notifyable key.
+     *
+     * @param notifyableKey the key of the notifyable
+     * @return the shard the key hashes to
+     */
+    Shard &getShard(const std::string &notifyableKey) const;
+
+  private:
+    /** 
+     * The shards, SAFE_NOTIFYABLE_MAP_SHARDS of them.
      */
-    Mutex m_ntpMapLock;
+    std::vector<Shard *> m_shards;
 };
 
 }	/* End of 'namespace clusterlib' */
@@ -47,8 +47,10 @@ namespace zk {
 class RetryHandler
 {
   public:
-    RetryHandler(const ZooKeeperConfig &zkConfig)
-        : m_zkConfig(zkConfig)
+    RetryHandler(const ZooKeeperConfig &zkConfig,
+                 RepositoryStatsRecorder &statsRecorder)
+        : m_zkConfig(zkConfig),
+          m_statsRecorder(statsRecorder)
     {
         if (zkConfig.getAutoReconnect()) {
             retries = 2;
@@ -77,6 +79,7 @@ class RetryHandler
                   rc, 
                   retries);
         if (retries-- > 0) {
+            m_statsRecorder.recordRetry();
             return true;
         } else {
             return false;
@@ -88,6 +91,11 @@ class RetryHandler
      * The ZK config.
      */
     const ZooKeeperConfig &m_zkConfig;
+
+    /**
+     * Counts the retries.
+     */
+    RepositoryStatsRecorder &m_statsRecorder;
         
     /**
      * The number of outstanding retries.
@@ -108,6 +116,78 @@ class RetryHandler
 };
     
     
+/**
+ * \brief Per-thread buffers for reading znode data, so that reads of
+ * small znodes do not allocate.
+ */
+class ReadBufferPool
+{
+  public:
+    /**
+     * Get the calling thread's buffer, grown to at least the
+     * requested size.
+     *
+     * @param size the minimum size of the buffer
+     * @return the buffer of the calling thread
+     */
+    static vector<char> &getBuffer(int32_t size)
+    {
+        pthread_once(&s_keyOnce, createKey);
+        vector<char> *buffer = 
+            reinterpret_cast<vector<char> *>(pthread_getspecific(s_key));
+        if (buffer == NULL) {
+            buffer = new vector<char>(
+                clusterlib::CLNumericInternal::DEFAULT_READ_BUFFER_SIZE);
+            pthread_setspecific(s_key, buffer);
+        }
+        if (static_cast<int32_t>(buffer->size()) < size) {
+            buffer->resize(size);
+        }
+        return *buffer;
+    }
+
+    /**
+     * Shrink the buffer back if a large read grew it, so that
+     * each thread only keeps a small buffer around.
+     *
+     * @param buffer the buffer from getBuffer()
+     */
+    static void releaseBuffer(vector<char> &buffer)
+    {
+        if (static_cast<int32_t>(buffer.size()) > 
+            clusterlib::CLNumericInternal::MAX_RETAINED_READ_BUFFER_SIZE) {
+            vector<char>(
+                clusterlib::CLNumericInternal::DEFAULT_READ_BUFFER_SIZE).swap(
+                    buffer);
+        }
+    }
+
+  private:
+    static void createKey()
+    {
+        pthread_key_create(&s_key, destroyBuffer);
+    }
+
+    static void destroyBuffer(void *buffer)
+    {
+        delete reinterpret_cast<vector<char> *>(buffer);
+    }
+
+  private:
+    /**
+     * Key of the per-thread buffer.
+     */
+    static pthread_key_t s_key;
+
+    /**
+     * Makes sure s_key is created once.
+     */
+    static pthread_once_t s_keyOnce;
+};
+
+pthread_key_t ReadBufferPool::s_key;
+pthread_once_t ReadBufferPool::s_keyOnce = PTHREAD_ONCE_INIT;
+    
 /*
  * The implementation of the global ZK event watcher
  */
@@ -320,9 +400,6 @@ ZooKeeperAdapter::ZooKeeperAdapter(ZooKeeperConfig config,
 
     //start the event dispatcher thread
     m_eventDispatcher.Create(*this, &ZooKeeperAdapter::processEvents);
-
-    //start the user event dispatcher thread
-    m_userEventDispatcher.Create(*this, &ZooKeeperAdapter::processUserEvents);
     
     //optionally establish the connection
     if (establishConnection) {
@@ -342,8 +419,7 @@ ZooKeeperAdapter::~ZooKeeperAdapter()
                   e.what());
     }
 
-    /* Exit our threads */
-    m_userEventDispatcher.Join();
+    /* Exit our thread */
     m_eventDispatcher.Join();
 
     /* 
@@ -354,7 +430,7 @@ ZooKeeperAdapter::~ZooKeeperAdapter()
 }
 
 void
-ZooKeeperAdapter::validatePath(const string &path)
+Repository::validatePath(const string &path)
 {
     TRACE(LOG, "validatePath");
     
@@ -498,7 +574,9 @@ ZooKeeperAdapter::sync(const string &path,
 
     int32_t rc = ZINVALIDSTATE, ret;
     struct sync_completion sc;
-    RetryHandler rh(m_zkConfig);
+    RetryHandler rh(m_zkConfig, getStatsRecorder());
+    RepositoryOperationTimer timer(getStatsRecorder(), 
+                                   clusterlib::RepositoryStats::SYNC);
     do {
         verifyConnection();
 	memset(&sc, 0, sizeof(sc));
@@ -541,6 +619,7 @@ ZooKeeperAdapter::sync(const string &path,
 	    throw SystemFailureException("Unable to destroy cond");
 	}
     } while ((rc != ZOK) && (rh.handleRC(rc)));
+    timer.setRc(rc);
     if (rc != ZOK) {
         LOG_ERROR(LOG, 
                   "sync: Error %d for %s", 
@@ -555,11 +634,10 @@ ZooKeeperAdapter::sync(const string &path,
      * listeners.  This assumes:
      * 
      * 1) After a sync, all the watches for any other events have been
-     * triggered and processed by zkWatcher.  
+     * triggered and delivered to the listeners by zkWatcher.  
      * 2) Syncs complete in order. 
      * 
-     * At this point, we insert the sync event into the blocking queue
-     * for other listeners.
+     * At this point, we deliver the sync event to the listeners.
      */
 
     /*
@@ -602,11 +680,49 @@ ZooKeeperAdapter::handleAsyncEvent(const ZKWatcherEvent &event)
         callbackAndContext = 
             reinterpret_cast<clusterlib::CallbackAndContext *>(
                 event.getContext());
+        if (event.getType() == ZOO_SESSION_EVENT) {
+            /*
+             * ZK tells every watch about session state changes.  The
+             * watch stays set (ZK sets it again after reconnecting)
+             * unless the session expired, and the listeners already
+             * got the same event without a context.  ZK reports the
+             * expiry without a context first, so loseWatches() has
+             * usually moved the watch already.
+             */
+            clusterlib::Locker l(getWatchLock());
+            if (m_lostContextSet.erase(callbackAndContext) != 0) {
+                getListenerAndContextManager()->
+                    deleteCallbackAndContext(callbackAndContext);
+                return;
+            }
+            if (m_watchMap.find(callbackAndContext) != m_watchMap.end()) {
+                if (event.getState() == ZOO_EXPIRED_SESSION_STATE) {
+                    m_lostWatchVec.push_back(
+                        m_watchMap[callbackAndContext]);
+                    m_watchMap.erase(callbackAndContext);
+                    getListenerAndContextManager()->
+                        deleteCallbackAndContext(callbackAndContext);
+                }
+                return;
+            }
+        }
+        else {
+            removeWatch(callbackAndContext);
+        }
+
+        /*
+         * Only use the context once it is known that this event
+         * consumes it.
+         */
         listener = 
             reinterpret_cast<ZKEventListener *>(callbackAndContext->callback);
         userContext = callbackAndContext->context;
     }
 
+    if (event.getType() == ZOO_DELETED_EVENT) {
+        forgetKnownPath(event.getPath());
+    }
+
     ZKWatcherEvent sentEvent(event.getType(), 
                              event.getState(), 
                              event.getPath(),
@@ -627,6 +743,352 @@ ZooKeeperAdapter::handleAsyncEvent(const ZKWatcherEvent &event)
     }
 }
 
+bool
+ZooKeeperAdapter::isKnownPath(const string &path)
+{
+    TRACE(LOG, "isKnownPath");
+
+    clusterlib::Locker l(getKnownPathLock());
+    return (m_knownPathMap.find(path) != m_knownPathMap.end());
+}
+
+void
+ZooKeeperAdapter::addKnownPath(const string &path)
+{
+    TRACE(LOG, "addKnownPath");
+
+    clusterlib::Locker l(getKnownPathLock());
+
+    /* 
+     * Add the node and then its ancestors, stopping at the first one
+     * that is already known.
+     */
+    string knownPath = path;
+    while (!knownPath.empty() && 
+           (m_knownPathMap.find(knownPath) == m_knownPathMap.end())) {
+        m_knownPathMap[knownPath] = 
+            m_knownPathQueue.insert(m_knownPathQueue.end(), knownPath);
+        knownPath.erase(knownPath.rfind('/'));
+    }
+
+    while (m_knownPathQueue.size() > 
+           clusterlib::CLNumericInternal::MAX_KNOWN_PATH_COUNT) {
+        m_knownPathMap.erase(m_knownPathQueue.front());
+        m_knownPathQueue.pop_front();
+    }
+}
+
+void
+ZooKeeperAdapter::forgetKnownPath(const string &path)
+{
+    TRACE(LOG, "forgetKnownPath");
+
+    clusterlib::Locker l(getKnownPathLock());
+
+    /* Remove the node and its descendants from both containers. */
+    map<string, list<string>::iterator>::iterator it = 
+        m_knownPathMap.find(path);
+    if (it != m_knownPathMap.end()) {
+        m_knownPathQueue.erase(it->second);
+        m_knownPathMap.erase(it);
+    }
+    string prefix = path + '/';
+    it = m_knownPathMap.lower_bound(prefix);
+    while ((it != m_knownPathMap.end()) && 
+           (it->first.compare(0, prefix.size(), prefix) == 0)) {
+        m_knownPathQueue.erase(it->second);
+        m_knownPathMap.erase(it++);
+    }
+}
+
+void
+ZooKeeperAdapter::addWatch(clusterlib::CallbackAndContext *callbackAndContext,
+                           const ZKWatchRecord &record)
+{
+    TRACE(LOG, "addWatch");
+
+    clusterlib::Locker l(getWatchLock());
+    m_watchMap[callbackAndContext] = record;
+}
+
+void
+ZooKeeperAdapter::setWatchZxid(
+    clusterlib::CallbackAndContext *callbackAndContext,
+    int64_t zxid)
+{
+    TRACE(LOG, "setWatchZxid");
+
+    clusterlib::Locker l(getWatchLock());
+    map<clusterlib::CallbackAndContext *, ZKWatchRecord>::iterator it =
+        m_watchMap.find(callbackAndContext);
+    if (it != m_watchMap.end()) {
+        it->second.setZxid(zxid);
+    }
+}
+
+bool
+ZooKeeperAdapter::removeWatch(
+    clusterlib::CallbackAndContext *callbackAndContext)
+{
+    TRACE(LOG, "removeWatch");
+
+    clusterlib::Locker l(getWatchLock());
+    return (m_watchMap.erase(callbackAndContext) != 0);
+}
+
+void
+ZooKeeperAdapter::loseWatches()
+{
+    TRACE(LOG, "loseWatches");
+
+    clusterlib::Locker l(getWatchLock());
+    LOG_INFO(LOG,
+             "loseWatches: %" PRIuPTR " watches lost with the session",
+             m_watchMap.size() + m_rearmWatchVec.size());
+    map<clusterlib::CallbackAndContext *, ZKWatchRecord>::const_iterator it;
+    for (it = m_watchMap.begin(); it != m_watchMap.end(); ++it) {
+        m_lostWatchVec.push_back(it->second);
+        m_lostContextSet.insert(it->first);
+    }
+    m_watchMap.clear();
+    m_lostWatchVec.insert(m_lostWatchVec.end(),
+                          m_rearmWatchVec.begin(),
+                          m_rearmWatchVec.end());
+    m_rearmWatchVec.clear();
+}
+
+/**
+ * Completion of a nodeExistsAsync() or getNodeChildrenAsync() call
+ * issued by rearmNextWatches().  Deletes itself once called.
+ */
+class ZooKeeperAdapter::WatchRearmCallback
+    : public AsyncOperationCallback
+{
+  public:
+    /**
+     * Constructor.
+     *
+     * @param adapter the adapter that issued the call
+     * @param record the watch being set again
+     * @param pOutstanding the count of outstanding calls of the batch
+     */
+    WatchRearmCallback(ZooKeeperAdapter *adapter,
+                       const ZKWatchRecord &record,
+                       int32_t *pOutstanding)
+        : mp_adapter(adapter),
+          m_record(record),
+          mp_outstanding(pOutstanding) {}
+
+    virtual void operationCompleted(const AsyncOperation &operation)
+    {
+        mp_adapter->watchRearmed(m_record, operation);
+        mp_adapter->releaseRearmBatch(mp_outstanding);
+        delete this;
+    }
+
+  private:
+    /**
+     * The adapter that issued the call.
+     */
+    ZooKeeperAdapter *mp_adapter;
+
+    /**
+     * The watch being set again.
+     */
+    ZKWatchRecord m_record;
+
+    /**
+     * The count of outstanding calls of the batch.
+     */
+    int32_t *mp_outstanding;
+};
+
+void
+ZooKeeperAdapter::rearmLostWatches()
+{
+    TRACE(LOG, "rearmLostWatches");
+
+    {
+        clusterlib::Locker l(getWatchLock());
+        if (m_lostWatchVec.empty()) {
+            return;
+        }
+        LOG_INFO(LOG,
+                 "rearmLostWatches: Setting %" PRIuPTR " watches again",
+                 m_lostWatchVec.size());
+        m_rearmWatchVec.insert(m_rearmWatchVec.end(),
+                               m_lostWatchVec.begin(),
+                               m_lostWatchVec.end());
+        m_lostWatchVec.clear();
+    }
+    rearmNextWatches();
+}
+
+void
+ZooKeeperAdapter::rearmNextWatches()
+{
+    TRACE(LOG, "rearmNextWatches");
+
+    vector<ZKWatchRecord> batchVec;
+    {
+        clusterlib::Locker l(getWatchLock());
+        size_t batchSize = min(
+            clusterlib::CLNumericInternal::MAX_WATCH_REARM_BATCH_SIZE,
+            m_rearmWatchVec.size());
+        batchVec.assign(m_rearmWatchVec.begin(), 
+                        m_rearmWatchVec.begin() + batchSize);
+        m_rearmWatchVec.erase(m_rearmWatchVec.begin(),
+                              m_rearmWatchVec.begin() + batchSize);
+    }
+    if (batchVec.empty()) {
+        return;
+    }
+
+    /*
+     * A NODE_WATCH is set again with nodeExists() since a watch set
+     * by exists on an existing node fires on the same changes as one
+     * set by getNodeData(), without reading the data.  Nothing waits
+     * for the calls here, the session events must keep flowing.  The
+     * issuer holds a reference to the count until every call is
+     * issued, so that the rearm event is queued only once.
+     */
+    int32_t *pOutstanding = new int32_t(1);
+    size_t issued = 0;
+    try {
+        for (; (issued < batchVec.size()) && (getState() == AS_CONNECTED); 
+             ++issued) {
+            const ZKWatchRecord &record = batchVec[issued];
+            ZKEventListener *listener = 
+                reinterpret_cast<ZKEventListener *>(record.getListener());
+            __sync_add_and_fetch(pOutstanding, 1);
+            WatchRearmCallback *callback = 
+                new WatchRearmCallback(this, record, pOutstanding);
+            if (record.getType() == ZKWatchRecord::CHILD_WATCH) {
+                getNodeChildrenAsync(record.getPath(),
+                                     listener,
+                                     record.getContext(),
+                                     callback);
+            }
+            else {
+                nodeExistsAsync(record.getPath(),
+                                listener,
+                                record.getContext(),
+                                callback);
+            }
+        }
+    }
+    catch (std::exception &e) {
+        /* The failed call already completed through its callback. */
+        ++issued;
+        LOG_WARN(LOG,
+                 "rearmNextWatches: Stopped issuing: %s",
+                 e.what());
+    }
+
+    if (issued < batchVec.size()) {
+        clusterlib::Locker l(getWatchLock());
+        m_lostWatchVec.insert(m_lostWatchVec.end(),
+                              batchVec.begin() + issued,
+                              batchVec.end());
+        m_lostWatchVec.insert(m_lostWatchVec.end(),
+                              m_rearmWatchVec.begin(),
+                              m_rearmWatchVec.end());
+        m_rearmWatchVec.clear();
+    }
+    releaseRearmBatch(pOutstanding);
+}
+
+void
+ZooKeeperAdapter::watchRearmed(const ZKWatchRecord &record,
+                               const AsyncOperation &operation)
+{
+    TRACE(LOG, "watchRearmed");
+
+    int32_t rc = operation.getRc();
+    const Stat &stat = operation.getStat();
+    int32_t missedEvent = 0;
+    if ((rc != ZOK) && (rc != ZNONODE)) {
+        LOG_WARN(LOG,
+                 "watchRearmed: Failed with error %d for %s, keeping it "
+                 "for the next session",
+                 rc,
+                 record.getPath().c_str());
+        clusterlib::Locker l(getWatchLock());
+        m_lostWatchVec.push_back(record);
+        return;
+    }
+    else if (record.getType() == ZKWatchRecord::CHILD_WATCH) {
+        if (rc == ZNONODE) {
+            missedEvent = ZOO_DELETED_EVENT;
+        }
+        else if (stat.pzxid != record.getZxid()) {
+            missedEvent = ZOO_CHILD_EVENT;
+        }
+    }
+    else if (record.getZxid() == 0) {
+        if (rc == ZOK) {
+            missedEvent = ZOO_CREATED_EVENT;
+        }
+    }
+    else if (rc == ZNONODE) {
+        missedEvent = ZOO_DELETED_EVENT;
+    }
+    else if (stat.mzxid != record.getZxid()) {
+        missedEvent = ZOO_CHANGED_EVENT;
+    }
+
+    /*
+     * The listener gets the event it missed after the events ZK
+     * already queued, and reloads the node itself.
+     */
+    if (missedEvent != 0) {
+        LOG_INFO(LOG,
+                 "watchRearmed: %s changed while the watch was lost",
+                 record.getPath().c_str());
+        m_events.put(
+            ZKWatcherEvent(
+                missedEvent,
+                ZOO_CONNECTED_STATE,
+                record.getPath(),
+                getListenerAndContextManager()->createCallbackAndContext(
+                    record.getListener(), record.getContext())));
+    }
+}
+
+void
+ZooKeeperAdapter::releaseRearmBatch(int32_t *pOutstanding)
+{
+    if (__sync_sub_and_fetch(pOutstanding, 1) == 0) {
+        delete pOutstanding;
+        m_events.put(ZKWatcherEvent(
+                         ZOO_SESSION_EVENT,
+                         ZOO_CONNECTED_STATE,
+                         clusterlib::CLStringInternal::REARM_EVENT.c_str(),
+                         NULL));
+    }
+}
+
+bool
+ZooKeeperAdapter::isRearmEvent(const ZKWatcherEvent &event) const
+{
+    return ((event.getType() == ZOO_SESSION_EVENT) &&
+            (event.getPath().compare(
+                clusterlib::CLStringInternal::REARM_EVENT) == 0) &&
+            (event.getContext() == NULL));
+}
+
+const clientid_t *
+ZooKeeperAdapter::getClientId()
+{
+    TRACE(LOG, "getClientId");
+
+    m_stateLock.lock();
+    const clientid_t *clientId = 
+        (mp_zkHandle == NULL) ? NULL : zoo_client_id(mp_zkHandle);
+    m_stateLock.unlock();
+    return clientId;
+}
+
 void
 ZooKeeperAdapter::injectEndEvent()
 {
@@ -668,11 +1130,43 @@ ZooKeeperAdapter::enqueueEvent(int32_t type,
     }
 
     /*
-     * Pass the event to the handler.
+     * Every event goes through m_events, so the listeners get the
+     * session and watch events on one thread in the order ZK
+     * triggered them.  The ZK completion thread cannot deliver the
+     * session events itself, since they change the adapter state
+     * under m_stateLock and disconnect() holds it while
+     * zookeeper_close() waits for this thread.
      */
     m_events.put(ZKWatcherEvent(type, state, path, context));
 }
 
+void
+ZooKeeperAdapter::deliverEvent(const ZKWatcherEvent &event)
+{
+    TRACE(LOG, "deliverEvent");
+
+    try {
+        LOG_DEBUG(LOG,
+                  "deliverEvent: processing event (type: %s, "
+                  "state: %s, path: %s, context %p)",
+                  getEventString(event.getType()).c_str(),
+                  getStateString(event.getState()).c_str(),
+                  event.getPath().c_str(),
+                  event.getContext());
+        
+        handleAsyncEvent(event);
+    } 
+    catch (std::exception &e) {
+        LOG_ERROR(LOG, 
+                  "Unable to process event (type: %s, state: %s, "
+                  "path: %s), because of exception: %s",
+                  getEventString(event.getType()).c_str(),
+                  getStateString(event.getState()).c_str(),
+                  event.getPath().c_str(),
+                  e.what());
+    }
+}
+
 void
 ZooKeeperAdapter::processEvents(void *param)
 {
@@ -688,6 +1182,12 @@ ZooKeeperAdapter::processEvents(void *param)
         ZKWatcherEvent source;
         bool found = m_events.takeWaitMsecs(100, source);
         if (found) {
+            /* Internal event, not delivered to the listeners */
+            if (isRearmEvent(source)) {
+                rearmNextWatches();
+                continue;
+            }
+
             if (source.getType() == ZOO_SESSION_EVENT) {
                 LOG_INFO(LOG,
                          "processEvents: Received SESSION event, state: %s. "
@@ -710,11 +1210,16 @@ ZooKeeperAdapter::processEvents(void *param)
                              source.getPath().c_str());
                     /*
                      * ZOO_EXPIRED_SESSION_STATE is overloaded to
-                     * specify an end event for FactoryOps.
+                     * specify an end event for FactoryOps.  The
+                     * expiry reported to each watch repeats the one
+                     * without a context and may come after the new
+                     * session was started.
                      */
-                    if (source.getPath().compare(
-                            clusterlib::CLStringInternal::END_EVENT) != 0) {
+                    if ((source.getPath().compare(
+                             clusterlib::CLStringInternal::END_EVENT) != 0) &&
+                        (source.getContext() == NULL)) {
                         setState(AS_SESSION_EXPIRED);
+                        loseWatches();
                     }
                 }
                 m_stateLock.unlock();
@@ -729,58 +1234,39 @@ ZooKeeperAdapter::processEvents(void *param)
                       ZooKeeperAdapter::getStateString(m_state).c_str(),
                       m_state);
 
-            m_userEvents.put(source);
-            
-            /* If that was the final event, exit loop */
-            if (isEndEvent(source)) {
-                break;
-            }
-        }
-    }
-
-    LOG_INFO(LOG,
-             "Ending thread with ZooKeeperAdapter::processEvents(): "
-             "this: %p, thread: %" PRIu32,
-             this,
-             clusterlib::ProcessThreadService::getTid());
-}
-
-void
-ZooKeeperAdapter::processUserEvents(void *param)
-{
-    TRACE(LOG, "processUserEvents");
-
-    LOG_INFO(LOG,
-             "Starting thread with ZooKeeperAdapter::processUserEvents(), "
-             "this: %p, thread: %" PRIu32,
-             this,
-             clusterlib::ProcessThreadService::getTid());
+            deliverEvent(source);
 
-    while (1) {
-        ZKWatcherEvent source;
-        bool found = m_userEvents.takeWaitMsecs(100, source);
-        if (found) {
-            try {
-		LOG_DEBUG(LOG,
-                          "processUserEvents: processing event (type: %s, "
-                          "state: %s, path: %s, context %p)",
-                          getEventString(source.getType()).c_str(),
-                          getStateString(source.getState()).c_str(),
-                          source.getPath().c_str(),
-                          source.getContext());
-		
-                handleAsyncEvent(source);
-            } 
-            catch (std::exception &e) {
-                LOG_ERROR(LOG, 
-                          "Unable to process event (type: %s, state: %s, "
-                          "path: %s), because of exception: %s",
-                          getEventString(source.getType()).c_str(),
-                          getStateString(source.getState()).c_str(),
-                          source.getPath().c_str(),
-                          e.what());
+            /*
+             * A ZK handle whose session expired never connects again,
+             * so start a new session right away instead of waiting
+             * for the next call to verifyConnection().
+             */
+            if ((source.getType() == ZOO_SESSION_EVENT) &&
+                (source.getState() == ZOO_EXPIRED_SESSION_STATE) &&
+                (source.getContext() == NULL) &&
+                !isEndEvent(source) &&
+                m_zkConfig.getAutoReconnect()) {
+                try {
+                    reconnect();
+                }
+                catch (std::exception &e) {
+                    LOG_WARN(LOG,
+                             "processEvents: Failed to reconnect after "
+                             "the session expired: %s",
+                             e.what());
+                }
             }
 
+            /* 
+             * Once connected in a new session, set the watches that
+             * were lost with the old one.
+             */
+            if ((source.getType() == ZOO_SESSION_EVENT) &&
+                (source.getState() == ZOO_CONNECTED_STATE) &&
+                (source.getContext() == NULL)) {
+                rearmLostWatches();
+            }
+            
             /* If that was the final event, exit loop */
             if (isEndEvent(source)) {
                 break;
@@ -789,7 +1275,7 @@ ZooKeeperAdapter::processUserEvents(void *param)
     }
 
     LOG_INFO(LOG,
-             "Ending thread with ZooKeeperAdapter::processUserEvents() "
+             "Ending thread with ZooKeeperAdapter::processEvents(): "
              "this: %p, thread: %" PRIu32,
              this,
              clusterlib::ProcessThreadService::getTid());
@@ -936,20 +1422,29 @@ ZooKeeperAdapter::createNode(const string &path,
     const int32_t MAX_PATH_LENGTH = 1024;
     char realPath[MAX_PATH_LENGTH];
     realPath[0] = 0;
+    string data = encodeData(value);
     
     int32_t rc;
-    RetryHandler rh(m_zkConfig);
-    do {
-        verifyConnection();
-        rc = zoo_create(mp_zkHandle, 
-                        path.c_str(), 
-                        value.c_str(),
-                        value.length(),
-                        &ZOO_OPEN_ACL_UNSAFE,
-                        flags,
-                        realPath,
-                        MAX_PATH_LENGTH);
-    } while ((rc != ZOK) && (rh.handleRC(rc)));
+    RetryHandler rh(m_zkConfig, getStatsRecorder());
+    {
+        RepositoryOperationTimer timer(getStatsRecorder(), 
+                                       clusterlib::RepositoryStats::CREATE);
+        do {
+            verifyConnection();
+            rc = zoo_create(mp_zkHandle, 
+                            path.c_str(), 
+                            data.c_str(),
+                            data.length(),
+                            &ZOO_OPEN_ACL_UNSAFE,
+                            flags,
+                            realPath,
+                            MAX_PATH_LENGTH);
+        } while ((rc != ZOK) && (rh.handleRC(rc)));
+        timer.setRc(rc);
+    }
+    if (rc == ZOK) {
+        getStatsRecorder().recordBytesWritten(data.length());
+    }
     if (rc != ZOK) {
         if (rc == ZNODEEXISTS) {
             //the node already exists
@@ -957,6 +1452,9 @@ ZooKeeperAdapter::createNode(const string &path,
                      "createNode: Error %d for %s", 
                      rc, 
                      path.c_str());
+            if (flags == 0) {
+                addKnownPath(path);
+            }
             return false;
         } 
         else if (rc == ZNONODE && createAncestors) {
@@ -964,14 +1462,21 @@ ZooKeeperAdapter::createNode(const string &path,
                      "createNode: Error %d for %s", 
                      rc, 
                      path.c_str());
+            //the parent is gone, even if we thought it existed
+            forgetKnownPath(path.substr(0, path.rfind('/')));
             //one of the ancestors doesn't exist so lets start from the root 
             //and make sure the whole path exists, creating missing nodes if
-            //necessary
+            //necessary; ancestors known to exist are skipped, and if one
+            //of them turns out to be gone the nested createNode() will
+            //forget it and create it
             for (string::size_type pos = 1; pos != string::npos;) {
                 pos = path.find("/", pos);
                 if (pos != string::npos) {
                     try {
-                        createNode(path.substr(0, pos), "", 0, true);
+                        string ancestor = path.substr(0, pos);
+                        if (!isKnownPath(ancestor)) {
+                            createNode(ancestor, "", 0, true);
+                        }
                     } catch (Exception &e) {
                         throw Exception(string("Unable to create "
                                                         "node ") + 
@@ -1002,6 +1507,16 @@ ZooKeeperAdapter::createNode(const string &path,
               "%s has been created", 
               realPath);
     createdPath = string(realPath);
+    /* 
+     * Sequence and ephemeral nodes are short-lived, so only their
+     * parent is worth remembering.
+     */
+    if (flags == 0) {
+        addKnownPath(createdPath);
+    }
+    else {
+        addKnownPath(createdPath.substr(0, createdPath.rfind('/')));
+    }
     return true;
 }
 
@@ -1058,24 +1573,31 @@ ZooKeeperAdapter::createSequence(const string &path,
 bool
 ZooKeeperAdapter::deleteNode(const string &path,
                              bool recursive,
-                             int32_t version)
+                             int32_t version,
+                             DeleteProgressCallback *progress)
 {
     TRACE(LOG, "deleteNode");
 
     validatePath(path);
         
     int32_t rc;
-    RetryHandler rh(m_zkConfig);
-    do {
-        verifyConnection();
-        rc = zoo_delete(mp_zkHandle, path.c_str(), version);
-    } while ((rc != ZOK) && (rh.handleRC(rc)));
+    RetryHandler rh(m_zkConfig, getStatsRecorder());
+    {
+        RepositoryOperationTimer timer(getStatsRecorder(), 
+                                       clusterlib::RepositoryStats::DELETE);
+        do {
+            verifyConnection();
+            rc = zoo_delete(mp_zkHandle, path.c_str(), version);
+        } while ((rc != ZOK) && (rh.handleRC(rc)));
+        timer.setRc(rc);
+    }
     if (rc != ZOK) {
         if (rc == ZNONODE) {
             LOG_WARN(LOG, 
                      "Error %d for %s", 
                      rc, 
                      path.c_str());
+            forgetKnownPath(path);
             return false;
         }
         if (rc == ZNOTEMPTY && recursive) {
@@ -1083,7 +1605,16 @@ ZooKeeperAdapter::deleteNode(const string &path,
                      "Error %d for %s", 
                      rc, 
                      path.c_str());
-            //get all children and delete them recursively...
+            //try to delete the whole subtree in batches...
+            if (deleteNodeTree(path, progress)) {
+                LOG_DEBUG(LOG, 
+                          "%s has been deleted", 
+                          path.c_str());
+                forgetKnownPath(path);
+                return true;
+            }
+            //...otherwise it changed underneath us, so get all
+            //children and delete them recursively...
             vector<string> nodeList;
             getNodeChildren(path, nodeList, false);
             for (vector<string>::const_iterator i = nodeList.begin();
@@ -1106,18 +1637,315 @@ ZooKeeperAdapter::deleteNode(const string &path,
     LOG_DEBUG(LOG, 
               "%s has been deleted", 
               path.c_str());
+    forgetKnownPath(path);
     return true;
 }
 
 bool
-ZooKeeperAdapter::nodeExists(const string &path,
-                             ZKEventListener *listener,
-                             void *context, 
-                             Stat *stat)
+ZooKeeperAdapter::multi(const vector<MultiOperation> &operations,
+                        vector<int32_t> *pResults)
 {
-    TRACE(LOG, "nodeExists");
-
-    validatePath(path);
+    TRACE(LOG, "multi");
+
+    if (pResults != NULL) {
+        pResults->clear();
+    }
+    if (operations.empty()) {
+        return true;
+    }
+
+    vector<MultiOperation>::const_iterator operationsIt;
+    for (operationsIt = operations.begin(); 
+         operationsIt != operations.end(); 
+         ++operationsIt) {
+        validatePath(operationsIt->getPath());
+    }
+
+    int32_t rc = ZOK;
+#ifdef HAVE_ZOO_MULTI
+    const int32_t MAX_PATH_LENGTH = 1024;
+    int32_t count = static_cast<int32_t>(operations.size());
+    vector<zoo_op_t> zooOps(count);
+    vector<zoo_op_result_t> zooResults(count);
+    vector<char> pathBuffers(count * MAX_PATH_LENGTH);
+    vector<string> dataVec(count);
+    for (int32_t i = 0; i < count; ++i) {
+        const MultiOperation &operation = operations[i];
+        dataVec[i] = encodeData(operation.getValue(), operation.getFlags());
+        switch (operation.getType()) {
+            case MultiOperation::CREATE_NODE:
+                zoo_create_op_init(&zooOps[i],
+                                   operation.getPath().c_str(),
+                                   dataVec[i].c_str(),
+                                   dataVec[i].length(),
+                                   &ZOO_OPEN_ACL_UNSAFE,
+                                   getZKFlags(operation.getFlags()),
+                                   &pathBuffers[i * MAX_PATH_LENGTH],
+                                   MAX_PATH_LENGTH);
+                break;
+            case MultiOperation::DELETE_NODE:
+                zoo_delete_op_init(&zooOps[i],
+                                   operation.getPath().c_str(),
+                                   operation.getVersion());
+                break;
+            case MultiOperation::SET_NODE_DATA:
+                zoo_set_op_init(&zooOps[i],
+                                operation.getPath().c_str(),
+                                dataVec[i].c_str(),
+                                dataVec[i].length(),
+                                operation.getVersion(),
+                                NULL);
+                break;
+            case MultiOperation::CHECK_VERSION:
+                zoo_check_op_init(&zooOps[i],
+                                  operation.getPath().c_str(),
+                                  operation.getVersion());
+                break;
+            default:
+                throw InvalidArgumentsException(
+                    "multi: Unknown operation type");
+        }
+    }
+
+    RetryHandler rh(m_zkConfig, getStatsRecorder());
+    {
+        RepositoryOperationTimer timer(getStatsRecorder(), 
+                                       clusterlib::RepositoryStats::MULTI);
+        do {
+            verifyConnection();
+            rc = zoo_multi(mp_zkHandle, count, &zooOps[0], &zooResults[0]);
+        } while ((rc != ZOK) && (rh.handleRC(rc)));
+        timer.setRc(rc);
+    }
+    if (rc == ZOK) {
+        for (int32_t i = 0; i < count; ++i) {
+            getStatsRecorder().recordBytesWritten(dataVec[i].length());
+        }
+    }
+    if (pResults != NULL) {
+        for (int32_t i = 0; i < count; ++i) {
+            pResults->push_back((rc == ZOK) ? ZOK : zooResults[i].err);
+        }
+    }
+#else
+    /*
+     * No transaction support in the client library, so do the
+     * operations one at a time and stop at the first failure.
+     */
+    for (operationsIt = operations.begin(); 
+         operationsIt != operations.end(); 
+         ++operationsIt) {
+        int32_t opRc = ZOK;
+        /*
+         * createNode() and setNodeData() encode the value themselves,
+         * so give them back the value of pre-encoded data.
+         */
+        string value = operationsIt->getValue();
+        if (operationsIt->getFlags() & DATA_ENCODED) {
+            DataCodec::decode(value);
+        }
+        try {
+            switch (operationsIt->getType()) {
+                case MultiOperation::CREATE_NODE:
+                    if (!createNode(operationsIt->getPath(),
+                                    value,
+                                    getZKFlags(operationsIt->getFlags()),
+                                    false)) {
+                        opRc = ZNODEEXISTS;
+                    }
+                    break;
+                case MultiOperation::DELETE_NODE:
+                    if (!deleteNode(operationsIt->getPath(),
+                                    false,
+                                    operationsIt->getVersion())) {
+                        opRc = ZNONODE;
+                    }
+                    break;
+                case MultiOperation::SET_NODE_DATA:
+                    setNodeData(operationsIt->getPath(),
+                                value,
+                                operationsIt->getVersion());
+                    break;
+                case MultiOperation::CHECK_VERSION:
+                    {
+                        Stat stat;
+                        if (!nodeExists(
+                                operationsIt->getPath(), NULL, NULL, &stat)) {
+                            opRc = ZNONODE;
+                        }
+                        else if ((operationsIt->getVersion() != -1) &&
+                                 (stat.version != 
+                                  operationsIt->getVersion())) {
+                            opRc = ZBADVERSION;
+                        }
+                    }
+                    break;
+                default:
+                    throw InvalidArgumentsException(
+                        "multi: Unknown operation type");
+            }
+        }
+        catch (BadVersionException &e) {
+            opRc = ZBADVERSION;
+        }
+        if (pResults != NULL) {
+            pResults->push_back(opRc);
+        }
+        if (opRc != ZOK) {
+            rc = opRc;
+            break;
+        }
+    }
+#endif
+
+    if (rc == ZOK) {
+        LOG_DEBUG(LOG, 
+                  "multi: Committed %" PRIuPTR " operations starting with %s", 
+                  operations.size(),
+                  operations.front().getPath().c_str());
+        return true;
+    }
+    else if ((rc == ZNODEEXISTS) || 
+             (rc == ZNONODE) || 
+             (rc == ZNOTEMPTY) ||
+             (rc == ZBADVERSION)) {
+        LOG_WARN(LOG, 
+                 "multi: Aborted with error %d for %" PRIuPTR 
+                 " operations starting with %s", 
+                 rc, 
+                 operations.size(),
+                 operations.front().getPath().c_str());
+        return false;
+    }
+
+    LOG_ERROR(LOG, 
+              "multi: Error %d for %" PRIuPTR 
+              " operations starting with %s", 
+              rc, 
+              operations.size(),
+              operations.front().getPath().c_str());
+    throwErrorCode(string("Unable to execute transaction starting with ") +
+                   operations.front().getPath(),
+                   rc,
+                   m_state == AS_CONNECTED);
+    return false;
+}
+
+bool
+ZooKeeperAdapter::deleteNodeTree(const string &path,
+                                 DeleteProgressCallback *progress)
+{
+    TRACE(LOG, "deleteNodeTree");
+
+    /*
+     * List the subtree one level at a time.  All the children of a
+     * level are requested before waiting on any of them, so each
+     * level costs a single round trip.  Deleting the resulting
+     * breadth first list in reverse removes every child before its
+     * parent.
+     */
+    vector<string> treeVec;
+    treeVec.push_back(path);
+    size_t levelBegin = 0;
+    while (levelBegin < treeVec.size()) {
+        size_t levelEnd = treeVec.size();
+        vector<AsyncOperationSP> operationVec;
+        operationVec.reserve(levelEnd - levelBegin);
+        for (size_t i = levelBegin; i < levelEnd; ++i) {
+            operationVec.push_back(getNodeChildrenAsync(treeVec[i]));
+        }
+        for (size_t i = 0; i < operationVec.size(); ++i) {
+            if (waitAsync(operationVec[i], ZNONODE) == ZOK) {
+                const vector<string> &children = 
+                    operationVec[i]->getChildren();
+                treeVec.insert(treeVec.end(), 
+                               children.begin(), 
+                               children.end());
+            }
+        }
+        levelBegin = levelEnd;
+    }
+
+    LOG_DEBUG(LOG,
+              "deleteNodeTree: Deleting %" PRIuPTR " nodes under %s",
+              treeVec.size(),
+              path.c_str());
+
+    size_t deletedCount = 0;
+#ifdef HAVE_ZOO_MULTI
+    /*
+     * Batches are bounded so that a single transaction stays well
+     * below the ZK server's request size limit.
+     */
+    vector<MultiOperation> operationVec;
+    vector<string>::const_reverse_iterator treeVecIt = treeVec.rbegin();
+    while (treeVecIt != treeVec.rend()) {
+        operationVec.clear();
+        for (; (treeVecIt != treeVec.rend()) && 
+                 (operationVec.size() < 
+                  clusterlib::CLNumericInternal::MAX_DELETE_BATCH_SIZE);
+             ++treeVecIt) {
+            operationVec.push_back(MultiOperation::deleteNode(*treeVecIt));
+        }
+        if (!multi(operationVec)) {
+            return false;
+        }
+        deletedCount += operationVec.size();
+        if (progress != NULL) {
+            progress->nodesDeleted(path, deletedCount, treeVec.size());
+        }
+    }
+#else
+    /*
+     * Without transactions, pipeline the deletes of each batch with
+     * deleteNodeAsync().  ZK executes the requests of a session in
+     * order, so a parent issued after its children in the same batch
+     * is deleted after them.
+     */
+    const size_t batchSize = 
+        clusterlib::CLNumericInternal::MAX_DELETE_BATCH_SIZE;
+    size_t batchEnd = treeVec.size();
+    while (batchEnd > 0) {
+        size_t batchBegin = (batchEnd > batchSize) ? batchEnd - batchSize : 0;
+        vector<AsyncOperationSP> operationVec;
+        operationVec.reserve(batchEnd - batchBegin);
+        for (size_t i = batchEnd; i > batchBegin; --i) {
+            operationVec.push_back(deleteNodeAsync(treeVec[i - 1]));
+        }
+        bool changed = false;
+        for (size_t i = 0; i < operationVec.size(); ++i) {
+            operationVec[i]->waitUsecs(-1);
+            int32_t rc = operationVec[i]->getRc();
+            if ((rc == ZNOTEMPTY) || (rc == ZNONODE)) {
+                changed = true;
+            }
+            else {
+                waitAsync(operationVec[i]);
+            }
+        }
+        if (changed) {
+            return false;
+        }
+        deletedCount += operationVec.size();
+        batchEnd = batchBegin;
+        if (progress != NULL) {
+            progress->nodesDeleted(path, deletedCount, treeVec.size());
+        }
+    }
+#endif
+
+    return true;
+}
+
+bool
+ZooKeeperAdapter::nodeExists(const string &path,
+                             ZKEventListener *listener,
+                             void *context, 
+                             Stat *stat)
+{
+    TRACE(LOG, "nodeExists");
+
+    validatePath(path);
 
     struct Stat tmpStat;
     if (stat == NULL) {
@@ -1126,7 +1954,7 @@ ZooKeeperAdapter::nodeExists(const string &path,
     memset(stat, 0, sizeof(Stat));
 
     int32_t rc;
-    RetryHandler rh(m_zkConfig);
+    RetryHandler rh(m_zkConfig, getStatsRecorder());
 
     LOG_DEBUG(LOG,
               "nodeExists: path (%s), listener (%p), "
@@ -1144,22 +1972,45 @@ ZooKeeperAdapter::nodeExists(const string &path,
     clusterlib::CallbackAndContext *callbackAndContext =
         getListenerAndContextManager()->createCallbackAndContext(listener,
                                                                  context);
-    do {
-        verifyConnection();
-        if (listener == NULL) {
-            rc = zoo_exists(mp_zkHandle,
-                            path.c_str(),
-                            0,
-                            stat);
-        }
-        else {
-            rc = zoo_wexists(mp_zkHandle,
-                             path.c_str(),
-                             zkWatcher,
-                             callbackAndContext,
-                             stat);
-        }
-    } while (((rc != ZOK) && (rc != ZNONODE)) && (rh.handleRC(rc)));
+    if (listener != NULL) {
+        addWatch(callbackAndContext, 
+                 ZKWatchRecord(path, 
+                               ZKWatchRecord::NODE_WATCH, 
+                               listener, 
+                               context));
+    }
+    {
+        RepositoryOperationTimer timer(getStatsRecorder(), 
+                                       clusterlib::RepositoryStats::EXISTS);
+        do {
+            verifyConnection();
+            if (listener == NULL) {
+                rc = zoo_exists(mp_zkHandle,
+                                path.c_str(),
+                                0,
+                                stat);
+            }
+            else {
+                rc = zoo_wexists(mp_zkHandle,
+                                 path.c_str(),
+                                 zkWatcher,
+                                 callbackAndContext,
+                                 stat);
+            }
+        } while (((rc != ZOK) && (rc != ZNONODE)) && (rh.handleRC(rc)));
+        timer.setRc(rc);
+    }
+    if ((listener != NULL) && ((rc == ZOK) || (rc == ZNONODE))) {
+        getStatsRecorder().recordWatch();
+        setWatchZxid(callbackAndContext, (rc == ZOK) ? stat->mzxid : 0);
+    }
+    else {
+        removeWatch(callbackAndContext);
+    }
+    if (listener == NULL) {
+        getListenerAndContextManager()->deleteCallbackAndContext(
+            callbackAndContext);
+    }
     if (rc != ZOK) {
         if (rc == ZNONODE) {
             LOG_DEBUG(LOG, 
@@ -1171,8 +2022,10 @@ ZooKeeperAdapter::nodeExists(const string &path,
                   "nodeExists: Error %d for %s", 
                   rc, 
                   path.c_str());
-        getListenerAndContextManager()->deleteCallbackAndContext(
-            callbackAndContext);
+        if (listener != NULL) {
+            getListenerAndContextManager()->deleteCallbackAndContext(
+                callbackAndContext);
+        }
 
         throwErrorCode(
             string("Unable to check existence of node ") + path,
@@ -1195,9 +2048,11 @@ ZooKeeperAdapter::getNodeChildren(const string &path,
     
     String_vector children;
     memset(&children, 0, sizeof(children));
+    struct Stat stat;
+    memset(&stat, 0, sizeof(stat));
 
     int32_t rc;
-    RetryHandler rh(m_zkConfig);
+    RetryHandler rh(m_zkConfig, getStatsRecorder());
 
     LOG_DEBUG(LOG,
               "getNodeChildren: path (%s), listener (%p), "
@@ -1214,22 +2069,43 @@ ZooKeeperAdapter::getNodeChildren(const string &path,
     clusterlib::CallbackAndContext *callbackAndContext =
         getListenerAndContextManager()->createCallbackAndContext(listener,
                                                                  context);
-    do {
-        verifyConnection();
-        if (listener == NULL) {
-            rc = zoo_get_children(mp_zkHandle,
-                                  path.c_str(), 
-                                  0,
-                                  &children);
-        }
-        else {
-            rc = zoo_wget_children(mp_zkHandle,
-                                   path.c_str(), 
-                                   zkWatcher,
-                                   callbackAndContext,
-                                   &children);
-        }
-    } while (((rc != ZOK) && (rc != ZNONODE)) && (rh.handleRC(rc)));
+    if (listener != NULL) {
+        addWatch(callbackAndContext, 
+                 ZKWatchRecord(path, 
+                               ZKWatchRecord::CHILD_WATCH, 
+                               listener, 
+                               context));
+    }
+    {
+        RepositoryOperationTimer timer(
+            getStatsRecorder(), clusterlib::RepositoryStats::GET_CHILDREN);
+        do {
+            verifyConnection();
+            if (listener == NULL) {
+                rc = zoo_get_children2(mp_zkHandle,
+                                       path.c_str(), 
+                                       0,
+                                       &children,
+                                       &stat);
+            }
+            else {
+                rc = zoo_wget_children2(mp_zkHandle,
+                                        path.c_str(), 
+                                        zkWatcher,
+                                        callbackAndContext,
+                                        &children,
+                                        &stat);
+            }
+        } while (((rc != ZOK) && (rc != ZNONODE)) && (rh.handleRC(rc)));
+        timer.setRc(rc);
+    }
+    if ((listener != NULL) && (rc == ZOK)) {
+        getStatsRecorder().recordWatch();
+        setWatchZxid(callbackAndContext, stat.pzxid);
+    }
+    else {
+        removeWatch(callbackAndContext);
+    }
     nodeList.clear();
     if ((rc != ZOK) && (rc != ZNONODE)) {
         LOG_ERROR(LOG, 
@@ -1244,7 +2120,8 @@ ZooKeeperAdapter::getNodeChildren(const string &path,
                               m_state == AS_CONNECTED);
     } 
 
-    if (listener == NULL) {
+    /* ZK does not set a watch on a missing node's children */
+    if ((listener == NULL) || (rc == ZNONODE)) {
         getListenerAndContextManager()->deleteCallbackAndContext(
             callbackAndContext);
     }
@@ -1283,15 +2160,23 @@ ZooKeeperAdapter::getNodeData(const string &path,
                               string &data,
                               ZKEventListener *listener,
                               void *context, 
-                              Stat *stat)
+                              Stat *stat,
+                              int32_t dataLengthHint)
 {
     TRACE(LOG, "getNodeData");
 
     validatePath(path);
    
-    const int32_t MAX_DATA_LENGTH = 1024 * 1024;
-    char *buffer = new char[MAX_DATA_LENGTH];
-    memset(buffer, 0, MAX_DATA_LENGTH);
+    /*
+     * Read into the per-thread buffer, sized for the expected data
+     * if the caller knows it.
+     */
+    const int32_t MAX_DATA_LENGTH = 
+        clusterlib::CLNumericInternal::MAX_ZNODE_DATA_LENGTH;
+    if (dataLengthHint >= MAX_DATA_LENGTH) {
+        dataLengthHint = MAX_DATA_LENGTH - 1;
+    }
+    vector<char> &buffer = ReadBufferPool::getBuffer(dataLengthHint + 1);
     struct Stat tmpStat;
     if (stat == NULL) {
         stat = &tmpStat;
@@ -1300,7 +2185,9 @@ ZooKeeperAdapter::getNodeData(const string &path,
     
     int32_t rc;
     int32_t len;
-    RetryHandler rh(m_zkConfig);
+    RetryHandler rh(m_zkConfig, getStatsRecorder());
+    RepositoryOperationTimer timer(getStatsRecorder(), 
+                                   clusterlib::RepositoryStats::GET_DATA);
 
     /*
      * Allocate the struct passed in as context for zoo_wget().  It
@@ -1310,14 +2197,21 @@ ZooKeeperAdapter::getNodeData(const string &path,
     clusterlib::CallbackAndContext *callbackAndContext =
         getListenerAndContextManager()->createCallbackAndContext(listener,
                                                                  context);
+    if (listener != NULL) {
+        addWatch(callbackAndContext, 
+                 ZKWatchRecord(path, 
+                               ZKWatchRecord::NODE_WATCH, 
+                               listener, 
+                               context));
+    }
     do {
         verifyConnection();
-        len = MAX_DATA_LENGTH - 1;
+        len = buffer.size() - 1;
         if (listener == NULL) {
             rc = zoo_get(mp_zkHandle, 
                          path.c_str(),
                          0,
-                         buffer, 
+                         &buffer[0], 
                          &len, 
                          stat);
         }
@@ -1326,18 +2220,52 @@ ZooKeeperAdapter::getNodeData(const string &path,
                           path.c_str(),
                           zkWatcher,
                           callbackAndContext,
-                          buffer, 
+                          &buffer[0], 
                           &len, 
                           stat);
         }
     } while (((rc != ZOK) && (rc != ZNONODE)) && (rh.handleRC(rc)));
+
+    /*
+     * ZK truncates the data to the buffer size.  If the data was
+     * larger than expected, grow the buffer and read it again.  The
+     * watch (if any) was already set by the first read.
+     */
+    while ((rc == ZOK) && 
+           (len == static_cast<int32_t>(buffer.size()) - 1) &&
+           (stat->dataLength > len)) {
+        LOG_DEBUG(LOG,
+                  "getNodeData: Growing buffer from %d to %d for %s",
+                  len,
+                  stat->dataLength,
+                  path.c_str());
+        buffer.resize(stat->dataLength + 1);
+        do {
+            verifyConnection();
+            len = buffer.size() - 1;
+            rc = zoo_get(mp_zkHandle, 
+                         path.c_str(),
+                         0,
+                         &buffer[0], 
+                         &len, 
+                         stat);
+        } while (((rc != ZOK) && (rc != ZNONODE)) && (rh.handleRC(rc)));
+    }
+    timer.setRc(rc);
+    if ((listener != NULL) && (rc == ZOK)) {
+        setWatchZxid(callbackAndContext, stat->mzxid);
+    }
+    else {
+        removeWatch(callbackAndContext);
+    }
+
     data.clear();
     if ((rc != ZOK) && (rc != ZNONODE)) {
         LOG_ERROR(LOG, 
                   "getNodeData: Error %d for %s", 
                   rc, 
                   path.c_str());
-        delete [] buffer;
+        ReadBufferPool::releaseBuffer(buffer);
         getListenerAndContextManager()->deleteCallbackAndContext(
             callbackAndContext);
         throwErrorCode(
@@ -1346,27 +2274,40 @@ ZooKeeperAdapter::getNodeData(const string &path,
             m_state == AS_CONNECTED);
     } 
 
-    LOG_DEBUG(LOG,
-              "getNodeData: path (%s), listener (%p), "
-              "context (%p), stat (%p), data (%s)\n",
-              path.c_str(),
-              listener,
-              context,
-              stat,
-              buffer);
-    
-    if (listener == NULL) {
+    /* ZK does not set a data watch on a missing node */
+    if ((listener == NULL) || (rc == ZNONODE)) {
         getListenerAndContextManager()->deleteCallbackAndContext(
             callbackAndContext);
     }
     
     if (rc == ZOK) {
-        data.assign(buffer, len);
-        delete [] buffer;
+        if (len > 0) {
+            data.assign(&buffer[0], len);
+        }
+        ReadBufferPool::releaseBuffer(buffer);
+        getStatsRecorder().recordBytesRead(data.size());
+        if (listener != NULL) {
+            getStatsRecorder().recordWatch();
+        }
+        if (!decodeData(path, data)) {
+            data.clear();
+            throwErrorCode(
+                string("Unable to decode data of node ") + path,
+                ZMARSHALLINGERROR,
+                m_state == AS_CONNECTED);
+        }
+        LOG_DEBUG(LOG,
+                  "getNodeData: path (%s), listener (%p), "
+                  "context (%p), stat (%p), data (%s)\n",
+                  path.c_str(),
+                  listener,
+                  context,
+                  stat,
+                  data.c_str());
         return true;
     }
     else {
-        delete [] buffer;
+        ReadBufferPool::releaseBuffer(buffer);
         return false;
     }
 }
@@ -1382,23 +2323,34 @@ ZooKeeperAdapter::setNodeData(const string &path,
     validatePath(path);
 
     int32_t rc;
-    RetryHandler rh(m_zkConfig);
+    RetryHandler rh(m_zkConfig, getStatsRecorder());
+    string data = encodeData(value);
 
     LOG_DEBUG(LOG,
-              "setNodeData: path (%s), value (%s), version (%d)\n",
+              "setNodeData: path (%s), value (%s), version (%d), "
+              "stored length (%" PRIuPTR ")\n",
               path.c_str(),
               value.c_str(),
-              version);
+              version,
+              data.length());
 
-    do {
-        verifyConnection();
-        rc = zoo_set2(mp_zkHandle,
-                      path.c_str(),
-                      value.c_str(),
-                      value.length(), 
-                      version,
-                      stat);
-    } while ((rc != ZOK) && (rh.handleRC(rc)));
+    {
+        RepositoryOperationTimer timer(
+            getStatsRecorder(), clusterlib::RepositoryStats::SET_DATA);
+        do {
+            verifyConnection();
+            rc = zoo_set2(mp_zkHandle,
+                          path.c_str(),
+                          data.c_str(),
+                          data.length(), 
+                          version,
+                          stat);
+        } while ((rc != ZOK) && (rh.handleRC(rc)));
+        timer.setRc(rc);
+    }
+    if (rc == ZOK) {
+        getStatsRecorder().recordBytesWritten(data.length());
+    }
     if (rc != ZOK) {
         LOG_ERROR(LOG, 
                   "setNodeData: Error %d for %s", 
@@ -1410,5 +2362,1008 @@ ZooKeeperAdapter::setNodeData(const string &path,
     }
 }
 
+AsyncOperation::AsyncOperation(OperationType type,
+                               const string &path,
+                               AsyncOperationCallback *callback)
+    : m_type(type),
+      m_path(path),
+      mp_callback(callback),
+      m_rc(ZINVALIDSTATE),
+      m_decodePending(false),
+      mp_statsRecorder(NULL),
+      mp_adapter(NULL),
+      mp_callbackAndContext(NULL),
+      m_startUsecs(clusterlib::TimerService::getCurrentTimeUsecs())
+{
+    memset(&m_stat, 0, sizeof(m_stat));
+}
+
+int32_t
+AsyncOperation::getRc() const
+{
+    decodeData();
+    return m_rc;
+}
+
+const string &
+AsyncOperation::getData() const
+{
+    decodeData();
+    return m_data;
+}
+
+void
+AsyncOperation::decodeData() const
+{
+    clusterlib::Locker l(&m_decodeMutex);
+    if (!m_decodePending) {
+        return;
+    }
+    m_decodePending = false;
+
+    if (!DataCodec::decode(m_data)) {
+        LOG_ERROR(LOG,
+                  "decodeData: Corrupt compressed data (%" PRIuPTR 
+                  " bytes) in %s",
+                  m_data.size(),
+                  m_path.c_str());
+        m_data.clear();
+        m_rc = ZMARSHALLINGERROR;
+        if (mp_statsRecorder != NULL) {
+            mp_statsRecorder->recordDecodeError();
+        }
+        return;
+    }
+    if (mp_statsRecorder != NULL) {
+        mp_statsRecorder->recordBytesDecoded(m_data.size());
+    }
+}
+
+bool
+AsyncOperation::waitUsecs(int64_t usecTimeout) const
+{
+    TRACE(LOG, "waitUsecs");
+
+    return m_predMutexCond.predWaitUsecs(usecTimeout);
+}
+
+bool
+AsyncOperation::isDone() const
+{
+    return m_predMutexCond.predWaitUsecs(0);
+}
+
+void
+AsyncOperation::complete(int32_t rc)
+{
+    TRACE(LOG, "complete");
+
+    m_rc = rc;
+    if (mp_callback != NULL) {
+        try {
+            mp_callback->operationCompleted(*this);
+        }
+        catch (std::exception &e) {
+            LOG_ERROR(LOG,
+                      "complete: Callback for path %s threw: %s",
+                      m_path.c_str(),
+                      e.what());
+        }
+    }
+    m_predMutexCond.predSignal();
+}
+
+AsyncOperationSP *
+ZooKeeperAdapter::prepareAsync(const AsyncOperationSP &operationSP,
+                               ZKEventListener *listener,
+                               void *context)
+{
+    TRACE(LOG, "prepareAsync");
+
+    validatePath(operationSP->getPath());
+
+    operationSP->mp_adapter = this;
+    operationSP->mp_statsRecorder = &getStatsRecorder();
+    if (listener != NULL) {
+        /*
+         * Allocate the struct passed in as context for the watch.  It
+         * will be deallocated when the event is processed through the
+         * watcher function or by finishAsync() if no watch was set.
+         */
+        operationSP->mp_callbackAndContext =
+            getListenerAndContextManager()->createCallbackAndContext(
+                listener, context);
+        addWatch(operationSP->mp_callbackAndContext,
+                 ZKWatchRecord(
+                     operationSP->getPath(),
+                     (operationSP->getType() == 
+                      AsyncOperation::GET_NODE_CHILDREN) ?
+                     ZKWatchRecord::CHILD_WATCH : ZKWatchRecord::NODE_WATCH,
+                     listener,
+                     context));
+    }
+
+    /* 
+     * Keep the operation alive until the completion function
+     * runs, even if the caller drops its reference.
+     */
+    return new AsyncOperationSP(operationSP);
+}
+
+void
+ZooKeeperAdapter::abortAsync(AsyncOperationSP *completionData, int32_t rc)
+{
+    TRACE(LOG, "abortAsync");
+
+    AsyncOperationSP operationSP = *completionData;
+    delete completionData;
+    if (operationSP->mp_callbackAndContext != NULL) {
+        removeWatch(operationSP->mp_callbackAndContext);
+        getListenerAndContextManager()->deleteCallbackAndContext(
+            operationSP->mp_callbackAndContext);
+        operationSP->mp_callbackAndContext = NULL;
+    }
+    recordAsync(*operationSP, rc, false);
+    operationSP->complete(rc);
+}
+
+void
+ZooKeeperAdapter::finishAsync(AsyncOperationSP *completionData, int32_t rc)
+{
+    TRACE(LOG, "finishAsync");
+
+    AsyncOperationSP operationSP = *completionData;
+    delete completionData;
+
+    /*
+     * ZK only keeps the watch for exists on ZOK or ZNONODE and
+     * for the other watchable operations on ZOK.
+     */
+    bool watchSet = (rc == ZOK) || 
+        ((rc == ZNONODE) && 
+         (operationSP->getType() == AsyncOperation::NODE_EXISTS));
+    if (operationSP->mp_callbackAndContext != NULL) {
+        if (watchSet) {
+            const Stat &stat = operationSP->getStat();
+            if (operationSP->getType() == AsyncOperation::GET_NODE_CHILDREN) {
+                setWatchZxid(operationSP->mp_callbackAndContext, stat.pzxid);
+            }
+            else {
+                setWatchZxid(operationSP->mp_callbackAndContext,
+                             (rc == ZOK) ? stat.mzxid : 0);
+            }
+        }
+        else {
+            removeWatch(operationSP->mp_callbackAndContext);
+            getListenerAndContextManager()->deleteCallbackAndContext(
+                operationSP->mp_callbackAndContext);
+        }
+    }
+    recordAsync(*operationSP, 
+                rc, 
+                (operationSP->mp_callbackAndContext != NULL) && watchSet);
+    operationSP->mp_callbackAndContext = NULL;
+
+    /* Decompressing is left to the reader of the data. */
+    if ((rc == ZOK) && 
+        (operationSP->getType() == AsyncOperation::GET_NODE_DATA)) {
+        operationSP->m_decodePending = true;
+    }
+    operationSP->complete(rc);
+}
+
+void
+ZooKeeperAdapter::statCompletion(int32_t rc,
+                                 const struct Stat *stat,
+                                 const void *data)
+{
+    AsyncOperationSP *completionData = 
+        reinterpret_cast<AsyncOperationSP *>(const_cast<void *>(data));
+    if ((rc == ZOK) && (stat != NULL)) {
+        (*completionData)->m_stat = *stat;
+    }
+    (*completionData)->mp_adapter->finishAsync(completionData, rc);
+}
+
+void
+ZooKeeperAdapter::stringsCompletion(int32_t rc,
+                                    const struct String_vector *strings,
+                                    const struct Stat *stat,
+                                    const void *data)
+{
+    AsyncOperationSP *completionData = 
+        reinterpret_cast<AsyncOperationSP *>(const_cast<void *>(data));
+    if ((rc == ZOK) && (stat != NULL)) {
+        (*completionData)->m_stat = *stat;
+    }
+    if ((rc == ZOK) && (strings != NULL)) {
+        const string &path = (*completionData)->getPath();
+        vector<string> &children = (*completionData)->m_children;
+        children.reserve(strings->count);
+        for (int32_t i = 0; i < strings->count; ++i) {
+            /*
+             * Convert each child's path from relative to absolute.
+             */
+            string absPath(path);
+            if (path != "/") {
+                absPath.append("/");
+            } 
+            absPath.append(strings->data[i]); 
+            children.push_back(absPath);
+        }
+        sort(children.begin(), children.end());
+    }
+    (*completionData)->mp_adapter->finishAsync(completionData, rc);
+}
+
+void
+ZooKeeperAdapter::dataCompletion(int32_t rc,
+                                 const char *value,
+                                 int32_t valueLen,
+                                 const struct Stat *stat,
+                                 const void *data)
+{
+    AsyncOperationSP *completionData = 
+        reinterpret_cast<AsyncOperationSP *>(const_cast<void *>(data));
+    if (rc == ZOK) {
+        if ((value != NULL) && (valueLen > 0)) {
+            (*completionData)->m_data.assign(value, valueLen);
+        }
+        if (stat != NULL) {
+            (*completionData)->m_stat = *stat;
+        }
+    }
+    (*completionData)->mp_adapter->finishAsync(completionData, rc);
+}
+
+void
+ZooKeeperAdapter::stringCompletion(int32_t rc,
+                                   const char *value,
+                                   const void *data)
+{
+    AsyncOperationSP *completionData = 
+        reinterpret_cast<AsyncOperationSP *>(const_cast<void *>(data));
+    if ((rc == ZOK) && (value != NULL)) {
+        (*completionData)->m_data.assign(value);
+    }
+    (*completionData)->mp_adapter->finishAsync(completionData, rc);
+}
+
+void
+ZooKeeperAdapter::voidCompletion(int32_t rc, const void *data)
+{
+    AsyncOperationSP *completionData = 
+        reinterpret_cast<AsyncOperationSP *>(const_cast<void *>(data));
+    (*completionData)->mp_adapter->finishAsync(completionData, rc);
+}
+
+AsyncOperationSP
+ZooKeeperAdapter::nodeExistsAsync(const string &path,
+                                  ZKEventListener *listener,
+                                  void *context,
+                                  AsyncOperationCallback *callback)
+{
+    TRACE(LOG, "nodeExistsAsync");
+
+    AsyncOperationSP operationSP(
+        new AsyncOperation(AsyncOperation::NODE_EXISTS, path, callback));
+    AsyncOperationSP *completionData = 
+        prepareAsync(operationSP, listener, context);
+
+    int32_t rc;
+    try {
+        verifyConnection();
+    }
+    catch (...) {
+        abortAsync(completionData, ZCONNECTIONLOSS);
+        throw;
+    }
+    if (listener == NULL) {
+        rc = zoo_aexists(mp_zkHandle,
+                         path.c_str(),
+                         0,
+                         statCompletion,
+                         completionData);
+    }
+    else {
+        rc = zoo_awexists(mp_zkHandle,
+                          path.c_str(),
+                          zkWatcher,
+                          operationSP->mp_callbackAndContext,
+                          statCompletion,
+                          completionData);
+    }
+    if (rc != ZOK) {
+        LOG_WARN(LOG, 
+                 "nodeExistsAsync: Error %d issuing for %s", 
+                 rc, 
+                 path.c_str());
+        abortAsync(completionData, rc);
+    }
+
+    return operationSP;
+}
+
+AsyncOperationSP
+ZooKeeperAdapter::getNodeChildrenAsync(const string &path,
+                                       ZKEventListener *listener,
+                                       void *context,
+                                       AsyncOperationCallback *callback)
+{
+    TRACE(LOG, "getNodeChildrenAsync");
+
+    AsyncOperationSP operationSP(
+        new AsyncOperation(
+            AsyncOperation::GET_NODE_CHILDREN, path, callback));
+    AsyncOperationSP *completionData = 
+        prepareAsync(operationSP, listener, context);
+
+    int32_t rc;
+    try {
+        verifyConnection();
+    }
+    catch (...) {
+        abortAsync(completionData, ZCONNECTIONLOSS);
+        throw;
+    }
+    if (listener == NULL) {
+        rc = zoo_aget_children2(mp_zkHandle,
+                                path.c_str(),
+                                0,
+                                stringsCompletion,
+                                completionData);
+    }
+    else {
+        rc = zoo_awget_children2(mp_zkHandle,
+                                 path.c_str(),
+                                 zkWatcher,
+                                 operationSP->mp_callbackAndContext,
+                                 stringsCompletion,
+                                 completionData);
+    }
+    if (rc != ZOK) {
+        LOG_WARN(LOG, 
+                 "getNodeChildrenAsync: Error %d issuing for %s", 
+                 rc, 
+                 path.c_str());
+        abortAsync(completionData, rc);
+    }
+
+    return operationSP;
+}
+
+AsyncOperationSP
+ZooKeeperAdapter::getNodeDataAsync(const string &path,
+                                   ZKEventListener *listener,
+                                   void *context,
+                                   AsyncOperationCallback *callback)
+{
+    TRACE(LOG, "getNodeDataAsync");
+
+    AsyncOperationSP operationSP(
+        new AsyncOperation(AsyncOperation::GET_NODE_DATA, path, callback));
+    AsyncOperationSP *completionData = 
+        prepareAsync(operationSP, listener, context);
+
+    int32_t rc;
+    try {
+        verifyConnection();
+    }
+    catch (...) {
+        abortAsync(completionData, ZCONNECTIONLOSS);
+        throw;
+    }
+    if (listener == NULL) {
+        rc = zoo_aget(mp_zkHandle,
+                      path.c_str(),
+                      0,
+                      dataCompletion,
+                      completionData);
+    }
+    else {
+        rc = zoo_awget(mp_zkHandle,
+                       path.c_str(),
+                       zkWatcher,
+                       operationSP->mp_callbackAndContext,
+                       dataCompletion,
+                       completionData);
+    }
+    if (rc != ZOK) {
+        LOG_WARN(LOG, 
+                 "getNodeDataAsync: Error %d issuing for %s", 
+                 rc, 
+                 path.c_str());
+        abortAsync(completionData, rc);
+    }
+
+    return operationSP;
+}
+
+AsyncOperationSP
+ZooKeeperAdapter::createNodeAsync(const string &path,
+                                  const string &value,
+                                  int32_t flags,
+                                  AsyncOperationCallback *callback)
+{
+    TRACE(LOG, "createNodeAsync");
+
+    AsyncOperationSP operationSP(
+        new AsyncOperation(AsyncOperation::CREATE_NODE, path, callback));
+    AsyncOperationSP *completionData = 
+        prepareAsync(operationSP, NULL, NULL);
+
+    try {
+        verifyConnection();
+    }
+    catch (...) {
+        abortAsync(completionData, ZCONNECTIONLOSS);
+        throw;
+    }
+    string data = encodeData(value, flags);
+    int32_t rc = zoo_acreate(mp_zkHandle,
+                             path.c_str(),
+                             data.c_str(),
+                             data.length(),
+                             &ZOO_OPEN_ACL_UNSAFE,
+                             getZKFlags(flags),
+                             stringCompletion,
+                             completionData);
+    if (rc == ZOK) {
+        getStatsRecorder().recordBytesWritten(data.length());
+    }
+    else {
+        LOG_WARN(LOG, 
+                 "createNodeAsync: Error %d issuing for %s", 
+                 rc, 
+                 path.c_str());
+        abortAsync(completionData, rc);
+    }
+
+    return operationSP;
+}
+
+AsyncOperationSP
+ZooKeeperAdapter::setNodeDataAsync(const string &path,
+                                   const string &value,
+                                   int32_t version,
+                                   AsyncOperationCallback *callback)
+{
+    TRACE(LOG, "setNodeDataAsync");
+
+    AsyncOperationSP operationSP(
+        new AsyncOperation(AsyncOperation::SET_NODE_DATA, path, callback));
+    AsyncOperationSP *completionData = 
+        prepareAsync(operationSP, NULL, NULL);
+
+    try {
+        verifyConnection();
+    }
+    catch (...) {
+        abortAsync(completionData, ZCONNECTIONLOSS);
+        throw;
+    }
+    string data = encodeData(value);
+    int32_t rc = zoo_aset(mp_zkHandle,
+                          path.c_str(),
+                          data.c_str(),
+                          data.length(),
+                          version,
+                          statCompletion,
+                          completionData);
+    if (rc == ZOK) {
+        getStatsRecorder().recordBytesWritten(data.length());
+    }
+    else {
+        LOG_WARN(LOG, 
+                 "setNodeDataAsync: Error %d issuing for %s", 
+                 rc, 
+                 path.c_str());
+        abortAsync(completionData, rc);
+    }
+
+    return operationSP;
+}
+
+AsyncOperationSP
+ZooKeeperAdapter::deleteNodeAsync(const string &path,
+                                  int32_t version,
+                                  AsyncOperationCallback *callback)
+{
+    TRACE(LOG, "deleteNodeAsync");
+
+    AsyncOperationSP operationSP(
+        new AsyncOperation(AsyncOperation::DELETE_NODE, path, callback));
+    AsyncOperationSP *completionData = 
+        prepareAsync(operationSP, NULL, NULL);
+
+    try {
+        verifyConnection();
+    }
+    catch (...) {
+        abortAsync(completionData, ZCONNECTIONLOSS);
+        throw;
+    }
+    int32_t rc = zoo_adelete(mp_zkHandle,
+                             path.c_str(),
+                             version,
+                             voidCompletion,
+                             completionData);
+    if (rc != ZOK) {
+        LOG_WARN(LOG, 
+                 "deleteNodeAsync: Error %d issuing for %s", 
+                 rc, 
+                 path.c_str());
+        abortAsync(completionData, rc);
+    }
+
+    return operationSP;
+}
+
+int32_t
+Repository::waitAsync(const AsyncOperationSP &operation,
+                      int32_t allowedRc)
+{
+    TRACE(LOG, "waitAsync");
+
+    operation->waitUsecs(-1);
+    int32_t rc = operation->getRc();
+    if ((rc != ZOK) && (rc != allowedRc)) {
+        LOG_ERROR(LOG, 
+                  "waitAsync: Error %d for operation %d on %s", 
+                  rc, 
+                  operation->getType(),
+                  operation->getPath().c_str());
+        ZooKeeperAdapter::throwErrorCode(
+            string("Asynchronous operation failed on node ") + 
+            operation->getPath(),
+            rc,
+            getState() == AS_CONNECTED);
+    }
+
+    return rc;
+}
+
+/**
+ * Get the path of a chunk of a value stored by setChunkedNodeData().
+ */
+static string
+getDataChunkPath(const string &chunksPath, int32_t index)
+{
+    ostringstream oss;
+    oss << chunksPath << "/" << index;
+    return oss.str();
+}
+
+bool
+Repository::isChunkedValue(const string &value)
+{
+    /*
+     * A small value that starts like a manifest is split anyway so
+     * that getChunkedNodeData() cannot mistake it for one.
+     */
+    const size_t chunkSize = clusterlib::CLNumericInternal::DATA_CHUNK_SIZE;
+    return ((value.size() > chunkSize) || DataCodec::isChunkManifest(value));
+}
+
+void
+Repository::setChunkedNodeData(const string &path,
+                               const string &value,
+                               int32_t version,
+                               Stat *stat)
+{
+    TRACE(LOG, "setChunkedNodeData");
+
+    validatePath(path);
+
+    Stat tmpStat;
+    if (stat == NULL) {
+        stat = &tmpStat;
+    }
+
+    const size_t chunkSize = clusterlib::CLNumericInternal::DATA_CHUNK_SIZE;
+    if (!isChunkedValue(value)) {
+        setNodeData(path, value, version, stat);
+        if (stat->numChildren > 0) {
+            removeDataChunks(path, "", stat->version);
+        }
+        return;
+    }
+
+    /*
+     * Decide on splitting from the encoded size, so that a value
+     * that compresses well is stored in the node itself.  The
+     * chunks hold pieces of the encoded value and are not encoded
+     * again.
+     */
+    string encoded = encodeData(value);
+    string chunksPath;
+    string chunksName;
+    int32_t chunkCount = 0;
+    int32_t rc = ZOK;
+    if ((encoded.size() > chunkSize) || DataCodec::isChunkManifest(value)) {
+        /*
+         * Write the chunks below a new sequence node so that they do
+         * not disturb the chunks of the current value, which may be
+         * read concurrently.
+         */
+        if (createSequence(path + "/" + 
+                           clusterlib::CLStringInternal::DATA_CHUNKS_PREFIX,
+                           "",
+                           0,
+                           false,
+                           chunksPath) == -1) {
+            ZooKeeperAdapter::throwErrorCode(
+                string("setChunkedNodeData: Unable to create chunks of ") + 
+                path,
+                ZNONODE,
+                getState() == AS_CONNECTED);
+        }
+        chunksName = chunksPath.substr(path.size() + 1);
+        chunkCount = (encoded.size() + chunkSize - 1) / chunkSize;
+
+        vector<AsyncOperationSP> operationVec;
+        try {
+            for (int32_t i = 0; i < chunkCount; ++i) {
+                /* Only frames a piece that starts with a NUL byte. */
+                string piece;
+                DataCodec::encode(
+                    encoded.substr(i * chunkSize, chunkSize), -1, piece);
+                operationVec.push_back(
+                    createNodeAsync(getDataChunkPath(chunksPath, i),
+                                    piece,
+                                    DATA_ENCODED));
+            }
+        }
+        catch (const Exception &e) {
+            LOG_ERROR(LOG,
+                      "setChunkedNodeData: Issuing chunks of %s failed: %s",
+                      path.c_str(),
+                      e.what());
+            rc = (e.getErrorCode() != ZOK) ? e.getErrorCode() : ZSYSTEMERROR;
+        }
+        vector<AsyncOperationSP>::const_iterator operationVecIt;
+        for (operationVecIt = operationVec.begin();
+             operationVecIt != operationVec.end();
+             ++operationVecIt) {
+            (*operationVecIt)->waitUsecs(-1);
+            if ((rc == ZOK) && ((*operationVecIt)->getRc() != ZOK)) {
+                rc = (*operationVecIt)->getRc();
+            }
+        }
+    }
+
+    /*
+     * Commit by replacing the node's data with the manifest (or the
+     * encoded value if it fits), as long as the chunks were not
+     * removed by a newer value.  Without an expected version, retry
+     * if the node changes in between.
+     */
+    string data;
+    int32_t dataFlags = DATA_ENCODED;
+    if (chunkCount > 0) {
+        data = DataCodec::encodeChunkManifest(
+            chunksName, chunkCount, encoded.size());
+        dataFlags = 0;
+    }
+    else {
+        data.swap(encoded);
+    }
+    int32_t committedVersion = -1;
+    for (int32_t attempt = 0; 
+         (rc == ZOK) && 
+             (attempt < 
+              clusterlib::CLNumericInternal::MAX_CHUNKED_DATA_ATTEMPTS);
+         ++attempt) {
+        int32_t expectedVersion = version;
+        if (expectedVersion == -1) {
+            if (!nodeExists(path, NULL, NULL, stat)) {
+                rc = ZNONODE;
+                break;
+            }
+            expectedVersion = stat->version;
+        }
+
+        vector<MultiOperation> operations;
+        if (chunkCount > 0) {
+            operations.push_back(
+                MultiOperation::checkVersion(chunksPath, -1));
+        }
+        operations.push_back(
+            MultiOperation::setNodeData(
+                path, data, expectedVersion, dataFlags));
+        vector<int32_t> results;
+        if (multi(operations, &results)) {
+            committedVersion = expectedVersion + 1;
+            break;
+        }
+        if ((results.size() < operations.size()) || 
+            ((chunkCount > 0) && (results[0] != ZOK))) {
+            /* A newer value removed the chunks, so this one is stale. */
+            rc = ZBADVERSION;
+            break;
+        }
+        rc = results.back();
+        if ((rc == ZBADVERSION) && (version == -1)) {
+            LOG_WARN(LOG,
+                     "setChunkedNodeData: %s changed while committing, "
+                     "attempt %" PRId32,
+                     path.c_str(),
+                     attempt);
+            rc = ZOK;
+        }
+    }
+    if ((rc == ZOK) && (committedVersion == -1)) {
+        rc = ZBADVERSION;
+    }
+    if (rc != ZOK) {
+        LOG_ERROR(LOG,
+                  "setChunkedNodeData: Error %d writing %" PRIuPTR 
+                  " bytes in %" PRId32 " chunks to %s",
+                  rc,
+                  value.size(),
+                  chunkCount,
+                  path.c_str());
+        if (chunkCount > 0) {
+            try {
+                deleteNode(chunksPath, true);
+            }
+            catch (const Exception &e) {
+                LOG_WARN(LOG,
+                         "setChunkedNodeData: Removing %s failed: %s",
+                         chunksPath.c_str(),
+                         e.what());
+            }
+        }
+        ZooKeeperAdapter::throwErrorCode(
+            string("setChunkedNodeData: Failed for ") + path,
+            rc,
+            getState() == AS_CONNECTED);
+    }
+
+    LOG_DEBUG(LOG,
+              "setChunkedNodeData: Wrote %" PRIuPTR " bytes (%" PRIuPTR 
+              " encoded) in %" PRId32 " chunks to %s (version %" PRId32 ")",
+              value.size(),
+              (chunkCount > 0) ? encoded.size() : data.size(),
+              chunkCount,
+              (chunkCount > 0) ? chunksPath.c_str() : path.c_str(),
+              committedVersion);
+    /*
+     * The multi does not return the Stat, so read it.  If another
+     * write got in first, keep the version of this one so that a
+     * cached copy still loads the newer value.
+     */
+    nodeExists(path, NULL, NULL, stat);
+    stat->version = committedVersion;
+    removeDataChunks(path, chunksName, committedVersion);
+}
+
+bool
+Repository::getChunkedNodeData(const string &path,
+                               string &data,
+                               ZKEventListener *listener,
+                               void *context,
+                               Stat *stat,
+                               int32_t dataLengthHint)
+{
+    TRACE(LOG, "getChunkedNodeData");
+
+    for (int32_t attempt = 0;
+         attempt < clusterlib::CLNumericInternal::MAX_CHUNKED_DATA_ATTEMPTS;
+         ++attempt) {
+        /* The watch on the node only needs to be set once. */
+        if (!getNodeData(path,
+                         data,
+                         (attempt == 0) ? listener : NULL,
+                         context,
+                         stat,
+                         dataLengthHint)) {
+            return false;
+        }
+
+        string chunksName;
+        int32_t chunkCount = 0;
+        int64_t length = 0;
+        if (!DataCodec::decodeChunkManifest(
+                data, chunksName, chunkCount, length)) {
+            return true;
+        }
+
+        string chunksPath = path + "/" + chunksName;
+        vector<AsyncOperationSP> operationVec;
+        for (int32_t i = 0; i < chunkCount; ++i) {
+            operationVec.push_back(
+                getNodeDataAsync(getDataChunkPath(chunksPath, i)));
+        }
+        string value;
+        value.reserve(length);
+        bool complete = true;
+        vector<AsyncOperationSP>::const_iterator operationVecIt;
+        for (operationVecIt = operationVec.begin();
+             operationVecIt != operationVec.end();
+             ++operationVecIt) {
+            if (waitAsync(*operationVecIt, ZNONODE) == ZNONODE) {
+                complete = false;
+            }
+            else if (complete) {
+                value.append((*operationVecIt)->getData());
+            }
+        }
+        if (complete && (static_cast<int64_t>(value.size()) == length)) {
+            if (!decodeData(path, value)) {
+                ZooKeeperAdapter::throwErrorCode(
+                    string("getChunkedNodeData: Corrupt chunks of ") + path,
+                    ZMARSHALLINGERROR,
+                    getState() == AS_CONNECTED);
+            }
+            data.swap(value);
+            return true;
+        }
+
+        /* A newer value removed the chunks, read the new manifest. */
+        LOG_WARN(LOG,
+                 "getChunkedNodeData: Chunks %s of %s changed while "
+                 "reading, attempt %" PRId32,
+                 chunksName.c_str(),
+                 path.c_str(),
+                 attempt);
+    }
+
+    data.clear();
+    ZooKeeperAdapter::throwErrorCode(
+        string("getChunkedNodeData: Unable to read the chunks of ") + path,
+        ZMARSHALLINGERROR,
+        getState() == AS_CONNECTED);
+    return false;
+}
+
+void
+Repository::removeDataChunks(const string &path,
+                             const string &currentChunksName,
+                             int32_t version)
+{
+    TRACE(LOG, "removeDataChunks");
+
+    try {
+        vector<string> children;
+        if (!getNodeChildren(path, children)) {
+            return;
+        }
+
+        /*
+         * Only remove the chunks if the node still has the value that
+         * was just written, so that chunks a newer value refers to
+         * are never removed.
+         */
+        vector<MultiOperation> operations;
+        operations.push_back(MultiOperation::checkVersion(path, version));
+        vector<string>::const_iterator childrenIt;
+        for (childrenIt = children.begin(); 
+             childrenIt != children.end(); 
+             ++childrenIt) {
+            string name = childrenIt->substr(path.size() + 1);
+            if ((name.compare(
+                     0,
+                     clusterlib::CLStringInternal::DATA_CHUNKS_PREFIX.size(),
+                     clusterlib::CLStringInternal::DATA_CHUNKS_PREFIX) != 0) ||
+                ((!currentChunksName.empty()) && 
+                 (name >= currentChunksName))) {
+                continue;
+            }
+            vector<string> chunks;
+            if (!getNodeChildren(*childrenIt, chunks)) {
+                continue;
+            }
+            vector<string>::const_iterator chunksIt;
+            for (chunksIt = chunks.begin(); 
+                 chunksIt != chunks.end(); 
+                 ++chunksIt) {
+                operations.push_back(MultiOperation::deleteNode(*chunksIt));
+            }
+            operations.push_back(MultiOperation::deleteNode(*childrenIt));
+        }
+        if (operations.size() == 1) {
+            return;
+        }
+        if (!multi(operations)) {
+            LOG_DEBUG(LOG,
+                      "removeDataChunks: %s changed, leaving old chunks "
+                      "to the next write",
+                      path.c_str());
+        }
+    }
+    catch (const Exception &e) {
+        LOG_WARN(LOG,
+                 "removeDataChunks: Failed for %s: %s",
+                 path.c_str(),
+                 e.what());
+    }
+}
+
+void
+Repository::getStats(clusterlib::RepositoryStats &stats) const
+{
+    TRACE(LOG, "getStats");
+
+    m_statsRecorder.getStats(stats);
+}
+
+void
+Repository::resetStats()
+{
+    TRACE(LOG, "resetStats");
+
+    m_statsRecorder.reset();
+}
+
+string
+Repository::encodeData(const string &value, int32_t flags) const
+{
+    if (flags & DATA_ENCODED) {
+        return value;
+    }
+    string encoded;
+    DataCodec::encode(value, m_compressionThreshold, encoded);
+    return encoded;
+}
+
+bool
+Repository::decodeData(const string &path, string &data)
+{
+    if (!DataCodec::decode(data)) {
+        LOG_ERROR(LOG,
+                  "decodeData: Corrupt compressed data (%" PRIuPTR 
+                  " bytes) in %s",
+                  data.size(),
+                  path.c_str());
+        m_statsRecorder.recordDecodeError();
+        return false;
+    }
+    m_statsRecorder.recordBytesDecoded(data.size());
+    return true;
+}
+
+void
+Repository::recordAsync(const AsyncOperation &operation,
+                        int32_t rc,
+                        bool watchSet)
+{
+    clusterlib::RepositoryStats::Operation statsOperation;
+    switch (operation.getType()) {
+        case AsyncOperation::NODE_EXISTS:
+            statsOperation = clusterlib::RepositoryStats::EXISTS;
+            break;
+        case AsyncOperation::GET_NODE_CHILDREN:
+            statsOperation = clusterlib::RepositoryStats::GET_CHILDREN;
+            break;
+        case AsyncOperation::GET_NODE_DATA:
+            statsOperation = clusterlib::RepositoryStats::GET_DATA;
+            if (rc == ZOK) {
+                m_statsRecorder.recordBytesRead(
+                    operation.getStat().dataLength);
+            }
+            break;
+        case AsyncOperation::CREATE_NODE:
+            statsOperation = clusterlib::RepositoryStats::CREATE;
+            break;
+        case AsyncOperation::SET_NODE_DATA:
+            statsOperation = clusterlib::RepositoryStats::SET_DATA;
+            break;
+        case AsyncOperation::DELETE_NODE:
+            statsOperation = clusterlib::RepositoryStats::DELETE;
+            break;
+        default:
+            return;
+    }
+    if (watchSet) {
+        m_statsRecorder.recordWatch();
+    }
+    m_statsRecorder.recordOperation(
+        statsOperation,
+        clusterlib::TimerService::getCurrentTimeUsecs() - 
+        operation.m_startUsecs,
+        rc);
+}
+
 }   /* end of 'namespace zk' */
 
@@ -286,332 +286,1395 @@ class EventHandlerWrapper
 #endif
 
 /**
- * \brief This is a wrapper around ZK C synchrounous API.
+ * Flag for Repository::createNodeAsync() and for the CREATE_NODE
+ * and SET_NODE_DATA operations of Repository::multi(): the value is
+ * already encoded with DataCodec and is stored as is.  It is never
+ * passed on to ZK.
  */
-class ZooKeeperAdapter
-    : public ZKEventSource
+const int32_t DATA_ENCODED = 0x10000;
+
+/**
+ * \brief A single operation of a ZooKeeperAdapter::multi() transaction.
+ */
+class MultiOperation
 {
   public:
+    /**
+     * The kind of operation.
+     */
+    enum OperationType {
+        CREATE_NODE = 0,
+        DELETE_NODE,
+        SET_NODE_DATA,
+        CHECK_VERSION
+    };
 
     /**
-     * Get the event type as a string (used primarily for debugging)
+     * Create a node (ancestors must exist or be created earlier in
+     * the same transaction).
      *
-     * @param etype the type passed in to the event
-     * @return the stringified etype
+     * @param path the absolute path name of the node to be created
+     * @param value the initial value to be associated with the node
+     * @param flags the ZK flags of the node to be created
      */
-    static std::string getEventString(int32_t etype);
+    static MultiOperation createNode(const std::string &path,
+                                     const std::string &value = "",
+                                     int flags = 0)
+    {
+        return MultiOperation(CREATE_NODE, path, value, flags, -1);
+    }
 
     /**
-     * Get the state as a string (used primarily for debugging)
+     * Delete a node without children.
      *
-     * @param state the state
-     * @return the stringified state
+     * @param path the absolute path name of the node to be deleted
+     * @param version the expected version of the node, -1 for any
      */
-    static std::string getStateString(int32_t state);
- 
+    static MultiOperation deleteNode(const std::string &path,
+                                     int version = -1)
+    {
+        return MultiOperation(DELETE_NODE, path, "", 0, version);
+    }
+
     /**
-     * Split a sequence node into a name, distributed lock type, and a
-     * sequence number.  This will not be needed when JIRA issues
-     * ZOOKEEPER-616 is resolved.
+     * Set the data of a node.
      *
-     * @param sequenceNode Node to parse
-     * @param pSequenceName If set, will be the name of the node
-     * @param pSequenceNumber If set, will be the sequence number
+     * @param path the absolute path name of the node
+     * @param value the node's data to be set
+     * @param version the expected version of the node, -1 for any
+     * @param flags DATA_ENCODED if value is already encoded, else 0
      */
-    static void splitSequenceNode(
-        const std::string &sequenceNode,
-        std::string *pSequenceName = NULL,
-        int64_t *pSequenceNumber = NULL);
+    static MultiOperation setNodeData(const std::string &path,
+                                      const std::string &value,
+                                      int version = -1,
+                                      int flags = 0)
+    {
+        return MultiOperation(SET_NODE_DATA, path, value, flags, version);
+    }
 
     /**
-     * Takes an ZooKeeper function error code and throws the
-     * appropriate zk::Exception.  If the error code does not map to a
-     * zk::Exception child object, a generic UnknownErrorCodeException
-     * is thrown.  Exceptions will be thrown for all error codes
-     * (including ZOK).
-     * 
-     * @param msg the additional message with the exception
-     * @param errorCode the error code that will be used to generate
-     *        the appropriate zk::Exception
-     * @param connected is the adapter connected?
+     * Make the transaction fail unless the node has this version.
+     *
+     * @param path the absolute path name of the node
+     * @param version the expected version of the node
      */
-    static void throwErrorCode(const std::string &msg,
-                               int32_t errorCode,
-                               bool connected);
+    static MultiOperation checkVersion(const std::string &path,
+                                       int version)
+    {
+        return MultiOperation(CHECK_VERSION, path, "", 0, version);
+    }
+
+    OperationType getType() const { return m_type; }
+    const std::string &getPath() const { return m_path; }
+    const std::string &getValue() const { return m_value; }
+    int getFlags() const { return m_flags; }
+    int getVersion() const { return m_version; }
 
+  private:
     /**
-     * \brief The global function that handles all ZK asynchronous
-     * notifications.
+     * \brief Constructor.  Use the static create functions.
+     */
+    MultiOperation(OperationType type,
+                   const std::string &path,
+                   const std::string &value,
+                   int flags,
+                   int version)
+        : m_type(type),
+          m_path(path),
+          m_value(value),
+          m_flags(flags),
+          m_version(version) {}
+
+  private:
+    /**
+     * The kind of operation.
      */
-    friend void zkWatcher(zhandle_t *, int, int, const char *, void *);
-        
+    OperationType m_type;
+
     /**
-     * \brief The type representing the user's context.
+     * The path of the node.
      */
-    typedef void *ContextType;
-        
+    std::string m_path;
+
     /**
-     * \brief All possible states of this client, in respect to 
-     * \brief connection to the ZK server.
+     * The value for CREATE_NODE and SET_NODE_DATA.
      */
-    enum AdapterState {
-        //mp_zkHandle is NULL
-        AS_DISCONNECTED = 0,
-        //mp_zkHandle is NULL, but no reconnection will be allowed
-        AS_NORECONNECT,
-        //mp_zkHandle is valid but this client is reconnecting
-        AS_CONNECTING,
-        //mp_zkHandle is valid and this client is connected
-        AS_CONNECTED,
-        //mp_zkHandle is valid, however no more calls can be made to ZK API
-        AS_SESSION_EXPIRED
+    std::string m_value;
+
+    /**
+     * The ZK flags for CREATE_NODE, and DATA_ENCODED for CREATE_NODE
+     * and SET_NODE_DATA.
+     */
+    int m_flags;
+
+    /**
+     * The expected version for everything except CREATE_NODE.
+     */
+    int m_version;
+};
+
+class AsyncOperation;
+class ZooKeeperAdapter;
+class RepositoryStatsRecorder;
+
+/**
+ * \brief Interface for being notified when an asynchronous ZK
+ * operation completes.
+ */
+class AsyncOperationCallback
+{
+  public:
+    /**
+     * \brief Destructor.
+     */
+    virtual ~AsyncOperationCallback() {}
+
+    /**
+     * Called from the ZK completion thread after the operation has
+     * completed and before any waiters are woken up.  Implementations
+     * must not block or call the synchronous ZooKeeperAdapter API.
+     *
+     * @param operation the completed operation
+     */
+    virtual void operationCompleted(const AsyncOperation &operation) = 0;
+};
+
+/**
+ * \brief Interface for following the progress of a recursive delete.
+ */
+class DeleteProgressCallback
+{
+  public:
+    /**
+     * \brief Destructor.
+     */
+    virtual ~DeleteProgressCallback() {}
+
+    /**
+     * Called after each batch of a recursive delete has been removed.
+     *
+     * @param path the root of the subtree being deleted
+     * @param deletedCount how many nodes have been deleted so far
+     * @param totalCount how many nodes the subtree had when listed
+     */
+    virtual void nodesDeleted(const std::string &path,
+                              size_t deletedCount,
+                              size_t totalCount) = 0;
+};
+
+/**
+ * \brief The future-like result of an asynchronous ZK operation.
+ *
+ * Returned by the ZooKeeperAdapter::*Async() methods.  Several
+ * operations may be issued back to back so that their round trips to
+ * the ZK server overlap, and then waited on one by one.
+ */
+class AsyncOperation
+{
+  public:
+    /**
+     * The ZooKeeperAdapter method that started this operation.
+     */
+    enum OperationType {
+        NODE_EXISTS = 0,
+        GET_NODE_CHILDREN,
+        GET_NODE_DATA,
+        CREATE_NODE,
+        SET_NODE_DATA,
+        DELETE_NODE
     };
 
     /**
      * \brief Constructor.
-     * Attempts to create a ZK adapter, optionally connecting
-     * to the ZK. Note, that if the connection is to be established
-     * and the given listener is NULL, some events may be lost, 
-     * as they may arrive asynchronously before this method finishes.
-     * 
-     * @param config the ZK configuration
-     * @param listener the event listener to be used for listening 
-     *                 on incoming ZK events;
-     *                 if <code>NULL</code> not used
-     * @param establishConnection whether to establish connection to 
-     *                            the ZK
-     * 
-     * @throw ZooKeeperException if cannot establish connection to the 
-     *                           given ZK
+     *
+     * @param type the type of operation
+     * @param path the absolute path name of the node operated on
+     * @param callback if not NULL, called when the operation completes
      */
-    ZooKeeperAdapter(ZooKeeperConfig config, 
-                     ZKEventListener *listener = NULL,
-                     bool establishConnection = false);
+    AsyncOperation(OperationType type,
+                   const std::string &path,
+                   AsyncOperationCallback *callback = NULL);
 
     /**
-     * \brief Destructor.
+     * Get the type of operation.
      */
-    ~ZooKeeperAdapter(); 
-                  
+    OperationType getType() const { return m_type; }
+
     /**
-     * \brief Returns the current config.
+     * Get the path the operation was issued on.
      */
-    const ZooKeeperConfig &getZooKeeperConfig() const {
-        return m_zkConfig;                      
+    const std::string &getPath() const { return m_path; }
+
+    /**
+     * Wait for the operation to complete.
+     *
+     * @param usecTimeout the amount of usecs to wait until giving up, 
+     *        -1 means wait forever, 0 means return immediately
+     * @return true if the operation completed, false otherwise
+     */
+    bool waitUsecs(int64_t usecTimeout = -1) const;
+
+    /**
+     * Has the operation completed?
+     */
+    bool isDone() const;
+
+    /**
+     * Get the ZK return code.  Only valid after completion.  For
+     * GET_NODE_DATA, the first call decodes the data (see getData()).
+     */
+    int32_t getRc() const;
+
+    /**
+     * Get the data of the node for GET_NODE_DATA or the actual
+     * created path for CREATE_NODE.  Only valid after completion.
+     * Compressed data is decompressed by the first call to getRc()
+     * or getData(), on the caller's thread rather than on the ZK
+     * completion thread; if it is corrupt, the data is empty and
+     * getRc() returns ZMARSHALLINGERROR.
+     */
+    const std::string &getData() const;
+
+    /**
+     * Get the sorted absolute paths of the children for
+     * GET_NODE_CHILDREN.  Only valid after completion.
+     */
+    const std::vector<std::string> &getChildren() const 
+    { 
+        return m_children; 
     }
 
     /**
-     * \brief Restablishes connection to the ZK. 
-     * If this adapter is already connected, the current connection 
-     * will be dropped and a new connection will be established.
-     * 
-     * @throw ZooKeeperException if cannot establish connection to the ZK
+     * Get the node statistics for NODE_EXISTS, GET_NODE_CHILDREN,
+     * GET_NODE_DATA and SET_NODE_DATA.  Only valid after completion.
      */
-    void reconnect();
-        
+    const Stat &getStat() const { return m_stat; }
+
+  private:
     /**
-     * \brief Disconnects from the ZK and unregisters.
+     * Set the return code, notify the callback and wake up waiters.
      *
-     * @param final if true, no reconnection will be allowed.
+     * @param rc the ZK return code
      */
-    void disconnect(bool final = false);
+    void complete(int32_t rc);
 
     /**
-     * \brief Stops the ZK event loop from dispatching events.
+     * Decode the data read if it has not been yet.
      */
-    void stopEventDispatch();
+    void decodeData() const;
 
     /**
-     * \brief Synchronizes all events with ZK with the local server.
-     *
-     * @param path the absolute path name of the node to synced
-     * @param listener the listener for ZK watcher events; 
-     *                 passing non <code>NULL</code> effectively establishes
-     *                 a ZK watch on the given node
-     * @param context the user specified context that is to be passed
-     *                in a corresponding {@link ZKWatcherEvent} at later time; 
-     *                not used if <code>listener</code> is <code>NULL</code>
+     * ZooKeeperAdapter and InMemoryRepository fill in the results.
      */
-    bool sync(const std::string &path,
-              ZKEventListener *listener,
-              void *context);
+    friend class Repository;
+    friend class ZooKeeperAdapter;
+    friend class InMemoryRepository;
 
+  private:
     /**
-     * \brief Creates a new node identified by the given path. 
-     * This method will optionally attempt to create all missing ancestors.
-     * 
-     * @param path the absolute path name of the node to be created
-     * @param value the initial value to be associated with the node
-     * @param flags the ZK flags of the node to be created
-     * @param createAncestors if true and there are some missing ancestor 
-     *                        nodes, this method will attempt to 
-     *                        create them
-     * 
-     * @return true if the node has been successfully created; false
-     *              otherwise
-     * @throw ZooKeeperException if the operation has failed
-     */ 
-    bool createNode(const std::string &path, 
-                    const std::string &value = "", 
-                    int flags = 0, 
-                    bool createAncestors = true);
-                  
+     * The type of operation.
+     */
+    OperationType m_type;
+
     /**
-     * \brief Creates a new sequence node using the give path as
-     * the prefix.  This method will optionally attempt to create
-     * all missing ancestors.
-     * 
-     * @param path the absolute path name of the node to be created; 
-     * @param value the initial value to be associated with the node
-     * @param flags the ZK flags of the sequence node to be created 
-     *              (in addition to SEQUENCE)
-     * @param createAncestors if true and there are some missing ancestor 
-     *                        nodes, this method will attempt to
-     *                        create them
-     * @param createdPath this is set to the actual created path if the 
-     *                    call is successful
-     * 
-     * @return the sequence number associate with newly created node,
-     *         or -1 if it couldn't be created
-     * @throw ZooKeeperException if the operation has failed
-     */ 
-    int64_t createSequence(const std::string &path, 
-                           const std::string &value,
-                           int flags, 
-                           bool createAncestors,
-                           std::string &createdPath);
-        
+     * The path of the node operated on.
+     */
+    std::string m_path;
+
     /**
-     * \brief Deletes a node identified by the given path.
-     * 
-     * @param path the absolute path name of the node to be deleted
-     * @param recursive if true this method will attempt to remove 
-     *                  all children of the given node if any exist
-     * @param version the expected version of the node. The function will 
-     *                fail if the actual version of the node does not 
-     *                match the expected version
-     * 
-     * @return true if the node has been deleted; false otherwise
-     * @throw ZooKeeperException if the operation has failed
+     * Optional completion callback.
      */
-    bool deleteNode(const std::string &path,
-                    bool recursive = false,
-                    int version = -1);
-        
+    AsyncOperationCallback *mp_callback;
+
     /**
-     * \brief Checks whether the given node exists or not.
-     * 
-     * @param path the absolute path name of the node to be checked
-     * @param listener the listener for ZK watcher events; 
-     *                 passing non <code>NULL</code> effectively establishes
-     *                 a ZK watch on the given node
-     * @param context the user specified context that is to be passed
-     *                in a corresponding {@link ZKWatcherEvent} at later time; 
-     *                not used if <code>listener</code> is <code>NULL</code>
-     * @param stat the optional node statistics to be filled in by ZK
-     * 
-     * @return true if the given node exists; false otherwise
-     * @throw ZooKeeperException if the operation has failed
+     * The ZK return code.
+     */
+    mutable int32_t m_rc;
+
+    /**
+     * Data or the created path.
+     */
+    mutable std::string m_data;
+
+    /**
+     * Whether m_data still has to be decoded.
+     */
+    mutable bool m_decodePending;
+
+    /**
+     * Makes the decoding of m_data thread-safe.
+     */
+    mutable clusterlib::Mutex m_decodeMutex;
+
+    /**
+     * The counters of the repository that issued this operation,
+     * updated when the data is decoded.
+     */
+    RepositoryStatsRecorder *mp_statsRecorder;
+
+    /**
+     * Absolute paths of the children.
+     */
+    std::vector<std::string> m_children;
+
+    /**
+     * Node statistics.
+     */
+    Stat m_stat;
+
+    /**
+     * The adapter that issued this operation.
+     */
+    ZooKeeperAdapter *mp_adapter;
+
+    /**
+     * If set, a watch was requested and this context must be released
+     * if ZK did not register it.
+     */
+    clusterlib::CallbackAndContext *mp_callbackAndContext;
+
+    /**
+     * When the operation was issued (usecs since the epoch).
+     */
+    int64_t m_startUsecs;
+
+    /**
+     * Signaled on completion.
+     */
+    clusterlib::PredMutexCond m_predMutexCond;
+};
+
+/**
+ * \brief Shared reference to an AsyncOperation.
+ */
+typedef boost::shared_ptr<AsyncOperation> AsyncOperationSP;
+
+/**
+ * \brief The counters behind Repository::getStats().
+ *
+ * All the counters are updated with atomic instructions so that
+ * recording never blocks or serializes the operations.
+ */
+class RepositoryStatsRecorder
+{
+  public:
+    /**
+     * Record a completed operation.
+     *
+     * @param operation the operation
+     * @param usecs how long it took
+     * @param rc the ZK return code; system errors (ZSYSTEMERROR to
+     *        ZAPIERROR exclusive) are counted as errors
+     */
+    void recordOperation(clusterlib::RepositoryStats::Operation operation,
+                         int64_t usecs,
+                         int32_t rc);
+
+    /**
+     * Record a retry after a connection loss or a timeout.
+     */
+    void recordRetry()
+    {
+        __sync_add_and_fetch(&m_stats.m_retryCount, 1);
+    }
+
+    /**
+     * Record node data read.
+     *
+     * @param bytes the size of the data
+     */
+    void recordBytesRead(int64_t bytes)
+    {
+        __sync_add_and_fetch(&m_stats.m_bytesRead, bytes);
+    }
+
+    /**
+     * Record node data decoded.
+     *
+     * @param bytes the size of the value after decoding
+     */
+    void recordBytesDecoded(int64_t bytes)
+    {
+        __sync_add_and_fetch(&m_stats.m_bytesDecoded, bytes);
+    }
+
+    /**
+     * Record node data that could not be decoded.
+     */
+    void recordDecodeError()
+    {
+        __sync_add_and_fetch(&m_stats.m_decodeErrorCount, 1);
+    }
+
+    /**
+     * Record node data written.
+     *
+     * @param bytes the size of the data
+     */
+    void recordBytesWritten(int64_t bytes)
+    {
+        __sync_add_and_fetch(&m_stats.m_bytesWritten, bytes);
+    }
+
+    /**
+     * Record a watch registration.
+     */
+    void recordWatch()
+    {
+        __sync_add_and_fetch(&m_stats.m_watchCount, 1);
+    }
+
+    /**
+     * Copy the counters.
+     *
+     * @param stats the snapshot to fill in
+     */
+    void getStats(clusterlib::RepositoryStats &stats) const;
+
+    /**
+     * Set all the counters back to 0.
+     */
+    void reset();
+
+  private:
+    /**
+     * The live counters.
+     */
+    clusterlib::RepositoryStats m_stats;
+};
+
+/**
+ * \brief Records the latency and the outcome of one repository
+ * operation when it goes out of scope, including when an exception
+ * is thrown.
+ */
+class RepositoryOperationTimer
+{
+  public:
+    /**
+     * \brief Constructor.  Starts the clock.
+     *
+     * @param recorder the recorder to update
+     * @param operation the operation being timed
+     */
+    RepositoryOperationTimer(
+        RepositoryStatsRecorder &recorder,
+        clusterlib::RepositoryStats::Operation operation)
+        : m_recorder(recorder),
+          m_operation(operation),
+          m_startUsecs(clusterlib::TimerService::getCurrentTimeUsecs()),
+          m_rc(ZSYSTEMERROR) {}
+
+    /**
+     * \brief Destructor.  Records the operation.
+     */
+    ~RepositoryOperationTimer()
+    {
+        int64_t usecs = 
+            clusterlib::TimerService::getCurrentTimeUsecs() - m_startUsecs;
+        m_recorder.recordOperation(m_operation, usecs, m_rc);
+    }
+
+    /**
+     * Set the final ZK return code.  If never set, the operation is
+     * recorded as an error.
+     *
+     * @param rc the ZK return code
+     */
+    void setRc(int32_t rc) { m_rc = rc; }
+
+  private:
+    /**
+     * The recorder to update.
+     */
+    RepositoryStatsRecorder &m_recorder;
+
+    /**
+     * The operation being timed.
+     */
+    clusterlib::RepositoryStats::Operation m_operation;
+
+    /**
+     * When the operation started.
+     */
+    int64_t m_startUsecs;
+
+    /**
+     * The final ZK return code.
+     */
+    int32_t m_rc;
+};
+
+/**
+ * \brief The interface of the store that holds the clusterlib
+ * objects.
+ *
+ * ZooKeeperAdapter implements it on top of a ZK ensemble.  Other
+ * implementations (i.e. InMemoryRepository) must provide the same
+ * semantics as ZK: one-shot watches delivered as ZKWatcherEvents,
+ * session events and ZK return codes.
+ */
+class Repository
+    : public ZKEventSource
+{
+  public:
+    /**
+     * \brief The type representing the user's context.
+     */
+    typedef void *ContextType;
+        
+    /**
+     * \brief All possible states of this client, in respect to 
+     * \brief connection to the ZK server.
+     */
+    enum AdapterState {
+        //mp_zkHandle is NULL
+        AS_DISCONNECTED = 0,
+        //mp_zkHandle is NULL, but no reconnection will be allowed
+        AS_NORECONNECT,
+        //mp_zkHandle is valid but this client is reconnecting
+        AS_CONNECTING,
+        //mp_zkHandle is valid and this client is connected
+        AS_CONNECTED,
+        //mp_zkHandle is valid, however no more calls can be made to ZK API
+        AS_SESSION_EXPIRED
+    };
+
+    /**
+     * \brief Constructor.  Data is stored uncompressed.
+     */
+    Repository()
+        : m_compressionThreshold(-1) {}
+
+    /**
+     * \brief Destructor.
+     */
+    virtual ~Repository() {}
+
+    /**
+     * \brief Restablishes connection to the ZK. 
+     * If this adapter is already connected, the current connection 
+     * will be dropped and a new connection will be established.
+     * 
+     * @throw ZooKeeperException if cannot establish connection to the ZK
+     */
+    virtual void reconnect() = 0;
+
+    /**
+     * \brief Disconnects from the ZK and unregisters.
+     *
+     * @param final if true, no reconnection will be allowed.
+     */
+    virtual void disconnect(bool final = false) = 0;
+
+    /**
+     * \brief Stops the ZK event loop from dispatching events.
+     */
+    virtual void stopEventDispatch() = 0;
+
+    /**
+     * \brief Synchronizes all events with ZK with the local server.
+     *
+     * @param path the absolute path name of the node to synced
+     * @param listener the listener for ZK watcher events; 
+     *                 passing non <code>NULL</code> effectively establishes
+     *                 a ZK watch on the given node
+     * @param context the user specified context that is to be passed
+     *                in a corresponding {@link ZKWatcherEvent} at later time; 
+     *                not used if <code>listener</code> is <code>NULL</code>
+     */
+    virtual bool sync(const std::string &path,
+                      ZKEventListener *listener,
+                      void *context) = 0;
+
+    /**
+     * \brief Creates a new node identified by the given path. 
+     * This method will optionally attempt to create all missing ancestors.
+     * 
+     * @param path the absolute path name of the node to be created
+     * @param value the initial value to be associated with the node
+     * @param flags the ZK flags of the node to be created
+     * @param createAncestors if true and there are some missing ancestor 
+     *                        nodes, this method will attempt to 
+     *                        create them
+     * 
+     * @return true if the node has been successfully created; false
+     *              otherwise
+     * @throw ZooKeeperException if the operation has failed
+     */ 
+    virtual bool createNode(const std::string &path,
+                            const std::string &value = "",
+                            int flags = 0,
+                            bool createAncestors = true) = 0;
+
+    /**
+     * \brief Creates a new sequence node using the give path as
+     * the prefix.  This method will optionally attempt to create
+     * all missing ancestors.
+     * 
+     * @param path the absolute path name of the node to be created; 
+     * @param value the initial value to be associated with the node
+     * @param flags the ZK flags of the sequence node to be created 
+     *              (in addition to SEQUENCE)
+     * @param createAncestors if true and there are some missing ancestor 
+     *                        nodes, this method will attempt to
+     *                        create them
+     * @param createdPath this is set to the actual created path if the 
+     *                    call is successful
+     * 
+     * @return the sequence number associate with newly created node,
+     *         or -1 if it couldn't be created
+     * @throw ZooKeeperException if the operation has failed
+     */ 
+    virtual int64_t createSequence(const std::string &path,
+                                   const std::string &value,
+                                   int flags,
+                                   bool createAncestors,
+                                   std::string &createdPath) = 0;
+
+    /**
+     * \brief Deletes a node identified by the given path.
+     * 
+     * @param path the absolute path name of the node to be deleted
+     * @param recursive if true this method will attempt to remove 
+     *                  all children of the given node if any exist
+     * @param version the expected version of the node. The function will 
+     *                fail if the actual version of the node does not 
+     *                match the expected version
+     * @param progress if not NULL, notified as the descendants of a
+     *                 recursive delete are removed
+     * 
+     * @return true if the node has been deleted; false otherwise
+     * @throw ZooKeeperException if the operation has failed
+     */
+    virtual bool deleteNode(const std::string &path,
+                            bool recursive = false,
+                            int version = -1,
+                            DeleteProgressCallback *progress = NULL) = 0;
+
+    /**
+     * \brief Checks whether the given node exists or not.
+     * 
+     * @param path the absolute path name of the node to be checked
+     * @param listener the listener for ZK watcher events; 
+     *                 passing non <code>NULL</code> effectively establishes
+     *                 a ZK watch on the given node
+     * @param context the user specified context that is to be passed
+     *                in a corresponding {@link ZKWatcherEvent} at later time; 
+     *                not used if <code>listener</code> is <code>NULL</code>
+     * @param stat the optional node statistics to be filled in by ZK
+     * 
+     * @return true if the given node exists; false otherwise
+     * @throw ZooKeeperException if the operation has failed
+     */
+    virtual bool nodeExists(const std::string &path,
+                            ZKEventListener *listener = NULL,
+                            void *context = NULL,
+                            Stat *stat = NULL) = 0;
+
+    /**
+     * \brief Retrieves list of all children of the given node.
+     * 
+     * Gets the data from the node.  If the listener is set, then a
+     * watch is set on the node.  Context can be passed along with the
+     * event, but is not required.
+     * 
+     * @param path the absolute path name of the node for which to 
+     *             get children
+     * @param children the children for this node if exists 
+     * @param listener the listener for ZK watcher events; 
+     *                 passing non <code>NULL</code> effectively 
+     *                 establishes
+     *                 a ZK watch on the given node
+     * @param context the user specified context that is to be passed
+     *                in a corresponding {@link ZKWatcherEvent} at later
+     *                time; not used if <code>listener</code> is
+     *                <code>NULL</code>
+     * 
+     * @return if exists (children will not be set)
+     * @throw ZooKeeperException if the operation has failed
+     */
+    virtual bool getNodeChildren(const std::string &path,
+                                 std::vector<std::string> &children,
+                                 ZKEventListener *listener = NULL,
+                                 void *context = NULL) = 0;
+
+    /**
+     * \brief Gets the given node's data.
+     * 
+     * @param path the absolute path name of the node to get data from
+     * @param data the data from this path returned
+     * @param listener the listener for ZK watcher events; 
+     *                 passing non <code>NULL</code> effectively 
+     *                 establishes a ZK watch on the given node
+     * @param context the user specified context that is to be passed
+     *                in a corresponding {@link ZKWatcherEvent} at later time; 
+     *                not used if <code>listener</code> is <code>NULL</code>
+     * @param stat the optional node statistics to be filled in by ZK
+     * @param dataLengthHint the expected data length (i.e. from a
+     *        cached Stat) used to size the read buffer; -1 if unknown
+     * @return True if exists (data will not be set)
+     * @throw ZooKeeperException if the operation has failed
+     */
+    virtual bool getNodeData(const std::string &path,
+                             std::string &data,
+                             ZKEventListener *listener = NULL,
+                             void *context = NULL,
+                             Stat *stat = NULL,
+                             int32_t dataLengthHint = -1) = 0;
+
+    /**
+     * \brief Sets the given node's data.
+     * 
+     * @param path the absolute path name of the node to get data from
+     * @param value the node's data to be set
+     * @param version the expected version of the node. The function will 
+     *                fail if the actual version of the node does not match 
+     *                the expected version
+     * @param stat the Stat pointer to get back if successful
+     * 
+     * @throw ZooKeeperException if the operation has failed
+     */
+    virtual void setNodeData(const std::string &path,
+                             const std::string &value,
+                             int version = -1,
+                             Stat *stat = NULL) = 0;
+
+    /**
+     * \brief Asynchronously checks whether the given node exists.
+     * 
+     * The result is ZOK if the node exists or ZNONODE if it does not.
+     * A watch is set in both cases if a listener is given.
+     *
+     * @param path the absolute path name of the node to be checked
+     * @param listener the listener for ZK watcher events; 
+     *                 passing non <code>NULL</code> effectively establishes
+     *                 a ZK watch on the given node
+     * @param context the user specified context that is to be passed
+     *                in a corresponding {@link ZKWatcherEvent} at later time; 
+     *                not used if <code>listener</code> is <code>NULL</code>
+     * @param callback if not NULL, called when the operation completes
+     * @return the pending operation
+     * @throw ZooKeeperException if the operation could not be issued
+     */
+    virtual AsyncOperationSP nodeExistsAsync(
+        const std::string &path,
+        ZKEventListener *listener = NULL,
+        void *context = NULL,
+        AsyncOperationCallback *callback = NULL) = 0;
+
+    /**
+     * \brief Asynchronously retrieves the list of all children of
+     * the given node.
+     *
+     * @param path the absolute path name of the node for which to 
+     *             get children
+     * @param listener the listener for ZK watcher events; 
+     *                 passing non <code>NULL</code> effectively 
+     *                 establishes a ZK watch on the given node
+     * @param context the user specified context that is to be passed
+     *                in a corresponding {@link ZKWatcherEvent} at later
+     *                time; not used if <code>listener</code> is
+     *                <code>NULL</code>
+     * @param callback if not NULL, called when the operation completes
+     * @return the pending operation
+     * @throw ZooKeeperException if the operation could not be issued
+     */
+    virtual AsyncOperationSP getNodeChildrenAsync(
+        const std::string &path,
+        ZKEventListener *listener = NULL,
+        void *context = NULL,
+        AsyncOperationCallback *callback = NULL) = 0;
+
+    /**
+     * \brief Asynchronously gets the given node's data.
+     *
+     * @param path the absolute path name of the node to get data from
+     * @param listener the listener for ZK watcher events; 
+     *                 passing non <code>NULL</code> effectively 
+     *                 establishes a ZK watch on the given node
+     * @param context the user specified context that is to be passed
+     *                in a corresponding {@link ZKWatcherEvent} at later time; 
+     *                not used if <code>listener</code> is <code>NULL</code>
+     * @param callback if not NULL, called when the operation completes
+     * @return the pending operation
+     * @throw ZooKeeperException if the operation could not be issued
+     */
+    virtual AsyncOperationSP getNodeDataAsync(
+        const std::string &path,
+        ZKEventListener *listener = NULL,
+        void *context = NULL,
+        AsyncOperationCallback *callback = NULL) = 0;
+
+    /**
+     * \brief Asynchronously creates a new node.  Missing ancestors
+     * are not created.
+     *
+     * @param path the absolute path name of the node to be created
+     * @param value the initial value to be associated with the node
+     * @param flags the ZK flags of the node to be created, plus
+     *        DATA_ENCODED if value is already encoded
+     * @param callback if not NULL, called when the operation completes
+     * @return the pending operation
+     * @throw ZooKeeperException if the operation could not be issued
+     */
+    virtual AsyncOperationSP createNodeAsync(
+        const std::string &path,
+        const std::string &value = "",
+        int flags = 0,
+        AsyncOperationCallback *callback = NULL) = 0;
+
+    /**
+     * \brief Asynchronously sets the given node's data.
+     *
+     * @param path the absolute path name of the node to set data on
+     * @param value the node's data to be set
+     * @param version the expected version of the node, -1 for any
+     * @param callback if not NULL, called when the operation completes
+     * @return the pending operation
+     * @throw ZooKeeperException if the operation could not be issued
+     */
+    virtual AsyncOperationSP setNodeDataAsync(
+        const std::string &path,
+        const std::string &value,
+        int version = -1,
+        AsyncOperationCallback *callback = NULL) = 0;
+
+    /**
+     * \brief Asynchronously deletes a node.  Children are not removed.
+     *
+     * @param path the absolute path name of the node to be deleted
+     * @param version the expected version of the node, -1 for any
+     * @param callback if not NULL, called when the operation completes
+     * @return the pending operation
+     * @throw ZooKeeperException if the operation could not be issued
+     */
+    virtual AsyncOperationSP deleteNodeAsync(
+        const std::string &path,
+        int version = -1,
+        AsyncOperationCallback *callback = NULL) = 0;
+
+    /**
+     * \brief Waits for a pending operation and throws the appropriate
+     * exception if it failed with a return code other than ZOK or
+     * one of the allowed ones.
+     *
+     * @param operation the operation to wait on
+     * @param allowedRc an additional return code that is not an error
+     *        (i.e. ZNONODE), ZOK if none
+     * @return the return code of the operation
+     * @throw ZooKeeperException if the operation has failed
+     */
+    int32_t waitAsync(const AsyncOperationSP &operation,
+                      int32_t allowedRc = ZOK);
+
+    /**
+     * \brief Atomically executes a list of operations in a single
+     * round trip.  Either all of the operations succeed or none of
+     * them are applied.  If the ZK client library does not support
+     * multi-op transactions, the operations are executed one at a
+     * time and the transaction is not atomic.
+     *
+     * @param operations the operations to execute in order
+     * @param pResults if not NULL, set to the ZK return code of each 
+     *        operation
+     * @return true if the transaction was committed, false if it was
+     *         aborted because a node existed, did not exist, was not
+     *         empty or had an unexpected version
+     * @throw ZooKeeperException if the operation has failed for any 
+     *        other reason
+     */
+    virtual bool multi(const std::vector<MultiOperation> &operations,
+                       std::vector<int32_t> *pResults = NULL) = 0;
+
+    /**
+     * \brief Sets the given node's data to a value that may be larger
+     * than a znode can hold.
+     *
+     * Values up to CLNumericInternal::DATA_CHUNK_SIZE are stored like
+     * setNodeData() does, unless they start like a manifest.  Larger
+     * values are encoded (compressed, see setCompressionThreshold())
+     * as a whole first.  If the encoded value fits, it is stored in
+     * the node.  Otherwise it is split and the pieces are written
+     * (pipelined, without encoding them again) as the children of a
+     * new sequence node below the node.  Then the node's data is
+     * replaced by a manifest that names them, in a multi that also
+     * checks that the chunks are still there.
+     * Readers and watches of the node only see the change when the
+     * manifest is replaced.  Chunks of older values are removed
+     * afterwards.  Read the value with getChunkedNodeData().
+     *
+     * @param path the absolute path name of the node
+     * @param value the node's value to be set
+     * @param version the expected version of the node, -1 for any
+     * @param stat if not NULL, set to the Stat of the node after the
+     *        write (for a chunked value it is read again, so only the
+     *        version is sure to be that of this write)
+     * @throw ZooKeeperException if the operation has failed
+     */
+    void setChunkedNodeData(const std::string &path,
+                            const std::string &value,
+                            int version = -1,
+                            Stat *stat = NULL);
+
+    /**
+     * \brief May a value be split into chunks by setChunkedNodeData()?
+     * The other values are stored like setNodeData() does.  Whether
+     * the value is actually split depends on its encoded size.
+     *
+     * @param value the node's value to be set
+     * @return true if the value may be split into chunks
+     */
+    static bool isChunkedValue(const std::string &value);
+
+    /**
+     * \brief Remove the chunk nodes of older values of a node, unless
+     * the node changed since version.  Failures are only logged.
+     *
+     * @param path the absolute path name of the node
+     * @param currentChunksName the chunks of the current value (only
+     *        older sequence nodes are removed), "" to remove all
+     * @param version the version of the node that was just written
+     */
+    void removeDataChunks(const std::string &path,
+                          const std::string &currentChunksName,
+                          int32_t version);
+
+    /**
+     * \brief Gets the given node's value, reassembled from its chunks
+     * if it was stored by setChunkedNodeData().  The chunks are read
+     * with pipelined getNodeDataAsync() calls and the joined value
+     * is decoded.  The arguments are
+     * the same as getNodeData(); the watch and the Stat are those
+     * of the node itself.
+     *
+     * @return true if the node exists
+     * @throw ZooKeeperException if the operation has failed or the
+     *        value kept being replaced while it was read
+     */
+    bool getChunkedNodeData(const std::string &path,
+                            std::string &data,
+                            ZKEventListener *listener = NULL,
+                            void *context = NULL,
+                            Stat *stat = NULL,
+                            int32_t dataLengthHint = -1);
+
+    /**
+     * \brief Validates the given path to a node in ZK.
+     * 
+     * @param path the path to be validated
+     * 
+     * @throw ZooKeeperException if the given path is not valid
+     *        (for instance it doesn't start with "/")
+     */
+    void validatePath(const std::string &path);
+
+    /**
+     * Returns the current state of this adapter.
+     * 
+     * @return the current state of this adapter
+     * @see AdapterState
+     */
+    virtual AdapterState getState() const = 0;
+
+    /**
+     * Simulate a SESSION_EXPIRED event so that the event-delivering
+     * threads shutdown.  It does not change the state of the
+     * ZooKeeperAdapter.  Calling this multiple times will add to the
+     * event queue, but will only be delivered once.
+     */
+    virtual void injectEndEvent() = 0;
+
+    /**
+     * Get a snapshot of the counters of the operations made so far.
+     *
+     * @param stats the snapshot to fill in
+     */
+    void getStats(clusterlib::RepositoryStats &stats) const;
+
+    /**
+     * Set the counters of the operations back to 0.
+     */
+    void resetStats();
+
+    /**
+     * Compress the node data written from now on if it is at least
+     * this large (see DataCodec).  Compressed data is always
+     * decompressed when read, whatever the threshold.  Only enable
+     * compression once every reader of the nodes understands it.
+     *
+     * @param threshold the smallest data to compress in bytes; -1
+     *        (the default) turns compression off
+     */
+    void setCompressionThreshold(int32_t threshold)
+    {
+        m_compressionThreshold = threshold;
+    }
+
+    /**
+     * Get the smallest node data that is compressed, -1 if none is.
+     */
+    int32_t getCompressionThreshold() const
+    {
+        return m_compressionThreshold;
+    }
+
+  protected:
+    /**
+     * Get the data to store for a value, compressed if it reaches
+     * the compression threshold.
+     *
+     * @param value the value to store
+     * @param flags if they include DATA_ENCODED, value is returned
+     *        as is
+     * @return the data to send to the repository
+     */
+    std::string encodeData(const std::string &value,
+                           int32_t flags = 0) const;
+
+    /**
+     * Get the flags to pass on to ZK, without DATA_ENCODED.
+     */
+    static int32_t getZKFlags(int32_t flags)
+    {
+        return (flags & ~DATA_ENCODED);
+    }
+
+    /**
+     * Decode data read from the repository in place and count the
+     * result in the stats.
+     *
+     * @param path the node the data was read from, for logging
+     * @param data the data read, replaced by the stored value
+     * @return false if the data is compressed but corrupt
+     */
+    bool decodeData(const std::string &path, std::string &data);
+
+    /**
+     * Get the counters that the implementations update.
+     */
+    RepositoryStatsRecorder &getStatsRecorder() { return m_statsRecorder; }
+
+    /**
+     * Record a completed asynchronous operation: its latency since
+     * it was issued, the data read and the watch registered.
+     *
+     * @param operation the operation
+     * @param rc the ZK return code it completed with
+     * @param watchSet whether a watch was registered
+     */
+    void recordAsync(const AsyncOperation &operation,
+                     int32_t rc,
+                     bool watchSet);
+
+  private:
+    /**
+     * The counters of the operations.
+     */
+    RepositoryStatsRecorder m_statsRecorder;
+
+    /**
+     * The smallest data that is compressed; -1 if compression is off.
+     */
+    volatile int32_t m_compressionThreshold;
+};
+
+/**
+ * \brief A watch that a ZooKeeperAdapter has registered with ZK,
+ * remembered so that it can be registered again in a new session.
+ */
+class ZKWatchRecord
+{
+  public:
+    /**
+     * The kind of watch.
+     */
+    enum WatchType {
+        /** Set by nodeExists() or getNodeData(). */
+        NODE_WATCH = 0,
+        /** Set by getNodeChildren(). */
+        CHILD_WATCH
+    };
+
+    /**
+     * \brief Constructor.
+     *
+     * @param path the absolute path name of the watched node
+     * @param type the kind of watch
+     * @param listener the listener of the watch
+     * @param context the user context of the watch
+     */
+    ZKWatchRecord(const std::string &path = std::string(),
+                  WatchType type = NODE_WATCH,
+                  void *listener = NULL,
+                  void *context = NULL)
+        : m_path(path),
+          m_type(type),
+          mp_listener(listener),
+          mp_context(context),
+          m_zxid(-1) {}
+
+    /**
+     * Get the path of the watched node.
+     */
+    const std::string &getPath() const { return m_path; }
+
+    /**
+     * Get the kind of watch.
+     */
+    WatchType getType() const { return m_type; }
+
+    /**
+     * Get the listener of the watch.
+     */
+    void *getListener() const { return mp_listener; }
+
+    /**
+     * Get the user context of the watch.
+     */
+    void *getContext() const { return mp_context; }
+
+    /**
+     * Get the zxid the watched node had when the watch was set: the
+     * mzxid for a NODE_WATCH (0 if the node did not exist) and the
+     * pzxid for a CHILD_WATCH.  -1 if unknown.
+     */
+    int64_t getZxid() const { return m_zxid; }
+
+    /**
+     * Set the zxid the watched node had when the watch was set.
+     *
+     * @param zxid the zxid
+     */
+    void setZxid(int64_t zxid) { m_zxid = zxid; }
+
+  private:
+    /**
+     * The path of the watched node.
+     */
+    std::string m_path;
+
+    /**
+     * The kind of watch.
+     */
+    WatchType m_type;
+
+    /**
+     * The listener of the watch.
+     */
+    void *mp_listener;
+
+    /**
+     * The user context of the watch.
+     */
+    void *mp_context;
+
+    /**
+     * The zxid of the node when the watch was set.
+     */
+    int64_t m_zxid;
+};
+
+/**
+ * \brief This is a wrapper around ZK C synchronous and asynchronous API.
+ */
+class ZooKeeperAdapter
+    : public Repository
+{
+  public:
+
+    /**
+     * Get the event type as a string (used primarily for debugging)
+     *
+     * @param etype the type passed in to the event
+     * @return the stringified etype
+     */
+    static std::string getEventString(int32_t etype);
+
+    /**
+     * Get the state as a string (used primarily for debugging)
+     *
+     * @param state the state
+     * @return the stringified state
+     */
+    static std::string getStateString(int32_t state);
+ 
+    /**
+     * Split a sequence node into a name, distributed lock type, and a
+     * sequence number.  This will not be needed when JIRA issues
+     * ZOOKEEPER-616 is resolved.
+     *
+     * @param sequenceNode Node to parse
+     * @param pSequenceName If set, will be the name of the node
+     * @param pSequenceNumber If set, will be the sequence number
      */
-    bool nodeExists(const std::string &path, 
-                    ZKEventListener *listener = NULL, 
-                    void *context = NULL,
-                    Stat *stat = NULL);
+    static void splitSequenceNode(
+        const std::string &sequenceNode,
+        std::string *pSequenceName = NULL,
+        int64_t *pSequenceNumber = NULL);
 
     /**
-     * \brief Retrieves list of all children of the given node.
-     * 
-     * Gets the data from the node.  If the listener is set, then a
-     * watch is set on the node.  Context can be passed along with the
-     * event, but is not required.
-     * 
-     * @param path the absolute path name of the node for which to 
-     *             get children
-     * @param children the children for this node if exists 
-     * @param listener the listener for ZK watcher events; 
-     *                 passing non <code>NULL</code> effectively 
-     *                 establishes
-     *                 a ZK watch on the given node
-     * @param context the user specified context that is to be passed
-     *                in a corresponding {@link ZKWatcherEvent} at later
-     *                time; not used if <code>listener</code> is
-     *                <code>NULL</code>
+     * Takes an ZooKeeper function error code and throws the
+     * appropriate zk::Exception.  If the error code does not map to a
+     * zk::Exception child object, a generic UnknownErrorCodeException
+     * is thrown.  Exceptions will be thrown for all error codes
+     * (including ZOK).
      * 
-     * @return if exists (children will not be set)
-     * @throw ZooKeeperException if the operation has failed
+     * @param msg the additional message with the exception
+     * @param errorCode the error code that will be used to generate
+     *        the appropriate zk::Exception
+     * @param connected is the adapter connected?
      */
-    bool getNodeChildren(const std::string &path, 
-                         std::vector<std::string> &children,
-                         ZKEventListener *listener = NULL, 
-                         void *context = NULL);
-                
+    static void throwErrorCode(const std::string &msg,
+                               int32_t errorCode,
+                               bool connected);
+
     /**
-     * \brief Gets the given node's data.
-     * 
-     * @param path the absolute path name of the node to get data from
-     * @param data the data from this path returned
-     * @param listener the listener for ZK watcher events; 
-     *                 passing non <code>NULL</code> effectively 
-     *                 establishes a ZK watch on the given node
-     * @param context the user specified context that is to be passed
-     *                in a corresponding {@link ZKWatcherEvent} at later time; 
-     *                not used if <code>listener</code> is <code>NULL</code>
-     * @param stat the optional node statistics to be filled in by ZK
-     * @return True if exists (data will not be set)
-     * @throw ZooKeeperException if the operation has failed
+     * \brief The global function that handles all ZK asynchronous
+     * notifications.
      */
-    bool getNodeData(const std::string &path, 
-                     std::string &data,
-                     ZKEventListener *listener = NULL, 
-                     void *context = NULL,
-                     Stat *stat = NULL);
+    friend void zkWatcher(zhandle_t *, int, int, const char *, void *);
         
     /**
-     * \brief Sets the given node's data.
+     * \brief Constructor.
+     * Attempts to create a ZK adapter, optionally connecting
+     * to the ZK. Note, that if the connection is to be established
+     * and the given listener is NULL, some events may be lost, 
+     * as they may arrive asynchronously before this method finishes.
      * 
-     * @param path the absolute path name of the node to get data from
-     * @param value the node's data to be set
-     * @param version the expected version of the node. The function will 
-     *                fail if the actual version of the node does not match 
-     *                the expected version
-     * @param stat the Stat pointer to get back if successful
+     * @param config the ZK configuration
+     * @param listener the event listener to be used for listening 
+     *                 on incoming ZK events;
+     *                 if <code>NULL</code> not used
+     * @param establishConnection whether to establish connection to 
+     *                            the ZK
      * 
-     * @throw ZooKeeperException if the operation has failed
+     * @throw ZooKeeperException if cannot establish connection to the 
+     *                           given ZK
      */
-    void setNodeData(const std::string &path, 
-                     const std::string &value, 
-                     int version = -1,
-                     Stat *stat = NULL);
-        
+    ZooKeeperAdapter(ZooKeeperConfig config, 
+                     ZKEventListener *listener = NULL,
+                     bool establishConnection = false);
+
     /**
-     * \brief Validates the given path to a node in ZK.
-     * 
-     * @param path the path to be validated
-     * 
-     * @throw ZooKeeperException if the given path is not valid
-     *        (for instance it doesn't start with "/")
+     * \brief Destructor.
      */
-    void validatePath(const std::string &path);
-
+    virtual ~ZooKeeperAdapter(); 
+                  
     /**
-     * Returns the current state of this adapter.
-     * 
-     * @return the current state of this adapter
-     * @see AdapterState
+     * \brief Returns the current config.
      */
-    AdapterState getState() const {
+    const ZooKeeperConfig &getZooKeeperConfig() const {
+        return m_zkConfig;                      
+    }
+
+    virtual void reconnect();
+
+    virtual void disconnect(bool final = false);
+
+    virtual void stopEventDispatch();
+
+    virtual bool sync(const std::string &path,
+                      ZKEventListener *listener,
+                      void *context);
+
+    virtual bool createNode(const std::string &path,
+                            const std::string &value = "",
+                            int flags = 0,
+                            bool createAncestors = true);
+
+    virtual int64_t createSequence(const std::string &path,
+                                   const std::string &value,
+                                   int flags,
+                                   bool createAncestors,
+                                   std::string &createdPath);
+
+    virtual bool deleteNode(const std::string &path,
+                            bool recursive = false,
+                            int version = -1,
+                            DeleteProgressCallback *progress = NULL);
+
+    virtual bool nodeExists(const std::string &path,
+                            ZKEventListener *listener = NULL,
+                            void *context = NULL,
+                            Stat *stat = NULL);
+
+    virtual bool getNodeChildren(const std::string &path,
+                                 std::vector<std::string> &children,
+                                 ZKEventListener *listener = NULL,
+                                 void *context = NULL);
+
+    virtual bool getNodeData(const std::string &path,
+                             std::string &data,
+                             ZKEventListener *listener = NULL,
+                             void *context = NULL,
+                             Stat *stat = NULL,
+                             int32_t dataLengthHint = -1);
+
+    virtual void setNodeData(const std::string &path,
+                             const std::string &value,
+                             int version = -1,
+                             Stat *stat = NULL);
+
+    virtual AsyncOperationSP nodeExistsAsync(
+        const std::string &path,
+        ZKEventListener *listener = NULL,
+        void *context = NULL,
+        AsyncOperationCallback *callback = NULL);
+
+    virtual AsyncOperationSP getNodeChildrenAsync(
+        const std::string &path,
+        ZKEventListener *listener = NULL,
+        void *context = NULL,
+        AsyncOperationCallback *callback = NULL);
+
+    virtual AsyncOperationSP getNodeDataAsync(
+        const std::string &path,
+        ZKEventListener *listener = NULL,
+        void *context = NULL,
+        AsyncOperationCallback *callback = NULL);
+
+    virtual AsyncOperationSP createNodeAsync(
+        const std::string &path,
+        const std::string &value = "",
+        int flags = 0,
+        AsyncOperationCallback *callback = NULL);
+
+    virtual AsyncOperationSP setNodeDataAsync(
+        const std::string &path,
+        const std::string &value,
+        int version = -1,
+        AsyncOperationCallback *callback = NULL);
+
+    virtual AsyncOperationSP deleteNodeAsync(
+        const std::string &path,
+        int version = -1,
+        AsyncOperationCallback *callback = NULL);
+
+    virtual bool multi(const std::vector<MultiOperation> &operations,
+                       std::vector<int32_t> *pResults = NULL);
+
+    virtual AdapterState getState() const
+    {
         return m_state;
-    }          
+    }
+
+    virtual void injectEndEvent();
 
     /**
-     * Simulate a SESSION_EXPIRED event so that the event-delivering
-     * threads shutdown.  It does not change the state of the
-     * ZooKeeperAdapter.  Calling this multiple times will add to the
-     * event queue, but will only be delivered once.
+     * Get the id of the current ZK session, i.e. to open another
+     * handle on the same session.
+     *
+     * @return the session id and password, NULL if there is no handle
      */
-    void injectEndEvent();
+    const clientid_t *getClientId();
         
   private:
+    /**
+     * Completion of a call issued by rearmNextWatches().
+     */
+    class WatchRearmCallback;
+    friend class WatchRearmCallback;
         
     /**
      * This enum defines methods from this class than can trigger an event.
@@ -646,12 +1709,104 @@ class ZooKeeperAdapter
                     int flags, 
                     bool createAncestors,
                     std::string &createdPath);
+
+    /**
+     * Deletes a node and all of its descendants.  The subtree is
+     * listed one level at a time with pipelined getNodeChildrenAsync()
+     * calls and then deleted bottom-up in multi-op batches, so the
+     * number of round trips depends on the depth of the tree rather
+     * than on the number of nodes.
+     *
+     * @param path the absolute path name of the root of the subtree
+     * @param progress if not NULL, notified after each batch
+     * @return true if the subtree was deleted, false if it changed
+     *         while being deleted
+     * @throw ZooKeeperException if the operation has failed
+     */
+    bool deleteNodeTree(const std::string &path,
+                        DeleteProgressCallback *progress);
+
+    /**
+     * Prepares an AsyncOperation and the completion data passed to
+     * ZK.  The completion data holds a reference to the operation
+     * until it is released by the completion function.
+     *
+     * @param operationSP the operation to issue
+     * @param listener if not NULL, a watch context is allocated
+     * @param context the user context for the watch
+     * @return the completion data to pass to ZK
+     */
+    AsyncOperationSP *prepareAsync(const AsyncOperationSP &operationSP,
+                                   ZKEventListener *listener,
+                                   void *context);
+
+    /**
+     * Cleans up after an asynchronous operation that ZK did not
+     * accept and marks it complete with the return code.
+     *
+     * @param completionData the data returned from prepareAsync()
+     * @param rc the ZK return code
+     */
+    void abortAsync(AsyncOperationSP *completionData, int32_t rc);
+
+    /**
+     * Completes an asynchronous operation in the ZK completion
+     * thread, releasing the watch context if no watch was
+     * registered.
+     *
+     * @param completionData the data returned from prepareAsync()
+     * @param rc the ZK return code
+     */
+    void finishAsync(AsyncOperationSP *completionData, int32_t rc);
+
+    /**
+     * ZK completion for nodeExistsAsync() and setNodeDataAsync().
+     */
+    static void statCompletion(int rc, 
+                               const struct Stat *stat, 
+                               const void *data);
+
+    /**
+     * ZK completion for getNodeChildrenAsync().
+     */
+    static void stringsCompletion(int rc, 
+                                  const struct String_vector *strings,
+                                  const struct Stat *stat,
+                                  const void *data);
+
+    /**
+     * ZK completion for getNodeDataAsync().
+     */
+    static void dataCompletion(int rc, 
+                               const char *value, 
+                               int valueLen,
+                               const struct Stat *stat, 
+                               const void *data);
+
+    /**
+     * ZK completion for createNodeAsync().
+     */
+    static void stringCompletion(int rc, 
+                                 const char *value, 
+                                 const void *data);
+
+    /**
+     * ZK completion for deleteNodeAsync().
+     */
+    static void voidCompletion(int rc, const void *data);
         
     /**
      * Handles an asynchronous event received from the ZK.
      */
     void handleAsyncEvent(const ZKWatcherEvent &event);
         
+    /**
+     * Hands an event to the listeners, logging any exception.
+     *
+     * @param event the event to deliver
+     */
+    void deliverEvent(const ZKWatcherEvent &event);
+
     /**
      * \brief Enqueues the given event in {@link #m_events} queue.
      */
@@ -665,11 +1820,6 @@ class ZooKeeperAdapter
      */
     void processEvents(void *param);
 
-    /**
-     * \brief Processes all user events in a loop.
-     */
-    void processUserEvents(void *param);
-
     /**
      * Sets the new state in case it's different then the current one.
      * This method assumes that {@link #m_stateLock} has been already locked.
@@ -748,6 +1898,126 @@ class ZooKeeperAdapter
         return &m_listenerAndContextManager; 
     }
 
+    /**
+     * Gets the lock that makes {@link #m_knownPathMap} and {@link
+     * #m_knownPathQueue} thread-safe.
+     */
+    const clusterlib::Mutex &getKnownPathLock()
+    {
+        return m_knownPathLock;
+    }
+
+    /**
+     * Is this node known to exist?
+     *
+     * @param path the absolute path name of the node
+     * @return true if the node was recently seen to exist
+     */
+    bool isKnownPath(const std::string &path);
+
+    /**
+     * Remembers that a node and all its ancestors exist.  The oldest
+     * entries are evicted once there are more than
+     * CLNumericInternal::MAX_KNOWN_PATH_COUNT of them.
+     *
+     * @param path the absolute path name of the node
+     */
+    void addKnownPath(const std::string &path);
+
+    /**
+     * Forgets a node and all its descendants, i.e. after it was
+     * deleted or reported missing.
+     *
+     * @param path the absolute path name of the node
+     */
+    void forgetKnownPath(const std::string &path);
+
+    /**
+     * Gets the lock that makes {@link #m_watchMap}, {@link
+     * #m_lostWatchVec}, {@link #m_rearmWatchVec} and {@link
+     * #m_lostContextSet} thread-safe.
+     */
+    const clusterlib::Mutex &getWatchLock()
+    {
+        return m_watchLock;
+    }
+
+    /**
+     * Remembers a watch that is about to be set.
+     *
+     * @param callbackAndContext the context passed to ZK with the watch
+     * @param record the watch
+     */
+    void addWatch(clusterlib::CallbackAndContext *callbackAndContext,
+                  const ZKWatchRecord &record);
+
+    /**
+     * Records the zxid of a node once its watch has been set.
+     *
+     * @param callbackAndContext the context passed to ZK with the watch
+     * @param zxid the mzxid or the pzxid of the node
+     */
+    void setWatchZxid(clusterlib::CallbackAndContext *callbackAndContext,
+                      int64_t zxid);
+
+    /**
+     * Forgets a watch that fired or was not set.
+     *
+     * @param callbackAndContext the context passed to ZK with the watch
+     * @return true if the watch was remembered
+     */
+    bool removeWatch(clusterlib::CallbackAndContext *callbackAndContext);
+
+    /**
+     * Moves all the remembered watches, and the ones still to be set
+     * again, to {@link #m_lostWatchVec} after the session expired and
+     * ZK dropped them.
+     */
+    void loseWatches();
+
+    /**
+     * Sets the watches lost with an expired session again in the
+     * current session.  The watches are set with pipelined
+     * asynchronous calls, CLNumericInternal::MAX_WATCH_REARM_BATCH_SIZE
+     * at a time, without waiting for them: the next batch is issued
+     * when the event thread gets the rearm event queued by the last
+     * completion of the previous one.  The listener of a watch whose
+     * node changed since it was set (its zxid differs) gets the event
+     * it missed; the others get nothing.  Watches that could not be
+     * set are kept for the next session.
+     */
+    void rearmLostWatches();
+
+    /**
+     * Issues the next batch of {@link #m_rearmWatchVec}.
+     */
+    void rearmNextWatches();
+
+    /**
+     * Called from the ZK completion thread once a watch was set
+     * again.  Queues the event the listener missed, if any.
+     *
+     * @param record the watch
+     * @param operation the completed call that set it
+     */
+    void watchRearmed(const ZKWatchRecord &record,
+                      const AsyncOperation &operation);
+
+    /**
+     * Releases a reference to the count of outstanding calls of a
+     * batch of rearmNextWatches().  The last one queues the rearm
+     * event.
+     *
+     * @param pOutstanding the count
+     */
+    void releaseRearmBatch(int32_t *pOutstanding);
+
+    /**
+     * Is this the event that asks the event thread to issue the next
+     * batch of rearmNextWatches()?
+     */
+    bool isRearmEvent(const ZKWatcherEvent &event) const;
+
   private:
         
     /**
@@ -761,25 +2031,14 @@ class ZooKeeperAdapter
     zhandle_t *mp_zkHandle;
         
     /**
-     * The blocking queue of all events waiting to be processed by ZK adapter.
-     */
-    clusterlib::BlockingQueue<ZKWatcherEvent> m_events;
-        
-    /**
-     * The blocking queue of all events waiting to be processed by users
-     * of ZK adapter.
+     * The queue of all events waiting to be processed by ZK adapter.
      */
-    clusterlib::BlockingQueue<ZKWatcherEvent> m_userEvents;
+    clusterlib::MPSCQueue<ZKWatcherEvent> m_events;
         
     /**
      * The thread that dispatches all events from {@link #m_events} queue.
      */
     clusterlib::CXXThread<ZooKeeperAdapter> m_eventDispatcher;
-
-    /**
-     * The thread that dispatches all events from {@link #m_userEvents} queue.
-     */
-    clusterlib::CXXThread<ZooKeeperAdapter> m_userEventDispatcher;
                 
     /**
      * Whether this adapter is connected to the ZK.
@@ -810,6 +2069,55 @@ class ZooKeeperAdapter
      * Manages the CallbackAndContexts allocated by this object. 
      */
     clusterlib::CallbackAndContextManager m_listenerAndContextManager;
+
+    /**
+     * Nodes recently seen to exist, each with its entry in {@link
+     * #m_knownPathQueue}.  Used by createNode() to skip ancestors
+     * that need not be created.
+     */
+    std::map<std::string, std::list<std::string>::iterator> m_knownPathMap;
+
+    /**
+     * The order in which nodes were added to {@link #m_knownPathMap},
+     * oldest first.
+     */
+    std::list<std::string> m_knownPathQueue;
+
+    /**
+     * Makes {@link #m_knownPathMap} and {@link #m_knownPathQueue}
+     * thread-safe.
+     */
+    clusterlib::Mutex m_knownPathLock;
+
+    /**
+     * The watches set in the current session, by the context passed
+     * to ZK.
+     */
+    std::map<clusterlib::CallbackAndContext *, ZKWatchRecord> m_watchMap;
+
+    /**
+     * The watches lost with an expired session, to be set again by
+     * rearmLostWatches().
+     */
+    std::vector<ZKWatchRecord> m_lostWatchVec;
+
+    /**
+     * The lost watches that rearmNextWatches() has yet to issue in
+     * the current session.
+     */
+    std::vector<ZKWatchRecord> m_rearmWatchVec;
+
+    /**
+     * The contexts of the watches moved by loseWatches(), released
+     * when ZK reports the expiry to each of them.
+     */
+    std::set<clusterlib::CallbackAndContext *> m_lostContextSet;
+
+    /**
+     * Makes {@link #m_watchMap}, {@link #m_lostWatchVec}, {@link
+     * #m_rearmWatchVec} and {@link #m_lostContextSet} thread-safe.
+     */
+    clusterlib::Mutex m_watchLock;
     
     /**
      * How much time left for the connect to succeed, in milliseconds.
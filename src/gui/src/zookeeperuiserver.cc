@@ -322,7 +322,7 @@ ZooKeeperUIServer::init()
             m_config["zookeeper.servers"],
             client->getRoot()));
         m_clusterFactory->registerPeriodicThread(
-            *m_zookeeperPeriodicCheck.get());
+            *m_zookeeperPeriodicCheck.get(), true);
     }
     m_clusterRpcMethod.reset(new clusterlib::rpc::json::MethodAdaptor(
                                m_clusterFactory->createClient()));
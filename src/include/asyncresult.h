@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ *
+ * $Id$
+ */
+
+#ifndef	_CL_ASYNCRESULT_H_
+#define	_CL_ASYNCRESULT_H_
+
+namespace clusterlib {
+
+class AsyncResultBase;
+
+/**
+ * Interface for being notified when an asynchronous clusterlib
+ * operation (i.e. Root::getApplicationAsync()) completes.
+ */
+class AsyncResultCallback
+{
+  public:
+    /**
+     * Virtual destructor.
+     */
+    virtual ~AsyncResultCallback() {}
+
+    /**
+     * Called on a clusterlib thread after the operation has
+     * completed (the result may be read with get()).
+     * Implementations should not block for long, since other
+     * operations wait for the thread.  Exceptions thrown are logged
+     * and ignored.
+     *
+     * @param result the completed result
+     */
+    virtual void asyncCompleted(AsyncResultBase &result) = 0;
+};
+
+/**
+ * The state of an asynchronous clusterlib operation that does not
+ * depend on the type of its value.
+ */
+class AsyncResultBase
+{
+  public:
+    /**
+     * Rethrows the exception an operation failed with.
+     */
+    typedef void (*RethrowFunction)(const std::string &message);
+
+    /**
+     * Constructor.
+     *
+     * @param callback if not NULL, called when the operation completes
+     */
+    explicit AsyncResultBase(AsyncResultCallback *callback = NULL);
+
+    /**
+     * Virtual destructor.
+     */
+    virtual ~AsyncResultBase() {}
+
+    /**
+     * Wait for the operation to complete.
+     *
+     * @param msecTimeout the amount of msecs to wait until giving up,
+     *        -1 means wait forever, 0 means return immediately
+     * @return true if the operation completed, false otherwise
+     */
+    bool waitMsecs(int64_t msecTimeout = -1) const;
+
+    /**
+     * Has the operation completed?
+     */
+    bool isDone() const;
+
+    /**
+     * Did the operation throw?  Only valid after completion.
+     */
+    bool hasFailed() const;
+
+    /**
+     * Get the message of the exception the operation threw.  Only
+     * valid after completion.
+     */
+    std::string getError() const;
+
+    /**
+     * Wait for the operation to complete and throw the exception it
+     * threw again (with the same type), if any.
+     */
+    void rethrowIfFailed() const;
+
+    /**
+     * Complete the operation with an exception.  Used by
+     * clusterlib internals.
+     *
+     * @param rethrowFunction throws an exception of the type the
+     *        operation threw
+     * @param message the message of the exception
+     */
+    void setFailed(RethrowFunction rethrowFunction,
+                   const std::string &message);
+
+  protected:
+    /**
+     * Mark the operation completed, wake up the waiters and notify
+     * the callback.
+     */
+    void setDone();
+
+    /**
+     * Get the lock protecting the result.
+     */
+    Mutex &getResultLock() const { return m_mutex; }
+
+  private:
+    /**
+     * No copy constructor allowed.
+     */
+    AsyncResultBase(const AsyncResultBase &);
+
+    /**
+     * No assignment allowed.
+     */
+    AsyncResultBase &operator=(const AsyncResultBase &);
+
+  private:
+    /**
+     * Optional completion callback.
+     */
+    AsyncResultCallback *mp_callback;
+
+    /**
+     * Protects the result.
+     */
+    mutable Mutex m_mutex;
+
+    /**
+     * Signaled on completion.
+     */
+    Cond m_cond;
+
+    /**
+     * Has the operation completed?
+     */
+    bool m_done;
+
+    /**
+     * Throws the exception the operation failed with, NULL if it
+     * did not fail.
+     */
+    RethrowFunction mp_rethrowFunction;
+
+    /**
+     * The message of the exception the operation failed with.
+     */
+    std::string m_error;
+};
+
+/**
+ * \brief The future-like result of an asynchronous clusterlib
+ * operation with a value of type T.
+ *
+ * Returned (shared) by the *Async() methods.  The operation runs on
+ * a clusterlib thread, so the caller may issue many of them back to
+ * back and then wait on them, or register a callback.
+ */
+template <class T>
+class AsyncResult
+    : public AsyncResultBase
+{
+  public:
+    /**
+     * Constructor.
+     *
+     * @param callback if not NULL, called when the operation completes
+     */
+    explicit AsyncResult(AsyncResultCallback *callback = NULL)
+        : AsyncResultBase(callback),
+          m_value() {}
+
+    /**
+     * Wait for the operation to complete and get its value.
+     *
+     * @return the value the operation returned
+     * @throw the exception the operation threw, if any
+     */
+    const T &get() const
+    {
+        rethrowIfFailed();
+        return m_value;
+    }
+
+    /**
+     * Complete the operation with a value.  Used by clusterlib
+     * internals.
+     *
+     * @param value the value of the operation
+     */
+    void setValue(const T &value)
+    {
+        {
+            Locker l(&getResultLock());
+            m_value = value;
+        }
+        setDone();
+    }
+
+  private:
+    /**
+     * The value of the operation.
+     */
+    T m_value;
+};
+
+}	/* End of 'namespace clusterlib' */
+
+#endif	/* !_CL_ASYNCRESULT_H_ */
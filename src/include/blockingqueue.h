@@ -55,6 +55,32 @@ class BlockingQueue
          * @return true if an element was retrieved, false otherwise
          */
         bool takeWaitMsecs(int64_t msecTimeout, E &element);
+
+        /**
+         * \brief Retrieves and removes the elements at the head of
+         * this queue, waiting if no elements are present in this
+         * queue.  All of them are taken under one lock acquisition.
+         * 
+         * @param msecTimeout the amount of msecs to wait until giving up, 
+         *        -1 means wait forever, 0 means return immediately
+         * @param elements the vector the elements are appended to
+         * @param maxElements the most elements to take
+         * @return true if at least one element was retrieved, false 
+         *         otherwise
+         */
+        bool takeAllWaitMsecs(int64_t msecTimeout, 
+                              std::vector<E> &elements,
+                              size_t maxElements);
+
+        /**
+         * \brief Retrieves and removes the elements at the head of
+         * this queue without waiting.
+         * 
+         * @param elements the vector the elements are appended to
+         * @param maxElements the most elements to take
+         * @return the number of elements retrieved
+         */
+        size_t drainTo(std::vector<E> &elements, size_t maxElements);
         
         /**
          * Returns the current size of this blocking queue.
@@ -75,6 +101,16 @@ class BlockingQueue
          */
         void erase();
 
+    private:
+        /**
+         * Wait until the queue has elements.  The mutex must be held.
+         *
+         * @param msecTimeout the amount of msecs to wait until giving up, 
+         *        -1 means wait forever, 0 means return immediately
+         * @return true if the queue has elements, false if timed out
+         */
+        bool waitForElements(int64_t msecTimeout);
+
     private:        
         /**
          * The queue of elements. Deque is used to provide O(1) time 
@@ -145,6 +181,22 @@ bool BlockingQueue<E>::takeWaitMsecs(int64_t msecTimeout, E &element)
         throw InvalidArgumentsException(ss.str());
     }
 
+    m_mutex.acquire();
+    if (waitForElements(msecTimeout)) {
+        element = m_queue.front();
+        m_queue.pop_front();
+        m_mutex.release();
+        return true;
+    } 
+    else {
+        m_mutex.release();
+        return false;
+    }
+}
+
+template<class E> 
+bool BlockingQueue<E>::waitForElements(int64_t msecTimeout)
+{
     /* Adjust the curUsecTimeout for msecTimeout */
     int64_t curUsecTimeout = 0;
     int64_t maxUsecs = 0;
@@ -155,7 +207,6 @@ bool BlockingQueue<E>::takeWaitMsecs(int64_t msecTimeout, E &element)
         curUsecTimeout = -1;
     }
 
-    m_mutex.acquire();
     bool hasResult = true;
     while (m_queue.empty()) {
         if (curUsecTimeout != -1) {
@@ -176,16 +227,43 @@ bool BlockingQueue<E>::takeWaitMsecs(int64_t msecTimeout, E &element)
             break;
         }
     }
+    return hasResult;
+}
+
+template<class E> 
+bool BlockingQueue<E>::takeAllWaitMsecs(int64_t msecTimeout, 
+                                        std::vector<E> &elements,
+                                        size_t maxElements)
+{
+    if (msecTimeout < -1) {
+        std::stringstream ss;
+        ss << "takeAllWaitMsecs: Cannot have msecTimeout < -1 (" 
+           << msecTimeout << ")";
+        throw InvalidArgumentsException(ss.str());
+    }
+
+    /* The mutex is recursive, so drainTo() takes it again cheaply. */
+    m_mutex.acquire();
+    bool hasResult = waitForElements(msecTimeout);
     if (hasResult) {
-        element = m_queue.front();
-        m_queue.pop_front();
-        m_mutex.release();
-        return true;
-    } 
-    else {
-        m_mutex.release();
-        return false;
+        drainTo(elements, maxElements);
     }
+    m_mutex.release();
+    return hasResult;
+}
+
+template<class E> 
+size_t BlockingQueue<E>::drainTo(std::vector<E> &elements, 
+                                 size_t maxElements)
+{
+    m_mutex.acquire();
+    size_t count = std::min(maxElements, m_queue.size());
+    elements.insert(elements.end(), 
+                    m_queue.begin(), 
+                    m_queue.begin() + count);
+    m_queue.erase(m_queue.begin(), m_queue.begin() + count);
+    m_mutex.release();
+    return count;
 }
 
 template<class E>
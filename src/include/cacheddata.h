@@ -48,6 +48,24 @@ class CachedData
      */
     virtual int32_t publish(bool unconditional = false) = 0;
 
+    /**
+     * Publish without blocking the caller (see publish()).  The data
+     * is sent to the repository before this returns (unless it is
+     * too large for a single node, then it is sent on a clusterlib
+     * thread), and the version is set on a clusterlib thread when
+     * the repository replies.  A publish that is not unconditional
+     * expects the version at the time it is called, so only the
+     * first of several issued back to back can succeed.
+     *
+     * @param unconditional If true, publish the data from this object
+     *        even if it is not the latest version.
+     * @param callback if not NULL, called when the operation completes
+     * @return the result, with the published version
+     */
+    virtual boost::shared_ptr<AsyncResult<int32_t> > publishAsync(
+        bool unconditional = false,
+        AsyncResultCallback *callback = NULL) = 0;
+
     /**
      * Simpler interface to get the version of this repository data.
      *
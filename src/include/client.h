@@ -133,6 +133,12 @@ const int32_t EN_ENDEVENT =                         (1<<26);
 /** Notifyable desired state has changed */
 const int32_t EN_DESIRED_STATE_CHANGE =		    (1<<27);
 
+/** 
+ * Not an event.  In the mask of a handler, merges the events waiting
+ * for it (see UserEventHandler::setCoalesce()).
+ */
+const int32_t EN_COALESCE =                         (1<<30);
+
 
 /*
  * Interface for user event handler. Must be derived
@@ -261,6 +267,9 @@ class UserEventHandler
         if (event & EN_DESIRED_STATE_CHANGE) { /* 27 */
             encodedEvents.append("EN_ENDEVENT,");
         }
+        if (event & EN_COALESCE) { /* 30 */
+            encodedEvents.append("EN_COALESCE,");
+        }
 
         /* Get rid of the last ',' */
         if (!encodedEvents.empty()) {
@@ -287,6 +296,7 @@ class UserEventHandler
     Event getMask() { return m_mask; }
     ClientData getClientData() { return m_cd; }
     bool getInitialRun() { return m_initialRun; }
+    bool getCoalesce() { return ((m_mask & EN_COALESCE) != 0); }
 
     void setNotifyable(const boost::shared_ptr<Notifyable> &notifyableSP) 
     {
@@ -295,6 +305,29 @@ class UserEventHandler
     void setMask(Event e) { m_mask = e; }
     void setClienData(ClientData cd) { m_cd = cd; }
 
+    /**
+     * Merge the events waiting for this handler (same as adding
+     * EN_COALESCE to the mask).  When several events on the
+     * notifyable are queued for the client at once (i.e. a burst of
+     * state changes), the handler is only called after the last of
+     * them, once for each kind of event among them that matches the
+     * mask, from the lowest event value up.  Each call still gets a
+     * single event.  The cached state it then reads is the latest.
+     * Use it when only the current state matters to the handler, not
+     * each change.
+     *
+     * @param coalesce true to merge the events
+     */
+    void setCoalesce(bool coalesce) 
+    { 
+        if (coalesce) {
+            m_mask |= EN_COALESCE;
+        }
+        else {
+            m_mask &= ~EN_COALESCE;
+        }
+    }
+
     Event addEvent(Event a) { m_mask |= a; return m_mask; }
     Event removeEvent(Event a) { m_mask &= (~a); return m_mask; }
 
@@ -458,6 +491,34 @@ class Client
      */
     virtual bool cancelHandler(UserEventHandler *uehp) = 0;
 
+    /**
+     * \brief Get the file descriptor that is readable while events
+     * are pending on a client created without handler threads (see
+     * Factory::createClient()).
+     *
+     * Add it to the poll/epoll loop of the application and call
+     * dispatchPending() when it is readable.  Do not read from it or
+     * close it.
+     *
+     * @return the file descriptor, or -1 if the client has handler
+     *         threads
+     */
+    virtual int32_t getEventFd() = 0;
+
+    /**
+     * \brief Run the handlers of the events pending on a client
+     * created without handler threads, on the calling thread.
+     *
+     * Never blocks waiting for events.  Only one thread at a time may
+     * call it.  If events are still pending when it returns, the
+     * event file descriptor stays readable.
+     *
+     * @param maxEvents the most events to handle
+     * @return the number of events handled
+     * @throw InvalidMethodException if the client has handler threads
+     */
+    virtual int32_t dispatchPending(int32_t maxEvents) = 0;
+
     /**
      * Virtual destructor.
      */
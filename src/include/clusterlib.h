@@ -29,7 +29,9 @@
 #include <string>
 #include <vector>
 #include <deque>
+#include <list>
 #include <map>
+#include <set>
 #include <algorithm>
 #include <iostream>
 #include <sstream> 
@@ -54,9 +56,11 @@
 #include "timerservice.h"
 #include "blockingqueue.h"
 #include "thread.h"
+#include "asyncresult.h"
 #include "cacheddata.h"
 #include "healthchecker.h"
 #include "periodic.h"
+#include "repositorystats.h"
 
 #include "json.h"
 #include "jsonrpc.h"
@@ -29,11 +29,36 @@ class Factory
      * the specified cluster registry.
      *
      * @param registry the Zookeeper comma separated list of
-     *        server:port (i.e. localhost:2221,localhost2:2222).
+     *        server:port (i.e. localhost:2221,localhost2:2222), or
+     *        "inmemory:[<name>][:<latency usecs>]" to keep all the
+     *        objects in this process (i.e. "inmemory:bench:500"
+     *        adds 500 usecs to each operation).  Factories using
+     *        the same in-memory name share their objects.
      * @param msecConnectTimeout the amount of milliseconds to wait for a 
      *        connection to the specified registry (defaulted to 30000)
-     */
-    Factory(const std::string &registry, int64_t msecConnectTimeout = 30000);
+     * @param repositorySessions the number of sessions to the registry
+     *        (defaulted to 1).  Watches, ephemeral nodes and locks
+     *        always use the first session.  Operations that do not
+     *        depend on session ordering (i.e. Queue::put()) are spread
+     *        across all of them.  Reads stay on the first session, so
+     *        they see what this process wrote.
+     * @param eventDispatchThreads the number of threads that update
+     *        the cache and send events to the clients (defaulted to
+     *        1).  With 1, every event is dispatched in the order it
+     *        was received.  With more, the events are spread across
+     *        the threads by Notifyable: the events of one Notifyable
+     *        keep their order, but events of different Notifyables
+     *        may be dispatched in any order.  synchronize() still
+     *        waits for every event received before it.
+     * @param periodicThreads the number of threads shared by the
+     *        Periodic objects that do not block (defaulted to 4, at
+     *        least 1).  See registerPeriodicThread().
+     */
+    Factory(const std::string &registry, 
+            int64_t msecConnectTimeout = 30000,
+            int32_t repositorySessions = 1,
+            int32_t eventDispatchThreads = 1,
+            int32_t periodicThreads = 4);
 
     /**
      * Destructor.
@@ -44,9 +69,21 @@ class Factory
      * Create a cluster client object.  This object is a gateway to
      * the clusterlib objects and a context for user-level events.
      *
+     * @param handlerThreads the number of threads that run the
+     *        UserEventHandler objects registered with the client
+     *        (defaulted to 1).  With 1, every handler runs in the
+     *        order the events were received, one at a time.  With
+     *        more, the handlers are spread across the threads by
+     *        Notifyable: the handlers of one Notifyable run one at a
+     *        time in the order of its events, but handlers of
+     *        different Notifyables (i.e. the JSON-RPC method handler
+     *        and a slow user handler) may run at the same time.
+     *        With 0, the client has no threads: the application
+     *        polls Client::getEventFd() and runs the handlers with
+     *        Client::dispatchPending().
      * @return a Client pointer
      */
-    Client *createClient();
+    Client *createClient(int32_t handlerThreads = 1);
 
     /**
      * Remove a clusterlib client object.  This is the only safe way
@@ -116,29 +153,70 @@ class Factory
 
     /**
      * Register a new Periodic object.  This Periodic object will be
-     * run at regular intervals according to its set frequency.
+     * run at regular intervals according to its set frequency, give
+     * or take a small random jitter.  The Periodic objects of a
+     * Factory share a pool of threads (see the periodicThreads
+     * parameter of the constructor).  A run() that waits (i.e. on a
+     * distributed lock or a slow repository) holds a thread that the
+     * other Periodic objects need to run on time, so register such a
+     * Periodic with mayBlock: the pool then has one more thread for
+     * as long as it is registered.
      *
      * @param periodic The periodic object to start running at regular
      *        intervals.
+     * @param mayBlock true if run() may block (defaulted to false)
      */
-    void registerPeriodicThread(Periodic &periodic);
+    void registerPeriodicThread(Periodic &periodic, bool mayBlock = false);
 
     /**
      * Unregister a Periodic object. This will cause it to stop
-     * running.
+     * running.  If run() is in progress, waits for it to finish.
+     * Called from its own run(), it returns right away and run() is
+     * not called again.
      * 
      * @param periodic The Periodic object to stop.
      * @return True if found and stopped, false otherwise.
      */
     bool cancelPeriodicThread(Periodic &periodic);
 
+    /**
+     * Get a snapshot of the operations this factory has made against
+     * the repository so far (over all its sessions): counts, latency
+     * histograms, retries, data bytes and watches.  Taking a
+     * snapshot does not block the operations in progress.
+     * 
+     * @return the snapshot
+     */
+    RepositoryStats getRepositoryStats();
+
+    /**
+     * Set the counters returned by getRepositoryStats() back to 0.
+     */
+    void resetRepositoryStats();
+
+    /**
+     * Compress the data of large repository nodes (i.e. shard
+     * tables, property lists and state) written by this factory from
+     * now on.  Data is compressed with zlib behind a header that
+     * tells it apart from plain data, so compressed and plain data
+     * can be mixed and data written before is still read.  Readers
+     * older than this feature cannot read compressed data, so only
+     * turn it on once every process using the registry understands
+     * it.  Data that does not get smaller is stored plain.  A build
+     * without zlib never compresses and cannot read compressed data.
+     *
+     * @param threshold the smallest node data to compress in bytes
+     *        (i.e. 1024); -1 (the default) turns compression off
+     */
+    void setDataCompressionThreshold(int32_t threshold);
+
     /**
      * For use by unit tests only: get the zkadapter so that the test can
      * synthesize ZK events and examine the results.
      * 
-     * @return the ZooKeeperAdapter * from Factory Ops
+     * @return the Repository * from Factory Ops
      */
-    zk::ZooKeeperAdapter *getRepository();    
+    zk::Repository *getRepository();    
     
   private:
     /**
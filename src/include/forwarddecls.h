@@ -106,6 +106,7 @@ class RegisteredNodeImpl;
 class RegisteredQueueImpl;
 class RegisteredProcessSlotImpl;
 class RegisteredPropertyListImpl;
+class RepositoryStats;
 class Root;
 class RootImpl;
 class Queue;
@@ -205,7 +206,10 @@ typedef uint32_t ServerFlags;
 
 namespace zk {
 
+class Repository;
+class RepositoryStatsRecorder;
 class ZooKeeperAdapter;
+class InMemoryRepository;
 
 }	/* End of 'namespace zk' */
 
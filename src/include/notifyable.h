@@ -111,9 +111,25 @@ class Notifyable
     /**
      * Get a list of all the children of this notifyable.
      *
+     * @param accessType CACHED_ONLY only gets the children in the
+     *        cache of this process, without going to the repository,
+     *        otherwise all the children are loaded from the repository
      * @return list of child Notifyable pointers
      */
-    virtual NotifyableList getMyChildren() = 0;
+    virtual NotifyableList getMyChildren(
+        AccessType accessType = LOAD_FROM_REPOSITORY) = 0;
+
+    /**
+     * Get a list of all the children of this notifyable without
+     * blocking the caller.  The names of the children are requested
+     * from the repository together, and once they have all arrived,
+     * the children are loaded on a clusterlib thread.
+     *
+     * @param callback if not NULL, called when the operation completes
+     * @return the result, with the list of child Notifyable pointers
+     */
+    virtual boost::shared_ptr<AsyncResult<NotifyableList> > 
+    getMyChildrenAsync(AsyncResultCallback *callback = NULL) = 0;
 
     /**
      * Retrieve the application object that this Notifyable is a part of.  
@@ -188,6 +204,18 @@ class Notifyable
     virtual boost::shared_ptr<Notifyable> getNotifyableFromKey(
         const std::string &key) = 0;
 
+    /**
+     * Get the notifyables in the cache of this process with keys that
+     * start with a prefix, without going to the repository.  A key
+     * followed by the key separator gets all the cached notifyables
+     * under that notifyable.
+     *
+     * @param keyPrefix the prefix of the keys
+     * @return the cached notifyables, each before the ones under it
+     */
+    virtual NotifyableList getCachedNotifyablesFromKeyPrefix(
+        const std::string &keyPrefix) = 0;
+
     /**
      * What state is this Notifyable in?  It is safe to call this even
      * if the Notifyable was removed but still has a valid reference
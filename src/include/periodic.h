@@ -45,7 +45,12 @@ class Periodic
     virtual ~Periodic() {}
 
     /**
-     * Subclasses define this function to be run periodically.
+     * Subclasses define this function to be run periodically.  It
+     * runs on a thread shared with the other Periodic objects of the
+     * Factory, so register it with mayBlock if it may block (see
+     * Factory::registerPeriodicThread()).  If it throws, it is run
+     * again later: the wait doubles with each failure in a row, up to
+     * 16 times its frequency.
      */
     virtual void run() = 0;
 
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ *
+ * $Id$
+ */
+
+#ifndef	_CL_REPOSITORYSTATS_H_
+#define	_CL_REPOSITORYSTATS_H_
+
+namespace clusterlib {
+
+/**
+ * A snapshot of the operations a Factory made against the
+ * repository: per-operation counts and latency histograms, retries,
+ * node data bytes read and written and watches registered.
+ *
+ * Latencies are kept in power-of-two buckets.  Bucket 0 counts the
+ * operations that took 0 usecs and bucket i counts the ones that took
+ * [2^(i-1), 2^i) usecs.  The last bucket also counts anything slower.
+ * The counters are read one at a time while operations continue, so
+ * a snapshot taken under load may be off by the operations in flight.
+ */
+class RepositoryStats
+{
+  public:
+    /**
+     * The repository operations that are measured.
+     */
+    enum Operation {
+        GET_DATA = 0,
+        GET_CHILDREN,
+        EXISTS,
+        CREATE,
+        SET_DATA,
+        DELETE,
+        SYNC,
+        MULTI,
+        OPERATION_COUNT
+    };
+
+    /**
+     * The number of latency buckets per operation.
+     */
+    enum {
+        LATENCY_BUCKET_COUNT = 32
+    };
+
+    /**
+     * Get a printable name for an operation.
+     *
+     * @param operation the operation
+     * @return the name of the operation
+     */
+    static std::string getOperationName(Operation operation);
+
+    /**
+     * Get the largest latency counted by a bucket.
+     *
+     * @param bucket the bucket (0 to LATENCY_BUCKET_COUNT - 1)
+     * @return the largest latency in usecs, or -1 for the last bucket
+     */
+    static int64_t getLatencyBucketMaxUsecs(int32_t bucket);
+
+    /**
+     * Get the bucket that counts a latency.
+     *
+     * @param usecs the latency in usecs
+     * @return the bucket
+     */
+    static int32_t getLatencyBucket(int64_t usecs);
+
+    /**
+     * Constructor.  All the counters are 0.
+     */
+    RepositoryStats();
+
+    /**
+     * Get the number of completed operations.
+     *
+     * @param operation the operation
+     * @return the count
+     */
+    int64_t getCount(Operation operation) const;
+
+    /**
+     * Get the number of operations that failed with a system error
+     * (i.e. connection loss or timeout) or threw.  Expected results
+     * such as a missing node are not errors.
+     *
+     * @param operation the operation
+     * @return the count
+     */
+    int64_t getErrorCount(Operation operation) const;
+
+    /**
+     * Get the sum of the latencies of the operations.
+     *
+     * @param operation the operation
+     * @return the total usecs
+     */
+    int64_t getTotalUsecs(Operation operation) const;
+
+    /**
+     * Get the largest latency of the operations.
+     *
+     * @param operation the operation
+     * @return the maximum usecs
+     */
+    int64_t getMaxUsecs(Operation operation) const;
+
+    /**
+     * Get the number of operations counted by a latency bucket.
+     *
+     * @param operation the operation
+     * @param bucket the bucket (0 to LATENCY_BUCKET_COUNT - 1)
+     * @return the count
+     */
+    int64_t getLatencyBucketCount(Operation operation, int32_t bucket) const;
+
+    /**
+     * Estimate a latency percentile from the histogram.  The result
+     * is the upper bound of the bucket the percentile falls in (or
+     * the maximum latency for the last bucket).
+     *
+     * @param operation the operation
+     * @param percentile the percentile (0.0 to 100.0)
+     * @return the latency in usecs, 0 if there were no operations
+     */
+    int64_t getPercentileUsecs(Operation operation, double percentile) const;
+
+    /**
+     * Get the number of times an operation was retried after a
+     * connection loss or a timeout.
+     */
+    int64_t getRetryCount() const { return m_retryCount; }
+
+    /**
+     * Get the number of node data bytes read.
+     */
+    int64_t getBytesRead() const { return m_bytesRead; }
+
+    /**
+     * Get the number of node data bytes returned after decoding
+     * (i.e. decompression), counted when the data is decoded.
+     * Compare with getBytesRead(), which counts the stored bytes.
+     */
+    int64_t getBytesDecoded() const { return m_bytesDecoded; }
+
+    /**
+     * Get the number of node data reads that could not be decoded.
+     */
+    int64_t getDecodeErrorCount() const { return m_decodeErrorCount; }
+
+    /**
+     * Get the number of node data bytes written.
+     */
+    int64_t getBytesWritten() const { return m_bytesWritten; }
+
+    /**
+     * Get the number of watches registered.
+     */
+    int64_t getWatchCount() const { return m_watchCount; }
+
+    /**
+     * Add the counters of another snapshot to this one.
+     *
+     * @param other the other snapshot
+     */
+    void add(const RepositoryStats &other);
+
+    /**
+     * Get a multi-line summary of the non-empty counters.
+     *
+     * @return the summary
+     */
+    std::string toString() const;
+
+  private:
+    /**
+     * Throws if the operation is out of range.
+     */
+    static void checkOperation(Operation operation);
+
+    /**
+     * The recorder updates the counters in place.
+     */
+    friend class zk::RepositoryStatsRecorder;
+
+  private:
+    /**
+     * Completed operations.
+     */
+    int64_t m_count[OPERATION_COUNT];
+
+    /**
+     * Failed operations.
+     */
+    int64_t m_errorCount[OPERATION_COUNT];
+
+    /**
+     * Sum of the latencies.
+     */
+    int64_t m_totalUsecs[OPERATION_COUNT];
+
+    /**
+     * Largest latency.
+     */
+    int64_t m_maxUsecs[OPERATION_COUNT];
+
+    /**
+     * Latency histograms.
+     */
+    int64_t m_latencyBucketCount[OPERATION_COUNT][LATENCY_BUCKET_COUNT];
+
+    /**
+     * Retried operations.
+     */
+    int64_t m_retryCount;
+
+    /**
+     * Node data bytes read.
+     */
+    int64_t m_bytesRead;
+
+    /**
+     * Node data bytes after decoding.
+     */
+    int64_t m_bytesDecoded;
+
+    /**
+     * Node data that could not be decoded.
+     */
+    int64_t m_decodeErrorCount;
+
+    /**
+     * Node data bytes written.
+     */
+    int64_t m_bytesWritten;
+
+    /**
+     * Watches registered.
+     */
+    int64_t m_watchCount;
+};
+
+}	/* End of 'namespace clusterlib' */
+
+#endif	/* !_CL_REPOSITORYSTATS_H_ */
@@ -62,6 +62,21 @@ class Root
         const std::string &name,
         AccessType accessType) = 0;
 
+    /**
+     * Get the named Application without blocking the caller.  The
+     * operation runs on a clusterlib thread.
+     * 
+     * @param name Name of the Application to get
+     * @param accessType Mode of access
+     * @param callback if not NULL, called when the operation completes
+     * @return the result, with NULL if the named Application does not 
+     *         exist
+     */
+    virtual boost::shared_ptr<AsyncResult<boost::shared_ptr<Application> > >
+    getApplicationAsync(const std::string &name,
+                        AccessType accessType,
+                        AsyncResultCallback *callback = NULL) = 0;
+
     /*
      * Destructor.
      */
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ * 
+ * $Id$
+ */
+
+#include "clusterlibinternal.h"
+#include "testparams.h"
+#include "MPITestFixture.h"
+
+extern TestParams globalTestParams;
+
+using namespace clusterlib;
+using namespace std;
+using namespace boost;
+
+/*
+ * A size that no event wrapper has, so that the tests have the
+ * EventWrapperPool free lists of that size to themselves.
+ */
+static const size_t testBlockSize = 1237;
+
+/*
+ * Releases blocks to the EventWrapperPool on its own thread.
+ */
+class BlockReleaser
+{
+  public:
+    BlockReleaser(const vector<void *> &blockVec)
+        : m_blockVec(blockVec) {}
+
+    void run(void *param)
+    {
+        for (size_t i = 0; i < m_blockVec.size(); ++i) {
+            EventWrapperPool::deallocate(m_blockVec[i], testBlockSize);
+        }
+    }
+
+  private:
+    vector<void *> m_blockVec;
+};
+
+class ClusterlibEvent : public MPITestFixture
+{
+    CPPUNIT_TEST_SUITE(ClusterlibEvent);
+    CPPUNIT_TEST(testEvent1);
+    CPPUNIT_TEST(testEvent2);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    
+    ClusterlibEvent() 
+        : MPITestFixture(globalTestParams) {}
+
+    /* Runs prior to each test */
+    virtual void setUp() 
+    {
+    }
+
+    /* Runs after each test */
+    virtual void tearDown() 
+    {
+        cleanAndBarrierMPITest(NULL, false);
+    }
+
+    /* 
+     * Copies of a GenericEvent share the wrapper, and the memory of a
+     * released wrapper is reused by the same thread.
+     */
+    void testEvent1()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    NULL,
+                                    false, 
+                                    "testEvent1");
+
+        GenericEvent event(TIMEREVENT, new EventWrapper<int32_t>(7));
+        GenericEvent copy(event);
+        GenericEvent assigned;
+        assigned = copy;
+        MPI_CPPUNIT_ASSERT(copy.getEvent() == event.getEvent());
+        MPI_CPPUNIT_ASSERT(assigned.getEvent() == event.getEvent());
+        MPI_CPPUNIT_ASSERT(*reinterpret_cast<int32_t *>(
+                               assigned.getEvent()) == 7);
+
+        void *block = EventWrapperPool::allocate(testBlockSize);
+        MPI_CPPUNIT_ASSERT(block != NULL);
+        EventWrapperPool::deallocate(block, testBlockSize);
+        MPI_CPPUNIT_ASSERT(
+            EventWrapperPool::allocate(testBlockSize) == block);
+        EventWrapperPool::deallocate(block, testBlockSize);
+    }
+
+    /* 
+     * Blocks released by another thread, as the event dispatch
+     * threads release the wrappers allocated by the repository
+     * thread, are reused by the allocating thread.
+     */
+    void testEvent2()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    NULL,
+                                    false, 
+                                    "testEvent2");
+
+        const size_t blockCount = 
+            3 * CLNumericInternal::EVENT_WRAPPER_BATCH_SIZE;
+        vector<void *> blockVec;
+        set<void *> blockSet;
+        for (size_t i = 0; i < blockCount; ++i) {
+            blockVec.push_back(EventWrapperPool::allocate(testBlockSize));
+            blockSet.insert(blockVec.back());
+        }
+        MPI_CPPUNIT_ASSERT(blockSet.size() == blockCount);
+
+        /* The releasing thread gives its cache back when it exits. */
+        BlockReleaser releaser(blockVec);
+        CXXThread<BlockReleaser> releaserThread;
+        releaserThread.Create(releaser, &BlockReleaser::run);
+        releaserThread.Join();
+
+        blockVec.clear();
+        for (size_t i = 0; i < blockCount; ++i) {
+            blockVec.push_back(EventWrapperPool::allocate(testBlockSize));
+            MPI_CPPUNIT_ASSERT(blockSet.erase(blockVec.back()) == 1);
+        }
+        MPI_CPPUNIT_ASSERT(blockSet.empty());
+        for (size_t i = 0; i < blockCount; ++i) {
+            EventWrapperPool::deallocate(blockVec[i], testBlockSize);
+        }
+    }
+};
+
+/* Registers the fixture into the 'registry' */
+CPPUNIT_TEST_SUITE_REGISTRATION(ClusterlibEvent);
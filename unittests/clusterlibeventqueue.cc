@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ * 
+ * $Id$
+ */
+
+#include "clusterlibinternal.h"
+#include "testparams.h"
+#include "MPITestFixture.h"
+
+extern TestParams globalTestParams;
+
+using namespace clusterlib;
+using namespace std;
+using namespace boost;
+
+/*
+ * Puts elements into a queue on its own thread.  Each element holds
+ * the producer index in the upper 32 bits and its sequence number in
+ * the lower 32 bits, so the consumer can check the order.
+ */
+template <class Q>
+class QueueProducer
+{
+  public:
+    QueueProducer(Q &queue, uint64_t index, uint64_t count)
+        : m_queue(queue),
+          m_index(index),
+          m_count(count) {}
+
+    void run(void *param)
+    {
+        for (uint64_t i = 0; i < m_count; ++i) {
+            m_queue.put((m_index << 32) | i);
+        }
+    }
+
+  private:
+    Q &m_queue;
+    uint64_t m_index;
+    uint64_t m_count;
+};
+
+/*
+ * Take every element of several producers in batches and check that
+ * the elements of each producer come out in order.
+ *
+ * @param queue the queue to use
+ * @param producers the number of producer threads
+ * @param count the elements each producer puts
+ * @param batchSize the most elements to take at a time
+ * @return true if all the elements were taken in order
+ */
+template <class Q>
+static bool
+takeInProducerOrder(Q &queue, 
+                    uint64_t producers, 
+                    uint64_t count, 
+                    size_t batchSize)
+{
+    vector<QueueProducer<Q> *> producerVec;
+    vector<CXXThread<QueueProducer<Q> > *> threadVec;
+    for (uint64_t i = 0; i < producers; ++i) {
+        producerVec.push_back(new QueueProducer<Q>(queue, i, count));
+        threadVec.push_back(new CXXThread<QueueProducer<Q> >());
+        threadVec.back()->Create(*producerVec.back(), 
+                                 &QueueProducer<Q>::run);
+    }
+
+    bool ordered = true;
+    vector<uint64_t> nextSequence(producers, 0);
+    vector<uint64_t> elements;
+    uint64_t taken = 0;
+    while (taken < producers * count) {
+        elements.clear();
+        if (!queue.takeAllWaitMsecs(10000, elements, batchSize) ||
+            (elements.size() > batchSize)) {
+            ordered = false;
+            break;
+        }
+        for (size_t i = 0; i < elements.size(); ++i) {
+            uint64_t index = elements[i] >> 32;
+            if ((index >= producers) ||
+                ((elements[i] & 0xffffffffULL) != nextSequence[index])) {
+                ordered = false;
+            }
+            else {
+                ++nextSequence[index];
+            }
+        }
+        taken += elements.size();
+    }
+
+    for (uint64_t i = 0; i < producers; ++i) {
+        threadVec[i]->Join();
+        delete threadVec[i];
+        delete producerVec[i];
+    }
+    return ordered && queue.empty();
+}
+
+class ClusterlibEventQueue : public MPITestFixture
+{
+    CPPUNIT_TEST_SUITE(ClusterlibEventQueue);
+    CPPUNIT_TEST(testEventQueue1);
+    CPPUNIT_TEST(testEventQueue2);
+    CPPUNIT_TEST(testEventQueue3);
+    CPPUNIT_TEST(testEventQueue4);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    
+    ClusterlibEventQueue() 
+        : MPITestFixture(globalTestParams) {}
+
+    /* Runs prior to each test */
+    virtual void setUp() 
+    {
+    }
+
+    /* Runs after each test */
+    virtual void tearDown() 
+    {
+        cleanAndBarrierMPITest(NULL, false);
+    }
+
+    /* 
+     * Several producers put into an MPSCQueue with a small ring, so
+     * that puts overflow, and the elements of each producer are
+     * taken in order.
+     */
+    void testEventQueue1()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    NULL,
+                                    false, 
+                                    "testEventQueue1");
+
+        MPSCQueue<uint64_t> queue(16);
+        MPI_CPPUNIT_ASSERT(takeInProducerOrder(queue, 4, 20000, 1));
+        MPI_CPPUNIT_ASSERT(takeInProducerOrder(queue, 4, 20000, 64));
+    }
+
+    /* 
+     * MPSCQueue::takeAllWaitMsecs() times out on an empty queue,
+     * takes at most the requested number of elements and keeps the
+     * rest for the next take.
+     */
+    void testEventQueue2()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    NULL,
+                                    false, 
+                                    "testEventQueue2");
+
+        MPSCQueue<int32_t> queue;
+        vector<int32_t> elements;
+        int64_t startMsecs = TimerService::getCurrentTimeMsecs();
+        MPI_CPPUNIT_ASSERT(queue.takeAllWaitMsecs(100, elements, 10) == 
+                           false);
+        MPI_CPPUNIT_ASSERT(TimerService::getCurrentTimeMsecs() - 
+                           startMsecs >= 100);
+        MPI_CPPUNIT_ASSERT(elements.empty());
+
+        for (int32_t i = 0; i < 5; ++i) {
+            queue.put(i);
+        }
+        MPI_CPPUNIT_ASSERT(queue.takeAllWaitMsecs(0, elements, 3));
+        MPI_CPPUNIT_ASSERT(elements.size() == 3);
+        MPI_CPPUNIT_ASSERT(queue.size() == 2);
+        MPI_CPPUNIT_ASSERT(queue.takeAllWaitMsecs(-1, elements, 10));
+        MPI_CPPUNIT_ASSERT(elements.size() == 5);
+        for (int32_t i = 0; i < 5; ++i) {
+            MPI_CPPUNIT_ASSERT(elements[i] == i);
+        }
+        MPI_CPPUNIT_ASSERT(queue.empty());
+    }
+
+    /* 
+     * Several producers put into a BlockingQueue and the elements of
+     * each producer are taken in order, one at a time and in batches.
+     */
+    void testEventQueue3()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    NULL,
+                                    false, 
+                                    "testEventQueue3");
+
+        BlockingQueue<uint64_t> queue;
+        MPI_CPPUNIT_ASSERT(takeInProducerOrder(queue, 4, 20000, 1));
+        MPI_CPPUNIT_ASSERT(takeInProducerOrder(queue, 4, 20000, 64));
+    }
+
+    /* 
+     * BlockingQueue::drainTo() never waits and takes at most the
+     * requested number of elements, and
+     * BlockingQueue::takeAllWaitMsecs() waits for the first element
+     * and then behaves like drainTo().
+     */
+    void testEventQueue4()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    NULL,
+                                    false, 
+                                    "testEventQueue4");
+
+        BlockingQueue<int32_t> queue;
+        vector<int32_t> elements;
+        MPI_CPPUNIT_ASSERT(queue.drainTo(elements, 10) == 0);
+        int64_t startMsecs = TimerService::getCurrentTimeMsecs();
+        MPI_CPPUNIT_ASSERT(queue.takeAllWaitMsecs(100, elements, 10) == 
+                           false);
+        MPI_CPPUNIT_ASSERT(TimerService::getCurrentTimeMsecs() - 
+                           startMsecs >= 100);
+        MPI_CPPUNIT_ASSERT(elements.empty());
+        bool caught = false;
+        try {
+            queue.takeAllWaitMsecs(-2, elements, 10);
+        }
+        catch (InvalidArgumentsException &e) {
+            caught = true;
+        }
+        MPI_CPPUNIT_ASSERT(caught);
+
+        for (int32_t i = 0; i < 6; ++i) {
+            queue.put(i);
+        }
+        MPI_CPPUNIT_ASSERT(queue.drainTo(elements, 2) == 2);
+        MPI_CPPUNIT_ASSERT(elements.size() == 2);
+        MPI_CPPUNIT_ASSERT(queue.takeAllWaitMsecs(0, elements, 3));
+        MPI_CPPUNIT_ASSERT(elements.size() == 5);
+        MPI_CPPUNIT_ASSERT(queue.size() == 1);
+        MPI_CPPUNIT_ASSERT(queue.drainTo(elements, 10) == 1);
+        MPI_CPPUNIT_ASSERT(elements.size() == 6);
+        for (int32_t i = 0; i < 6; ++i) {
+            MPI_CPPUNIT_ASSERT(elements[i] == i);
+        }
+        MPI_CPPUNIT_ASSERT(queue.empty());
+        MPI_CPPUNIT_ASSERT(queue.drainTo(elements, 10) == 0);
+    }
+};
+
+/* Registers the fixture into the 'registry' */
+CPPUNIT_TEST_SUITE_REGISTRATION(ClusterlibEventQueue);
@@ -32,6 +32,9 @@ class ClusterlibHealthCheck : public MPITestFixture
     CPPUNIT_TEST(testHealthCheck1);
     CPPUNIT_TEST(testHealthCheck2);
     CPPUNIT_TEST(testHealthCheck3);
+    CPPUNIT_TEST(testHealthCheck4);
+    CPPUNIT_TEST(testHealthCheck5);
+    CPPUNIT_TEST(testHealthCheck6);
     CPPUNIT_TEST_SUITE_END();
 
   public:
@@ -80,6 +83,88 @@ class ClusterlibHealthCheck : public MPITestFixture
         string m_health;
     };
 
+    /**
+     * Counts its runs and does something else on a given run.
+     */
+    class CountingPeriodic : public Periodic {
+      public:
+        enum Action {
+            NOTHING,
+            THROW_STD_EXCEPTION,
+            THROW_INT,
+            CANCEL_ITSELF,
+            BLOCK
+        };
+
+        CountingPeriodic(Factory *factory, Action action, int32_t actionRun)
+            : Periodic(10),
+              m_factory(factory),
+              m_action(action),
+              m_actionRun(actionRun),
+              m_runs(0),
+              m_cancelled(false),
+              m_released(false) {}
+
+        virtual void run()
+        {
+            int32_t runs;
+            {
+                Locker l(&m_lock);
+                runs = ++m_runs;
+            }
+            if (runs != m_actionRun) {
+                return;
+            }
+
+            if (m_action == THROW_STD_EXCEPTION) {
+                throw std::runtime_error("CountingPeriodic");
+            }
+            else if (m_action == THROW_INT) {
+                throw runs;
+            }
+            else if (m_action == CANCEL_ITSELF) {
+                bool cancelled = m_factory->cancelPeriodicThread(*this);
+                Locker l(&m_lock);
+                m_cancelled = cancelled;
+            }
+            else if (m_action == BLOCK) {
+                Locker l(&m_lock);
+                while (!m_released) {
+                    m_releasedCond.wait(m_lock);
+                }
+            }
+        }
+
+        void release()
+        {
+            Locker l(&m_lock);
+            m_released = true;
+            m_releasedCond.signal_all();
+        }
+
+        int32_t getRuns()
+        {
+            Locker l(&m_lock);
+            return m_runs;
+        }
+
+        bool getCancelled()
+        {
+            Locker l(&m_lock);
+            return m_cancelled;
+        }
+
+      private:
+        Mutex m_lock;
+        Cond m_releasedCond;
+        Factory *m_factory;
+        Action m_action;
+        int32_t m_actionRun;
+        int32_t m_runs;
+        bool m_cancelled;
+        bool m_released;
+    };
+
     ClusterlibHealthCheck() 
         : MPITestFixture(globalTestParams),
           _factory(NULL),
@@ -276,6 +361,97 @@ class ClusterlibHealthCheck : public MPITestFixture
         }
    }
 
+    /** 
+     * A Periodic whose run() throws anything is run again later, and
+     * the others keep running.
+     */
+    void testHealthCheck4()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true,
+                                    _factory, 
+                                    true, 
+                                    "testHealthCheck4");
+
+        CountingPeriodic counting(_factory, CountingPeriodic::NOTHING, 0);
+        CountingPeriodic throwingStd(
+            _factory, CountingPeriodic::THROW_STD_EXCEPTION, 1);
+        CountingPeriodic throwingInt(
+            _factory, CountingPeriodic::THROW_INT, 1);
+        _factory->registerPeriodicThread(counting);
+        _factory->registerPeriodicThread(throwingStd);
+        _factory->registerPeriodicThread(throwingInt);
+        usleep(500000);
+
+        MPI_CPPUNIT_ASSERT(counting.getRuns() > 1);
+        MPI_CPPUNIT_ASSERT(throwingStd.getRuns() > 1);
+        MPI_CPPUNIT_ASSERT(throwingInt.getRuns() > 1);
+        MPI_CPPUNIT_ASSERT(_factory->cancelPeriodicThread(counting) == true);
+        MPI_CPPUNIT_ASSERT(
+            _factory->cancelPeriodicThread(throwingStd) == true);
+        MPI_CPPUNIT_ASSERT(
+            _factory->cancelPeriodicThread(throwingInt) == true);
+    }
+
+    /** 
+     * A Periodic can cancel itself from its run() without waiting on
+     * itself, and is not run again.
+     */
+    void testHealthCheck5()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true,
+                                    _factory, 
+                                    true, 
+                                    "testHealthCheck5");
+
+        CountingPeriodic cancelling(
+            _factory, CountingPeriodic::CANCEL_ITSELF, 2);
+        _factory->registerPeriodicThread(cancelling);
+        usleep(500000);
+
+        MPI_CPPUNIT_ASSERT(cancelling.getRuns() == 2);
+        MPI_CPPUNIT_ASSERT(cancelling.getCancelled() == true);
+        MPI_CPPUNIT_ASSERT(
+            _factory->cancelPeriodicThread(cancelling) == false);
+    }
+
+    /** 
+     * Periodic objects registered as blocking get workers of their
+     * own, so while they block the shared worker keeps running the
+     * others.
+     */
+    void testHealthCheck6()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true,
+                                    _factory, 
+                                    true, 
+                                    "testHealthCheck6");
+
+        Factory factory(globalTestParams.getZkServerPortList(), 
+                        30000, 
+                        1, 
+                        1, 
+                        1);
+        CountingPeriodic blocking0(&factory, CountingPeriodic::BLOCK, 1);
+        CountingPeriodic blocking1(&factory, CountingPeriodic::BLOCK, 1);
+        CountingPeriodic counting(&factory, CountingPeriodic::NOTHING, 0);
+        factory.registerPeriodicThread(blocking0, true);
+        factory.registerPeriodicThread(blocking1, true);
+        factory.registerPeriodicThread(counting);
+        usleep(500000);
+
+        MPI_CPPUNIT_ASSERT(blocking0.getRuns() == 1);
+        MPI_CPPUNIT_ASSERT(blocking1.getRuns() == 1);
+        MPI_CPPUNIT_ASSERT(counting.getRuns() > 1);
+        blocking0.release();
+        blocking1.release();
+        MPI_CPPUNIT_ASSERT(factory.cancelPeriodicThread(blocking0) == true);
+        MPI_CPPUNIT_ASSERT(factory.cancelPeriodicThread(blocking1) == true);
+        MPI_CPPUNIT_ASSERT(factory.cancelPeriodicThread(counting) == true);
+    }
+
   private:
     Factory *_factory;
     Client *_client0;
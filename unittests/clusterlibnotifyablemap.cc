@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ *
+ * $Id$
+ */
+
+#include "clusterlibinternal.h"
+#include "testparams.h"
+#include "MPITestFixture.h"
+
+extern TestParams globalTestParams;
+
+using namespace clusterlib;
+using namespace std;
+using namespace boost;
+
+const string appName = "unittests-notifyablemap-app";
+
+/*
+ * Looks up every key of a SafeNotifyableMap on its own thread,
+ * holding only the lock of each key.
+ */
+class MapReader
+{
+  public:
+    MapReader(SafeNotifyableMap &ntpMap,
+              const vector<string> &keyVec,
+              int32_t count)
+        : m_ntpMap(ntpMap),
+          m_keyVec(keyVec),
+          m_count(count),
+          m_found(0) {}
+
+    void run(void *param)
+    {
+        for (int32_t i = 0; i < m_count; ++i) {
+            for (size_t j = 0; j < m_keyVec.size(); ++j) {
+                Locker l(&m_ntpMap.getLock(m_keyVec[j]));
+                if (m_ntpMap.getNotifyable(m_keyVec[j]) != NULL) {
+                    ++m_found;
+                }
+            }
+        }
+    }
+
+    int64_t getFound() const { return m_found; }
+
+  private:
+    SafeNotifyableMap &m_ntpMap;
+    const vector<string> &m_keyVec;
+    int32_t m_count;
+    int64_t m_found;
+};
+
+class ClusterlibNotifyableMap : public MPITestFixture
+{
+    CPPUNIT_TEST_SUITE(ClusterlibNotifyableMap);
+    CPPUNIT_TEST(testNotifyableMap1);
+    CPPUNIT_TEST(testNotifyableMap2);
+    CPPUNIT_TEST(testNotifyableMap3);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+
+    ClusterlibNotifyableMap()
+        : MPITestFixture(globalTestParams),
+          _factory(NULL),
+          _client0(NULL)
+    {
+    }
+
+    /* Runs prior to each test */
+    virtual void setUp()
+    {
+	_factory =
+            new Factory(globalTestParams.getZkServerPortList());
+	MPI_CPPUNIT_ASSERT(_factory != NULL);
+	_client0 = _factory->createClient();
+	MPI_CPPUNIT_ASSERT(_client0 != NULL);
+        _app0 = _client0->getRoot()->getApplication(
+            appName, CREATE_IF_NOT_FOUND);
+        MPI_CPPUNIT_ASSERT(_app0 != NULL);
+        for (int32_t i = 0; i < 64; ++i) {
+            ostringstream oss;
+            oss << "grp" << i;
+            shared_ptr<NotifyableImpl> notifyableSP =
+                dynamic_pointer_cast<NotifyableImpl>(
+                    _app0->getGroup(oss.str(), CREATE_IF_NOT_FOUND));
+            MPI_CPPUNIT_ASSERT(notifyableSP != NULL);
+            _ntpVec.push_back(notifyableSP);
+        }
+    }
+
+    /* Runs after each test */
+    virtual void tearDown()
+    {
+        cleanAndBarrierMPITest(_factory, true);
+        _ntpVec.clear();
+        _app0.reset();
+	delete _factory;
+        _factory = NULL;
+        _client0 = NULL;
+    }
+
+    /*
+     * Every inserted notifyable is found by its key, unknown keys
+     * are not, and inserting a key twice or erasing a missing key
+     * throws.
+     */
+    void testNotifyableMap1()
+    {
+        initializeAndBarrierMPITest(-1,
+                                    true,
+                                    _factory,
+                                    true,
+                                    "testNotifyableMap1");
+
+        SafeNotifyableMap ntpMap;
+        for (size_t i = 0; i < _ntpVec.size(); ++i) {
+            Locker l(&ntpMap.getLock(_ntpVec[i]->getKey()));
+            MPI_CPPUNIT_ASSERT(
+                ntpMap.getNotifyable(_ntpVec[i]->getKey()) == NULL);
+            ntpMap.uniqueInsert(_ntpVec[i]);
+        }
+        for (size_t i = 0; i < _ntpVec.size(); ++i) {
+            Locker l(&ntpMap.getLock(_ntpVec[i]->getKey()));
+            MPI_CPPUNIT_ASSERT(
+                ntpMap.getNotifyable(_ntpVec[i]->getKey()) == _ntpVec[i]);
+        }
+        string unknownKey = _app0->getKey() + "/unknown";
+        {
+            Locker l(&ntpMap.getLock(unknownKey));
+            MPI_CPPUNIT_ASSERT(ntpMap.getNotifyable(unknownKey) == NULL);
+        }
+
+        bool threw = false;
+        try {
+            Locker l(&ntpMap.getLock(_ntpVec[0]->getKey()));
+            ntpMap.uniqueInsert(_ntpVec[0]);
+        } catch (InconsistentInternalStateException &e) {
+            threw = true;
+        }
+        MPI_CPPUNIT_ASSERT(threw);
+
+        {
+            Locker l(&ntpMap.getLock(_ntpVec[0]->getKey()));
+            ntpMap.erase(_ntpVec[0]);
+        }
+        threw = false;
+        try {
+            Locker l(&ntpMap.getLock(_ntpVec[0]->getKey()));
+            ntpMap.erase(_ntpVec[0]);
+        } catch (InconsistentInternalStateException &e) {
+            threw = true;
+        }
+        MPI_CPPUNIT_ASSERT(threw);
+
+        for (size_t i = 1; i < _ntpVec.size(); ++i) {
+            Locker l(&ntpMap.getLock(_ntpVec[i]->getKey()));
+            ntpMap.erase(_ntpVec[i]);
+        }
+    }
+
+    /*
+     * Erasing half of the notifyables leaves the other half, whatever
+     * shards they are in, and the keys are spread over more than one
+     * lock, with the same lock always used for the same key.
+     */
+    void testNotifyableMap2()
+    {
+        initializeAndBarrierMPITest(-1,
+                                    true,
+                                    _factory,
+                                    true,
+                                    "testNotifyableMap2");
+
+        SafeNotifyableMap ntpMap;
+        set<const Mutex *> lockSet;
+        for (size_t i = 0; i < _ntpVec.size(); ++i) {
+            const Mutex &lock = ntpMap.getLock(_ntpVec[i]->getKey());
+            MPI_CPPUNIT_ASSERT(&lock == &ntpMap.getLock(_ntpVec[i]->getKey()));
+            lockSet.insert(&lock);
+            Locker l(&lock);
+            ntpMap.uniqueInsert(_ntpVec[i]);
+        }
+        MPI_CPPUNIT_ASSERT(lockSet.size() > 1);
+        MPI_CPPUNIT_ASSERT(
+            lockSet.size() <=
+            static_cast<size_t>(
+                CLNumericInternal::SAFE_NOTIFYABLE_MAP_SHARDS));
+
+        for (size_t i = 0; i < _ntpVec.size(); i += 2) {
+            Locker l(&ntpMap.getLock(_ntpVec[i]->getKey()));
+            ntpMap.erase(_ntpVec[i]);
+        }
+        for (size_t i = 0; i < _ntpVec.size(); ++i) {
+            Locker l(&ntpMap.getLock(_ntpVec[i]->getKey()));
+            if ((i % 2) == 0) {
+                MPI_CPPUNIT_ASSERT(
+                    ntpMap.getNotifyable(_ntpVec[i]->getKey()) == NULL);
+            }
+            else {
+                MPI_CPPUNIT_ASSERT(
+                    ntpMap.getNotifyable(_ntpVec[i]->getKey()) ==
+                    _ntpVec[i]);
+                ntpMap.erase(_ntpVec[i]);
+            }
+        }
+    }
+
+    /*
+     * Several readers look up the keys concurrently, each holding
+     * only the lock of the key it looks up, and find all of them.
+     */
+    void testNotifyableMap3()
+    {
+        initializeAndBarrierMPITest(-1,
+                                    true,
+                                    _factory,
+                                    true,
+                                    "testNotifyableMap3");
+
+        SafeNotifyableMap ntpMap;
+        vector<string> keyVec;
+        for (size_t i = 0; i < _ntpVec.size(); ++i) {
+            Locker l(&ntpMap.getLock(_ntpVec[i]->getKey()));
+            ntpMap.uniqueInsert(_ntpVec[i]);
+            keyVec.push_back(_ntpVec[i]->getKey());
+        }
+
+        const int32_t readers = 4;
+        const int32_t count = 1000;
+        vector<MapReader *> readerVec;
+        vector<CXXThread<MapReader> *> threadVec;
+        for (int32_t i = 0; i < readers; ++i) {
+            readerVec.push_back(new MapReader(ntpMap, keyVec, count));
+            threadVec.push_back(new CXXThread<MapReader>());
+            threadVec.back()->Create(*readerVec.back(), &MapReader::run);
+        }
+        for (int32_t i = 0; i < readers; ++i) {
+            threadVec[i]->Join();
+            MPI_CPPUNIT_ASSERT(readerVec[i]->getFound() ==
+                               static_cast<int64_t>(count * keyVec.size()));
+            delete threadVec[i];
+            delete readerVec[i];
+        }
+
+        for (size_t i = 0; i < _ntpVec.size(); ++i) {
+            Locker l(&ntpMap.getLock(_ntpVec[i]->getKey()));
+            ntpMap.erase(_ntpVec[i]);
+        }
+    }
+
+  private:
+    Factory *_factory;
+    Client *_client0;
+    shared_ptr<Application> _app0;
+    vector<shared_ptr<NotifyableImpl> > _ntpVec;
+};
+
+/* Registers the fixture into the 'registry' */
+CPPUNIT_TEST_SUITE_REGISTRATION(ClusterlibNotifyableMap);
@@ -0,0 +1,1153 @@
+/*
+ * Copyright (c) 2010 Yahoo! Inc. All rights reserved. Licensed under
+ * the Apache License, Version 2.0 (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License. See accompanying
+ * LICENSE file.
+ * 
+ * $Id$
+ */
+
+#include "clusterlibinternal.h"
+#include "testparams.h"
+#include "MPITestFixture.h"
+
+extern TestParams globalTestParams;
+
+using namespace std;
+using namespace boost;
+using namespace clusterlib;
+
+const string appName = "unittests-repository-app";
+
+/**
+ * Remembers the last progress reported by a recursive delete.
+ */
+class TestDeleteProgress
+    : public zk::DeleteProgressCallback
+{
+  public:
+    TestDeleteProgress()
+        : m_calls(0),
+          m_deletedCount(0),
+          m_totalCount(0) {}
+
+    virtual void nodesDeleted(const string &path,
+                              size_t deletedCount,
+                              size_t totalCount)
+    {
+        ++m_calls;
+        m_deletedCount = deletedCount;
+        m_totalCount = totalCount;
+    }
+
+    int32_t m_calls;
+    size_t m_deletedCount;
+    size_t m_totalCount;
+};
+
+/**
+ * Counts the asynchronous operations that completed.
+ */
+class TestAsyncCallback
+    : public AsyncResultCallback
+{
+  public:
+    explicit TestAsyncCallback(bool throwOnCompletion = false)
+        : m_throwOnCompletion(throwOnCompletion),
+          m_count(0) {}
+
+    virtual void asyncCompleted(AsyncResultBase &result)
+    {
+        {
+            Locker l(&m_mutex);
+            ++m_count;
+        }
+        if (m_throwOnCompletion) {
+            throw InvalidMethodException("asyncCompleted: Test exception");
+        }
+    }
+
+    int32_t getCount()
+    {
+        Locker l(&m_mutex);
+        return m_count;
+    }
+
+  private:
+    bool m_throwOnCompletion;
+    Mutex m_mutex;
+    int32_t m_count;
+};
+
+/**
+ * Records the ZK events it gets and the threads that deliver them.
+ */
+class TestZKEventRecorder
+    : public zk::ZKEventListener
+{
+  public:
+    virtual void eventReceived(const EventSource<zk::ZKWatcherEvent> &source,
+                               const zk::ZKWatcherEvent &e)
+    {
+        Locker l(&m_mutex);
+        m_eventVec.push_back(e);
+        m_tidSet.insert(ProcessThreadService::getTid());
+        m_cond.signal();
+    }
+
+    /**
+     * Wait until at least count events were received.
+     *
+     * @param count the number of events
+     * @param msecTimeout the msecs to wait for each event
+     * @return the events received so far
+     */
+    vector<zk::ZKWatcherEvent> waitForEvents(size_t count, 
+                                             int64_t msecTimeout)
+    {
+        Locker l(&m_mutex);
+        while ((m_eventVec.size() < count) &&
+               m_cond.waitMsecs(m_mutex, msecTimeout)) {
+        }
+        return m_eventVec;
+    }
+
+    /**
+     * Wait until at least count events of a type and state were
+     * received.
+     *
+     * @param type the type of the events
+     * @param state the state of the events
+     * @param count the number of events
+     * @param msecTimeout the msecs to wait for each event
+     * @return true if they were received
+     */
+    bool waitForEvents(int32_t type, 
+                       int32_t state, 
+                       size_t count, 
+                       int64_t msecTimeout)
+    {
+        Locker l(&m_mutex);
+        while (true) {
+            size_t found = 0;
+            for (size_t i = 0; i < m_eventVec.size(); ++i) {
+                if ((m_eventVec[i].getType() == type) &&
+                    (m_eventVec[i].getState() == state)) {
+                    ++found;
+                }
+            }
+            if (found >= count) {
+                return true;
+            }
+            if (!m_cond.waitMsecs(m_mutex, msecTimeout)) {
+                return false;
+            }
+        }
+    }
+
+    size_t getThreadCount()
+    {
+        Locker l(&m_mutex);
+        return m_tidSet.size();
+    }
+
+  private:
+    Mutex m_mutex;
+    Cond m_cond;
+    vector<zk::ZKWatcherEvent> m_eventVec;
+    set<int32_t> m_tidSet;
+};
+
+/**
+ * Tests of the repository operations that clusterlib builds its
+ * objects on.
+ */
+class ClusterlibRepository
+    : public MPITestFixture
+{
+    CPPUNIT_TEST_SUITE(ClusterlibRepository);
+    CPPUNIT_TEST(testRepository1);
+    CPPUNIT_TEST(testRepository2);
+    CPPUNIT_TEST(testRepository3);
+    CPPUNIT_TEST(testRepository4);
+    CPPUNIT_TEST(testRepository5);
+    CPPUNIT_TEST(testRepository6);
+    CPPUNIT_TEST(testRepository7);
+    CPPUNIT_TEST(testRepository8);
+    CPPUNIT_TEST(testRepository9);
+    CPPUNIT_TEST(testRepository10);
+    CPPUNIT_TEST(testRepository11);
+    CPPUNIT_TEST(testRepository12);
+    CPPUNIT_TEST(testRepository13);
+    CPPUNIT_TEST(testRepository14);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    
+    ClusterlibRepository()
+        : MPITestFixture(globalTestParams),
+          _factory(NULL),
+          _client0(NULL),
+          _zk(NULL) {}
+
+    /* Runs prior to each test */
+    virtual void setUp() 
+    {
+	_factory =
+            new Factory(globalTestParams.getZkServerPortList());
+	MPI_CPPUNIT_ASSERT(_factory != NULL);
+        _zk = _factory->getRepository();
+        MPI_CPPUNIT_ASSERT(_zk != NULL);
+	_client0 = _factory->createClient();
+	MPI_CPPUNIT_ASSERT(_client0 != NULL);
+        _app0 = _client0->getRoot()->getApplication(appName, 
+                                                    CREATE_IF_NOT_FOUND);
+        MPI_CPPUNIT_ASSERT(_app0 != NULL);
+        _nod0 = _app0->getNode("nod0", CREATE_IF_NOT_FOUND);
+        MPI_CPPUNIT_ASSERT(_nod0 != NULL);
+    }
+
+    /* Runs after each test */
+    virtual void tearDown() 
+    {
+        cleanAndBarrierMPITest(_factory, true);
+        /*
+         * Delete only the factory, that automatically deletes
+         * all the other objects.
+         */
+	delete _factory;
+        _factory = NULL;
+        _client0 = NULL;
+        _zk = NULL;
+    }
+
+    void testRepository1()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testRepository1");
+
+        /*
+         * Test that pipelined asynchronous repository operations
+         * return the same results as the synchronous ones.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        string asyncPath = _nod0->getKey() + "/" + "_asyncTest";
+        _zk->deleteNode(asyncPath, true, -1);
+
+        vector<zk::AsyncOperationSP> operationVec;
+        for (int32_t i = 0; i < 5; ++i) {
+            ostringstream oss;
+            oss << asyncPath << i;
+            operationVec.push_back(_zk->createNodeAsync(oss.str(), "v"));
+        }
+        for (int32_t i = 0; i < 5; ++i) {
+            MPI_CPPUNIT_ASSERT(_zk->waitAsync(operationVec[i]) == ZOK);
+        }
+
+        operationVec.clear();
+        for (int32_t i = 0; i < 5; ++i) {
+            ostringstream oss;
+            oss << asyncPath << i;
+            operationVec.push_back(_zk->getNodeDataAsync(oss.str()));
+        }
+        operationVec.push_back(_zk->nodeExistsAsync(asyncPath));
+        for (int32_t i = 0; i < 5; ++i) {
+            MPI_CPPUNIT_ASSERT(_zk->waitAsync(operationVec[i]) == ZOK);
+            MPI_CPPUNIT_ASSERT(operationVec[i]->getData() == "v");
+        }
+        MPI_CPPUNIT_ASSERT(_zk->waitAsync(operationVec[5], ZNONODE) == 
+                           ZNONODE);
+
+        operationVec.clear();
+        for (int32_t i = 0; i < 5; ++i) {
+            ostringstream oss;
+            oss << asyncPath << i;
+            operationVec.push_back(_zk->deleteNodeAsync(oss.str()));
+        }
+        for (int32_t i = 0; i < 5; ++i) {
+            MPI_CPPUNIT_ASSERT(_zk->waitAsync(operationVec[i]) == ZOK);
+        }
+    }
+    void testRepository2()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testRepository2");
+
+        /*
+         * Test that multi-op transactions are all or nothing and
+         * that a recursive delete removes the whole subtree.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        string multiPath = _nod0->getKey() + "/" + "_multiTest";
+        _zk->deleteNode(multiPath, true, -1);
+
+        vector<zk::MultiOperation> operationVec;
+        operationVec.push_back(zk::MultiOperation::createNode(multiPath));
+        operationVec.push_back(
+            zk::MultiOperation::createNode(multiPath + "/a", "a"));
+        operationVec.push_back(
+            zk::MultiOperation::createNode(multiPath + "/a/b", "b"));
+        MPI_CPPUNIT_ASSERT(_zk->multi(operationVec) == true);
+        MPI_CPPUNIT_ASSERT(_zk->nodeExists(multiPath + "/a/b") == true);
+
+#ifdef HAVE_ZOO_MULTI
+        /* Fails on the existing node, so nothing is created */
+        operationVec.clear();
+        operationVec.push_back(
+            zk::MultiOperation::createNode(multiPath + "/c"));
+        operationVec.push_back(
+            zk::MultiOperation::createNode(multiPath + "/a"));
+        vector<int32_t> resultVec;
+        MPI_CPPUNIT_ASSERT(_zk->multi(operationVec, &resultVec) == false);
+        MPI_CPPUNIT_ASSERT(resultVec.size() == 2);
+        MPI_CPPUNIT_ASSERT(resultVec[1] == ZNODEEXISTS);
+        MPI_CPPUNIT_ASSERT(_zk->nodeExists(multiPath + "/c") == false);
+#endif
+
+        MPI_CPPUNIT_ASSERT(_zk->deleteNode(multiPath, true, -1) == true);
+        MPI_CPPUNIT_ASSERT(_zk->nodeExists(multiPath) == false);
+    }
+    void testRepository3()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testRepository3");
+
+        /*
+         * Test that a recursive delete of a wide tree removes every
+         * node and reports its progress.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        string treePath = _nod0->getKey() + "/" + "_deleteTreeTest";
+        _zk->deleteNode(treePath, true, -1);
+
+        _zk->createNode(treePath, "", 0);
+        vector<zk::AsyncOperationSP> operationVec;
+        for (int32_t i = 0; i < 30; ++i) {
+            ostringstream oss;
+            oss << treePath << "/" << i;
+            operationVec.push_back(_zk->createNodeAsync(oss.str()));
+            for (int32_t j = 0; j < 50; ++j) {
+                ostringstream childOss;
+                childOss << oss.str() << "/" << j;
+                operationVec.push_back(
+                    _zk->createNodeAsync(childOss.str()));
+            }
+        }
+        for (size_t i = 0; i < operationVec.size(); ++i) {
+            MPI_CPPUNIT_ASSERT(_zk->waitAsync(operationVec[i]) == ZOK);
+        }
+
+        TestDeleteProgress progress;
+        MPI_CPPUNIT_ASSERT(
+            _zk->deleteNode(treePath, true, -1, &progress) == true);
+        MPI_CPPUNIT_ASSERT(_zk->nodeExists(treePath) == false);
+        MPI_CPPUNIT_ASSERT(progress.m_calls > 1);
+        MPI_CPPUNIT_ASSERT(progress.m_totalCount == 1 + 30 + 30 * 50);
+        MPI_CPPUNIT_ASSERT(progress.m_deletedCount == 
+                           progress.m_totalCount);
+    }
+    void testRepository4()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testRepository4");
+
+        /*
+         * Test that ancestors are created again after they were
+         * deleted, both by this session and by another one.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        string knownPath = _nod0->getKey() + "/" + "_knownPathTest";
+        _zk->deleteNode(knownPath, true, -1);
+
+        MPI_CPPUNIT_ASSERT(_zk->createNode(knownPath + "/a/b", "", 0, true));
+        MPI_CPPUNIT_ASSERT(_zk->deleteNode(knownPath + "/a", true, -1));
+        MPI_CPPUNIT_ASSERT(_zk->createNode(knownPath + "/a/b", "", 0, true));
+        MPI_CPPUNIT_ASSERT(_zk->nodeExists(knownPath + "/a/b") == true);
+
+        Factory *otherFactory = 
+            new Factory(globalTestParams.getZkServerPortList());
+        MPI_CPPUNIT_ASSERT(
+            otherFactory->getRepository()->deleteNode(knownPath, true, -1));
+        delete otherFactory;
+        MPI_CPPUNIT_ASSERT(
+            _zk->createNode(knownPath + "/a/b/c", "", 0, true));
+        MPI_CPPUNIT_ASSERT(_zk->nodeExists(knownPath + "/a/b/c") == true);
+
+        MPI_CPPUNIT_ASSERT(_zk->deleteNode(knownPath, true, -1) == true);
+    }
+    void testRepository5()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testRepository5");
+
+        /*
+         * Test that factories with the same in-memory registry share
+         * their objects and that the watches of one see the changes
+         * of the other.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        Factory *memFactory0 = new Factory("inmemory:testRepository5:100");
+        Factory *memFactory1 = new Factory("inmemory:testRepository5");
+        shared_ptr<Root> root0 = memFactory0->createClient()->getRoot();
+        shared_ptr<Root> root1 = memFactory1->createClient()->getRoot();
+
+        shared_ptr<Application> memApp0 = root0->getApplication(
+            "memApp", CREATE_IF_NOT_FOUND);
+        MPI_CPPUNIT_ASSERT(memApp0);
+        shared_ptr<Application> memApp1 = root1->getApplication(
+            "memApp", LOAD_FROM_REPOSITORY);
+        MPI_CPPUNIT_ASSERT(memApp1);
+
+        shared_ptr<PropertyList> propList0 = memApp0->getPropertyList(
+            CLString::DEFAULT_PROPERTYLIST, CREATE_IF_NOT_FOUND);
+        propList0->cachedKeyValues().set(
+            "memKey", json::JSONValue::JSONString("v0"));
+        propList0->cachedKeyValues().publish();
+
+        shared_ptr<PropertyList> propList1 = memApp1->getPropertyList(
+            CLString::DEFAULT_PROPERTYLIST, LOAD_FROM_REPOSITORY);
+        MPI_CPPUNIT_ASSERT(propList1);
+        json::JSONValue jsonValue;
+        for (int32_t i = 0; i < 100; ++i) {
+            if (propList1->cachedKeyValues().get("memKey", jsonValue)) {
+                break;
+            }
+            usleep(10000);
+        }
+        MPI_CPPUNIT_ASSERT(
+            jsonValue.get<json::JSONValue::JSONString>() == "v0");
+
+        /* The results of multi() only hold the last transaction. */
+        string multiPath = memApp0->getKey() + "/" + "_multiTest";
+        vector<zk::MultiOperation> operationVec;
+        operationVec.push_back(zk::MultiOperation::createNode(multiPath));
+        operationVec.push_back(zk::MultiOperation::deleteNode(multiPath));
+        vector<int32_t> resultVec;
+        MPI_CPPUNIT_ASSERT(
+            memFactory0->getRepository()->multi(operationVec, &resultVec));
+        MPI_CPPUNIT_ASSERT(
+            memFactory0->getRepository()->multi(operationVec, &resultVec));
+        MPI_CPPUNIT_ASSERT(resultVec.size() == operationVec.size());
+
+        memApp0->remove(true);
+        MPI_CPPUNIT_ASSERT(memFactory1->getRepository()->nodeExists(
+            memApp1->getKey()) == false);
+
+        delete memFactory1;
+        delete memFactory0;
+    }
+    void testRepository6()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testRepository6");
+
+        /*
+         * Test that the repository operations are counted and timed.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        Factory *memFactory = new Factory("inmemory:testRepository6:100");
+        zk::Repository *memZk = memFactory->getRepository();
+        memFactory->resetRepositoryStats();
+
+        string statsPath = "/_statsTest";
+        MPI_CPPUNIT_ASSERT(memZk->createNode(statsPath, "abc", 0, false));
+        memZk->setNodeData(statsPath, "defg");
+        string data;
+        MPI_CPPUNIT_ASSERT(memZk->getNodeData(statsPath, data));
+        MPI_CPPUNIT_ASSERT(memZk->nodeExists(statsPath + "/none") == false);
+        memZk->waitAsync(memZk->getNodeDataAsync(statsPath));
+        MPI_CPPUNIT_ASSERT(memZk->deleteNode(statsPath));
+
+        RepositoryStats stats = memFactory->getRepositoryStats();
+        MPI_CPPUNIT_ASSERT(stats.getCount(RepositoryStats::CREATE) == 1);
+        MPI_CPPUNIT_ASSERT(stats.getCount(RepositoryStats::SET_DATA) == 1);
+        MPI_CPPUNIT_ASSERT(stats.getCount(RepositoryStats::GET_DATA) == 2);
+        MPI_CPPUNIT_ASSERT(stats.getCount(RepositoryStats::EXISTS) == 1);
+        MPI_CPPUNIT_ASSERT(stats.getErrorCount(RepositoryStats::EXISTS) == 0);
+        MPI_CPPUNIT_ASSERT(stats.getCount(RepositoryStats::DELETE) == 1);
+        MPI_CPPUNIT_ASSERT(stats.getBytesWritten() == 7);
+        MPI_CPPUNIT_ASSERT(stats.getBytesRead() == 8);
+        MPI_CPPUNIT_ASSERT(stats.getMaxUsecs(RepositoryStats::GET_DATA) >= 
+                           100);
+        MPI_CPPUNIT_ASSERT(
+            stats.getPercentileUsecs(RepositoryStats::GET_DATA, 50.0) >= 100);
+        MPI_CPPUNIT_ASSERT(
+            stats.getPercentileUsecs(RepositoryStats::GET_DATA, 100.0) <= 
+            stats.getMaxUsecs(RepositoryStats::GET_DATA));
+
+        memFactory->resetRepositoryStats();
+        stats = memFactory->getRepositoryStats();
+        MPI_CPPUNIT_ASSERT(stats.getCount(RepositoryStats::GET_DATA) == 0);
+
+        delete memFactory;
+    }
+    void testRepository7()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testRepository7");
+
+        /*
+         * Test that large node data is compressed when written and
+         * read back by a factory that does not compress, and that
+         * plain data is never mistaken for compressed data.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        Factory *writerFactory = new Factory("inmemory:testRepository7");
+        Factory *readerFactory = new Factory("inmemory:testRepository7");
+        zk::Repository *writerZk = writerFactory->getRepository();
+        zk::Repository *readerZk = readerFactory->getRepository();
+
+        string largeValue;
+        for (int32_t i = 0; i < 1000; ++i) {
+            ostringstream oss;
+            oss << "[\"" << i * 1000 << "\",\"/app/group/node" << i % 10 
+                << "\",0],";
+            largeValue.append(oss.str());
+        }
+        string plainPath = "/_compressTestPlain";
+        MPI_CPPUNIT_ASSERT(writerZk->createNode(plainPath, largeValue));
+
+        writerFactory->setDataCompressionThreshold(256);
+        writerFactory->resetRepositoryStats();
+        string compressedPath = "/_compressTestCompressed";
+        MPI_CPPUNIT_ASSERT(writerZk->createNode(compressedPath, largeValue));
+        RepositoryStats stats = writerFactory->getRepositoryStats();
+        MPI_CPPUNIT_ASSERT(stats.getBytesWritten() > 0);
+        if (zk::DataCodec::canCompress()) {
+            MPI_CPPUNIT_ASSERT(stats.getBytesWritten() <
+                               static_cast<int64_t>(largeValue.size() / 2));
+        }
+        
+        string data;
+        Stat stat;
+        MPI_CPPUNIT_ASSERT(readerZk->getNodeData(
+                               compressedPath, data, NULL, NULL, &stat));
+        MPI_CPPUNIT_ASSERT(data == largeValue);
+        if (zk::DataCodec::canCompress()) {
+            MPI_CPPUNIT_ASSERT(stat.dataLength < 
+                               static_cast<int32_t>(largeValue.size() / 2));
+        }
+
+        /* The async read is decoded by the reader and counted then */
+        readerFactory->resetRepositoryStats();
+        zk::AsyncOperationSP operationSP = 
+            readerZk->getNodeDataAsync(compressedPath);
+        readerZk->waitAsync(operationSP);
+        MPI_CPPUNIT_ASSERT(operationSP->getData() == largeValue);
+        stats = readerFactory->getRepositoryStats();
+        MPI_CPPUNIT_ASSERT(stats.getBytesDecoded() == 
+                           static_cast<int64_t>(largeValue.size()));
+        MPI_CPPUNIT_ASSERT(stats.getDecodeErrorCount() == 0);
+        MPI_CPPUNIT_ASSERT(readerZk->getNodeData(plainPath, data));
+        MPI_CPPUNIT_ASSERT(data == largeValue);
+
+        /* Small values are never compressed */
+        writerZk->setNodeData(compressedPath, "small");
+        MPI_CPPUNIT_ASSERT(readerZk->getNodeData(
+                               compressedPath, data, NULL, NULL, &stat));
+        MPI_CPPUNIT_ASSERT(data == "small");
+        MPI_CPPUNIT_ASSERT(stat.dataLength == 5);
+
+        /* 
+         * Values that start like a header or a chunk manifest read
+         * back unchanged.
+         */
+        vector<string> headerValueVec;
+        headerValueVec.push_back(string("\0CL\1\0\0\0\5xyz", 11));
+        headerValueVec.push_back(string("\0CL\0abc", 7));
+        headerValueVec.push_back(string("\0CK1_dataChunks 1 5", 20));
+        headerValueVec.push_back(string("\0", 1));
+        for (size_t i = 0; i < headerValueVec.size(); ++i) {
+            writerZk->setNodeData(compressedPath, headerValueVec[i]);
+            MPI_CPPUNIT_ASSERT(readerZk->getNodeData(compressedPath, data));
+            MPI_CPPUNIT_ASSERT(data == headerValueVec[i]);
+            operationSP = readerZk->getNodeDataAsync(compressedPath);
+            MPI_CPPUNIT_ASSERT(readerZk->waitAsync(operationSP) == ZOK);
+            MPI_CPPUNIT_ASSERT(operationSP->getData() == headerValueVec[i]);
+            writerZk->setChunkedNodeData(compressedPath, headerValueVec[i]);
+            MPI_CPPUNIT_ASSERT(readerZk->getChunkedNodeData(compressedPath, 
+                                                            data));
+            MPI_CPPUNIT_ASSERT(data == headerValueVec[i]);
+        }
+
+        /*
+         * A value larger than a chunk is compressed as a whole before
+         * it is split, so a compressible one is stored in the node
+         * itself.  An incompressible one is split and its pieces,
+         * even those that start with a NUL byte, read back unchanged.
+         */
+        const size_t chunkSize = CLNumericInternal::DATA_CHUNK_SIZE;
+        string hugeValue;
+        while (hugeValue.size() <= chunkSize) {
+            hugeValue.append(largeValue);
+        }
+        writerZk->setChunkedNodeData(compressedPath, hugeValue);
+        vector<string> children;
+        MPI_CPPUNIT_ASSERT(writerZk->getNodeChildren(compressedPath, 
+                                                     children));
+        if (zk::DataCodec::canCompress()) {
+            MPI_CPPUNIT_ASSERT(children.empty());
+        }
+        MPI_CPPUNIT_ASSERT(readerZk->getChunkedNodeData(compressedPath, 
+                                                        data));
+        MPI_CPPUNIT_ASSERT(data == hugeValue);
+
+        string randomValue(2 * chunkSize + 100, '\0');
+        uint32_t seed = 12345;
+        for (size_t i = 1; i < randomValue.size(); ++i) {
+            seed = seed * 1103515245 + 12345;
+            randomValue[i] = static_cast<char>(seed >> 16);
+        }
+        randomValue[chunkSize - 4] = '\0';
+        writerZk->setChunkedNodeData(compressedPath, randomValue);
+        children.clear();
+        MPI_CPPUNIT_ASSERT(writerZk->getNodeChildren(compressedPath, 
+                                                     children));
+        MPI_CPPUNIT_ASSERT(children.size() == 1);
+        MPI_CPPUNIT_ASSERT(readerZk->getChunkedNodeData(compressedPath, 
+                                                        data));
+        MPI_CPPUNIT_ASSERT(data == randomValue);
+
+        MPI_CPPUNIT_ASSERT(writerZk->deleteNode(plainPath));
+        MPI_CPPUNIT_ASSERT(writerZk->deleteNode(compressedPath, true));
+        delete readerFactory;
+        delete writerFactory;
+    }
+    void testRepository8()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testRepository8");
+
+        /*
+         * Test that a property list larger than a znode is stored in
+         * chunks, read back by another factory and that the chunks of
+         * a replaced value are removed.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        Factory *memFactory0 = new Factory("inmemory:testRepository8");
+        Factory *memFactory1 = new Factory("inmemory:testRepository8");
+        zk::Repository *memZk = memFactory0->getRepository();
+        shared_ptr<Root> root0 = memFactory0->createClient()->getRoot();
+        shared_ptr<Root> root1 = memFactory1->createClient()->getRoot();
+
+        shared_ptr<Application> memApp0 = root0->getApplication(
+            "memApp", CREATE_IF_NOT_FOUND);
+        shared_ptr<PropertyList> propList0 = memApp0->getPropertyList(
+            CLString::DEFAULT_PROPERTYLIST, CREATE_IF_NOT_FOUND);
+        string keyValuesKey = 
+            PropertyListImpl::createKeyValJsonObjectKey(propList0->getKey());
+
+        string largeValue(3 * CLNumericInternal::DATA_CHUNK_SIZE, 'x');
+        for (size_t i = 0; i < largeValue.size(); i += 1000) {
+            largeValue[i] = 'a' + (i % 26);
+        }
+        for (int32_t i = 0; i < 2; ++i) {
+            propList0->cachedKeyValues().set(
+                "largeKey", json::JSONValue::JSONString(largeValue));
+            propList0->cachedKeyValues().publish();
+        }
+
+        string data;
+        MPI_CPPUNIT_ASSERT(memZk->getNodeData(keyValuesKey, data));
+        MPI_CPPUNIT_ASSERT(data.size() < 100);
+        vector<string> children;
+        MPI_CPPUNIT_ASSERT(memZk->getNodeChildren(keyValuesKey, children));
+        MPI_CPPUNIT_ASSERT(children.size() == 1);
+
+        shared_ptr<Application> memApp1 = root1->getApplication(
+            "memApp", LOAD_FROM_REPOSITORY);
+        shared_ptr<PropertyList> propList1 = memApp1->getPropertyList(
+            CLString::DEFAULT_PROPERTYLIST, LOAD_FROM_REPOSITORY);
+        MPI_CPPUNIT_ASSERT(propList1);
+        json::JSONValue jsonValue;
+        MPI_CPPUNIT_ASSERT(
+            propList1->cachedKeyValues().get("largeKey", jsonValue));
+        MPI_CPPUNIT_ASSERT(
+            jsonValue.get<json::JSONValue::JSONString>() == largeValue);
+
+        propList0->cachedKeyValues().set(
+            "largeKey", json::JSONValue::JSONString("small"));
+        propList0->cachedKeyValues().publish();
+        children.clear();
+        MPI_CPPUNIT_ASSERT(memZk->getNodeChildren(keyValuesKey, children));
+        MPI_CPPUNIT_ASSERT(children.empty());
+        for (int32_t i = 0; i < 100; ++i) {
+            propList1->cachedKeyValues().get("largeKey", jsonValue);
+            if (jsonValue.get<json::JSONValue::JSONString>() == "small") {
+                break;
+            }
+            usleep(10000);
+        }
+        MPI_CPPUNIT_ASSERT(
+            jsonValue.get<json::JSONValue::JSONString>() == "small");
+
+        memApp0->remove(true);
+        delete memFactory1;
+        delete memFactory0;
+    }
+    void testRepository9()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testRepository9");
+
+        /*
+         * Test that a factory dispatching events on several threads
+         * sees the changes to many Notifyables once it synchronizes.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        Factory *writerFactory = new Factory("inmemory:testRepository9");
+        Factory *readerFactory = 
+            new Factory("inmemory:testRepository9", 30000, 1, 4);
+        shared_ptr<Root> writerRoot = writerFactory->createClient()->getRoot();
+        shared_ptr<Root> readerRoot = readerFactory->createClient()->getRoot();
+
+        const int32_t appCount = 8;
+        vector<shared_ptr<PropertyList> > writerPropLists;
+        vector<shared_ptr<PropertyList> > readerPropLists;
+        for (int32_t i = 0; i < appCount; ++i) {
+            ostringstream oss;
+            oss << "memApp" << i;
+            shared_ptr<Application> writerApp = writerRoot->getApplication(
+                oss.str(), CREATE_IF_NOT_FOUND);
+            writerPropLists.push_back(writerApp->getPropertyList(
+                CLString::DEFAULT_PROPERTYLIST, CREATE_IF_NOT_FOUND));
+            shared_ptr<Application> readerApp = readerRoot->getApplication(
+                oss.str(), LOAD_FROM_REPOSITORY);
+            MPI_CPPUNIT_ASSERT(readerApp);
+            readerPropLists.push_back(readerApp->getPropertyList(
+                CLString::DEFAULT_PROPERTYLIST, LOAD_FROM_REPOSITORY));
+            MPI_CPPUNIT_ASSERT(readerPropLists.back());
+        }
+
+        for (int32_t round = 0; round < 3; ++round) {
+            for (int32_t i = 0; i < appCount; ++i) {
+                writerPropLists[i]->cachedKeyValues().set(
+                    "round", json::JSONValue::JSONInteger(round));
+                writerPropLists[i]->cachedKeyValues().publish();
+            }
+        }
+        writerFactory->synchronize();
+
+        /* The events on the watched nodes arrive asynchronously. */
+        json::JSONValue jsonValue;
+        for (int32_t i = 0; i < appCount; ++i) {
+            jsonValue = json::JSONValue::JSONInteger(-1);
+            for (int32_t j = 0; j < 100; ++j) {
+                readerFactory->synchronize();
+                if (readerPropLists[i]->cachedKeyValues().get(
+                        "round", jsonValue) &&
+                    (jsonValue.get<json::JSONValue::JSONInteger>() == 2)) {
+                    break;
+                }
+                usleep(10000);
+            }
+            MPI_CPPUNIT_ASSERT(
+                jsonValue.get<json::JSONValue::JSONInteger>() == 2);
+        }
+
+        for (int32_t i = 0; i < appCount; ++i) {
+            writerPropLists[i]->getMyParent()->remove(true);
+        }
+        delete readerFactory;
+        delete writerFactory;
+    }
+    void testRepository10()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testRepository10");
+
+        /*
+         * Test that asynchronous operations complete with the same
+         * results as the blocking ones.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        Factory *memFactory = new Factory("inmemory:testRepository10");
+        shared_ptr<Root> memRoot = memFactory->createClient()->getRoot();
+
+        const int32_t appCount = 8;
+        TestAsyncCallback callback;
+        vector<shared_ptr<AsyncResult<shared_ptr<Application> > > > 
+            appResults;
+        for (int32_t i = 0; i < appCount; ++i) {
+            ostringstream oss;
+            oss << "memApp" << i;
+            appResults.push_back(memRoot->getApplicationAsync(
+                oss.str(), CREATE_IF_NOT_FOUND, &callback));
+        }
+
+        vector<shared_ptr<AsyncResult<int32_t> > > publishResults;
+        vector<shared_ptr<PropertyList> > propLists;
+        for (int32_t i = 0; i < appCount; ++i) {
+            MPI_CPPUNIT_ASSERT(appResults[i]->waitMsecs(10000));
+            MPI_CPPUNIT_ASSERT(!appResults[i]->hasFailed());
+            MPI_CPPUNIT_ASSERT(appResults[i]->get());
+            propLists.push_back(appResults[i]->get()->getPropertyList(
+                CLString::DEFAULT_PROPERTYLIST, CREATE_IF_NOT_FOUND));
+            propLists.back()->cachedKeyValues().set(
+                "index", json::JSONValue::JSONInteger(i));
+            publishResults.push_back(
+                propLists.back()->cachedKeyValues().publishAsync());
+        }
+        for (int32_t i = 0; i < appCount; ++i) {
+            MPI_CPPUNIT_ASSERT(publishResults[i]->get() == 
+                               propLists[i]->cachedKeyValues().getVersion());
+        }
+        /* Callbacks run after the waiters are woken up. */
+        for (int32_t i = 0; 
+             (i < 100) && (callback.getCount() < appCount); 
+             ++i) {
+            usleep(10000);
+        }
+        MPI_CPPUNIT_ASSERT(callback.getCount() == appCount);
+
+        shared_ptr<AsyncResult<NotifyableList> > childrenResult = 
+            memRoot->getMyChildrenAsync();
+        MPI_CPPUNIT_ASSERT(childrenResult->get().size() >= 
+                           static_cast<size_t>(appCount));
+
+        /* Failures are thrown again with the same type by get(). */
+        shared_ptr<AsyncResult<shared_ptr<Application> > > failedResult = 
+            memRoot->getApplicationAsync("bad/name", CREATE_IF_NOT_FOUND);
+        bool caught = false;
+        try {
+            failedResult->get();
+        }
+        catch (InvalidArgumentsException &e) {
+            caught = true;
+        }
+        MPI_CPPUNIT_ASSERT(caught);
+        MPI_CPPUNIT_ASSERT(failedResult->hasFailed());
+
+        for (int32_t i = 0; i < appCount; ++i) {
+            appResults[i]->get()->remove(true);
+        }
+        delete memFactory;
+    }
+
+    void testRepository11()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testRepository11");
+
+        /*
+         * Test that the cached children and key prefix queries only
+         * see the notifyables in the cache of the process.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        Factory *memFactory0 = new Factory("inmemory:testRepository11");
+        Factory *memFactory1 = new Factory("inmemory:testRepository11");
+        shared_ptr<Root> root0 = memFactory0->createClient()->getRoot();
+        shared_ptr<Root> root1 = memFactory1->createClient()->getRoot();
+
+        shared_ptr<Application> app0 = root0->getApplication(
+            "memApp", CREATE_IF_NOT_FOUND);
+        shared_ptr<Group> group0 = app0->getGroup(
+            "group0", CREATE_IF_NOT_FOUND);
+        shared_ptr<Group> group1 = app0->getGroup(
+            "group1", CREATE_IF_NOT_FOUND);
+        shared_ptr<Node> node0 = app0->getNode("node0", CREATE_IF_NOT_FOUND);
+        MPI_CPPUNIT_ASSERT(app0->getMyChildren(CACHED_ONLY).size() == 3);
+        MPI_CPPUNIT_ASSERT(app0->getMyChildren().size() == 3);
+
+        /* Everything under the application and both groups by prefix. */
+        MPI_CPPUNIT_ASSERT(root0->getCachedNotifyablesFromKeyPrefix(
+                               app0->getKey() + "/").size() == 3);
+        NotifyableList ntList = root0->getCachedNotifyablesFromKeyPrefix(
+            group0->getKey().substr(0, group0->getKey().size() - 1));
+        MPI_CPPUNIT_ASSERT(ntList.size() == 2);
+        MPI_CPPUNIT_ASSERT(ntList[0]->getKey() == group0->getKey());
+        MPI_CPPUNIT_ASSERT(ntList[1]->getKey() == group1->getKey());
+
+        /* The other factory has not loaded the children yet. */
+        shared_ptr<Application> app1 = root1->getApplication(
+            "memApp", LOAD_FROM_REPOSITORY);
+        MPI_CPPUNIT_ASSERT(app1);
+        MPI_CPPUNIT_ASSERT(app1->getMyChildren(CACHED_ONLY).empty());
+        MPI_CPPUNIT_ASSERT(app1->getMyChildren().size() == 3);
+        MPI_CPPUNIT_ASSERT(app1->getMyChildren(CACHED_ONLY).size() == 3);
+
+        group1->remove(true);
+        MPI_CPPUNIT_ASSERT(app0->getMyChildren(CACHED_ONLY).size() == 2);
+        MPI_CPPUNIT_ASSERT(root0->getCachedNotifyablesFromKeyPrefix(
+                               group1->getKey()).empty());
+
+        app0->remove(true);
+        MPI_CPPUNIT_ASSERT(root0->getCachedNotifyablesFromKeyPrefix(
+                               app0->getKey()).empty());
+        delete memFactory1;
+        delete memFactory0;
+    }
+    void testRepository12()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testRepository12");
+
+        /*
+         * Test that the session and watch events of a ZooKeeperAdapter
+         * reach its listeners on one thread, in the order they
+         * happened.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        TestZKEventRecorder recorder;
+        zk::ZooKeeperAdapter zk(
+            zk::ZooKeeperConfig(globalTestParams.getZkServerPortList(),
+                                30000), 
+            &recorder, 
+            true);
+        string orderPath = _nod0->getKey() + "/" + "_eventOrderTest";
+        zk.deleteNode(orderPath, true, -1);
+        MPI_CPPUNIT_ASSERT(zk.nodeExists(orderPath, &recorder) == false);
+        zk.createNode(orderPath);
+        zk.sync(orderPath, &recorder, NULL);
+
+        vector<zk::ZKWatcherEvent> eventVec = 
+            recorder.waitForEvents(3, 10000);
+        MPI_CPPUNIT_ASSERT(eventVec.size() >= 3);
+        MPI_CPPUNIT_ASSERT(eventVec[0].getType() == ZOO_SESSION_EVENT);
+        MPI_CPPUNIT_ASSERT(eventVec[0].getState() == ZOO_CONNECTED_STATE);
+        MPI_CPPUNIT_ASSERT(eventVec[1].getType() == ZOO_CREATED_EVENT);
+        MPI_CPPUNIT_ASSERT(eventVec[1].getPath() == orderPath);
+        MPI_CPPUNIT_ASSERT(eventVec[2].getType() == ZOO_SESSION_EVENT);
+        MPI_CPPUNIT_ASSERT(eventVec[2].getPath() == CLStringInternal::SYNC);
+        MPI_CPPUNIT_ASSERT(recorder.getThreadCount() == 1);
+
+        zk.deleteNode(orderPath);
+    }
+
+    void testRepository13()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testRepository13");
+
+        /*
+         * Test that after the session expires a ZooKeeperAdapter
+         * starts a new one and its watches fire again.  The session
+         * is expired by closing another handle on it.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        TestZKEventRecorder recorder;
+        zk::ZooKeeperAdapter zk(
+            zk::ZooKeeperConfig(globalTestParams.getZkServerPortList(),
+                                30000), 
+            &recorder, 
+            true);
+        string expirePath = _nod0->getKey() + "/" + "_expireTest";
+        zk.deleteNode(expirePath, true, -1);
+        zk.createNode(expirePath, "v0");
+        MPI_CPPUNIT_ASSERT(zk.nodeExists(expirePath, &recorder) == true);
+
+        const clientid_t *clientId = zk.getClientId();
+        MPI_CPPUNIT_ASSERT(clientId != NULL);
+        zhandle_t *otherHandle = 
+            zookeeper_init(globalTestParams.getZkServerPortList().c_str(),
+                           NULL,
+                           30000,
+                           clientId,
+                           NULL,
+                           0);
+        MPI_CPPUNIT_ASSERT(otherHandle != NULL);
+        for (int32_t i = 0; 
+             (i < 100) && (zoo_state(otherHandle) != ZOO_CONNECTED_STATE); 
+             ++i) {
+            usleep(100 * 1000);
+        }
+        MPI_CPPUNIT_ASSERT(zoo_state(otherHandle) == ZOO_CONNECTED_STATE);
+        zookeeper_close(otherHandle);
+
+        MPI_CPPUNIT_ASSERT(recorder.waitForEvents(ZOO_SESSION_EVENT,
+                                                  ZOO_EXPIRED_SESSION_STATE,
+                                                  1,
+                                                  30000));
+        MPI_CPPUNIT_ASSERT(recorder.waitForEvents(ZOO_SESSION_EVENT,
+                                                  ZOO_CONNECTED_STATE,
+                                                  2,
+                                                  30000));
+
+        /* 
+         * Either the watch was set again before the change or the
+         * change is reported as missed, the listener gets it once.
+         */
+        _zk->setNodeData(expirePath, "v1");
+        MPI_CPPUNIT_ASSERT(recorder.waitForEvents(ZOO_CHANGED_EVENT,
+                                                  ZOO_CONNECTED_STATE,
+                                                  1,
+                                                  10000));
+        MPI_CPPUNIT_ASSERT(recorder.waitForEvents(ZOO_SESSION_EVENT,
+                                                  ZOO_EXPIRED_SESSION_STATE,
+                                                  2,
+                                                  1000) == false);
+
+        zk.deleteNode(expirePath);
+    }
+
+    void testRepository14()
+    {
+        initializeAndBarrierMPITest(-1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testRepository14");
+
+        /*
+         * Test that the repository-driven asynchronous operations
+         * complete like the blocking ones, even if the callback
+         * throws.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        Factory *memFactory = new Factory("inmemory:testRepository14");
+        shared_ptr<Root> memRoot = memFactory->createClient()->getRoot();
+        shared_ptr<Application> app = memRoot->getApplication(
+            "memApp", CREATE_IF_NOT_FOUND);
+        app->getGroup("group0", CREATE_IF_NOT_FOUND);
+        app->getNode("node0", CREATE_IF_NOT_FOUND);
+        shared_ptr<PropertyList> propList = app->getPropertyList(
+            CLString::DEFAULT_PROPERTYLIST, CREATE_IF_NOT_FOUND);
+
+        TestAsyncCallback callback(true);
+        shared_ptr<AsyncResult<NotifyableList> > childrenResult = 
+            app->getMyChildrenAsync(&callback);
+        MPI_CPPUNIT_ASSERT(childrenResult->waitMsecs(10000));
+        MPI_CPPUNIT_ASSERT(!childrenResult->hasFailed());
+        MPI_CPPUNIT_ASSERT(childrenResult->get().size() == 3);
+        MPI_CPPUNIT_ASSERT(childrenResult->get().size() == 
+                           app->getMyChildren().size());
+
+        propList->cachedKeyValues().set(
+            "async", json::JSONValue::JSONInteger(1));
+        shared_ptr<AsyncResult<int32_t> > publishResult = 
+            propList->cachedKeyValues().publishAsync(false, &callback);
+        MPI_CPPUNIT_ASSERT(publishResult->waitMsecs(10000));
+        MPI_CPPUNIT_ASSERT(!publishResult->hasFailed());
+        MPI_CPPUNIT_ASSERT(publishResult->get() == 
+                           propList->cachedKeyValues().getVersion());
+
+        /* Callbacks run after the waiters are woken up. */
+        for (int32_t i = 0; (i < 100) && (callback.getCount() < 2); ++i) {
+            usleep(10000);
+        }
+        MPI_CPPUNIT_ASSERT(callback.getCount() == 2);
+
+        /* 
+         * Conditional publishes issued back to back expect the same
+         * version, so only the first one succeeds.
+         */
+        shared_ptr<AsyncResult<int32_t> > firstResult = 
+            propList->cachedKeyValues().publishAsync();
+        shared_ptr<AsyncResult<int32_t> > secondResult = 
+            propList->cachedKeyValues().publishAsync();
+        MPI_CPPUNIT_ASSERT(firstResult->get() > publishResult->get());
+        bool caught = false;
+        try {
+            secondResult->get();
+        }
+        catch (PublishVersionException &e) {
+            caught = true;
+        }
+        MPI_CPPUNIT_ASSERT(caught);
+        shared_ptr<AsyncResult<int32_t> > unconditionalResult = 
+            propList->cachedKeyValues().publishAsync(true);
+        MPI_CPPUNIT_ASSERT(unconditionalResult->get() > firstResult->get());
+        MPI_CPPUNIT_ASSERT(unconditionalResult->get() == 
+                           propList->cachedKeyValues().getVersion());
+
+        app->remove(true);
+        delete memFactory;
+    }
+
+  private:
+    Factory *_factory;
+    Client *_client0;
+    shared_ptr<Application> _app0;
+    shared_ptr<Node> _nod0;
+    zk::Repository *_zk;
+};
+
+/* Registers the fixture into the 'registry' */
+CPPUNIT_TEST_SUITE_REGISTRATION(ClusterlibRepository);
@@ -13,7 +13,7 @@
  * $Id$
  */
 
-#include "clusterlib.h"
+#include "clusterlibinternal.h"
 #include "testparams.h"
 #include "MPITestFixture.h"
 
@@ -76,6 +76,58 @@ class MyTimerEventHandler
     int32_t counter;
 };
 
+/*
+ * Records the timer events of a Timer in the order they fire.
+ */
+class TimerEventRecorder
+    : public EventListener<TimerEvent<int32_t> >
+{
+  public:
+    virtual void eventReceived(const EventSource<TimerEvent<int32_t> > &source,
+                               const TimerEvent<int32_t> &e)
+    {
+        Locker l(&m_lock);
+        m_eventVec.push_back(e);
+    }
+
+    /*
+     * Wait until count events have fired.
+     *
+     * @return true if they fired within msecTimeout
+     */
+    bool waitForEvents(size_t count, int64_t msecTimeout)
+    {
+        int64_t endMsecs = TimerService::getCurrentTimeMsecs() + msecTimeout;
+        while (TimerService::getCurrentTimeMsecs() < endMsecs) {
+            {
+                Locker l(&m_lock);
+                if (m_eventVec.size() >= count) {
+                    return true;
+                }
+            }
+            usleep(10000);
+        }
+        return false;
+    }
+
+    vector<TimerEvent<int32_t> > getEvents()
+    {
+        Locker l(&m_lock);
+        return m_eventVec;
+    }
+
+  private:
+    /**
+     * Protects m_eventVec.
+     */
+    Mutex m_lock;
+
+    /*
+     * The events in the order they fired.
+     */
+    vector<TimerEvent<int32_t> > m_eventVec;
+};
+
 /*
  * The test class itself.
  */
@@ -86,6 +138,8 @@ class ClusterlibTimer
     CPPUNIT_TEST(testTimer1);
     CPPUNIT_TEST(testTimer2);
     CPPUNIT_TEST(testTimer3);
+    CPPUNIT_TEST(testTimer4);
+    CPPUNIT_TEST(testTimer5);
     CPPUNIT_TEST_SUITE_END();
 
   public:
@@ -192,6 +246,83 @@ class ClusterlibTimer
         MPI_CPPUNIT_ASSERT(_timer0->getCounter() == 2);
     }
 
+    void testTimer4()
+    {
+        initializeAndBarrierMPITest(-1,
+                                    true,
+                                    _factory,
+                                    true,
+                                    "testTimer4");
+
+        /*
+         * Events scheduled out of order, some at the same time, fire
+         * in the order of their alarm times, and the cancelled ones
+         * (including the earliest) never fire.
+         */
+        TimerEventRecorder recorder;
+        Timer<int32_t> timer;
+        timer.addListener(&recorder);
+
+        const int32_t eventCount = 60;
+        int64_t baseMsecs = TimerService::getCurrentTimeMsecs() + 300;
+        vector<TimerId> idVec;
+        for (int32_t i = 0; i < eventCount; ++i) {
+            idVec.push_back(timer.scheduleAt(
+                                baseMsecs + ((i * 37) % 20) * 20, i));
+        }
+        TimerId earliestId = idVec[0];
+        set<int32_t> cancelledSet;
+        for (int32_t i = 0; i < eventCount; i += 3) {
+            MPI_CPPUNIT_ASSERT(timer.cancelAlarm(idVec[i]) == true);
+            cancelledSet.insert(i);
+        }
+        MPI_CPPUNIT_ASSERT(timer.cancelAlarm(earliestId) == false);
+
+        size_t expectedCount = eventCount - cancelledSet.size();
+        MPI_CPPUNIT_ASSERT(recorder.waitForEvents(expectedCount, 10000));
+        usleep(100000);
+        vector<TimerEvent<int32_t> > eventVec = recorder.getEvents();
+        MPI_CPPUNIT_ASSERT(eventVec.size() == expectedCount);
+        for (size_t i = 0; i < eventVec.size(); ++i) {
+            MPI_CPPUNIT_ASSERT(cancelledSet.find(eventVec[i].getUserData()) ==
+                               cancelledSet.end());
+            if (i > 0) {
+                MPI_CPPUNIT_ASSERT(eventVec[i - 1].getAlarmTime() <= 
+                                   eventVec[i].getAlarmTime());
+            }
+        }
+        timer.removeListener(&recorder);
+    }
+
+    void testTimer5()
+    {
+        initializeAndBarrierMPITest(-1,
+                                    true,
+                                    _factory,
+                                    true,
+                                    "testTimer5");
+
+        /*
+         * An event scheduled earlier than every pending one fires
+         * first without waiting for the others, and a fired event
+         * can no longer be cancelled.
+         */
+        TimerEventRecorder recorder;
+        Timer<int32_t> timer;
+        timer.addListener(&recorder);
+
+        TimerId lateId = timer.scheduleAfter(60000, 1);
+        TimerId soonId = timer.scheduleAfter(100, 2);
+        MPI_CPPUNIT_ASSERT(recorder.waitForEvents(1, 5000));
+        vector<TimerEvent<int32_t> > eventVec = recorder.getEvents();
+        MPI_CPPUNIT_ASSERT(eventVec.size() == 1);
+        MPI_CPPUNIT_ASSERT(eventVec[0].getID() == soonId);
+        MPI_CPPUNIT_ASSERT(timer.cancelAlarm(soonId) == false);
+        MPI_CPPUNIT_ASSERT(timer.cancelAlarm(lateId) == true);
+        MPI_CPPUNIT_ASSERT(timer.cancelAlarm(lateId) == false);
+        timer.removeListener(&recorder);
+    }
+
   private:
     Factory *_factory;
     Client *_client0;
@@ -199,7 +330,7 @@ class ClusterlibTimer
     shared_ptr<Group> _grp0;
     shared_ptr<Node> _nod0;
     shared_ptr<DataDistribution> _dist0;
-    zk::ZooKeeperAdapter *_zk;
+    zk::Repository *_zk;
     MyTimerEventHandler *_timer0;
 };
 
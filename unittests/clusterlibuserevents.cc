@@ -16,6 +16,7 @@
 #include "clusterlib.h"
 #include "testparams.h"
 #include "MPITestFixture.h"
+#include <poll.h>
 
 extern TestParams globalTestParams;
 
@@ -98,6 +99,151 @@ class MyUserEventHandler
     int32_t m_targetCounter;
 };
 
+/*
+ * A user event handler that records the events it is called with.
+ */
+class RecordingUserEventHandler
+    : public UserEventHandler
+{
+  public:
+    /*
+     * Constructor.
+     */
+    RecordingUserEventHandler(const shared_ptr<Notifyable> &notifyableSP,
+                              Event mask)
+        : UserEventHandler(notifyableSP, mask, NULL)
+    {
+    }
+
+    virtual void handleUserEvent(Event e)
+    {
+        Locker l(&m_lock);
+        m_eventVec.push_back(e);
+    }
+
+    vector<Event> getEvents()
+    {
+        Locker l(&m_lock);
+        return m_eventVec;
+    }
+
+  private:
+    /**
+     * Protects m_eventVec.
+     */
+    Mutex m_lock;
+
+    /*
+     * The events in the order they were handled.
+     */
+    vector<Event> m_eventVec;
+};
+
+/*
+ * A user event handler that blocks until it is released.
+ */
+class BlockingUserEventHandler
+    : public UserEventHandler
+{
+  public:
+    /*
+     * Constructor.
+     */
+    BlockingUserEventHandler(const shared_ptr<Notifyable> &notifyableSP,
+                             Event mask,
+                             bool initialRun = false)
+        : UserEventHandler(notifyableSP, mask, NULL, initialRun),
+          m_started(false),
+          m_counter(0)
+    {
+    }
+
+    virtual void handleUserEvent(Event e)
+    {
+        {
+            Locker l(&m_lock);
+            m_started = true;
+        }
+        /* Give up after a while so that a failed test still ends. */
+        m_release.predWaitMsecs(10000);
+        Locker l(&m_lock);
+        m_counter++;
+    }
+
+    void release()
+    {
+        m_release.predSignal();
+    }
+
+    /*
+     * Wait until handleUserEvent() is called.
+     *
+     * @return true if it was called within msecTimeout
+     */
+    bool waitForStart(int64_t msecTimeout)
+    {
+        for (int64_t i = 0; i < msecTimeout; i += 10) {
+            {
+                Locker l(&m_lock);
+                if (m_started) {
+                    return true;
+                }
+            }
+            usleep(10000);
+        }
+        return false;
+    }
+
+    int32_t getCounter() 
+    { 
+        Locker l(&m_lock);
+        return m_counter; 
+    }
+
+  private:
+    /**
+     * Signaled to let handleUserEvent() return.
+     */
+    PredMutexCond m_release;
+
+    /**
+     * Coordinating mutex
+     */
+    Mutex m_lock;
+
+    /*
+     * Was handleUserEvent() called?
+     */
+    bool m_started;
+
+    /*
+     * Counter for how many times the handler was
+     * called.
+     */
+    int32_t m_counter;
+};
+
+/*
+ * Releases a BlockingUserEventHandler after a delay on its own thread.
+ */
+class DelayedRelease
+{
+  public:
+    DelayedRelease(BlockingUserEventHandler &handler, int64_t msecDelay)
+        : m_handler(handler),
+          m_msecDelay(msecDelay) {}
+
+    void run(void *param)
+    {
+        usleep(m_msecDelay * 1000);
+        m_handler.release();
+    }
+
+  private:
+    BlockingUserEventHandler &m_handler;
+    int64_t m_msecDelay;
+};
+
 /*
  * The test class.
  */
@@ -109,6 +255,11 @@ class ClusterlibUserEvents
     CPPUNIT_TEST(testUserEvents2);
     CPPUNIT_TEST(testUserEvents3);
     CPPUNIT_TEST(testUserEvents4);
+    CPPUNIT_TEST(testUserEvents5);
+    CPPUNIT_TEST(testUserEvents6);
+    CPPUNIT_TEST(testUserEvents7);
+    CPPUNIT_TEST(testUserEvents8);
+    CPPUNIT_TEST(testUserEvents9);
     CPPUNIT_TEST_SUITE_END();
 
   public:
@@ -398,6 +549,310 @@ class ClusterlibUserEvents
 
         MPI_CPPUNIT_ASSERT(ueh.getCounter() == 1);
     }
+    void testUserEvents5()
+    {
+        initializeAndBarrierMPITest(1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testUserEvents5");
+
+        /*
+         * A client with several handler threads keeps running the
+         * handlers of other Notifyables while one handler blocks.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        Client *client = _factory->createClient(4);
+        MPI_CPPUNIT_ASSERT(client != NULL);
+        BlockingUserEventHandler blockingHandler(_propList0,
+                                                 EN_PROPLISTVALUESCHANGE);
+        client->registerHandler(&blockingHandler);
+
+        const int32_t propListCount = 8;
+        vector<shared_ptr<PropertyList> > propLists;
+        vector<MyUserEventHandler *> handlers;
+        for (int32_t i = 0; i < propListCount; ++i) {
+            ostringstream oss;
+            oss << "propList" << (i + 1);
+            propLists.push_back(
+                _grp0->getPropertyList(oss.str(), CREATE_IF_NOT_FOUND));
+            MPI_CPPUNIT_ASSERT(propLists.back() != NULL);
+            handlers.push_back(
+                new MyUserEventHandler(propLists.back(),
+                                       EN_PROPLISTVALUESCHANGE,
+                                       NULL));
+            client->registerHandler(handlers.back());
+        }
+
+        _propList0->cachedKeyValues().set("name", "test");
+        _propList0->cachedKeyValues().publish(true);
+        for (int32_t i = 0; i < propListCount; ++i) {
+            propLists[i]->cachedKeyValues().set("name", "test");
+            propLists[i]->cachedKeyValues().publish(true);
+        }
+
+        /*
+         * The Notifyables are spread across the threads, so some of
+         * the other handlers run while the blocking one waits.
+         */
+        bool handled = false;
+        for (int32_t i = 0; (i < 500) && !handled; ++i) {
+            for (int32_t j = 0; j < propListCount; ++j) {
+                if (handlers[j]->getCounter() > 0) {
+                    handled = true;
+                }
+            }
+            if (!handled) {
+                usleep(10000);
+            }
+        }
+        MPI_CPPUNIT_ASSERT(handled);
+        MPI_CPPUNIT_ASSERT(blockingHandler.getCounter() == 0);
+        blockingHandler.release();
+
+        MPI_CPPUNIT_ASSERT(client->cancelHandler(&blockingHandler) == true);
+        for (int32_t i = 0; i < propListCount; ++i) {
+            MPI_CPPUNIT_ASSERT(client->cancelHandler(handlers[i]) == true);
+            propLists[i]->remove();
+        }
+        MPI_CPPUNIT_ASSERT(_factory->removeClient(client) == true);
+        for (int32_t i = 0; i < propListCount; ++i) {
+            delete handlers[i];
+        }
+    }
+    void testUserEvents6()
+    {
+        initializeAndBarrierMPITest(1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testUserEvents6");
+
+        /*
+         * A client without handler threads runs the handlers from
+         * the loop polling its event file descriptor.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        MPI_CPPUNIT_ASSERT(_client0->getEventFd() == -1);
+        Client *client = _factory->createClient(0);
+        MPI_CPPUNIT_ASSERT(client != NULL);
+        MPI_CPPUNIT_ASSERT(client->getEventFd() != -1);
+        MPI_CPPUNIT_ASSERT(client->dispatchPending(10) == 0);
+
+        MyUserEventHandler ueh(_propList0, EN_PROPLISTVALUESCHANGE, NULL);
+        client->registerHandler(&ueh);
+        _propList0->cachedKeyValues().set("name", "test");
+        _propList0->cachedKeyValues().publish(true);
+
+        struct pollfd pfd;
+        pfd.fd = client->getEventFd();
+        pfd.events = POLLIN;
+        for (int32_t i = 0; (i < 100) && (ueh.getCounter() == 0); ++i) {
+            pfd.revents = 0;
+            if ((poll(&pfd, 1, 100) == 1) && (pfd.revents & POLLIN)) {
+                client->dispatchPending(10);
+            }
+        }
+        MPI_CPPUNIT_ASSERT(ueh.getCounter() == 1);
+
+        /* Nothing is pending any more. */
+        pfd.revents = 0;
+        MPI_CPPUNIT_ASSERT(poll(&pfd, 1, 0) == 0);
+
+        MPI_CPPUNIT_ASSERT(client->cancelHandler(&ueh) == true);
+        MPI_CPPUNIT_ASSERT(_factory->removeClient(client) == true);
+    }
+    void testUserEvents7()
+    {
+        initializeAndBarrierMPITest(1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testUserEvents7");
+
+        /*
+         * Events are only sent to the clients with a handler for the
+         * Notifyable whose mask matches the event.  The client
+         * without handler threads shows whether anything was sent
+         * to it on its event file descriptor.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        shared_ptr<PropertyList> propList1 = 
+            _grp0->getPropertyList("propList1", CREATE_IF_NOT_FOUND);
+        MPI_CPPUNIT_ASSERT(propList1 != NULL);
+        Client *client = _factory->createClient(0);
+        MPI_CPPUNIT_ASSERT(client != NULL);
+        MyUserEventHandler otherHandler(propList1, 
+                                        EN_PROPLISTVALUESCHANGE, 
+                                        NULL);
+        client->registerHandler(&otherHandler);
+        MyUserEventHandler otherMaskHandler(_propList0, 
+                                            EN_LOCKNODECHANGE, 
+                                            NULL);
+        client->registerHandler(&otherMaskHandler);
+
+        MyUserEventHandler ueh(_propList0, EN_PROPLISTVALUESCHANGE, NULL);
+        ueh.acquireLock();
+        ueh.setTargetCounter(1);
+        _client0->registerHandler(&ueh);
+        _propList0->cachedKeyValues().set("name", "test");
+        _propList0->cachedKeyValues().publish(true);
+        MPI_CPPUNIT_ASSERT(ueh.waitUntilCondition() == true);
+        ueh.releaseLock();
+
+        /* Nothing was sent to the other client. */
+        struct pollfd pfd;
+        pfd.fd = client->getEventFd();
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        MPI_CPPUNIT_ASSERT(poll(&pfd, 1, 500) == 0);
+
+        /* A mask changed after registering is honored. */
+        otherMaskHandler.setMask(EN_LOCKNODECHANGE | EN_PROPLISTVALUESCHANGE);
+        _propList0->cachedKeyValues().set("name", "test2");
+        _propList0->cachedKeyValues().publish(true);
+        propList1->cachedKeyValues().set("name", "test");
+        propList1->cachedKeyValues().publish(true);
+        for (int32_t i = 0; 
+             (i < 100) && ((otherHandler.getCounter() == 0) ||
+                           (otherMaskHandler.getCounter() == 0)); 
+             ++i) {
+            pfd.revents = 0;
+            if ((poll(&pfd, 1, 100) == 1) && (pfd.revents & POLLIN)) {
+                client->dispatchPending(10);
+            }
+        }
+        MPI_CPPUNIT_ASSERT(otherHandler.getCounter() == 1);
+        MPI_CPPUNIT_ASSERT(otherMaskHandler.getCounter() == 1);
+
+        MPI_CPPUNIT_ASSERT(_client0->cancelHandler(&ueh) == true);
+        MPI_CPPUNIT_ASSERT(client->cancelHandler(&otherHandler) == true);
+        MPI_CPPUNIT_ASSERT(client->cancelHandler(&otherMaskHandler) == true);
+        MPI_CPPUNIT_ASSERT(_factory->removeClient(client) == true);
+        propList1->remove();
+    }
+    void testUserEvents8()
+    {
+        initializeAndBarrierMPITest(1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testUserEvents8");
+
+        /*
+         * A handler that merges its events is still called with one
+         * event at a time, once for each kind of event queued.  The
+         * client without handler threads lets the events queue up
+         * until they are dispatched.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        Client *client = _factory->createClient(0);
+        MPI_CPPUNIT_ASSERT(client != NULL);
+        RecordingUserEventHandler ueh(
+            _grp0, EN_NODESCHANGE | EN_PROPLISTSCHANGE | EN_COALESCE);
+        MPI_CPPUNIT_ASSERT(ueh.getCoalesce());
+        client->registerHandler(&ueh);
+
+        shared_ptr<Node> node1 = 
+            _grp0->getNode("node1", CREATE_IF_NOT_FOUND);
+        MPI_CPPUNIT_ASSERT(node1 != NULL);
+        shared_ptr<PropertyList> propList1 = 
+            _grp0->getPropertyList("propList1", CREATE_IF_NOT_FOUND);
+        MPI_CPPUNIT_ASSERT(propList1 != NULL);
+        shared_ptr<Node> node2 = 
+            _grp0->getNode("node2", CREATE_IF_NOT_FOUND);
+        MPI_CPPUNIT_ASSERT(node2 != NULL);
+
+        struct pollfd pfd;
+        pfd.fd = client->getEventFd();
+        pfd.events = POLLIN;
+        Event handled = EN_NOEVENT;
+        for (int32_t i = 0; 
+             (i < 100) && 
+                 (handled != (EN_NODESCHANGE | EN_PROPLISTSCHANGE)); 
+             ++i) {
+            pfd.revents = 0;
+            if ((poll(&pfd, 1, 100) == 1) && (pfd.revents & POLLIN)) {
+                /* Let the other events queue up behind the first. */
+                usleep(200000);
+                client->dispatchPending(100);
+            }
+            vector<Event> events = ueh.getEvents();
+            for (size_t j = 0; j < events.size(); ++j) {
+                handled |= events[j];
+            }
+        }
+        MPI_CPPUNIT_ASSERT(handled == (EN_NODESCHANGE | EN_PROPLISTSCHANGE));
+
+        /* Each call got a single event of the mask. */
+        vector<Event> events = ueh.getEvents();
+        for (size_t i = 0; i < events.size(); ++i) {
+            MPI_CPPUNIT_ASSERT((events[i] != EN_NOEVENT) &&
+                               ((events[i] & (events[i] - 1)) == 0));
+            MPI_CPPUNIT_ASSERT((events[i] & 
+                                (EN_NODESCHANGE | EN_PROPLISTSCHANGE)) != 0);
+        }
+
+        MPI_CPPUNIT_ASSERT(client->cancelHandler(&ueh) == true);
+        MPI_CPPUNIT_ASSERT(_factory->removeClient(client) == true);
+        node1->remove();
+        node2->remove();
+        propList1->remove();
+    }
+    void testUserEvents9()
+    {
+        initializeAndBarrierMPITest(1, 
+                                    true, 
+                                    _factory, 
+                                    true, 
+                                    "testUserEvents9");
+
+        /*
+         * Once cancelHandler() returns, a handler worker no longer
+         * runs the initial run of the handler: a queued one is
+         * dropped and one in progress is waited for.
+         */
+        if (!isMyRank(0)) {
+            return;
+        }
+
+        /* Both handlers are on one Notifyable, so on one worker. */
+        Client *client = _factory->createClient(2);
+        MPI_CPPUNIT_ASSERT(client != NULL);
+        BlockingUserEventHandler runningHandler(
+            _propList0, EN_PROPLISTVALUESCHANGE, true);
+        BlockingUserEventHandler queuedHandler(
+            _propList0, EN_PROPLISTVALUESCHANGE, true);
+        client->registerHandler(&runningHandler);
+        client->registerHandler(&queuedHandler);
+        MPI_CPPUNIT_ASSERT(runningHandler.waitForStart(5000));
+
+        MPI_CPPUNIT_ASSERT(client->cancelHandler(&queuedHandler) == true);
+        queuedHandler.release();
+
+        DelayedRelease delayedRelease(runningHandler, 300);
+        CXXThread<DelayedRelease> releaseThread;
+        releaseThread.Create(delayedRelease, &DelayedRelease::run);
+        MPI_CPPUNIT_ASSERT(runningHandler.getCounter() == 0);
+        MPI_CPPUNIT_ASSERT(client->cancelHandler(&runningHandler) == true);
+        MPI_CPPUNIT_ASSERT(runningHandler.getCounter() == 1);
+        releaseThread.Join();
+
+        MPI_CPPUNIT_ASSERT(_factory->removeClient(client) == true);
+        MPI_CPPUNIT_ASSERT(queuedHandler.getCounter() == 0);
+    }
 
   private:
     Factory *_factory;
@@ -405,7 +860,7 @@ class ClusterlibUserEvents
     shared_ptr<Application> _app0;
     shared_ptr<Group> _grp0;
     shared_ptr<PropertyList> _propList0;
-    zk::ZooKeeperAdapter *_zk;
+    zk::Repository *_zk;
 };
 
 /* Registers the fixture into the 'registry' */